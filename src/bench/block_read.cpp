@@ -0,0 +1,63 @@
+// Copyright (c) 2021 pacprotocol
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+
+#include <chainparams.h>
+#include <clientversion.h>
+#include <random.h>
+#include <streams.h>
+#include <validation.h>
+
+#include <bench/data/block813851.raw.h>
+
+#include <vector>
+
+//! Copies of the test block written to the block file, ~24MB
+static const int BLOCK_COPIES = 32;
+
+//! Write BLOCK_COPIES copies of the test block to blk00000.dat, the way
+//! WriteBlockToDisk stores blocks, and return their positions
+static std::vector<CDiskBlockPos> WriteBenchBlockFile()
+{
+    CAutoFile fileout(fsbridge::fopen(GetBlockPosFilename(CDiskBlockPos(0, 0), "blk"), "wb"), SER_DISK, CLIENT_VERSION);
+    assert(!fileout.IsNull());
+
+    std::vector<CDiskBlockPos> positions;
+    for (int i = 0; i < BLOCK_COPIES; i++) {
+        fileout << Params().MessageStart() << (unsigned int)sizeof(raw_bench::block813851);
+        positions.emplace_back(0, (unsigned int)ftell(fileout.Get()));
+        fileout.write((const char*)raw_bench::block813851, sizeof(raw_bench::block813851));
+    }
+    return positions;
+}
+
+static void ReadBlocksRandomly(benchmark::State& state, size_t nMappedFiles)
+{
+    SelectParams(CBaseChainParams::REGTEST);
+    const std::vector<CDiskBlockPos> positions = WriteBenchBlockFile();
+    SetMappedBlockFiles(nMappedFiles);
+
+    FastRandomContext rng(true);
+    while (state.KeepRunning()) {
+        CBlock block;
+        assert(ReadBlockFromDisk(block, positions[rng.randrange(positions.size())], Params().GetConsensus()));
+    }
+
+    SetMappedBlockFiles(0);
+    fs::remove(GetBlockPosFilename(CDiskBlockPos(0, 0), "blk"));
+}
+
+static void ReadBlockFromDiskStdio(benchmark::State& state)
+{
+    ReadBlocksRandomly(state, 0);
+}
+
+static void ReadBlockFromDiskMapped(benchmark::State& state)
+{
+    ReadBlocksRandomly(state, DEFAULT_MMAP_BLOCK_FILES > 0 ? DEFAULT_MMAP_BLOCK_FILES : 1);
+}
+
+BENCHMARK(ReadBlockFromDiskStdio, 100);
+BENCHMARK(ReadBlockFromDiskMapped, 130);
@@ -4,9 +4,13 @@
 
 #include <bench/bench.h>
 #include <coins.h>
+#include <memusage.h>
 #include <policy/policy.h>
+#include <random.h>
+#include <tinyformat.h>
 #include <wallet/crypter.h>
 
+#include <iostream>
 #include <vector>
 
 // FIXME: Dedup with SetupDummyInputs in test/transaction_tests.cpp.
@@ -85,3 +89,62 @@ static void CCoinsCaching(benchmark::State& state)
 }
 
 BENCHMARK(CCoinsCaching, 170 * 1000);
+
+static const size_t COINS_CACHE_BENCH_SIZE = 100000;
+
+static void FillCoinsCache(CCoinsViewCache& cache, std::vector<COutPoint>& outpoints, size_t nCoins)
+{
+    FastRandomContext rng(true);
+    CScript script = GetScriptForDestination(CKeyID(uint160(rng.randbytes(20))));
+    outpoints.clear();
+    outpoints.reserve(nCoins);
+    for (size_t i = 0; i < nCoins; i++) {
+        outpoints.emplace_back(rng.rand256(), rng.randrange(4));
+        cache.AddCoin(outpoints.back(), Coin(CTxOut(rng.randrange(COIN), script), (int)i, false, false), false);
+    }
+}
+
+// Cost of filling a cache with P2PKH coins. Also reports how many coins fit in
+// a MiB of -dbcache, next to the one malloc per node estimate the pool
+// allocator replaced.
+static void CCoinsCachingFill(benchmark::State& state)
+{
+    CCoinsView coinsDummy;
+    std::vector<COutPoint> outpoints;
+    while (state.KeepRunning()) {
+        CCoinsViewCache cache(&coinsDummy);
+        FillCoinsCache(cache, outpoints, COINS_CACHE_BENCH_SIZE);
+    }
+
+    CCoinsViewCache cache(&coinsDummy);
+    FillCoinsCache(cache, outpoints, COINS_CACHE_BENCH_SIZE);
+    size_t nCoinsUsage = 0;
+    for (const COutPoint& outpoint : outpoints) {
+        nCoinsUsage += cache.AccessCoin(outpoint).DynamicMemoryUsage();
+    }
+    size_t nMallocUsage = memusage::MallocUsage(sizeof(memusage::unordered_node<std::pair<const COutPoint, CCoinsCacheEntry>>)) * outpoints.size() +
+                          memusage::MallocUsage(sizeof(void*) * outpoints.size()) + nCoinsUsage;
+    const double nMiB = 1024.0 * 1024.0;
+    std::cerr << strprintf("CCoinsCachingFill: %u coins use %.2f MiB, %.0f coins per MiB (%.0f with one malloc per node)\n",
+        outpoints.size(), cache.DynamicMemoryUsage() / nMiB,
+        outpoints.size() * nMiB / cache.DynamicMemoryUsage(), outpoints.size() * nMiB / nMallocUsage);
+}
+
+// Lookup throughput of a warm cache
+static void CCoinsCachingLookup(benchmark::State& state)
+{
+    CCoinsView coinsDummy;
+    CCoinsViewCache cache(&coinsDummy);
+    std::vector<COutPoint> outpoints;
+    FillCoinsCache(cache, outpoints, COINS_CACHE_BENCH_SIZE);
+
+    size_t i = 0;
+    while (state.KeepRunning()) {
+        bool found = cache.HaveCoinInCache(outpoints[i]);
+        assert(found);
+        i = (i + 7919) % outpoints.size();
+    }
+}
+
+BENCHMARK(CCoinsCachingFill, 2);
+BENCHMARK(CCoinsCachingLookup, 5 * 1000 * 1000);
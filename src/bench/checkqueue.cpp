@@ -3,6 +3,7 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include <bench/bench.h>
+#include <crypto/sha256.h>
 #include <util.h>
 #include <validation.h>
 #include <checkqueue.h>
@@ -60,3 +61,53 @@ static void CCheckQueueSpeedPrevectorJob(benchmark::State& state)
     tg.join_all();
 }
 BENCHMARK(CCheckQueueSpeedPrevectorJob, 1400);
+
+// Checks which hash a little, roughly the cost of a signature check divided
+// by ten, so the scaling benchmarks below measure the queue and not only the
+// work.
+struct HashJob {
+    unsigned char data[32] = {};
+    bool operator()()
+    {
+        for (int i = 0; i < 20; i++) {
+            CSHA256().Write(data, sizeof(data)).Finalize(data);
+        }
+        return true;
+    }
+    void swap(HashJob& x) { std::swap(data, x.data); }
+};
+
+// Verifies 101 batches of 30 checks, like a block of 3000 inputs, on the
+// given number of threads including the master.
+template <typename Queue>
+static void CheckQueueScaling(benchmark::State& state, int nThreads)
+{
+    Queue queue {QUEUE_BATCH_SIZE};
+    boost::thread_group tg;
+    for (int x = 0; x < nThreads - 1; ++x) {
+       tg.create_thread([&]{queue.Thread();});
+    }
+    while (state.KeepRunning()) {
+        CCheckQueueControl<HashJob, Queue> control(&queue);
+        for (size_t i = 0; i < BATCHES; ++i) {
+            std::vector<HashJob> vChecks(BATCH_SIZE);
+            control.Add(vChecks);
+        }
+        control.Wait();
+    }
+    tg.interrupt_all();
+    tg.join_all();
+}
+
+#define CHECKQUEUE_SCALING_BENCHMARKS(name, threads, iters) \
+    static void CCheckQueueScaling_##name(benchmark::State& state) { CheckQueueScaling<CCheckQueue<HashJob>>(state, threads); } \
+    static void CWorkStealingCheckQueueScaling_##name(benchmark::State& state) { CheckQueueScaling<CWorkStealingCheckQueue<HashJob>>(state, threads); } \
+    BENCHMARK(CCheckQueueScaling_##name, iters); \
+    BENCHMARK(CWorkStealingCheckQueueScaling_##name, iters);
+
+CHECKQUEUE_SCALING_BENCHMARKS(01, 1, 20)
+CHECKQUEUE_SCALING_BENCHMARKS(02, 2, 40)
+CHECKQUEUE_SCALING_BENCHMARKS(04, 4, 80)
+CHECKQUEUE_SCALING_BENCHMARKS(08, 8, 160)
+CHECKQUEUE_SCALING_BENCHMARKS(16, 16, 320)
+CHECKQUEUE_SCALING_BENCHMARKS(32, 32, 640)
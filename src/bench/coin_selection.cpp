@@ -3,6 +3,13 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include <bench/bench.h>
+#include <chainparams.h>
+#include <coinjoin/coinjoin.h>
+#include <evo/deterministicmns.h>
+#include <evo/evodb.h>
+#include <key.h>
+#include <validation.h>
+#include <wallet/coincontrol.h>
 #include <wallet/wallet.h>
 #include <wallet/coinselection.h>
 
@@ -104,5 +111,94 @@ static void BnBExhaustion(benchmark::State& state)
     }
 }
 
+// AvailableCoins() over a wallet holding nOutputs confirmed outputs, a tenth
+// of them denominations and a tenth collaterals, the rest plain amounts.
+static void AvailableCoins(benchmark::State& state, int nOutputs, CoinType nCoinType)
+{
+    static const int OUTPUTS_PER_TX = 100;
+
+    SelectParams(CBaseChainParams::REGTEST);
+    // the outputs are bucketed by denomination as they are added
+    CCoinJoin::InitStandardDenominations();
+    // AddToWallet() looks up masternode collaterals in the list at the tip
+    evoDb.reset(new CEvoDB(1 << 20, true, true));
+    deterministicMNManager.reset(new CDeterministicMNManager(*evoDb));
+
+    // a tip to confirm the transactions in
+    CBlockIndex* pindex = new CBlockIndex();
+    {
+        LOCK(cs_main);
+        pindex->phashBlock = &mapBlockIndex.emplace(GetRandHash(), pindex).first->first;
+        chainActive.SetTip(pindex);
+    }
+
+    std::unique_ptr<CWallet> wallet(new CWallet(WalletLocation(), WalletDatabase::CreateMock()));
+    CKey key;
+    key.MakeNewKey(true);
+    CScript scriptPubKey = GetScriptForDestination(key.GetPubKey().GetID());
+    {
+        LOCK2(cs_main, wallet->cs_wallet);
+        wallet->AddKeyPubKey(key, key.GetPubKey());
+
+        for (int i = 0; i < nOutputs; i += OUTPUTS_PER_TX) {
+            CMutableTransaction tx;
+            tx.vin.resize(1);
+            tx.vin[0].prevout = COutPoint(GetRandHash(), 0); // so all transactions get different hashes
+            tx.vout.resize(OUTPUTS_PER_TX);
+            for (int j = 0; j < OUTPUTS_PER_TX; j++) {
+                tx.vout[j].scriptPubKey = scriptPubKey;
+                if (j % 10 == 0) {
+                    tx.vout[j].nValue = CCoinJoin::GetSmallestDenomination();
+                } else if (j % 10 == 1) {
+                    tx.vout[j].nValue = CCoinJoin::GetCollateralAmount();
+                } else {
+                    tx.vout[j].nValue = COIN + j;
+                }
+            }
+            CWalletTx wtx(wallet.get(), MakeTransactionRef(std::move(tx)));
+            wtx.hashBlock = pindex->GetBlockHash();
+            wtx.nIndex = 0;
+            wallet->AddToWallet(wtx);
+        }
+    }
+
+    CCoinControl coinControl;
+    coinControl.nCoinType = nCoinType;
+    std::vector<COutput> vCoins;
+    while (state.KeepRunning()) {
+        LOCK2(cs_main, wallet->cs_wallet);
+        wallet->AvailableCoins(vCoins, true, &coinControl);
+        assert(!vCoins.empty());
+    }
+
+    wallet.reset();
+    {
+        LOCK(cs_main);
+        chainActive.SetTip(nullptr);
+        mapBlockIndex.erase(pindex->GetBlockHash());
+        delete pindex;
+    }
+    deterministicMNManager.reset();
+    evoDb.reset();
+}
+
+static void AvailableCoins100k(benchmark::State& state)
+{
+    AvailableCoins(state, 100000, CoinType::ALL_COINS);
+}
+
+static void AvailableCoins1M(benchmark::State& state)
+{
+    AvailableCoins(state, 1000000, CoinType::ALL_COINS);
+}
+
+static void AvailableCollaterals1M(benchmark::State& state)
+{
+    AvailableCoins(state, 1000000, CoinType::ONLY_COINJOIN_COLLATERAL);
+}
+
 BENCHMARK(CoinSelection, 650);
 BENCHMARK(BnBExhaustion, 650);
+BENCHMARK(AvailableCoins100k, 5);
+BENCHMARK(AvailableCoins1M, 1);
+BENCHMARK(AvailableCollaterals1M, 20);
@@ -0,0 +1,82 @@
+// Copyright (c) 2021 The Dash Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <coins.h>
+#include <script/standard.h>
+#include <txmempool.h>
+
+#include <vector>
+
+static const int NUM_TXS = 1000;
+static const int NUM_ADDRESSES = 50;
+
+static CScript AddressScript(int n)
+{
+    uint160 hash;
+    *hash.begin() = (unsigned char)n;
+    return GetScriptForDestination(CKeyID(hash));
+}
+
+// Fill the mempool with transactions paying to and from a small set of
+// P2PKH addresses and remove them again, which is the churn the mempool
+// address and spent indexes (-addressindex, -spentindex) see.
+static void MempoolAddToRemove(benchmark::State& state, bool fIndexes)
+{
+    CCoinsView coinsDummy;
+    CCoinsViewCache coins(&coinsDummy);
+
+    CMutableTransaction funding;
+    funding.vout.resize(NUM_TXS);
+    for (int i = 0; i < NUM_TXS; i++) {
+        funding.vout[i].nValue = COIN;
+        funding.vout[i].scriptPubKey = AddressScript(i % NUM_ADDRESSES);
+    }
+    AddCoins(coins, funding, 1);
+
+    std::vector<CTransactionRef> txs;
+    txs.reserve(NUM_TXS);
+    for (int i = 0; i < NUM_TXS; i++) {
+        CMutableTransaction tx;
+        tx.vin.resize(1);
+        tx.vin[0].prevout = COutPoint(funding.GetHash(), i);
+        tx.vout.resize(2);
+        tx.vout[0].nValue = COIN / 2;
+        tx.vout[0].scriptPubKey = AddressScript((i + 1) % NUM_ADDRESSES);
+        tx.vout[1].nValue = COIN / 2 - 1000;
+        tx.vout[1].scriptPubKey = AddressScript((i + 2) % NUM_ADDRESSES);
+        txs.push_back(MakeTransactionRef(tx));
+    }
+
+    CTxMemPool pool;
+    LockPoints lp;
+
+    while (state.KeepRunning()) {
+        for (const auto& tx : txs) {
+            CTxMemPoolEntry entry(tx, 1000, 0, 1, false, 1, lp);
+            LOCK(pool.cs);
+            pool.addUnchecked(tx->GetHash(), entry);
+            if (fIndexes) {
+                pool.addAddressIndex(entry, coins);
+                pool.addSpentIndex(entry, coins);
+            }
+        }
+        for (const auto& tx : txs) {
+            pool.removeRecursive(*tx);
+        }
+    }
+}
+
+static void MempoolAddressIndexNone(benchmark::State& state)
+{
+    MempoolAddToRemove(state, false);
+}
+
+static void MempoolAddressIndex(benchmark::State& state)
+{
+    MempoolAddToRemove(state, true);
+}
+
+BENCHMARK(MempoolAddressIndexNone, 20);
+BENCHMARK(MempoolAddressIndex, 20);
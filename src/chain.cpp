@@ -6,6 +6,40 @@
 #include <chain.h>
 #include <util.h>
 
+constexpr size_t CBlockIndexArena::CHUNK_SIZE;
+
+void CBlockIndexArena::NewChunk(size_t nCapacity)
+{
+    vChunks.push_back(Chunk{std::unique_ptr<Storage[]>(new Storage[nCapacity]), nCapacity, 0});
+}
+
+void CBlockIndexArena::Reserve(size_t n)
+{
+    if (vChunks.empty() || vChunks.back().capacity - vChunks.back().used < n) {
+        NewChunk(std::max(n, CHUNK_SIZE));
+    }
+}
+
+void CBlockIndexArena::Clear()
+{
+    for (Chunk& chunk : vChunks) {
+        for (size_t i = 0; i < chunk.used; i++) {
+            reinterpret_cast<CBlockIndex*>(&chunk.data[i])->~CBlockIndex();
+        }
+    }
+    vChunks.clear();
+    nSize = 0;
+}
+
+size_t CBlockIndexArena::DynamicMemoryUsage() const
+{
+    size_t nUsage = vChunks.capacity() * sizeof(Chunk);
+    for (const Chunk& chunk : vChunks) {
+        nUsage += chunk.capacity * sizeof(Storage);
+    }
+    return nUsage;
+}
+
 /**
  * CChain implementation
  */
@@ -14,6 +14,8 @@
 
 #include <utilmoneystr.h>
 
+#include <memory>
+#include <type_traits>
 #include <vector>
 
 /**
@@ -411,6 +413,60 @@ int64_t GetBlockProofEquivalentTime(const CBlockIndex& to, const CBlockIndex& fr
 const CBlockIndex* LastCommonAncestor(const CBlockIndex* pa, const CBlockIndex* pb);
 
 
+/**
+ * Owns CBlockIndex entries, allocating them in large chunks of contiguous
+ * memory instead of one heap allocation each. Entries allocated one after
+ * the other sit next to each other, so walking entries loaded in height
+ * order touches far fewer cache lines and pages. Entries are freed all at
+ * once by Clear().
+ *
+ * Not thread safe, the block index arena is only used under cs_main.
+ */
+class CBlockIndexArena
+{
+private:
+    static constexpr size_t CHUNK_SIZE = 4096;
+
+    typedef std::aligned_storage<sizeof(CBlockIndex), alignof(CBlockIndex)>::type Storage;
+    struct Chunk {
+        std::unique_ptr<Storage[]> data;
+        size_t capacity;
+        size_t used;
+    };
+    std::vector<Chunk> vChunks;
+    size_t nSize{0};
+
+    void NewChunk(size_t nCapacity);
+
+public:
+    CBlockIndexArena() = default;
+    CBlockIndexArena(const CBlockIndexArena&) = delete;
+    CBlockIndexArena& operator=(const CBlockIndexArena&) = delete;
+    ~CBlockIndexArena() { Clear(); }
+
+    template<typename... Args>
+    CBlockIndex* Allocate(Args&&... args)
+    {
+        if (vChunks.empty() || vChunks.back().used == vChunks.back().capacity) {
+            NewChunk(CHUNK_SIZE);
+        }
+        Chunk& chunk = vChunks.back();
+        CBlockIndex* pindex = new (&chunk.data[chunk.used]) CBlockIndex(std::forward<Args>(args)...);
+        chunk.used++;
+        nSize++;
+        return pindex;
+    }
+
+    /** Make sure the next n entries are allocated contiguously */
+    void Reserve(size_t n);
+
+    /** Destroy all entries, every pointer handed out becomes invalid */
+    void Clear();
+
+    size_t size() const { return nSize; }
+    size_t DynamicMemoryUsage() const;
+};
+
 /** Used to marshal pointers into hashes for db storage. */
 class CDiskBlockIndex : public CBlockIndex
 {
@@ -8,12 +8,20 @@
 #include <sync.h>
 
 #include <algorithm>
+#include <assert.h>
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex>
 #include <vector>
 
 #include <boost/thread/condition_variable.hpp>
 #include <boost/thread/mutex.hpp>
 
 template <typename T>
+class CCheckQueue;
+
+template <typename T, typename Queue = CCheckQueue<T>>
 class CCheckQueueControl;
 
 /**
@@ -163,22 +171,218 @@ public:
 
 };
 
+/**
+ * Work stealing variant of CCheckQueue, for machines with many cores where
+ * the single mutex of CCheckQueue limits how far verification scales.
+ *
+ * Every worker, and the master, has a deque of its own. Add() spreads the
+ * checks over them, workers take batches from the back of their own deque
+ * and steal from the front of the others once it runs dry, so there is no
+ * lock all workers contend on. Batches shrink with the outstanding work so
+ * all workers finish approximately simultaneously.
+ */
+template <typename T>
+class CWorkStealingCheckQueue
+{
+private:
+    struct WorkerQueue {
+        std::mutex mutex;
+        std::deque<T> checks;
+    };
+
+    //! The deques of the master (index 0) and the workers
+    std::vector<std::unique_ptr<WorkerQueue>> vQueues;
+
+    //! Which deques belong to a running thread, worker threads exiting free theirs
+    std::mutex mutexSlots;
+    std::vector<bool> vSlotTaken;
+
+    //! The number of deques in use, including the ones of exited workers
+    std::atomic<int> nSlots{1};
+
+    //! The deque Add() starts spreading the next checks from
+    int nNextQueue{0};
+
+    //! The number of checks waiting in the deques. Workers may take checks
+    //! before Add() counted them, so it can be negative for a moment.
+    std::atomic<int64_t> nQueued{0};
+
+    //! Number of verifications that haven't completed yet, including the
+    //! ones in the batches the workers are processing
+    std::atomic<unsigned int> nTodo{0};
+
+    //! The temporary evaluation result
+    std::atomic<bool> fAllOk{true};
+
+    //! The maximum number of elements to be processed in one batch
+    const unsigned int nBatchSize;
+
+    //! Only used to sleep when out of work
+    boost::mutex mutexSleep;
+    boost::condition_variable condWorker;
+    boost::condition_variable condMaster;
+
+    /** Take a batch from our own deque or steal one from another, returns its size */
+    unsigned int Take(int nSelf, std::vector<T>& vChecks)
+    {
+        const int nSlotsNow = nSlots;
+        const unsigned int nBatch = std::max<int64_t>(1, std::min<int64_t>(nBatchSize, nQueued / (2 * nSlotsNow)));
+        for (int i = 0; i < nSlotsNow; i++) {
+            WorkerQueue& queue = *vQueues[(nSelf + i) % nSlotsNow];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            if (queue.checks.empty()) {
+                continue;
+            }
+            // Leave the victim half of its checks
+            const unsigned int nNow = std::min<size_t>(nBatch, i == 0 ? queue.checks.size() : (queue.checks.size() + 1) / 2);
+            vChecks.resize(nNow);
+            for (unsigned int j = 0; j < nNow; j++) {
+                if (i == 0) {
+                    vChecks[j].swap(queue.checks.back());
+                    queue.checks.pop_back();
+                } else {
+                    vChecks[j].swap(queue.checks.front());
+                    queue.checks.pop_front();
+                }
+            }
+            nQueued -= nNow;
+            return nNow;
+        }
+        return 0;
+    }
+
+    /** Internal function that does bulk of the verification work. */
+    bool Loop(int nSelf)
+    {
+        const bool fMaster = nSelf == 0;
+        std::vector<T> vChecks;
+        vChecks.reserve(nBatchSize);
+        while (true) {
+            const unsigned int nNow = nQueued > 0 ? Take(nSelf, vChecks) : 0;
+            if (nNow == 0) {
+                boost::unique_lock<boost::mutex> lock(mutexSleep);
+                if (fMaster && nTodo == 0) {
+                    bool fRet = fAllOk;
+                    // reset the status for new work later
+                    fAllOk = true;
+                    return fRet;
+                }
+                if (nQueued <= 0) {
+                    (fMaster ? condMaster : condWorker).wait(lock);
+                }
+                continue;
+            }
+
+            // Don't bother once a check failed
+            bool fOk = fAllOk;
+            for (T& check : vChecks)
+                if (fOk)
+                    fOk = check();
+            // Destroy the checks before reporting them done
+            vChecks.clear();
+            if (!fOk)
+                fAllOk = false;
+            if (nTodo.fetch_sub(nNow) == nNow && !fMaster) {
+                // We processed the last element; inform the master it can exit and return the result
+                boost::unique_lock<boost::mutex> lock(mutexSleep);
+                condMaster.notify_one();
+            }
+        }
+    }
+
+public:
+    //! Mutex to ensure only one concurrent CCheckQueueControl
+    boost::mutex ControlMutex;
+
+    //! Create a new check queue for up to nMaxWorkers worker threads
+    explicit CWorkStealingCheckQueue(unsigned int nBatchSizeIn, int nMaxWorkers = 64) : vSlotTaken(nMaxWorkers + 1), nBatchSize(nBatchSizeIn)
+    {
+        for (int i = 0; i <= nMaxWorkers; i++) {
+            vQueues.emplace_back(new WorkerQueue());
+        }
+        vSlotTaken[0] = true;
+    }
+
+    //! Worker thread
+    void Thread()
+    {
+        int nSelf;
+        {
+            std::lock_guard<std::mutex> lock(mutexSlots);
+            nSelf = std::find(vSlotTaken.begin(), vSlotTaken.end(), false) - vSlotTaken.begin();
+            assert(nSelf < (int)vSlotTaken.size());
+            vSlotTaken[nSelf] = true;
+            nSlots = std::max<int>(nSlots, nSelf + 1);
+        }
+        // Workers are stopped by interrupting them, free the slot either way
+        struct SlotRelease {
+            CWorkStealingCheckQueue* queue;
+            int nSelf;
+            ~SlotRelease() {
+                std::lock_guard<std::mutex> lock(queue->mutexSlots);
+                queue->vSlotTaken[nSelf] = false;
+            }
+        } release{this, nSelf};
+        Loop(nSelf);
+    }
+
+    //! Wait until execution finishes, and return whether all evaluations were successful.
+    bool Wait()
+    {
+        return Loop(0);
+    }
+
+    //! Add a batch of checks to the queue
+    void Add(std::vector<T>& vChecks)
+    {
+        if (vChecks.empty()) {
+            return;
+        }
+        // Count them first, so they can't complete before they are counted
+        nTodo += vChecks.size();
+
+        const int nSlotsNow = nSlots;
+        const size_t nPerQueue = (vChecks.size() + nSlotsNow - 1) / nSlotsNow;
+        size_t nPos = 0;
+        for (int i = 0; nPos < vChecks.size(); i++) {
+            WorkerQueue& queue = *vQueues[(nNextQueue + i) % nSlotsNow];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            for (size_t j = 0; j < nPerQueue && nPos < vChecks.size(); j++) {
+                queue.checks.emplace_back();
+                queue.checks.back().swap(vChecks[nPos++]);
+            }
+        }
+        nNextQueue = (nNextQueue + 1) % nSlotsNow;
+        nQueued += vChecks.size();
+
+        // Only wake as many workers as there are checks
+        boost::unique_lock<boost::mutex> lock(mutexSleep);
+        if (vChecks.size() >= (size_t)nSlotsNow) {
+            condWorker.notify_all();
+        } else {
+            for (size_t i = 0; i < vChecks.size(); i++) {
+                condWorker.notify_one();
+            }
+        }
+    }
+};
+
 /**
  * RAII-style controller object for a CCheckQueue that guarantees the passed
  * queue is finished before continuing.
  */
-template <typename T>
+template <typename T, typename Queue>
 class CCheckQueueControl
 {
 private:
-    CCheckQueue<T> * const pqueue;
+    Queue * const pqueue;
     bool fDone;
 
 public:
     CCheckQueueControl() = delete;
     CCheckQueueControl(const CCheckQueueControl&) = delete;
     CCheckQueueControl& operator=(const CCheckQueueControl&) = delete;
-    explicit CCheckQueueControl(CCheckQueue<T> * const pqueueIn) : pqueue(pqueueIn), fDone(false)
+    explicit CCheckQueueControl(Queue * const pqueueIn) : pqueue(pqueueIn), fDone(false)
     {
         // passed queue is supposed to be unused, or nullptr
         if (pqueue != nullptr) {
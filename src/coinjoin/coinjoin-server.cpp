@@ -221,9 +221,12 @@ void CCoinJoinServer::ProcessMessage(CNode* pfrom, const std::string& strCommand
         int nTxInIndex = 0;
         int nTxInsCount = (int)vecTxIn.size();
 
+        // Verify all of them at once, if any fails they are checked one by one below
+        bool fScriptSigsChecked = nState == POOL_STATE_SIGNING && AreInputScriptSigsValid(vecTxIn);
+
         for (const auto& txin : vecTxIn) {
             nTxInIndex++;
-            if (!AddScriptSig(txin)) {
+            if (!AddScriptSig(txin, fScriptSigsChecked)) {
                 LogPrint(BCLog::COINJOIN, "DSSIGNFINALTX -- AddScriptSig() failed at %d/%d, session: %d\n", nTxInIndex, nTxInsCount, nSessionID);
                 RelayStatus(STATUS_REJECTED, connman);
                 return;
@@ -239,6 +242,7 @@ void CCoinJoinServer::SetNull()
 {
     // MN side
     vecSessionCollaterals.clear();
+    mapFinalTxInputs.clear();
 
     CCoinJoinBaseSession::SetNull();
     CCoinJoinBaseManager::SetNull();
@@ -301,6 +305,20 @@ void CCoinJoinServer::CreateFinalTransaction(CConnman& connman)
     finalMutableTransaction = txNew;
     LogPrint(BCLog::COINJOIN, "CCoinJoinServer::CreateFinalTransaction -- finalMutableTransaction=%s", txNew.ToString()); /* Continued */
 
+    // index the inputs once, all signatures of the session are checked against this transaction
+    mapFinalTxInputs.clear();
+    for (unsigned int i = 0; i < finalMutableTransaction.vin.size(); i++) {
+        mapFinalTxInputs.emplace(finalMutableTransaction.vin[i].prevout, std::make_pair(i, CScript()));
+    }
+    for (const auto& entry : vecEntries) {
+        for (const auto& txdsin : entry.vecTxDSIn) {
+            auto it = mapFinalTxInputs.find(txdsin.prevout);
+            if (it != mapFinalTxInputs.end()) {
+                it->second.second = txdsin.prevPubKey;
+            }
+        }
+    }
+
     // request signatures from clients
     SetState(POOL_STATE_SIGNING);
     RelayFinalTransaction(finalMutableTransaction, connman);
@@ -319,6 +337,7 @@ void CCoinJoinServer::CommitFinalTransaction(CConnman& connman)
         // See if the transaction is valid
         TRY_LOCK(cs_main, lockMain);
         CValidationState validationState;
+        SigCacheCallerScope sigCacheCaller(SIGCACHE_COINJOIN);
         mempool.PrioritiseTransaction(hashTx, 0.1 * COIN);
         if (!lockMain || !AcceptToMemoryPool(mempool, validationState, finalTransaction, nullptr /* pfMissingInputs */, false /* bypass_limits */, maxTxFee /* nAbsurdFee */)) {
             LogPrint(BCLog::COINJOIN, "CCoinJoinServer::CommitFinalTransaction -- AcceptToMemoryPool() error: Transaction not valid\n");
@@ -451,6 +470,7 @@ void CCoinJoinServer::ConsumeCollateral(CConnman& connman, const CTransactionRef
 {
     LOCK(cs_main);
     CValidationState validationState;
+    SigCacheCallerScope sigCacheCaller(SIGCACHE_COINJOIN);
     if (!AcceptToMemoryPool(mempool, validationState, txref, nullptr /* pfMissingInputs */, false /* bypass_limits */, 0 /* nAbsurdFee */)) {
         LogPrint(BCLog::COINJOIN, "%s -- AcceptToMemoryPool failed\n", __func__);
     } else {
@@ -511,44 +531,55 @@ void CCoinJoinServer::CheckForCompleteQueue(CConnman& connman)
 // Check to make sure a given input matches an input in the pool and its scriptSig is valid
 bool CCoinJoinServer::IsInputScriptSigValid(const CTxIn& txin)
 {
-    CMutableTransaction txNew;
-    txNew.vin.clear();
-    txNew.vout.clear();
+    auto it = mapFinalTxInputs.find(txin.prevout);
+    if (it == mapFinalTxInputs.end()) {
+        LogPrint(BCLog::COINJOIN, "CCoinJoinServer::IsInputScriptSigValid -- Failed to find matching input in pool, %s\n", txin.ToString());
+        return false;
+    }
 
-    int i = 0;
-    int nTxInIndex = -1;
-    CScript sigPubKey = CScript();
+    unsigned int nTxInIndex = it->second.first;
+    const CScript& sigPubKey = it->second.second;
 
-    for (const auto& entry : vecEntries) {
-        for (const auto& txout : entry.vecTxOut) {
-            txNew.vout.push_back(txout);
-        }
-        for (const auto& txdsin : entry.vecTxDSIn) {
-            txNew.vin.push_back(txdsin);
-
-            if (txdsin.prevout == txin.prevout) {
-                nTxInIndex = i;
-                sigPubKey = txdsin.prevPubKey;
-            }
-            i++;
-        }
+    LogPrint(BCLog::COINJOIN, "CCoinJoinServer::IsInputScriptSigValid -- verifying scriptSig %s\n", ScriptToAsmStr(txin.scriptSig).substr(0, 24));
+    // The scriptSigs of the other inputs are not part of the signature hash, no need to copy the transaction.
+    // TODO we're using amount=0 here but we should use the correct amount. This works because Dash ignores the amount while signing/verifying (only used in Bitcoin/Segwit)
+    if (!VerifyScript(txin.scriptSig, sigPubKey, SCRIPT_VERIFY_P2SH | SCRIPT_VERIFY_STRICTENC, MutableTransactionSignatureChecker(&finalMutableTransaction, nTxInIndex, 0))) {
+        LogPrint(BCLog::COINJOIN, "CCoinJoinServer::IsInputScriptSigValid -- VerifyScript() failed on input %d\n", nTxInIndex);
+        return false;
     }
 
-    if (nTxInIndex >= 0) { //might have to do this one input at a time?
-        txNew.vin[nTxInIndex].scriptSig = txin.scriptSig;
-        LogPrint(BCLog::COINJOIN, "CCoinJoinServer::IsInputScriptSigValid -- verifying scriptSig %s\n", ScriptToAsmStr(txin.scriptSig).substr(0, 24));
-        // TODO we're using amount=0 here but we should use the correct amount. This works because Dash ignores the amount while signing/verifying (only used in Bitcoin/Segwit)
-        if (!VerifyScript(txNew.vin[nTxInIndex].scriptSig, sigPubKey, SCRIPT_VERIFY_P2SH | SCRIPT_VERIFY_STRICTENC, MutableTransactionSignatureChecker(&txNew, nTxInIndex, 0))) {
-            LogPrint(BCLog::COINJOIN, "CCoinJoinServer::IsInputScriptSigValid -- VerifyScript() failed on input %d\n", nTxInIndex);
+    LogPrint(BCLog::COINJOIN, "CCoinJoinServer::IsInputScriptSigValid -- Successfully validated input and scriptSig\n");
+    return true;
+}
+
+bool CCoinJoinServer::AreInputScriptSigsValid(const std::vector<CTxIn>& vecTxIn)
+{
+    CMutableTransaction txTmp(finalMutableTransaction);
+    std::vector<std::pair<unsigned int, const CScript*>> vecInputs;
+    std::set<unsigned int> setIndexes;
+    vecInputs.reserve(vecTxIn.size());
+
+    for (const auto& txin : vecTxIn) {
+        auto it = mapFinalTxInputs.find(txin.prevout);
+        if (it == mapFinalTxInputs.end() || !setIndexes.emplace(it->second.first).second) {
             return false;
         }
-    } else {
-        LogPrint(BCLog::COINJOIN, "CCoinJoinServer::IsInputScriptSigValid -- Failed to find matching input in pool, %s\n", txin.ToString());
-        return false;
+        txTmp.vin[it->second.first].scriptSig = txin.scriptSig;
+        vecInputs.emplace_back(it->second.first, &it->second.second);
     }
 
-    LogPrint(BCLog::COINJOIN, "CCoinJoinServer::IsInputScriptSigValid -- Successfully validated input and scriptSig\n");
-    return true;
+    const CTransaction tx(txTmp);
+    PrecomputedTransactionData txdata(tx);
+    std::vector<CScriptCheck> vChecks;
+    vChecks.reserve(vecInputs.size());
+    for (const auto& input : vecInputs) {
+        vChecks.emplace_back(CTxOut(0, *input.second), tx, input.first, SCRIPT_VERIFY_P2SH | SCRIPT_VERIFY_STRICTENC, false, &txdata);
+    }
+
+    int64_t nStart = GetTimeMicros();
+    bool fValid = RunScriptChecks(vChecks);
+    LogPrint(BCLog::COINJOIN, "CCoinJoinServer::%s -- verified %d scriptSigs, valid=%d, %dus\n", __func__, vecTxIn.size(), fValid, GetTimeMicros() - nStart);
+    return fValid;
 }
 
 //
@@ -613,7 +644,7 @@ bool CCoinJoinServer::AddEntry(CConnman& connman, const CCoinJoinEntry& entry, P
     return true;
 }
 
-bool CCoinJoinServer::AddScriptSig(const CTxIn& txinNew)
+bool CCoinJoinServer::AddScriptSig(const CTxIn& txinNew, bool fScriptSigChecked)
 {
     LogPrint(BCLog::COINJOIN, "CCoinJoinServer::AddScriptSig -- scriptSig=%s\n", ScriptToAsmStr(txinNew.scriptSig).substr(0, 24));
 
@@ -626,15 +657,17 @@ bool CCoinJoinServer::AddScriptSig(const CTxIn& txinNew)
         }
     }
 
-    if (!IsInputScriptSigValid(txinNew)) {
+    if (!fScriptSigChecked && !IsInputScriptSigValid(txinNew)) {
         LogPrint(BCLog::COINJOIN, "CCoinJoinServer::AddScriptSig -- Invalid scriptSig\n");
         return false;
     }
 
     LogPrint(BCLog::COINJOIN, "CCoinJoinServer::AddScriptSig -- scriptSig=%s new\n", ScriptToAsmStr(txinNew.scriptSig).substr(0, 24));
 
-    for (auto& txin : finalMutableTransaction.vin) {
-        if (txin.prevout == txinNew.prevout && txin.nSequence == txinNew.nSequence) {
+    auto it = mapFinalTxInputs.find(txinNew.prevout);
+    if (it != mapFinalTxInputs.end()) {
+        CTxIn& txin = finalMutableTransaction.vin[it->second.first];
+        if (txin.nSequence == txinNew.nSequence) {
             txin.scriptSig = txinNew.scriptSig;
             LogPrint(BCLog::COINJOIN, "CCoinJoinServer::AddScriptSig -- adding to finalMutableTransaction, scriptSig=%s\n", ScriptToAsmStr(txinNew.scriptSig).substr(0, 24));
         }
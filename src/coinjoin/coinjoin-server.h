@@ -23,12 +23,15 @@ private:
     // to behave honestly. If they don't it takes their money.
     std::vector<CTransactionRef> vecSessionCollaterals;
 
+    // Inputs of finalMutableTransaction: prevout -> (index, prevPubKey), set by CreateFinalTransaction
+    std::map<COutPoint, std::pair<unsigned int, CScript>> mapFinalTxInputs;
+
     bool fUnitTest;
 
     /// Add a clients entry to the pool
     bool AddEntry(CConnman& connman, const CCoinJoinEntry& entry, PoolMessage& nMessageIDRet);
-    /// Add signature to a txin
-    bool AddScriptSig(const CTxIn& txin);
+    /// Add signature to a txin, fScriptSigChecked skips verifying it again
+    bool AddScriptSig(const CTxIn& txin, bool fScriptSigChecked = false);
 
     /// Charge fees to bad actors (Charge clients a fee if they're abusive)
     void ChargeFees(CConnman& connman);
@@ -54,6 +57,8 @@ private:
     bool IsSignaturesComplete();
     /// Check to make sure a given input matches an input in the pool and its scriptSig is valid
     bool IsInputScriptSigValid(const CTxIn& txin);
+    /// Verify the scriptSigs of a DSSIGNFINALTX in one batch, true only if all of them are valid
+    bool AreInputScriptSigsValid(const std::vector<CTxIn>& vecTxIn);
 
     // Set the 'state' value, with some logging and capturing when the state changed
     void SetState(PoolState nStateNew);
@@ -69,6 +74,7 @@ private:
 public:
     CCoinJoinServer() :
         vecSessionCollaterals(),
+        mapFinalTxInputs(),
         fUnitTest(false) {}
 
     void ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStream& vRecv, CConnman& connman, bool enable_bip61);
@@ -80,6 +86,8 @@ public:
     void DoMaintenance(CConnman& connman);
 
     void GetJsonInfo(UniValue& obj) const;
+
+    friend struct CCoinJoinServerTest;
 };
 
 #endif // BITCOIN_COINJOIN_COINJOIN_SERVER_H
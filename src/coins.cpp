@@ -7,10 +7,12 @@
 #include <consensus/consensus.h>
 #include <random.h>
 
+#include <algorithm>
+
 bool CCoinsView::GetCoin(const COutPoint &outpoint, Coin &coin) const { return false; }
 uint256 CCoinsView::GetBestBlock() const { return uint256(); }
 std::vector<uint256> CCoinsView::GetHeadBlocks() const { return std::vector<uint256>(); }
-bool CCoinsView::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) { return false; }
+bool CCoinsView::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock, bool erase) { return false; }
 CCoinsViewCursor *CCoinsView::Cursor() const { return nullptr; }
 
 bool CCoinsView::HaveCoin(const COutPoint &outpoint) const
@@ -25,18 +27,24 @@ bool CCoinsViewBacked::HaveCoin(const COutPoint &outpoint) const { return base->
 uint256 CCoinsViewBacked::GetBestBlock() const { return base->GetBestBlock(); }
 std::vector<uint256> CCoinsViewBacked::GetHeadBlocks() const { return base->GetHeadBlocks(); }
 void CCoinsViewBacked::SetBackend(CCoinsView &viewIn) { base = &viewIn; }
-bool CCoinsViewBacked::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) { return base->BatchWrite(mapCoins, hashBlock); }
+bool CCoinsViewBacked::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock, bool erase) { return base->BatchWrite(mapCoins, hashBlock, erase); }
 CCoinsViewCursor *CCoinsViewBacked::Cursor() const { return base->Cursor(); }
 size_t CCoinsViewBacked::EstimateSize() const { return base->EstimateSize(); }
 
 SaltedOutpointHasher::SaltedOutpointHasher() : k0(GetRand(std::numeric_limits<uint64_t>::max())), k1(GetRand(std::numeric_limits<uint64_t>::max())) {}
 
-CCoinsViewCache::CCoinsViewCache(CCoinsView *baseIn) : CCoinsViewBacked(baseIn), cachedCoinsUsage(0) {}
+CCoinsViewCache::CCoinsViewCache(CCoinsView *baseIn) : CCoinsViewBacked(baseIn),
+    cacheCoins(0, SaltedOutpointHasher(), CCoinsMap::key_equal(), &m_cache_coins_memory_resource),
+    cachedCoinsUsage(0), nFlushSequence(0) {}
 
 size_t CCoinsViewCache::DynamicMemoryUsage() const {
     return memusage::DynamicUsage(cacheCoins) + cachedCoinsUsage;
 }
 
+size_t CCoinsViewCache::UsedMemoryUsage() const {
+    return m_cache_coins_memory_resource.UsedBytes() + memusage::MallocUsage(sizeof(void*) * cacheCoins.bucket_count()) + cachedCoinsUsage;
+}
+
 CCoinsMap::iterator CCoinsViewCache::FetchCoin(const COutPoint &outpoint) const {
     CCoinsMap::iterator it = cacheCoins.find(outpoint);
     if (it != cacheCoins.end())
@@ -142,8 +150,8 @@ void CCoinsViewCache::SetBestBlock(const uint256 &hashBlockIn) {
     hashBlock = hashBlockIn;
 }
 
-bool CCoinsViewCache::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlockIn) {
-    for (CCoinsMap::iterator it = mapCoins.begin(); it != mapCoins.end(); it = mapCoins.erase(it)) {
+bool CCoinsViewCache::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlockIn, bool erase) {
+    for (CCoinsMap::iterator it = mapCoins.begin(); it != mapCoins.end(); it = erase ? mapCoins.erase(it) : std::next(it)) {
         // Ignore non-dirty entries (optimization).
         if (!(it->second.flags & CCoinsCacheEntry::DIRTY)) {
             continue;
@@ -156,7 +164,11 @@ bool CCoinsViewCache::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlockIn
                 // Otherwise we will need to create it in the parent
                 // and move the data up and mark it as dirty
                 CCoinsCacheEntry& entry = cacheCoins[it->first];
-                entry.coin = std::move(it->second.coin);
+                if (erase) {
+                    entry.coin = std::move(it->second.coin);
+                } else {
+                    entry.coin = it->second.coin;
+                }
                 cachedCoinsUsage += entry.coin.DynamicMemoryUsage();
                 entry.flags = CCoinsCacheEntry::DIRTY;
                 // We can mark it FRESH in the parent if it was FRESH in the child
@@ -185,7 +197,11 @@ bool CCoinsViewCache::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlockIn
             } else {
                 // A normal modification.
                 cachedCoinsUsage -= itUs->second.coin.DynamicMemoryUsage();
-                itUs->second.coin = std::move(it->second.coin);
+                if (erase) {
+                    itUs->second.coin = std::move(it->second.coin);
+                } else {
+                    itUs->second.coin = it->second.coin;
+                }
                 cachedCoinsUsage += itUs->second.coin.DynamicMemoryUsage();
                 itUs->second.flags |= CCoinsCacheEntry::DIRTY;
                 // NOTE: It is possible the child has a FRESH flag here in
@@ -204,9 +220,89 @@ bool CCoinsViewCache::Flush() {
     bool fOk = base->BatchWrite(cacheCoins, hashBlock);
     cacheCoins.clear();
     cachedCoinsUsage = 0;
+    nFlushSequence++;
+    ReallocateCache();
     return fOk;
 }
 
+bool CCoinsViewCache::Sync() {
+    bool fOk = base->BatchWrite(cacheCoins, hashBlock, false);
+    if (fOk) {
+        MarkSynced();
+    }
+    return fOk;
+}
+
+void CCoinsViewCache::SnapshotDirty(CCoinsMap& mapDirty) {
+    for (const auto& entry : cacheCoins) {
+        if (entry.second.flags & CCoinsCacheEntry::DIRTY) {
+            mapDirty.emplace(entry.first, entry.second);
+        }
+    }
+    MarkSynced();
+}
+
+void CCoinsViewCache::MarkSynced() {
+    nFlushSequence++;
+    for (CCoinsMap::iterator it = cacheCoins.begin(); it != cacheCoins.end();) {
+        if (it->second.coin.IsSpent()) {
+            cachedCoinsUsage -= it->second.coin.DynamicMemoryUsage();
+            it = cacheCoins.erase(it);
+        } else {
+            it->second.flags = 0;
+            ++it;
+        }
+    }
+}
+
+void CCoinsViewCache::Trim(size_t nTargetUsage) {
+    if (DynamicMemoryUsage() <= nTargetUsage) {
+        return;
+    }
+    std::vector<CCoinsMap::iterator> vClean;
+    vClean.reserve(cacheCoins.size());
+    for (CCoinsMap::iterator it = cacheCoins.begin(); it != cacheCoins.end(); ++it) {
+        if (it->second.flags == 0) {
+            vClean.push_back(it);
+        }
+    }
+    // Old coins are the least likely to be spent by the next blocks. Instead of
+    // sorting every clean entry, select roughly as many of the oldest as need to
+    // go to get under the target, and repeat if the estimate fell short.
+    // Erased entries only go back to the pool's free list, so this counts the
+    // memory the entries use rather than the chunks the pool holds.
+    auto older = [](const CCoinsMap::iterator& a, const CCoinsMap::iterator& b) {
+        return a->second.coin.nHeight < b->second.coin.nHeight;
+    };
+    std::vector<CCoinsMap::iterator>::iterator first = vClean.begin();
+    while (first != vClean.end() && UsedMemoryUsage() > nTargetUsage) {
+        size_t nEntryUsage = std::max<size_t>(UsedMemoryUsage() / cacheCoins.size(), 1);
+        size_t nEvict = std::min<size_t>((UsedMemoryUsage() - nTargetUsage) / nEntryUsage + 1, vClean.end() - first);
+        std::vector<CCoinsMap::iterator>::iterator last = first + nEvict;
+        std::nth_element(first, last - 1, vClean.end(), older);
+        for (; first != last && UsedMemoryUsage() > nTargetUsage; ++first) {
+            cachedCoinsUsage -= (*first)->second.coin.DynamicMemoryUsage();
+            cacheCoins.erase(*first);
+        }
+    }
+    vClean.clear();
+
+    // Move what is left to a new pool to release the chunks
+    if (DynamicMemoryUsage() > nTargetUsage) {
+        std::vector<std::pair<COutPoint, CCoinsCacheEntry>> vEntries;
+        vEntries.reserve(cacheCoins.size());
+        for (auto& entry : cacheCoins) {
+            vEntries.emplace_back(entry.first, std::move(entry.second));
+        }
+        cacheCoins.clear();
+        ReallocateCache();
+        cacheCoins.reserve(vEntries.size());
+        for (auto& entry : vEntries) {
+            cacheCoins.emplace(entry.first, std::move(entry.second));
+        }
+    }
+}
+
 void CCoinsViewCache::Uncache(const COutPoint& hash)
 {
     CCoinsMap::iterator it = cacheCoins.find(hash);
@@ -216,6 +312,31 @@ void CCoinsViewCache::Uncache(const COutPoint& hash)
     }
 }
 
+bool CCoinsViewCache::AddFetchedCoin(const COutPoint& outpoint, Coin&& coin, uint64_t nFlushSequenceRead)
+{
+    if (nFlushSequenceRead != nFlushSequence || coin.IsSpent())
+        return false;
+    CCoinsMap::iterator it;
+    bool inserted;
+    std::tie(it, inserted) = cacheCoins.emplace(std::piecewise_construct, std::forward_as_tuple(outpoint), std::forward_as_tuple(std::move(coin)));
+    if (inserted) {
+        cachedCoinsUsage += it->second.coin.DynamicMemoryUsage();
+    }
+    return inserted;
+}
+
+void CCoinsViewCache::ReallocateCache()
+{
+    // The pool keeps its chunks until it is destroyed, so an emptied cache
+    // only shrinks once map and resource are recreated.
+    assert(cacheCoins.size() == 0);
+    SaltedOutpointHasher hasher = cacheCoins.hash_function();
+    cacheCoins.~CCoinsMap();
+    m_cache_coins_memory_resource.~CCoinsMapMemoryResource();
+    ::new (&m_cache_coins_memory_resource) CCoinsMapMemoryResource{};
+    ::new (&cacheCoins) CCoinsMap{0, hasher, CCoinsMap::key_equal(), &m_cache_coins_memory_resource};
+}
+
 unsigned int CCoinsViewCache::GetCacheSize() const {
     return cacheCoins.size();
 }
@@ -12,6 +12,7 @@
 #include <hash.h>
 #include <memusage.h>
 #include <serialize.h>
+#include <support/allocators/pool.h>
 #include <uint256.h>
 
 #include <assert.h>
@@ -134,7 +135,19 @@ struct CCoinsCacheEntry
     explicit CCoinsCacheEntry(Coin&& coin_) : coin(std::move(coin_)), flags(0) {}
 };
 
-typedef std::unordered_map<COutPoint, CCoinsCacheEntry, SaltedOutpointHasher> CCoinsMap;
+/**
+ * Cache entries are allocated from a PoolResource owned by the cache. A node
+ * holds the key/value pair, the next pointer and the cached hash, which the
+ * block size leaves room for.
+ */
+using CCoinsMap = std::unordered_map<COutPoint,
+                                     CCoinsCacheEntry,
+                                     SaltedOutpointHasher,
+                                     std::equal_to<COutPoint>,
+                                     PoolAllocator<std::pair<const COutPoint, CCoinsCacheEntry>,
+                                                   sizeof(std::pair<const COutPoint, CCoinsCacheEntry>) + sizeof(void*) * 4>>;
+
+using CCoinsMapMemoryResource = CCoinsMap::allocator_type::ResourceType;
 
 /** Cursor for iterating over CoinsView state */
 class CCoinsViewCursor
@@ -179,8 +192,8 @@ public:
     virtual std::vector<uint256> GetHeadBlocks() const;
 
     //! Do a bulk modification (multiple Coin changes + BestBlock change).
-    //! The passed mapCoins can be modified.
-    virtual bool BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock);
+    //! The passed mapCoins can be modified, its entries are only removed if erase is true.
+    virtual bool BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock, bool erase = true);
 
     //! Get a cursor to iterate over the whole state
     virtual CCoinsViewCursor *Cursor() const;
@@ -206,7 +219,7 @@ public:
     uint256 GetBestBlock() const override;
     std::vector<uint256> GetHeadBlocks() const override;
     void SetBackend(CCoinsView &viewIn);
-    bool BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) override;
+    bool BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock, bool erase = true) override;
     CCoinsViewCursor *Cursor() const override;
     size_t EstimateSize() const override;
 };
@@ -221,11 +234,18 @@ protected:
      * declared as "const".
      */
     mutable uint256 hashBlock;
+    mutable CCoinsMapMemoryResource m_cache_coins_memory_resource{};
     mutable CCoinsMap cacheCoins;
 
     /* Cached dynamic memory usage for the inner Coin objects. */
     mutable size_t cachedCoinsUsage;
 
+    /* Bumped whenever written entries are dropped from the cache. */
+    uint64_t nFlushSequence;
+
+    //! Memory usage if the entries were packed into a new pool, without the free blocks and the unused end of the last chunk
+    size_t UsedMemoryUsage() const;
+
 public:
     CCoinsViewCache(CCoinsView *baseIn);
 
@@ -239,7 +259,7 @@ public:
     bool HaveCoin(const COutPoint &outpoint) const override;
     uint256 GetBestBlock() const override;
     void SetBestBlock(const uint256 &hashBlock);
-    bool BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) override;
+    bool BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock, bool erase = true) override;
     CCoinsViewCursor* Cursor() const override {
         throw std::logic_error("CCoinsViewCache cursor iteration not supported.");
     }
@@ -283,12 +303,44 @@ public:
      */
     bool Flush();
 
+    /**
+     * Push the modifications applied to this cache to its base like Flush(),
+     * but keep the unspent coins cached so the next blocks don't start from a
+     * cold cache. Spent entries are dropped and the others are marked clean.
+     */
+    bool Sync();
+
+    /**
+     * Copy the modified entries into mapDirty and mark this cache as synced.
+     * The caller takes over writing mapDirty to the base.
+     */
+    void SnapshotDirty(CCoinsMap& mapDirty);
+
+    /**
+     * Uncache unmodified coins, oldest first, until the cache uses at most
+     * nTargetUsage bytes, give or take one pool chunk. The remaining entries
+     * are then moved to a new pool so the chunks of the erased ones are freed.
+     */
+    void Trim(size_t nTargetUsage);
+
     /**
      * Removes the UTXO with the given outpoint from the cache, if it is
      * not modified.
      */
     void Uncache(const COutPoint &outpoint);
 
+    /**
+     * Add an unmodified coin that was read from the base view, unless the
+     * cache already has an entry for it. nFlushSequenceRead is the
+     * GetFlushSequence() value from before the read; if modified entries were
+     * written and dropped since, the read may be stale and is discarded.
+     * Returns whether the coin was added.
+     */
+    bool AddFetchedCoin(const COutPoint& outpoint, Coin&& coin, uint64_t nFlushSequenceRead);
+
+    //! Changes whenever modified entries are written to the base and dropped from the cache
+    uint64_t GetFlushSequence() const { return nFlushSequence; }
+
     //! Calculate the size of the cache (in number of transaction outputs)
     unsigned int GetCacheSize() const;
 
@@ -310,6 +362,9 @@ public:
 
 private:
     CCoinsMap::iterator FetchCoin(const COutPoint &outpoint) const;
+    void MarkSynced();
+    //! Give the pool memory of an empty cache back to the system
+    void ReallocateCache();
 };
 
 //! Utility function to add all of a transaction's outputs to a cache.
@@ -0,0 +1,116 @@
+// Copyright (c) 2021 pacprotocol
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <coinsprefetch.h>
+
+#include <primitives/block.h>
+#include <saltedhasher.h>
+#include <txdb.h>
+#include <util.h>
+#include <validation.h>
+
+#include <future>
+#include <unordered_set>
+
+CCoinsPrefetcher coinsPrefetcher;
+
+//! Outpoints read by one prefetch job
+static const size_t PREFETCH_BATCH_SIZE = 32;
+
+CCoinsPrefetcher::~CCoinsPrefetcher()
+{
+    Stop();
+}
+
+void CCoinsPrefetcher::Start(int nThreads)
+{
+    workerPool.resize(nThreads);
+    RenameThreadPool(workerPool, "pacprotocol-prefetch");
+    fRunning = true;
+}
+
+void CCoinsPrefetcher::Stop()
+{
+    if (!fRunning.exchange(false))
+        return;
+    workerPool.clear_queue();
+    workerPool.stop(true);
+}
+
+void CCoinsPrefetcher::Prefetch(const CBlock& block)
+{
+    AssertLockNotHeld(cs_main);
+    if (!fRunning)
+        return;
+
+    int64_t nTimeStart = GetTimeMicros();
+
+    // Outputs created and spent within the block are never in the database
+    std::unordered_set<uint256, StaticSaltedHasher> setBlockTxids;
+    std::vector<COutPoint> vInputs;
+    for (const auto& tx : block.vtx) {
+        setBlockTxids.insert(tx->GetHash());
+        if (tx->IsCoinBase())
+            continue;
+        for (const CTxIn& txin : tx->vin) {
+            vInputs.push_back(txin.prevout);
+        }
+    }
+    if (vInputs.empty())
+        return;
+
+    std::vector<COutPoint> vMissing;
+    CCoinsView* pdbview;
+    uint64_t nFlushSequence;
+    {
+        LOCK(cs_main);
+        if (!pcoinsTip || !pcoinsdbview)
+            return;
+        BlockMap::const_iterator mi = mapBlockIndex.find(block.GetHash());
+        if (mi != mapBlockIndex.end() && (mi->second->nStatus & BLOCK_HAVE_DATA))
+            return;
+        for (const COutPoint& outpoint : vInputs) {
+            if (!setBlockTxids.count(outpoint.hash) && !pcoinsTip->HaveCoinInCache(outpoint))
+                vMissing.push_back(outpoint);
+        }
+        pdbview = pcoinsdbview.get();
+        nFlushSequence = pcoinsTip->GetFlushSequence();
+    }
+
+    size_t nFound = 0;
+    std::vector<std::pair<COutPoint, Coin>> vFetched(vMissing.size());
+    std::vector<char> vHave(vMissing.size());
+    if (!vMissing.empty()) {
+        std::vector<std::future<void>> futures;
+        for (size_t nStart = 0; nStart < vMissing.size(); nStart += PREFETCH_BATCH_SIZE) {
+            size_t nEnd = std::min(nStart + PREFETCH_BATCH_SIZE, vMissing.size());
+            futures.emplace_back(workerPool.push([&, nStart, nEnd](int threadId) {
+                for (size_t i = nStart; i < nEnd; i++) {
+                    vFetched[i].first = vMissing[i];
+                    vHave[i] = pdbview->GetCoin(vMissing[i], vFetched[i].second);
+                }
+            }));
+        }
+        for (auto& f : futures) {
+            f.get();
+        }
+
+        LOCK(cs_main);
+        // Coins that were flushed and dropped from the cache while we were
+        // reading may have changed, AddFetchedCoin drops the reads then
+        for (size_t i = 0; i < vFetched.size(); i++) {
+            if (vHave[i] && pcoinsTip->AddFetchedCoin(vFetched[i].first, std::move(vFetched[i].second), nFlushSequence))
+                nFound++;
+        }
+    }
+
+    size_t nCached = vInputs.size() - vMissing.size();
+    nInputsTotal += vInputs.size();
+    nCachedTotal += nCached;
+    nPrefetchedTotal += nFound;
+    LogPrint(BCLog::BENCHMARK, "  - Prefetch %u inputs: cache hit rate %.1f%% -> %.1f%% (%u read, %u found) %.2fms [%.1f%% -> %.1f%%]\n",
+        vInputs.size(), 100.0 * nCached / vInputs.size(), 100.0 * (nCached + nFound) / vInputs.size(),
+        vMissing.size(), nFound, 0.001 * (GetTimeMicros() - nTimeStart),
+        100.0 * nCachedTotal / nInputsTotal, 100.0 * (nCachedTotal + nPrefetchedTotal) / nInputsTotal);
+}
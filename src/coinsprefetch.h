@@ -0,0 +1,49 @@
+// Copyright (c) 2021 pacprotocol
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_COINSPREFETCH_H
+#define BITCOIN_COINSPREFETCH_H
+
+#include <ctpl.h>
+
+#include <atomic>
+
+class CBlock;
+
+//! -prefetchthreads default
+static const int DEFAULT_PREFETCH_THREADS = 4;
+//! Maximum number of prefetch threads
+static const int MAX_PREFETCH_THREADS = 16;
+
+/**
+ * Warms the coins cache with the inputs of a block before it is connected.
+ *
+ * The coins a block spends are read from the coins database in parallel and
+ * without holding cs_main, so ConnectBlock finds them in pcoinsTip instead of
+ * doing one synchronous database read per input.
+ */
+class CCoinsPrefetcher
+{
+private:
+    ctpl::thread_pool workerPool;
+    std::atomic<bool> fRunning{false};
+
+    // Running totals for the benchmark log
+    std::atomic<uint64_t> nInputsTotal{0};
+    std::atomic<uint64_t> nCachedTotal{0};
+    std::atomic<uint64_t> nPrefetchedTotal{0};
+
+public:
+    ~CCoinsPrefetcher();
+
+    void Start(int nThreads);
+    void Stop();
+
+    //! Read the coins spent by block into pcoinsTip, must be called without cs_main
+    void Prefetch(const CBlock& block);
+};
+
+extern CCoinsPrefetcher coinsPrefetcher;
+
+#endif // BITCOIN_COINSPREFETCH_H
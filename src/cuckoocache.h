@@ -332,7 +332,8 @@ public:
     /** setup initializes the container to store no more than new_size
      * elements.
      *
-     * setup should only be called once.
+     * setup may be called again to resize the container, which drops all
+     * elements.
      *
      * @param new_size the desired number of elements to store
      * @returns the maximum number of elements storable
@@ -342,9 +343,10 @@ public:
         // depth_limit must be at least one otherwise errors can occur.
         depth_limit = static_cast<uint8_t>(std::log2(static_cast<float>(std::max((uint32_t)2, new_size))));
         size = std::max<uint32_t>(2, new_size);
-        table.resize(size);
+        table.assign(size, Element());
+        table.shrink_to_fit();
         collection_flags.setup(size);
-        epoch_flags.resize(size);
+        epoch_flags.assign(size, false);
         // Set to 45% as described above
         epoch_size = std::max((uint32_t)1, (45 * size) / 100);
         // Initially set to wait for a whole epoch
@@ -475,6 +477,21 @@ public:
             }
         return false;
     }
+
+    /** for_each calls f on every element which is not marked for garbage
+     * collection, e.g. to copy the contents into a cache of another size.
+     *
+     * for_each requires the same external synchronization as insert.
+     *
+     * @param f the function to call with each element
+     */
+    template <typename F>
+    void for_each(F f) const
+    {
+        for (uint32_t i = 0; i < size; ++i)
+            if (!collection_flags.bit_is_set(i))
+                f(table[i]);
+    }
 };
 } // namespace CuckooCache
 
@@ -0,0 +1,211 @@
+// Copyright (c) 2021 pacprotocol
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <governance/governance-db.h>
+#include <governance/governance-object.h>
+#include <clientversion.h>
+#include <hash.h>
+#include <util.h>
+
+static const std::string DB_STATE = "gov_s";
+static const std::string DB_OBJECT = "gov_o";
+static const std::string DB_VOTE = "gov_v";
+
+// write the pending batch out once it gets this large
+static const size_t DB_BATCH_SIZE = 1 << 24;
+
+static std::vector<unsigned char> SerializeObjectRecord(const CGovernanceObject& govobj)
+{
+    CDataStream ds(SER_DISK, CLIENT_VERSION);
+    // the votes are stored as records of their own
+    const_cast<CGovernanceObject&>(govobj).SerializationOpImpl(ds, CSerActionSerialize(), false);
+    return std::vector<unsigned char>(ds.begin(), ds.end());
+}
+
+CGovernanceDB::CGovernanceDB(const fs::path& path, size_t nCacheSize, bool fMemory, bool fWipe) :
+    db(path, nCacheSize, fMemory, fWipe)
+{
+}
+
+bool CGovernanceDB::Load(std::vector<unsigned char>& vchState, std::map<uint256, CGovernanceObject>& mapObjects)
+{
+    hashState.SetNull();
+    mapObjectRecords.clear();
+    mapObjectVotes.clear();
+
+    if (!db.Read(DB_STATE, vchState)) {
+        return false;
+    }
+    hashState = Hash(vchState.begin(), vchState.end());
+
+    std::unique_ptr<CDBIterator> pcursor(db.NewIterator());
+
+    auto firstObjectKey = std::make_tuple(DB_OBJECT, uint256());
+    pcursor->Seek(firstObjectKey);
+    while (pcursor->Valid()) {
+        decltype(firstObjectKey) curKey;
+        std::vector<unsigned char> vchRecord;
+        if (!pcursor->GetKey(curKey) || std::get<0>(curKey) != DB_OBJECT) {
+            break;
+        }
+        if (!pcursor->GetValue(vchRecord)) {
+            return error("%s: failed to read object %s", __func__, std::get<1>(curKey).ToString());
+        }
+
+        CGovernanceObject govobj;
+        try {
+            CDataStream ds(vchRecord, SER_DISK, CLIENT_VERSION);
+            govobj.SerializationOpImpl(ds, CSerActionUnserialize(), false);
+        } catch (const std::exception& e) {
+            return error("%s: failed to deserialize object %s: %s", __func__, std::get<1>(curKey).ToString(), e.what());
+        }
+        govobj.SetDirtyDB(false);
+        mapObjects.emplace(std::get<1>(curKey), govobj);
+        mapObjectRecords.emplace(std::get<1>(curKey), Hash(vchRecord.begin(), vchRecord.end()));
+
+        pcursor->Next();
+    }
+
+    auto firstVoteKey = std::make_tuple(DB_VOTE, uint256(), uint256());
+    pcursor->Seek(firstVoteKey);
+    while (pcursor->Valid()) {
+        decltype(firstVoteKey) curKey;
+        CGovernanceVote vote;
+        if (!pcursor->GetKey(curKey) || std::get<0>(curKey) != DB_VOTE) {
+            break;
+        }
+        if (!pcursor->GetValue(vote)) {
+            return error("%s: failed to read vote %s", __func__, std::get<2>(curKey).ToString());
+        }
+
+        const uint256& nObjectHash = std::get<1>(curKey);
+        auto it = mapObjects.find(nObjectHash);
+        if (it != mapObjects.end()) {
+            it->second.LoadVote(vote);
+        }
+        // votes of objects we don't have anymore are still recorded so the next flush erases them
+        mapObjectVotes[nObjectHash].emplace(std::get<2>(curKey));
+
+        pcursor->Next();
+    }
+
+    return true;
+}
+
+bool CGovernanceDB::Flush(const std::vector<unsigned char>& vchState, std::map<uint256, CGovernanceObject>& mapObjects, bool fSync)
+{
+    CDBBatch batch(db);
+    size_t nObjectsWritten = 0;
+    size_t nVotesWritten = 0;
+    size_t nErased = 0;
+
+    // what changes in the database once the batch is written
+    std::vector<CGovernanceObject*> vecFlushed;
+    std::map<uint256, uint256> mapNewObjectRecords;
+    std::map<uint256, std::unordered_set<uint256, StaticSaltedHasher>> mapNewObjectVotes;
+    std::vector<uint256> vecGone;
+
+    auto writeIfLarge = [&]() {
+        if (batch.SizeEstimate() >= DB_BATCH_SIZE) {
+            db.WriteBatch(batch);
+            batch.Clear();
+        }
+    };
+
+    uint256 hashNewState = Hash(vchState.begin(), vchState.end());
+    bool fStateChanged = hashNewState != hashState;
+    if (fStateChanged) {
+        batch.Write(DB_STATE, vchState);
+    }
+
+    for (auto& p : mapObjects) {
+        const uint256& nObjectHash = p.first;
+        CGovernanceObject& govobj = p.second;
+        if (!govobj.IsDirtyDB()) {
+            continue;
+        }
+        vecFlushed.push_back(&govobj);
+
+        std::vector<unsigned char> vchRecord = SerializeObjectRecord(govobj);
+        uint256 hashRecord = Hash(vchRecord.begin(), vchRecord.end());
+        auto itRecord = mapObjectRecords.find(nObjectHash);
+        if (itRecord == mapObjectRecords.end() || itRecord->second != hashRecord) {
+            batch.Write(std::make_tuple(DB_OBJECT, nObjectHash), vchRecord);
+            ++nObjectsWritten;
+        }
+        mapNewObjectRecords.emplace(nObjectHash, hashRecord);
+
+        const CGovernanceObjectVoteFile& fileVotes = govobj.GetVoteFile();
+        auto& setVotes = mapNewObjectVotes[nObjectHash];
+        for (const auto& nVoteHash : fileVotes.GetVoteHashes()) {
+            setVotes.emplace(nVoteHash);
+        }
+
+        auto itVotes = mapObjectVotes.find(nObjectHash);
+        for (const auto& nVoteHash : setVotes) {
+            if (itVotes != mapObjectVotes.end() && itVotes->second.count(nVoteHash)) {
+                continue;
+            }
+            batch.Write(std::make_tuple(DB_VOTE, nObjectHash, nVoteHash), *fileVotes.GetVote(nVoteHash));
+            ++nVotesWritten;
+        }
+        if (itVotes != mapObjectVotes.end()) {
+            for (const auto& nVoteHash : itVotes->second) {
+                if (!setVotes.count(nVoteHash)) {
+                    batch.Erase(std::make_tuple(DB_VOTE, nObjectHash, nVoteHash));
+                    ++nErased;
+                }
+            }
+        }
+
+        writeIfLarge();
+    }
+
+    // objects which are gone from memory
+    for (const auto& p : mapObjectRecords) {
+        if (!mapObjects.count(p.first)) {
+            batch.Erase(std::make_tuple(DB_OBJECT, p.first));
+            vecGone.push_back(p.first);
+            ++nErased;
+        }
+    }
+    for (const auto& p : mapObjectVotes) {
+        if (mapObjects.count(p.first)) {
+            continue;
+        }
+        for (const auto& nVoteHash : p.second) {
+            batch.Erase(std::make_tuple(DB_VOTE, p.first, nVoteHash));
+            ++nErased;
+        }
+        if (!mapObjectRecords.count(p.first)) {
+            vecGone.push_back(p.first);
+        }
+        writeIfLarge();
+    }
+
+    if (fStateChanged || nObjectsWritten > 0 || nVotesWritten > 0 || nErased > 0) {
+        if (!db.WriteBatch(batch, fSync)) {
+            return error("%s: failed to write governance database", __func__);
+        }
+    }
+
+    hashState = hashNewState;
+    for (auto& p : mapNewObjectRecords) {
+        mapObjectRecords[p.first] = p.second;
+    }
+    for (auto& p : mapNewObjectVotes) {
+        mapObjectVotes[p.first].swap(p.second);
+    }
+    for (const uint256& nObjectHash : vecGone) {
+        mapObjectRecords.erase(nObjectHash);
+        mapObjectVotes.erase(nObjectHash);
+    }
+    for (CGovernanceObject* pObj : vecFlushed) {
+        pObj->SetDirtyDB(false);
+    }
+
+    LogPrint(BCLog::GOBJECT, "CGovernanceDB::%s -- dirty objects: %d, objects written: %d, votes written: %d, records erased: %d\n",
+        __func__, vecFlushed.size(), nObjectsWritten, nVotesWritten, nErased);
+    return true;
+}
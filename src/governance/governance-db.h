@@ -0,0 +1,58 @@
+// Copyright (c) 2021 pacprotocol
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_GOVERNANCE_GOVERNANCE_DB_H
+#define BITCOIN_GOVERNANCE_GOVERNANCE_DB_H
+
+#include <dbwrapper.h>
+#include <saltedhasher.h>
+#include <uint256.h>
+
+#include <map>
+#include <unordered_set>
+#include <vector>
+
+class CGovernanceObject;
+
+/**
+ * LevelDB store for the governance manager, replacing governance.dat.
+ *
+ * Every object and every vote is a record of its own and the store keeps the
+ * hashes of what it holds. A flush only looks at objects flagged dirty and
+ * writes the records of theirs that changed, and loading streams record by
+ * record instead of reading and hashing one big blob.
+ *
+ * Not thread safe, callers hold CGovernanceManager::cs.
+ */
+class CGovernanceDB
+{
+private:
+    CDBWrapper db;
+
+    // what the database currently holds
+    uint256 hashState;
+    std::map<uint256, uint256> mapObjectRecords;
+    std::map<uint256, std::unordered_set<uint256, StaticSaltedHasher>> mapObjectVotes;
+
+public:
+    CGovernanceDB(const fs::path& path, size_t nCacheSize, bool fMemory = false, bool fWipe = false);
+
+    bool IsEmpty() { return db.IsEmpty(); }
+
+    /**
+     * Read the manager state and all objects with their votes. Returns false
+     * if there is no state record.
+     */
+    bool Load(std::vector<unsigned char>& vchState, std::map<uint256, CGovernanceObject>& mapObjects);
+
+    /**
+     * Bring the database in line with vchState and mapObjects, writing only
+     * the records of dirty objects that differ from what it holds and erasing
+     * the objects that are gone. Clears the dirty flags once written. Nothing
+     * is written if nothing changed, fSync is for the final flush on shutdown.
+     */
+    bool Flush(const std::vector<unsigned char>& vchState, std::map<uint256, CGovernanceObject>& mapObjects, bool fSync);
+};
+
+#endif // BITCOIN_GOVERNANCE_GOVERNANCE_DB_H
@@ -35,6 +35,7 @@ CGovernanceObject::CGovernanceObject() :
     fDirtyCache(true),
     fExpired(false),
     fUnparsable(false),
+    fDirtyDB(true),
     mapCurrentMNVotes(),
     fileVotes()
 {
@@ -62,6 +63,7 @@ CGovernanceObject::CGovernanceObject(const uint256& nHashParentIn, int nRevision
     fDirtyCache(true),
     fExpired(false),
     fUnparsable(false),
+    fDirtyDB(true),
     mapCurrentMNVotes(),
     fileVotes()
 {
@@ -89,6 +91,7 @@ CGovernanceObject::CGovernanceObject(const CGovernanceObject& other) :
     fDirtyCache(other.fDirtyCache),
     fExpired(other.fExpired),
     fUnparsable(other.fUnparsable),
+    fDirtyDB(other.fDirtyDB),
     mapCurrentMNVotes(other.mapCurrentMNVotes),
     fileVotes(other.fileVotes)
 {
@@ -97,7 +100,8 @@ CGovernanceObject::CGovernanceObject(const CGovernanceObject& other) :
 bool CGovernanceObject::ProcessVote(CNode* pfrom,
     const CGovernanceVote& vote,
     CGovernanceException& exception,
-    CConnman& connman)
+    CConnman& connman,
+    const std::shared_ptr<const CDeterministicMN>& dmnSigChecked)
 {
     LOCK(cs);
 
@@ -185,7 +189,7 @@ bool CGovernanceObject::ProcessVote(CNode* pfrom,
     bool onlyVotingKeyAllowed = nObjectType == GOVERNANCE_OBJECT_PROPOSAL && vote.GetSignal() == VOTE_SIGNAL_FUNDING;
 
     // Finally check that the vote is actually valid (done last because of cost of signature verification)
-    if (!vote.IsValid(onlyVotingKeyAllowed)) {
+    if (!vote.IsValid(onlyVotingKeyAllowed, dmnSigChecked)) {
         std::ostringstream ostr;
         ostr << "CGovernanceObject::ProcessVote -- Invalid vote"
              << ", MN outpoint = " << vote.GetMasternodeOutpoint().ToStringShort()
@@ -210,11 +214,18 @@ bool CGovernanceObject::ProcessVote(CNode* pfrom,
     voteInstanceRef = vote_instance_t(vote.GetOutcome(), nVoteTimeUpdate, vote.GetTimestamp());
     fileVotes.AddVote(vote);
     fDirtyCache = true;
+    fDirtyDB = true;
     // SEND NOTIFICATION TO SCRIPT/ZMQ
     GetMainSignals().NotifyGovernanceVote(std::make_shared<const CGovernanceVote>(vote));
     return true;
 }
 
+void CGovernanceObject::LoadVote(const CGovernanceVote& vote)
+{
+    LOCK(cs);
+    fileVotes.AddVote(vote);
+}
+
 void CGovernanceObject::ClearMasternodeVotes()
 {
     LOCK(cs);
@@ -227,6 +238,7 @@ void CGovernanceObject::ClearMasternodeVotes()
             fileVotes.RemoveVotesFromMasternode(it->first);
             mapCurrentMNVotes.erase(it++);
             fDirtyCache = true;
+            fDirtyDB = true;
         } else {
             ++it;
         }
@@ -247,6 +259,7 @@ std::set<uint256> CGovernanceObject::RemoveInvalidVotes(const COutPoint& mnOutpo
     if (removedVotes.empty()) {
         return {};
     }
+    fDirtyDB = true;
 
     auto nParentHash = GetHash();
     for (auto jt = it->second.mapInstances.begin(); jt != it->second.mapInstances.end(); ) {
@@ -439,8 +452,8 @@ UniValue CGovernanceObject::ToJson() const
 
 void CGovernanceObject::UpdateLocalValidity()
 {
-    LOCK(cs_main);
     // THIS DOES NOT CHECK COLLATERAL, THIS IS CHECKED UPON ORIGINAL ARRIVAL
+    // which is also the only part of IsValidLocally that needs cs_main
     fCachedLocalValidity = IsValidLocally(strLocalValidityError, false);
 }
 
@@ -701,6 +714,7 @@ void CGovernanceObject::UpdateSentinelVariables()
         fCachedDelete = true;
         if (nDeletionTime == 0) {
             nDeletionTime = GetAdjustedTime();
+            fDirtyDB = true;
         }
     }
     if (GetAbsoluteYesCount(VOTE_SIGNAL_ENDORSED) >= nAbsVoteReq) fCachedEndorsed = true;
@@ -159,6 +159,9 @@ private:
     /// Failed to parse object data
     bool fUnparsable;
 
+    /// Object or its votes changed since CGovernanceDB last wrote it
+    bool fDirtyDB;
+
     vote_m_t mapCurrentMNVotes;
 
     CGovernanceObjectVoteFile fileVotes;
@@ -229,7 +232,20 @@ public:
 
     void SetExpired()
     {
-        fExpired = true;
+        if (!fExpired) {
+            fExpired = true;
+            fDirtyDB = true;
+        }
+    }
+
+    bool IsDirtyDB() const
+    {
+        return fDirtyDB;
+    }
+
+    void SetDirtyDB(bool fDirty)
+    {
+        fDirtyDB = fDirty;
     }
 
     const CGovernanceObjectVoteFile& GetVoteFile() const
@@ -263,6 +279,7 @@ public:
         fCachedDelete = true;
         if (nDeletionTime == 0) {
             nDeletionTime = nDeletionTime_;
+            fDirtyDB = true;
         }
     }
 
@@ -297,6 +314,16 @@ public:
 
     template <typename Stream, typename Operation>
     inline void SerializationOp(Stream& s, Operation ser_action)
+    {
+        SerializationOpImpl(s, ser_action, true);
+    }
+
+    /**
+     * The serialization above, optionally without the vote file. CGovernanceDB
+     * stores votes as records of their own.
+     */
+    template <typename Stream, typename Operation>
+    inline void SerializationOpImpl(Stream& s, Operation ser_action, bool fWithVotes)
     {
         // SERIALIZE DATA FOR SAVING/LOADING OR NETWORK FUNCTIONS
         READWRITE(nHashParent);
@@ -315,8 +342,10 @@ public:
             READWRITE(nDeletionTime);
             READWRITE(fExpired);
             READWRITE(mapCurrentMNVotes);
-            READWRITE(fileVotes);
-            LogPrint(BCLog::GOBJECT, "CGovernanceObject::SerializationOp hash = %s, vote count = %d\n", GetHash().ToString(), fileVotes.GetVoteCount());
+            if (fWithVotes) {
+                READWRITE(fileVotes);
+                LogPrint(BCLog::GOBJECT, "CGovernanceObject::SerializationOp hash = %s, vote count = %d\n", GetHash().ToString(), fileVotes.GetVoteCount());
+            }
         }
 
         // AFTER DESERIALIZATION OCCURS, CACHED VARIABLES MUST BE CALCULATED MANUALLY
@@ -331,7 +360,11 @@ public:
     bool ProcessVote(CNode* pfrom,
         const CGovernanceVote& vote,
         CGovernanceException& exception,
-        CConnman& connman);
+        CConnman& connman,
+        const std::shared_ptr<const CDeterministicMN>& dmnSigChecked = nullptr);
+
+    /// Restore a vote read from disk, without validating it again
+    void LoadVote(const CGovernanceVote& vote);
 
     /// Called when MN's which have voted on this object have been removed
     void ClearMasternodeVotes();
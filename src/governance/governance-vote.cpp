@@ -241,7 +241,7 @@ bool CGovernanceVote::CheckSignature(const CBLSPublicKey& pubKey) const
     return true;
 }
 
-bool CGovernanceVote::IsValid(bool useVotingKey) const
+bool CGovernanceVote::IsValid(bool useVotingKey, const std::shared_ptr<const CDeterministicMN>& dmnSigChecked) const
 {
     if (nTime > GetAdjustedTime() + (60 * 60)) {
         LogPrint(BCLog::GOBJECT, "CGovernanceVote::IsValid -- vote is too far ahead of current time - %s - nTime %lli - Max Time %lli\n", GetHash().ToString(), nTime, GetAdjustedTime() + (60 * 60));
@@ -266,6 +266,15 @@ bool CGovernanceVote::IsValid(bool useVotingKey) const
         return false;
     }
 
+    if (dmnSigChecked) {
+        bool fSameKey = useVotingKey ? dmnSigChecked->pdmnState->keyIDVoting == dmn->pdmnState->keyIDVoting
+                                     : dmnSigChecked->pdmnState->pubKeyOperator == dmn->pdmnState->pubKeyOperator;
+        if (fSameKey) {
+            return true;
+        }
+        LogPrint(BCLog::GOBJECT, "CGovernanceVote::IsValid -- Masternode key changed since the batch check - %s\n", GetHash().ToString());
+    }
+
     if (useVotingKey) {
         return CheckSignature(dmn->pdmnState->keyIDVoting);
     } else {
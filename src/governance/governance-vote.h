@@ -9,8 +9,11 @@
 #include <primitives/transaction.h>
 #include <bls/bls.h>
 
+#include <memory>
+
 class CGovernanceVote;
 class CConnman;
+class CDeterministicMN;
 
 // INTENTION OF MASTERNODES REGARDING ITEM
 enum vote_outcome_enum_t {
@@ -95,11 +98,18 @@ public:
 
     void SetSignature(const std::vector<unsigned char>& vchSigIn) { vchSig = vchSigIn; }
 
+    const std::vector<unsigned char>& GetSignature() const { return vchSig; }
+
     bool Sign(const CKey& key, const CKeyID& keyID);
     bool CheckSignature(const CKeyID& keyID) const;
     bool Sign(const CBLSSecretKey& key);
     bool CheckSignature(const CBLSPublicKey& pubKey) const;
-    bool IsValid(bool useVotingKey) const;
+    /**
+     * dmnSigChecked is the masternode entry the signature was already verified
+     * against in a batch. The check is skipped only if its keys still match the
+     * ones at the chain tip.
+     */
+    bool IsValid(bool useVotingKey, const std::shared_ptr<const CDeterministicMN>& dmnSigChecked = nullptr) const;
     void Relay(CConnman& connman) const;
 
     const COutPoint& GetMasternodeOutpoint() const { return masternodeOutpoint; }
@@ -7,14 +7,16 @@
 CGovernanceObjectVoteFile::CGovernanceObjectVoteFile() :
     nMemoryVotes(0),
     listVotes(),
-    mapVoteIndex()
+    mapVoteIndex(),
+    mapMasternodeVotes()
 {
 }
 
 CGovernanceObjectVoteFile::CGovernanceObjectVoteFile(const CGovernanceObjectVoteFile& other) :
     nMemoryVotes(other.nMemoryVotes),
     listVotes(other.listVotes),
-    mapVoteIndex()
+    mapVoteIndex(),
+    mapMasternodeVotes()
 {
     RebuildIndex();
 }
@@ -27,6 +29,7 @@ void CGovernanceObjectVoteFile::AddVote(const CGovernanceVote& vote)
         return;
     listVotes.push_front(vote);
     mapVoteIndex.emplace(nHash, listVotes.begin());
+    mapMasternodeVotes.emplace(vote.GetMasternodeOutpoint(), listVotes.begin());
     ++nMemoryVotes;
     RemoveOldVotes(vote);
 }
@@ -49,23 +52,37 @@ bool CGovernanceObjectVoteFile::SerializeVoteToStream(const uint256& nHash, CDat
 std::vector<CGovernanceVote> CGovernanceObjectVoteFile::GetVotes() const
 {
     std::vector<CGovernanceVote> vecResult;
+    vecResult.reserve(listVotes.size());
     for (auto it = listVotes.begin(); it != listVotes.end(); ++it) {
         vecResult.push_back(*it);
     }
     return vecResult;
 }
 
+const CGovernanceVote* CGovernanceObjectVoteFile::GetVote(const uint256& nHash) const
+{
+    auto it = mapVoteIndex.find(nHash);
+    if (it == mapVoteIndex.end()) {
+        return nullptr;
+    }
+    return &*(it->second);
+}
+
+std::vector<uint256> CGovernanceObjectVoteFile::GetVoteHashes() const
+{
+    std::vector<uint256> vecResult;
+    vecResult.reserve(mapVoteIndex.size());
+    for (const auto& p : mapVoteIndex) {
+        vecResult.push_back(p.first);
+    }
+    return vecResult;
+}
+
 void CGovernanceObjectVoteFile::RemoveVotesFromMasternode(const COutPoint& outpointMasternode)
 {
-    auto it = listVotes.begin();
-    while (it != listVotes.end()) {
-        if (it->GetMasternodeOutpoint() == outpointMasternode) {
-            --nMemoryVotes;
-            mapVoteIndex.erase(it->GetHash());
-            listVotes.erase(it++);
-        } else {
-            ++it;
-        }
+    auto range = mapMasternodeVotes.equal_range(outpointMasternode);
+    for (auto it = range.first; it != range.second; ) {
+        EraseVote(it++);
     }
 }
 
@@ -73,19 +90,16 @@ std::set<uint256> CGovernanceObjectVoteFile::RemoveInvalidVotes(const COutPoint&
 {
     std::set<uint256> removedVotes;
 
-    auto it = listVotes.begin();
-    while (it != listVotes.end()) {
-        if (it->GetMasternodeOutpoint() == outpointMasternode) {
-            bool useVotingKey = fProposal && (it->GetSignal() == VOTE_SIGNAL_FUNDING);
-            if (!it->IsValid(useVotingKey)) {
-                removedVotes.emplace(it->GetHash());
-                --nMemoryVotes;
-                mapVoteIndex.erase(it->GetHash());
-                listVotes.erase(it++);
-                continue;
-            }
+    auto range = mapMasternodeVotes.equal_range(outpointMasternode);
+    for (auto it = range.first; it != range.second; ) {
+        const CGovernanceVote& vote = *it->second;
+        bool useVotingKey = fProposal && (vote.GetSignal() == VOTE_SIGNAL_FUNDING);
+        if (!vote.IsValid(useVotingKey)) {
+            removedVotes.emplace(vote.GetHash());
+            EraseVote(it++);
+        } else {
+            ++it;
         }
-        ++it;
     }
 
     return removedVotes;
@@ -93,32 +107,41 @@ std::set<uint256> CGovernanceObjectVoteFile::RemoveInvalidVotes(const COutPoint&
 
 void CGovernanceObjectVoteFile::RemoveOldVotes(const CGovernanceVote& vote)
 {
-    auto it = listVotes.begin();
-    while (it != listVotes.end()) {
-        if (it->GetMasternodeOutpoint() == vote.GetMasternodeOutpoint() // same masternode
-            && it->GetParentHash() == vote.GetParentHash() // same governance object (e.g. same proposal)
-            && it->GetSignal() == vote.GetSignal() // same signal (e.g. "funding", "delete", etc.)
-            && it->GetTimestamp() < vote.GetTimestamp()) // older than new vote
+    // only votes from the same masternode can be superseded
+    auto range = mapMasternodeVotes.equal_range(vote.GetMasternodeOutpoint());
+    for (auto it = range.first; it != range.second; ) {
+        const CGovernanceVote& oldVote = *it->second;
+        if (oldVote.GetParentHash() == vote.GetParentHash() // same governance object (e.g. same proposal)
+            && oldVote.GetSignal() == vote.GetSignal() // same signal (e.g. "funding", "delete", etc.)
+            && oldVote.GetTimestamp() < vote.GetTimestamp()) // older than new vote
         {
-            --nMemoryVotes;
-            mapVoteIndex.erase(it->GetHash());
-            listVotes.erase(it++);
+            EraseVote(it++);
         } else {
             ++it;
         }
     }
 }
 
+void CGovernanceObjectVoteFile::EraseVote(vote_mn_mm_t::iterator it)
+{
+    vote_l_t::iterator itVote = it->second;
+    --nMemoryVotes;
+    mapVoteIndex.erase(itVote->GetHash());
+    mapMasternodeVotes.erase(it);
+    listVotes.erase(itVote);
+}
+
 void CGovernanceObjectVoteFile::RebuildIndex()
 {
     mapVoteIndex.clear();
+    mapMasternodeVotes.clear();
     nMemoryVotes = 0;
     auto it = listVotes.begin();
     while (it != listVotes.end()) {
         CGovernanceVote& vote = *it;
         uint256 nHash = vote.GetHash();
-        if (mapVoteIndex.find(nHash) == mapVoteIndex.end()) {
-            mapVoteIndex[nHash] = it;
+        if (mapVoteIndex.emplace(nHash, it).second) {
+            mapMasternodeVotes.emplace(vote.GetMasternodeOutpoint(), it);
             ++nMemoryVotes;
             ++it;
         } else {
@@ -7,26 +7,31 @@
 
 #include <list>
 #include <map>
+#include <unordered_map>
 
 #include <governance/governance-vote.h>
+#include <saltedhasher.h>
 #include <serialize.h>
 #include <streams.h>
 #include <uint256.h>
 
 /**
  * Represents the collection of votes associated with a given CGovernanceObject
- * Recently received votes are held in memory until a maximum size is reached after
- * which older votes a flushed to a disk file.
  *
- * Note: This is a stub implementation that doesn't limit the number of votes held
- * in memory and doesn't flush to disk.
+ * Votes are kept in a list, newest first, and indexed by vote hash and by
+ * masternode outpoint, so lookups are O(1) and removing the votes of one
+ * masternode only touches that masternode's votes. Older votes for the same
+ * signal are dropped when a newer one arrives, which bounds the file to one
+ * vote per masternode and signal.
  */
 class CGovernanceObjectVoteFile
 {
 public: // Types
     typedef std::list<CGovernanceVote> vote_l_t;
 
-    typedef std::map<uint256, vote_l_t::iterator> vote_m_t;
+    typedef std::unordered_map<uint256, vote_l_t::iterator, StaticSaltedHasher> vote_m_t;
+
+    typedef std::multimap<COutPoint, vote_l_t::iterator> vote_mn_mm_t;
 
 private:
     int nMemoryVotes;
@@ -35,6 +40,8 @@ private:
 
     vote_m_t mapVoteIndex;
 
+    vote_mn_mm_t mapMasternodeVotes;
+
 public:
     CGovernanceObjectVoteFile();
 
@@ -62,6 +69,17 @@ public:
 
     std::vector<CGovernanceVote> GetVotes() const;
 
+    /**
+     * Retrieve a vote cached in memory by hash, nullptr if there is none.
+     * Only valid until the file is modified.
+     */
+    const CGovernanceVote* GetVote(const uint256& nHash) const;
+
+    /**
+     * Hashes of all votes cached in memory, in no particular order
+     */
+    std::vector<uint256> GetVoteHashes() const;
+
     void RemoveVotesFromMasternode(const COutPoint& outpointMasternode);
     std::set<uint256> RemoveInvalidVotes(const COutPoint& outpointMasternode, bool fProposal);
 
@@ -81,6 +99,9 @@ private:
     // Drop older votes for the same gobject from the same masternode
     void RemoveOldVotes(const CGovernanceVote& vote);
 
+    // Remove the vote at it from the list and both indexes
+    void EraseVote(vote_mn_mm_t::iterator it);
+
     void RebuildIndex();
 };
 
@@ -3,6 +3,8 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include <governance/governance.h>
+#include <bls/bls_batchverifier.h>
+#include <clientversion.h>
 #include <consensus/validation.h>
 #include <governance/governance-classes.h>
 #include <governance/governance-validators.h>
@@ -237,20 +239,178 @@ void CGovernanceManager::ProcessMessage(CNode* pfrom, const std::string& strComm
             return;
         }
 
+        // Signatures are verified in batches by ProcessPendingVotes
+        LOCK(cs);
+        if (cmapVoteToObject.HasKey(nHash) || setPendingVotes.count(nHash)) {
+            LogPrint(BCLog::GOBJECT, "MNGOVERNANCEOBJECTVOTE -- skipping known vote %s\n", strHash);
+            return;
+        }
+        std::deque<CGovernanceVote>& queue = mapPendingVotes[pfrom->GetId()];
+        if (queue.size() >= MAX_PENDING_VOTES_PER_PEER || setPendingVotes.size() >= MAX_PENDING_VOTES) {
+            LogPrint(BCLog::GOBJECT, "MNGOVERNANCEOBJECTVOTE -- too many pending votes, dropping vote %s, peer=%d\n", strHash, pfrom->GetId());
+            if (queue.empty()) {
+                mapPendingVotes.erase(pfrom->GetId());
+            }
+            return;
+        }
+        queue.emplace_back(vote);
+        setPendingVotes.emplace(nHash);
+    }
+}
+
+void CGovernanceManager::StartVoteVerification()
+{
+    // can't start new threads if we have them running already
+    assert(voteVerifyPool.size() == 0);
+    int nThreads = std::max(1, std::min(GetNumCores() - 1, 4));
+    voteVerifyPool.resize(nThreads);
+    RenameThreadPool(voteVerifyPool, "pacprotocol-govvote");
+}
+
+void CGovernanceManager::StopVoteVerification()
+{
+    voteVerifyPool.clear_queue();
+    voteVerifyPool.stop(true);
+}
+
+void CGovernanceManager::ProcessPendingVotes(CConnman& connman)
+{
+    std::vector<std::pair<NodeId, CGovernanceVote>> vecVotes;
+    {
+        LOCK(cs);
+        // Take the oldest vote of each peer in turn
+        while (!mapPendingVotes.empty() && vecVotes.size() < MAX_PENDING_VOTES_BATCH) {
+            for (auto it = mapPendingVotes.begin(); it != mapPendingVotes.end() && vecVotes.size() < MAX_PENDING_VOTES_BATCH;) {
+                setPendingVotes.erase(it->second.front().GetHash());
+                vecVotes.emplace_back(it->first, std::move(it->second.front()));
+                it->second.pop_front();
+                if (it->second.empty()) {
+                    it = mapPendingVotes.erase(it);
+                } else {
+                    ++it;
+                }
+            }
+        }
+    }
+    if (vecVotes.empty()) {
+        return;
+    }
+
+    int64_t nTimeStart = GetTimeMicros();
+
+    // Check signatures against the keys ProcessVote would pick. Votes for
+    // unknown objects or masternodes are left to ProcessVote, which orphans
+    // or rejects them. ProcessVote compares the keys of vecVoteMNs with the
+    // chain tip again, in case a block changed them in the meantime.
+    auto mnList = deterministicMNManager->GetListAtChainTip();
+    std::vector<CDeterministicMNCPtr> vecVoteMNs(vecVotes.size());
+    CBLSBatchVerifier<NodeId, uint256> batchVerifier(false, true);
+    std::vector<size_t> vecBLSVotes;
+    std::vector<std::pair<size_t, CKeyID>> vecECDSAVotes;
+    std::set<uint256> setUnknownParents;
+    {
+        LOCK(cs);
+        for (size_t i = 0; i < vecVotes.size(); ++i) {
+            const CGovernanceVote& vote = vecVotes[i].second;
+            auto it = mapObjects.find(vote.GetParentHash());
+            if (it == mapObjects.end()) {
+                setUnknownParents.emplace(vote.GetParentHash());
+                continue;
+            }
+            auto dmn = mnList.GetMNByCollateral(vote.GetMasternodeOutpoint());
+            if (!dmn) {
+                continue;
+            }
+            vecVoteMNs[i] = dmn;
+            if (it->second.GetObjectType() == GOVERNANCE_OBJECT_PROPOSAL && vote.GetSignal() == VOTE_SIGNAL_FUNDING) {
+                vecECDSAVotes.emplace_back(i, dmn->pdmnState->keyIDVoting);
+                continue;
+            }
+            CBLSSignature sig(vote.GetSignature());
+            const CBLSPublicKey& pubKey = dmn->pdmnState->pubKeyOperator.Get();
+            if (!sig.IsValid() || !pubKey.IsValid()) {
+                continue;
+            }
+            batchVerifier.PushMessage(vecVotes[i].first, vote.GetHash(), vote.GetSignatureHash(), sig, pubKey);
+            vecBLSVotes.emplace_back(i);
+        }
+    }
+
+    std::vector<char> vecSigChecked(vecVotes.size(), 0);
+
+    // ECDSA checks run on the pool while this thread verifies the BLS batch
+    std::vector<std::future<void>> futures;
+    size_t nThreads = voteVerifyPool.size();
+    if (nThreads > 0 && !vecECDSAVotes.empty()) {
+        size_t nChunkSize = (vecECDSAVotes.size() + nThreads - 1) / nThreads;
+        for (size_t nStart = 0; nStart < vecECDSAVotes.size(); nStart += nChunkSize) {
+            size_t nEnd = std::min(nStart + nChunkSize, vecECDSAVotes.size());
+            futures.emplace_back(voteVerifyPool.push([&, nStart, nEnd](int) {
+                for (size_t j = nStart; j < nEnd; ++j) {
+                    size_t i = vecECDSAVotes[j].first;
+                    vecSigChecked[i] = vecVotes[i].second.CheckSignature(vecECDSAVotes[j].second);
+                }
+            }));
+        }
+    } else {
+        for (const auto& p : vecECDSAVotes) {
+            vecSigChecked[p.first] = vecVotes[p.first].second.CheckSignature(p.second);
+        }
+    }
+
+    batchVerifier.Verify();
+    for (size_t i : vecBLSVotes) {
+        vecSigChecked[i] = !batchVerifier.badMessages.count(vecVotes[i].second.GetHash());
+    }
+    for (auto& f : futures) {
+        f.get();
+    }
+
+    int64_t nTimeVerify = GetTimeMicros();
+
+    int nAccepted = 0;
+    std::map<NodeId, int> mapPenalties;
+    for (size_t i = 0; i < vecVotes.size(); ++i) {
+        NodeId nodeId = vecVotes[i].first;
+        const CGovernanceVote& vote = vecVotes[i].second;
+        std::string strHash = vote.GetHash().ToString();
         CGovernanceException exception;
-        if (ProcessVote(pfrom, vote, exception, connman)) {
+        if (ProcessVote(nullptr, vote, exception, connman, vecSigChecked[i] ? vecVoteMNs[i] : nullptr)) {
             LogPrint(BCLog::GOBJECT, "MNGOVERNANCEOBJECTVOTE -- %s new\n", strHash);
             masternodeSync.BumpAssetLastTime("MNGOVERNANCEOBJECTVOTE");
             vote.Relay(connman);
+            nAccepted++;
         } else {
             LogPrint(BCLog::GOBJECT, "MNGOVERNANCEOBJECTVOTE -- Rejected vote, error = %s\n", exception.what());
-            if ((exception.GetNodePenalty() != 0) && masternodeSync.IsSynced()) {
-                LOCK(cs_main);
-                Misbehaving(pfrom->GetId(), exception.GetNodePenalty());
+            if (exception.GetNodePenalty() != 0) {
+                mapPenalties[nodeId] += exception.GetNodePenalty();
             }
-            return;
         }
     }
+
+    // ProcessVote had no peer to ask, request unknown parents from the peers that sent the votes
+    for (size_t i = 0; i < vecVotes.size() && !setUnknownParents.empty(); ++i) {
+        const uint256& nParentHash = vecVotes[i].second.GetParentHash();
+        if (!setUnknownParents.count(nParentHash) || HaveObjectForHash(nParentHash)) {
+            continue;
+        }
+        connman.ForNode(vecVotes[i].first, [&](CNode* pnode) {
+            RequestGovernanceObject(pnode, nParentHash, connman);
+            return true;
+        });
+        setUnknownParents.erase(nParentHash);
+    }
+
+    if (!mapPenalties.empty() && masternodeSync.IsSynced()) {
+        LOCK(cs_main);
+        for (const auto& p : mapPenalties) {
+            Misbehaving(p.first, p.second);
+        }
+    }
+
+    LogPrint(BCLog::GOBJECT, "CGovernanceManager::%s -- votes=%d (bls=%d, ecdsa=%d), accepted=%d, verify=%.2fms, total=%.2fms\n", __func__,
+        vecVotes.size(), vecBLSVotes.size(), vecECDSAVotes.size(), nAccepted,
+        (nTimeVerify - nTimeStart) * 0.001, (GetTimeMicros() - nTimeStart) * 0.001);
 }
 
 void CGovernanceManager::CheckOrphanVotes(CGovernanceObject& govobj, CGovernanceException& exception, CConnman& connman)
@@ -349,7 +509,8 @@ void CGovernanceManager::UpdateCachesAndClean()
 
     std::vector<uint256> vecDirtyHashes = mmetaman.GetAndClearDirtyGovernanceObjectHashes();
 
-    LOCK2(cs_main, cs);
+    // Nothing below reads chain state, so cs_main is not needed here
+    LOCK(cs);
 
     for (const uint256& nHash : vecDirtyHashes) {
         auto it = mapObjects.find(nHash);
@@ -400,16 +561,12 @@ void CGovernanceManager::UpdateCachesAndClean()
             mmetaman.RemoveGovernanceObject(pObj->GetHash());
 
             // Remove vote references
-            const object_ref_cm_t::list_t& listItems = cmapVoteToObject.GetItemList();
-            object_ref_cm_t::list_cit lit = listItems.begin();
-            while (lit != listItems.end()) {
-                if (lit->value == pObj) {
-                    uint256 nKey = lit->key;
-                    ++lit;
-                    cmapVoteToObject.Erase(nKey);
-                } else {
-                    ++lit;
+            auto vit = mapVoteHashesByObject.find(nHash);
+            if (vit != mapVoteHashesByObject.end()) {
+                for (const uint256& nHashVote : vit->second) {
+                    cmapVoteToObject.Erase(nHashVote);
                 }
+                mapVoteHashesByObject.erase(vit);
             }
 
             int64_t nTimeExpired{0};
@@ -536,17 +693,23 @@ struct sortProposalsByVotes {
 
 void CGovernanceManager::DoMaintenance(CConnman& connman)
 {
-    if (fDisableGovernance || !masternodeSync.IsSynced() || ShutdownRequested()) return;
+    if (fDisableGovernance || ShutdownRequested()) return;
 
-    // CHECK OBJECTS WE'VE ASKED FOR, REMOVE OLD ENTRIES
+    if (masternodeSync.IsSynced()) {
+        // CHECK OBJECTS WE'VE ASKED FOR, REMOVE OLD ENTRIES
 
-    CleanOrphanObjects();
+        CleanOrphanObjects();
 
-    RequestOrphanObjects(connman);
+        RequestOrphanObjects(connman);
 
-    // CHECK AND REMOVE - REPROCESS GOVERNANCE OBJECTS
+        // CHECK AND REMOVE - REPROCESS GOVERNANCE OBJECTS
 
-    UpdateCachesAndClean();
+        UpdateCachesAndClean();
+    }
+
+    // WRITE WHAT CHANGED SINCE THE LAST RUN, SO SHUTDOWN ONLY HAS THE REST LEFT
+
+    FlushToDB();
 }
 
 bool CGovernanceManager::ConfirmInventoryRequest(const CInv& inv)
@@ -568,7 +731,7 @@ bool CGovernanceManager::ConfirmInventoryRequest(const CInv& inv)
         break;
     }
     case MSG_GOVERNANCE_OBJECT_VOTE: {
-        if (cmapVoteToObject.HasKey(inv.hash)) {
+        if (cmapVoteToObject.HasKey(inv.hash) || setPendingVotes.count(inv.hash)) {
             LogPrint(BCLog::GOBJECT, "CGovernanceManager::ConfirmInventoryRequest already have governance vote, returning false\n");
             return false;
         }
@@ -790,7 +953,7 @@ bool CGovernanceManager::MasternodeRateCheck(const CGovernanceObject& govobj, bo
     return false;
 }
 
-bool CGovernanceManager::ProcessVote(CNode* pfrom, const CGovernanceVote& vote, CGovernanceException& exception, CConnman& connman)
+bool CGovernanceManager::ProcessVote(CNode* pfrom, const CGovernanceVote& vote, CGovernanceException& exception, CConnman& connman, const CDeterministicMNCPtr& dmnSigChecked)
 {
     ENTER_CRITICAL_SECTION(cs);
     uint256 nHashVote = vote.GetHash();
@@ -839,7 +1002,10 @@ bool CGovernanceManager::ProcessVote(CNode* pfrom, const CGovernanceVote& vote,
         return false;
     }
 
-    bool fOk = govobj.ProcessVote(pfrom, vote, exception, connman) && cmapVoteToObject.Insert(nHashVote, &govobj);
+    bool fOk = govobj.ProcessVote(pfrom, vote, exception, connman, dmnSigChecked);
+    if (fOk) {
+        AddVoteReference(nHashVote, govobj);
+    }
     LEAVE_CRITICAL_SECTION(cs);
     return fOk;
 }
@@ -1082,13 +1248,47 @@ void CGovernanceManager::RebuildIndexes()
     LOCK(cs);
 
     cmapVoteToObject.Clear();
+    mapVoteHashesByObject.clear();
     for (auto& objPair : mapObjects) {
         CGovernanceObject& govobj = objPair.second;
         std::vector<CGovernanceVote> vecVotes = govobj.GetVoteFile().GetVotes();
         for (size_t i = 0; i < vecVotes.size(); ++i) {
-            cmapVoteToObject.Insert(vecVotes[i].GetHash(), &govobj);
+            AddVoteReference(vecVotes[i].GetHash(), govobj);
+        }
+    }
+}
+
+void CGovernanceManager::AddVoteReference(const uint256& nHashVote, CGovernanceObject& govobj)
+{
+    AssertLockHeld(cs);
+    if (cmapVoteToObject.HasKey(nHashVote)) {
+        return;
+    }
+    // Evict the oldest reference here rather than inside the cache map, so it
+    // leaves mapVoteHashesByObject too
+    if (cmapVoteToObject.GetSize() >= cmapVoteToObject.GetMaxSize()) {
+        EraseVoteReference(cmapVoteToObject.GetItemList().back().key);
+    }
+    if (cmapVoteToObject.Insert(nHashVote, &govobj)) {
+        mapVoteHashesByObject[govobj.GetHash()].insert(nHashVote);
+    }
+}
+
+void CGovernanceManager::EraseVoteReference(const uint256& nHashVote)
+{
+    AssertLockHeld(cs);
+    CGovernanceObject* pGovobj = nullptr;
+    if (!cmapVoteToObject.Get(nHashVote, pGovobj)) {
+        return;
+    }
+    auto it = mapVoteHashesByObject.find(pGovobj->GetHash());
+    if (it != mapVoteHashesByObject.end()) {
+        it->second.erase(nHashVote);
+        if (it->second.empty()) {
+            mapVoteHashesByObject.erase(it);
         }
     }
+    cmapVoteToObject.Erase(nHashVote);
 }
 
 void CGovernanceManager::AddCachedTriggers()
@@ -1119,6 +1319,84 @@ void CGovernanceManager::InitOnLoad()
     LogPrintf("     %s\n", ToString());
 }
 
+void CGovernanceManager::OpenDB(bool fWipe)
+{
+    LOCK(cs);
+    // close first, LevelDB holds a lock on the directory
+    pdb.reset();
+    pdb.reset(new CGovernanceDB(GetDataDir() / "governance", 1 << 20, false, fWipe));
+}
+
+void CGovernanceManager::CloseDB()
+{
+    LOCK(cs);
+    pdb.reset();
+}
+
+bool CGovernanceManager::IsDBEmpty()
+{
+    LOCK(cs);
+    return !pdb || pdb->IsEmpty();
+}
+
+bool CGovernanceManager::LoadFromDB()
+{
+    LOCK(cs);
+    if (!pdb) return false;
+
+    int64_t nStart = GetTimeMillis();
+    Clear();
+
+    std::vector<unsigned char> vchState;
+    if (!pdb->Load(vchState, mapObjects)) {
+        // either empty or unreadable, start over with a fresh cache
+        mapObjects.clear();
+        return pdb->IsEmpty();
+    }
+
+    try {
+        CDataStream ds(vchState, SER_DISK, CLIENT_VERSION);
+        std::string strVersion;
+        ds >> strVersion;
+        if (strVersion != SERIALIZATION_VERSION_STRING) {
+            LogPrintf("CGovernanceManager::%s -- Governance database has version %s, expected %s, discarding it\n", __func__, strVersion, SERIALIZATION_VERSION_STRING);
+            Clear();
+            return true;
+        }
+        ds >> mapErasedGovernanceObjects;
+        ds >> cmapInvalidVotes;
+        ds >> cmmapOrphanVotes;
+        ds >> mapLastMasternodeObject;
+        ds >> lastMNListForVotingKeys;
+    } catch (const std::exception& e) {
+        Clear();
+        return error("%s: failed to deserialize governance state: %s", __func__, e.what());
+    }
+
+    LogPrintf("Loaded %d governance objects from database  %dms\n", mapObjects.size(), GetTimeMillis() - nStart);
+    CheckAndRemove();
+    return true;
+}
+
+bool CGovernanceManager::FlushToDB(bool fSync)
+{
+    LOCK(cs);
+    if (!pdb) return false;
+
+    CDataStream ds(SER_DISK, CLIENT_VERSION);
+    ds << SERIALIZATION_VERSION_STRING;
+    ds << mapErasedGovernanceObjects;
+    ds << cmapInvalidVotes;
+    ds << cmmapOrphanVotes;
+    ds << mapLastMasternodeObject;
+    ds << lastMNListForVotingKeys;
+
+    int64_t nStart = GetTimeMillis();
+    bool fResult = pdb->Flush(std::vector<unsigned char>(ds.begin(), ds.end()), mapObjects, fSync);
+    LogPrint(BCLog::GOBJECT, "CGovernanceManager::%s -- Flushed governance database  %dms\n", __func__, GetTimeMillis() - nStart);
+    return fResult;
+}
+
 std::string CGovernanceManager::ToString() const
 {
     LOCK(cs);
@@ -1281,7 +1559,7 @@ void CGovernanceManager::RemoveInvalidVotes()
                 continue;
             }
             for (auto& voteHash : removed) {
-                cmapVoteToObject.Erase(voteHash);
+                EraseVoteReference(voteHash);
                 cmapInvalidVotes.Erase(voteHash);
                 cmmapOrphanVotes.Erase(voteHash);
                 setRequestedVotes.erase(voteHash);
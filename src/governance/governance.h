@@ -9,6 +9,8 @@
 #include <cachemap.h>
 #include <cachemultimap.h>
 #include <chain.h>
+#include <ctpl.h>
+#include <governance/governance-db.h>
 #include <governance/governance-exceptions.h>
 #include <governance/governance-object.h>
 #include <governance/governance-vote.h>
@@ -168,9 +170,18 @@ public: // Types
 
     typedef std::set<uint256> hash_s_t;
 
+    typedef std::map<uint256, hash_s_t> hash_s_m_t;
+
 private:
     static const int MAX_CACHE_SIZE = 1000000;
 
+    // votes taken from the queue per ProcessPendingVotes() run
+    static const size_t MAX_PENDING_VOTES_BATCH = 1024;
+
+    // votes queued at most per peer and in total, further votes are dropped on receipt
+    static const size_t MAX_PENDING_VOTES_PER_PEER = 10000;
+    static const size_t MAX_PENDING_VOTES = 100000;
+
     static const std::string SERIALIZATION_VERSION_STRING;
 
     static const int MAX_TIME_FUTURE_DEVIATION;
@@ -192,12 +203,27 @@ private:
     std::map<uint256, CGovernanceObject> mapPostponedObjects;
     hash_s_t setAdditionalRelayObjects;
 
+    std::unique_ptr<CGovernanceDB> pdb;
+
     object_ref_cm_t cmapVoteToObject;
 
+    // vote hashes in cmapVoteToObject by parent object, so deleting an object
+    // only touches its own votes
+    hash_s_m_t mapVoteHashesByObject;
+
     CacheMap<uint256, CGovernanceVote> cmapInvalidVotes;
 
     vote_cmm_t cmmapOrphanVotes;
 
+    // received votes waiting for batched signature verification, with the peer that sent them
+    // in arrival order per peer. Peers are drained in turn, so a flood from one
+    // peer can't hold back the votes of the others.
+    std::map<NodeId, std::deque<CGovernanceVote>> mapPendingVotes;
+    hash_s_t setPendingVotes;
+
+    // checks the ECDSA signatures of pending votes in parallel
+    ctpl::thread_pool voteVerifyPool;
+
     txout_m_t mapLastMasternodeObject;
 
     hash_s_t setRequestedObjects;
@@ -251,6 +277,17 @@ public:
 
     void DoMaintenance(CConnman& connman);
 
+    void StartVoteVerification();
+    void StopVoteVerification();
+
+    /**
+     * Verify queued votes in one go and process them. BLS signatures are
+     * aggregated through CBLSBatchVerifier, ECDSA signatures are checked on
+     * voteVerifyPool. Votes that fail, or could not be checked up front, go
+     * through the regular per vote path so ban scores stay the same.
+     */
+    void ProcessPendingVotes(CConnman& connman);
+
     CGovernanceObject* FindGovernanceObject(const uint256& nHash);
 
     // These commands are only used in RPC
@@ -271,8 +308,11 @@ public:
         mapObjects.clear();
         mapErasedGovernanceObjects.clear();
         cmapVoteToObject.Clear();
+        mapVoteHashesByObject.clear();
         cmapInvalidVotes.Clear();
         cmmapOrphanVotes.Clear();
+        mapPendingVotes.clear();
+        setPendingVotes.clear();
         mapLastMasternodeObject.clear();
     }
 
@@ -353,6 +393,18 @@ public:
 
     void InitOnLoad();
 
+    /**
+     * The governance database, objects and votes are stored as records of
+     * their own and flushes only write what changed. It's flushed
+     * periodically from DoMaintenance() and on shutdown, only the latter
+     * with fSync.
+     */
+    void OpenDB(bool fWipe);
+    void CloseDB();
+    bool IsDBEmpty();
+    bool LoadFromDB();
+    bool FlushToDB(bool fSync = false);
+
     int RequestGovernanceObjectVotes(CNode* pnode, CConnman& connman);
     int RequestGovernanceObjectVotes(const std::vector<CNode*>& vNodesCopy, CConnman& connman);
 
@@ -364,7 +416,7 @@ private:
         cmapInvalidVotes.Insert(vote.GetHash(), vote);
     }
 
-    bool ProcessVote(CNode* pfrom, const CGovernanceVote& vote, CGovernanceException& exception, CConnman& connman);
+    bool ProcessVote(CNode* pfrom, const CGovernanceVote& vote, CGovernanceException& exception, CConnman& connman, const CDeterministicMNCPtr& dmnSigChecked = nullptr);
 
     /// Called to indicate a requested object has been received
     bool AcceptObjectMessage(const uint256& nHash);
@@ -378,6 +430,10 @@ private:
 
     void RebuildIndexes();
 
+    void AddVoteReference(const uint256& nHashVote, CGovernanceObject& govobj);
+
+    void EraseVoteReference(const uint256& nHashVote);
+
     void AddCachedTriggers();
 
     void RequestOrphanObjects(CConnman& connman);
@@ -147,6 +147,41 @@ static bool RPCAuthorized(const std::string& strAuth, std::string& strAuthUserna
     return multiUserAuthorized(strUserPass);
 }
 
+/** Streams a JSON-RPC reply as a chunked HTTP reply */
+class HTTPRPCReplyStream : public JSONRPCReplyStream
+{
+private:
+    HTTPRequest* req;
+    bool fStarted;
+    bool fEnded;
+
+public:
+    explicit HTTPRPCReplyStream(HTTPRequest* reqIn) : req(reqIn), fStarted(false), fEnded(false) {}
+
+    void Write(const std::string& strChunk) override
+    {
+        assert(!fEnded);
+        if (!fStarted) {
+            req->WriteHeader("Content-Type", "application/json");
+            req->WriteReplyStart(HTTP_OK);
+            fStarted = true;
+        }
+        if (!req->WriteReplyChunk(strChunk)) {
+            throw std::runtime_error("client went away while streaming the reply");
+        }
+    }
+
+    void End() override
+    {
+        if (fStarted && !fEnded) {
+            req->WriteReplyEnd();
+            fEnded = true;
+        }
+    }
+
+    bool IsStarted() const override { return fStarted; }
+};
+
 static bool HTTPReq_JSONRPC(HTTPRequest* req, const std::string &)
 {
     // JSONRPC handles only POST
@@ -190,9 +225,16 @@ static bool HTTPReq_JSONRPC(HTTPRequest* req, const std::string &)
         // singleton request
         if (valRequest.isObject()) {
             jreq.parse(valRequest);
+            jreq.replyStream = std::make_shared<HTTPRPCReplyStream>(req);
 
             UniValue result = tableRPC.execute(jreq);
 
+            // Reply was already streamed by the RPC handler
+            if (jreq.replyStream->IsStarted()) {
+                jreq.replyStream->End();
+                return true;
+            }
+
             // Send reply
             strReply = JSONRPCReply(result, NullUniValue, jreq.id);
 
@@ -205,9 +247,20 @@ static bool HTTPReq_JSONRPC(HTTPRequest* req, const std::string &)
         req->WriteHeader("Content-Type", "application/json");
         req->WriteReply(HTTP_OK, strReply);
     } catch (const UniValue& objError) {
+        if (jreq.replyStream && jreq.replyStream->IsStarted()) {
+            // Too late for an error reply, cut the streamed one short
+            LogPrintf("%s: error while streaming reply: %s\n", __func__, objError.write());
+            jreq.replyStream->End();
+            return false;
+        }
         JSONErrorReply(req, objError, jreq.id);
         return false;
     } catch (const std::exception& e) {
+        if (jreq.replyStream && jreq.replyStream->IsStarted()) {
+            LogPrintf("%s: error while streaming reply: %s\n", __func__, e.what());
+            jreq.replyStream->End();
+            return false;
+        }
         JSONErrorReply(req, JSONRPCError(RPC_PARSE_ERROR, e.what()), jreq.id);
         return false;
     }
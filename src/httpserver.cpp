@@ -45,6 +45,8 @@
 
 /** Maximum size of http request (request line + headers) */
 static const size_t MAX_HEADERS_SIZE = 8192;
+/** Bytes of a chunked reply that may wait to be sent before the worker writing it blocks */
+static const size_t MAX_CHUNKED_REPLY_UNSENT = 1024 * 1024;
 
 /** HTTP request work item */
 class HTTPWorkItem final : public HTTPClosure
@@ -494,6 +496,22 @@ struct event_base* EventBase()
     return eventBase;
 }
 
+/** Re-enable reading from the socket. This is the second part of the libevent
+ * workaround in http_request_cb.
+ */
+static void http_reenable_reading(struct evhttp_request* req)
+{
+    if (event_get_version_number() >= 0x02010600 && event_get_version_number() < 0x02020001) {
+        evhttp_connection* conn = evhttp_request_get_connection(req);
+        if (conn) {
+            bufferevent* bev = evhttp_connection_get_bufferevent(conn);
+            if (bev) {
+                bufferevent_enable(bev, EV_READ | EV_WRITE);
+            }
+        }
+    }
+}
+
 static void httpevent_callback_fn(evutil_socket_t, short, void* data)
 {
     // Static handler: simply call inner handler
@@ -520,13 +538,62 @@ void HTTPEvent::trigger(struct timeval* tv)
     else
         evtimer_add(ev, tv); // trigger after timeval passed
 }
+/**
+ * A chunked reply in progress. The worker thread adds to nQueued for every
+ * chunk it hands to the main http thread, which moves the bytes to the
+ * connection's output buffer and records how much is still buffered there.
+ */
+struct HTTPChunkedReply
+{
+    std::mutex cs;
+    std::condition_variable cond;
+    //! Bytes handed to the main thread, but not added to the output buffer yet
+    size_t nQueued{0};
+    //! Bytes in the connection's output buffer at the last check
+    size_t nBuffered{0};
+    //! A check of the output buffer was requested and has not run yet
+    bool fCheckPending{false};
+    //! The connection was closed, libevent freed the request
+    bool fClosed{false};
+};
+
+static void http_chunked_reply_closed(struct evhttp_connection*, void* arg)
+{
+    HTTPChunkedReply* reply = static_cast<HTTPChunkedReply*>(arg);
+    std::lock_guard<std::mutex> lock(reply->cs);
+    reply->fClosed = true;
+    reply->cond.notify_all();
+}
+
+/** Record how much of a chunked reply is still buffered, must run in the main http thread */
+static void http_chunked_reply_check(struct evhttp_request* req, HTTPChunkedReply& reply)
+{
+    std::lock_guard<std::mutex> lock(reply.cs);
+    reply.fCheckPending = false;
+    reply.nBuffered = 0;
+    if (!reply.fClosed) {
+        evhttp_connection* conn = evhttp_request_get_connection(req);
+        bufferevent* bev = conn ? evhttp_connection_get_bufferevent(conn) : nullptr;
+        if (bev) {
+            reply.nBuffered = evbuffer_get_length(bufferevent_get_output(bev));
+        }
+    }
+    reply.cond.notify_all();
+}
+
 HTTPRequest::HTTPRequest(struct evhttp_request* _req) : req(_req),
-                                                       replySent(false)
+                                                       replySent(false),
+                                                       replyChunked(false)
 {
 }
 HTTPRequest::~HTTPRequest()
 {
-    if (!replySent) {
+    if (replyChunked) {
+        // Chunked reply was started but never finished, terminate it so the
+        // connection does not hang
+        LogPrintf("%s: Unfinished chunked reply\n", __func__);
+        WriteReplyEnd();
+    } else if (!replySent) {
         // Keep track of whether reply was sent to avoid request leaks
         LogPrintf("%s: Unhandled request\n", __func__);
         WriteReply(HTTP_INTERNAL, "Unhandled request");
@@ -590,20 +657,115 @@ void HTTPRequest::WriteReply(int nStatus, const std::string& strReply)
     auto req_copy = req;
     HTTPEvent* ev = new HTTPEvent(eventBase, true, [req_copy, nStatus]{
         evhttp_send_reply(req_copy, nStatus, nullptr, nullptr);
-        // Re-enable reading from the socket. This is the second part of the libevent
-        // workaround above.
-        if (event_get_version_number() >= 0x02010600 && event_get_version_number() < 0x02020001) {
-            evhttp_connection* conn = evhttp_request_get_connection(req_copy);
-            if (conn) {
-                bufferevent* bev = evhttp_connection_get_bufferevent(conn);
-                if (bev) {
-                    bufferevent_enable(bev, EV_READ | EV_WRITE);
-                }
-            }
+        http_reenable_reading(req_copy);
+    });
+    ev->trigger(nullptr);
+    replySent = true;
+    req = nullptr; // transferred back to main thread
+}
+
+/** Chunked replies follow the same rule as WriteReply: every libevent call
+ * happens in the main http thread, the worker only queues events. Events
+ * triggered from one thread are run in order, so chunks arrive in sequence.
+ * The worker blocks while more than MAX_CHUNKED_REPLY_UNSENT bytes wait to be
+ * sent, so a slow client does not make the whole reply pile up in memory.
+ */
+void HTTPRequest::WriteReplyStart(int nStatus)
+{
+    assert(!replySent && req);
+    if (ShutdownRequested()) {
+        WriteHeader("Connection", "close");
+    }
+    chunkedReply = std::make_shared<HTTPChunkedReply>();
+    auto req_copy = req;
+    auto reply = chunkedReply;
+    HTTPEvent* ev = new HTTPEvent(eventBase, true, [req_copy, reply, nStatus]{
+        evhttp_connection* conn = evhttp_request_get_connection(req_copy);
+        if (conn) {
+            evhttp_connection_set_closecb(conn, http_chunked_reply_closed, reply.get());
         }
+        evhttp_send_reply_start(req_copy, nStatus, nullptr);
     });
     ev->trigger(nullptr);
     replySent = true;
+    replyChunked = true;
+}
+
+bool HTTPRequest::WriteReplyChunk(const std::string& strChunk)
+{
+    assert(replyChunked && req);
+    if (strChunk.empty()) {
+        return true;
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(chunkedReply->cs);
+        while (!chunkedReply->fClosed && chunkedReply->nQueued + chunkedReply->nBuffered > MAX_CHUNKED_REPLY_UNSENT) {
+            if (ShutdownRequested()) {
+                return false;
+            }
+            // libevent does not tell when the output buffer drains, so look again
+            if (!chunkedReply->fCheckPending) {
+                chunkedReply->fCheckPending = true;
+                auto req_copy = req;
+                auto reply = chunkedReply;
+                HTTPEvent* ev = new HTTPEvent(eventBase, true, [req_copy, reply]{
+                    http_chunked_reply_check(req_copy, *reply);
+                });
+                struct timeval tv = {0, 20 * 1000};
+                ev->trigger(&tv);
+            }
+            chunkedReply->cond.wait_for(lock, std::chrono::milliseconds(100));
+        }
+        if (chunkedReply->fClosed) {
+            return false;
+        }
+        chunkedReply->nQueued += strChunk.size();
+    }
+
+    auto req_copy = req;
+    auto reply = chunkedReply;
+    HTTPEvent* ev = new HTTPEvent(eventBase, true, [req_copy, reply, strChunk]{
+        {
+            std::lock_guard<std::mutex> lock(reply->cs);
+            reply->nQueued -= strChunk.size();
+            if (reply->fClosed) {
+                return;
+            }
+        }
+        struct evbuffer* evb = evbuffer_new();
+        assert(evb);
+        evbuffer_add(evb, strChunk.data(), strChunk.size());
+        evhttp_send_reply_chunk(req_copy, evb);
+        evbuffer_free(evb);
+        http_chunked_reply_check(req_copy, *reply);
+    });
+    ev->trigger(nullptr);
+    return true;
+}
+
+void HTTPRequest::WriteReplyEnd()
+{
+    assert(replyChunked && req);
+    auto req_copy = req;
+    auto reply = chunkedReply;
+    HTTPEvent* ev = new HTTPEvent(eventBase, true, [req_copy, reply]{
+        {
+            std::lock_guard<std::mutex> lock(reply->cs);
+            if (reply->fClosed) {
+                return;
+            }
+        }
+        evhttp_connection* conn = evhttp_request_get_connection(req_copy);
+        if (conn) {
+            evhttp_connection_set_closecb(conn, nullptr, nullptr);
+        }
+        evhttp_send_reply_end(req_copy);
+        http_reenable_reading(req_copy);
+    });
+    ev->trigger(nullptr);
+    replyChunked = false;
+    chunkedReply.reset();
     req = nullptr; // transferred back to main thread
 }
 
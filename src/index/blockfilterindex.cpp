@@ -0,0 +1,396 @@
+// Copyright (c) 2021 pacprotocol
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <index/blockfilterindex.h>
+
+#include <chainparams.h>
+#include <clientversion.h>
+#include <undo.h>
+#include <util.h>
+#include <validation.h>
+
+static const char DB_FILTER = 'f';
+static const char DB_FILTER_POS = 'P';
+static const char DB_BEST_BLOCK = 'B';
+
+static const char* const FLTR_FILE_PREFIX = "fltr";
+static const unsigned int MAX_FLTR_FILE_SIZE = 0x1000000; // 16 MiB
+
+// don't keep more checkpoint headers than a few reorgs worth of the whole chain
+static const size_t CF_HEADERS_CACHE_MAX_SZ = 2000;
+
+static const int64_t SYNC_LOG_INTERVAL = 30; // seconds
+static const int64_t SYNC_COMMIT_INTERVAL = 30; // seconds
+
+std::unique_ptr<BlockFilterIndex> g_blockfilterindex;
+
+BlockFilterIndex::BlockFilterIndex(BlockFilterType filter_type, size_t n_cache_size, bool f_memory, bool f_wipe) :
+    m_filter_type(filter_type),
+    m_path(GetDataDir() / "indexes" / "blockfilter" / "basic"),
+    m_db(m_path / "db", n_cache_size, f_memory, f_wipe)
+{
+    LOCK(m_cs);
+    if (!m_db.Read(DB_FILTER_POS, m_next_filter_pos)) {
+        m_next_filter_pos.SetNull();
+        m_next_filter_pos.nFile = 0;
+    }
+}
+
+BlockFilterIndex::~BlockFilterIndex()
+{
+    m_interrupt();
+    if (m_thread_sync.joinable()) {
+        m_thread_sync.join();
+    }
+    LOCK(m_cs);
+    CloseFilterFile();
+}
+
+FILE* BlockFilterIndex::OpenFilterFile(const CDiskBlockPos& pos, bool fReadOnly) const
+{
+    fs::path path = m_path / strprintf("%s%05u.dat", FLTR_FILE_PREFIX, pos.nFile);
+    FILE* file = fsbridge::fopen(path, fReadOnly ? "rb" : "rb+");
+    if (!file && !fReadOnly) {
+        file = fsbridge::fopen(path, "wb+");
+    }
+    if (!file) {
+        LogPrintf("Unable to open file %s\n", path.string());
+        return nullptr;
+    }
+    if (pos.nPos && fseek(file, pos.nPos, SEEK_SET)) {
+        LogPrintf("Unable to seek to position %u of %s\n", pos.nPos, path.string());
+        fclose(file);
+        return nullptr;
+    }
+    return file;
+}
+
+void BlockFilterIndex::CloseFilterFile()
+{
+    AssertLockHeld(m_cs);
+    if (m_file) {
+        fclose(m_file);
+        m_file = nullptr;
+    }
+}
+
+bool BlockFilterIndex::ReadEntry(const uint256& block_hash, DBVal& entry) const
+{
+    {
+        LOCK(m_cs);
+        auto it = m_pending.find(block_hash);
+        if (it != m_pending.end()) {
+            entry = it->second;
+            return true;
+        }
+    }
+    return m_db.Read(std::make_pair(DB_FILTER, block_hash), entry);
+}
+
+bool BlockFilterIndex::ReadFilter(const uint256& block_hash, const CDiskBlockPos& pos, std::vector<unsigned char>& encoded_filter) const
+{
+    CAutoFile filein(OpenFilterFile(pos, true), SER_DISK, CLIENT_VERSION);
+    if (filein.IsNull()) {
+        return false;
+    }
+
+    uint256 read_block_hash;
+    try {
+        filein >> read_block_hash >> encoded_filter;
+    } catch (const std::exception& e) {
+        return error("%s: Failed to deserialize block filter from disk: %s", __func__, e.what());
+    }
+    if (read_block_hash != block_hash) {
+        return error("%s: Filter at %s is not the one of block %s", __func__, pos.ToString(), block_hash.ToString());
+    }
+    return true;
+}
+
+bool BlockFilterIndex::WriteFilter(const BlockFilter& filter, CDiskBlockPos& pos)
+{
+    AssertLockHeld(m_cs);
+
+    const uint256& block_hash = filter.GetBlockHash();
+    size_t data_size = GetSerializeSize(block_hash, SER_DISK, CLIENT_VERSION) +
+        GetSerializeSize(filter.GetEncodedFilter(), SER_DISK, CLIENT_VERSION);
+
+    // If writing the filter would overflow the file, sync the file and continue in the next one
+    if (m_next_filter_pos.nPos + data_size > MAX_FLTR_FILE_SIZE) {
+        if (m_file && !FileCommit(m_file)) {
+            return error("%s: Failed to sync filter file %d", __func__, m_next_filter_pos.nFile);
+        }
+        CloseFilterFile();
+        m_next_filter_pos.nFile++;
+        m_next_filter_pos.nPos = 0;
+    }
+
+    if (!m_file) {
+        m_file = OpenFilterFile(m_next_filter_pos);
+        if (!m_file) {
+            return error("%s: Failed to open filter file %d", __func__, m_next_filter_pos.nFile);
+        }
+    }
+
+    // m_file stays open, don't let CAutoFile close it
+    CAutoFile fileout(m_file, SER_DISK, CLIENT_VERSION);
+    try {
+        fileout << block_hash << filter.GetEncodedFilter();
+    } catch (const std::exception& e) {
+        fileout.release();
+        CloseFilterFile();
+        return error("%s: Failed to write filter to file %d: %s", __func__, m_next_filter_pos.nFile, e.what());
+    }
+    fileout.release();
+    if (fflush(m_file) != 0) {
+        CloseFilterFile();
+        return error("%s: Failed to flush filter file %d", __func__, m_next_filter_pos.nFile);
+    }
+
+    pos = m_next_filter_pos;
+    m_next_filter_pos.nPos += data_size;
+    return true;
+}
+
+bool BlockFilterIndex::WriteBlock(const CBlock& block, const CBlockIndex* pindex)
+{
+    CBlockUndo block_undo;
+    if (pindex->nHeight > 0 && !UndoReadFromDisk(block_undo, pindex)) {
+        return error("%s: Failed to read undo data of block %s", __func__, pindex->GetBlockHash().ToString());
+    }
+    BlockFilter filter(m_filter_type, block, block_undo);
+
+    LOCK(m_cs);
+
+    const uint256& block_hash = pindex->GetBlockHash();
+    uint256 prev_header;
+    if (pindex->pprev && pindex->pprev != m_best_block_index) {
+        // Not the block after the last one we indexed, it's on another branch or
+        // we have it already
+        DBVal entry;
+        if (ReadEntry(block_hash, entry)) {
+            m_best_block_index = pindex;
+            m_best_header = entry.header;
+            return true;
+        }
+        if (!ReadEntry(pindex->pprev->GetBlockHash(), entry)) {
+            return error("%s: Filter header of block %s not found", __func__, pindex->pprev->GetBlockHash().ToString());
+        }
+        prev_header = entry.header;
+    } else if (pindex->pprev) {
+        prev_header = m_best_header;
+    }
+
+    DBVal entry;
+    entry.hash = filter.GetHash();
+    entry.header = filter.ComputeHeader(prev_header);
+    if (!WriteFilter(filter, entry.pos)) {
+        return false;
+    }
+    m_pending.emplace(block_hash, entry);
+
+    m_best_block_index = pindex;
+    m_best_header = entry.header;
+    return true;
+}
+
+bool BlockFilterIndex::Commit()
+{
+    AssertLockHeld(m_cs);
+
+    if (m_pending.empty()) {
+        return true;
+    }
+
+    // The filters have to be on disk before the entries pointing to them
+    if (m_file && !FileCommit(m_file)) {
+        return error("%s: Failed to sync filter file %d", __func__, m_next_filter_pos.nFile);
+    }
+
+    CDBBatch batch(m_db);
+    for (const auto& p : m_pending) {
+        batch.Write(std::make_pair(DB_FILTER, p.first), p.second);
+    }
+    batch.Write(DB_FILTER_POS, m_next_filter_pos);
+    if (m_best_block_index) {
+        batch.Write(DB_BEST_BLOCK, m_best_block_index->GetBlockHash());
+    }
+    if (!m_db.WriteBatch(batch)) {
+        return error("%s: Failed to write block filter index", __func__);
+    }
+    m_pending.clear();
+    return true;
+}
+
+static const CBlockIndex* NextSyncBlock(const CBlockIndex* pindex_prev) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
+{
+    AssertLockHeld(cs_main);
+
+    if (!pindex_prev) {
+        return chainActive.Genesis();
+    }
+
+    const CBlockIndex* pindex = chainActive.Next(pindex_prev);
+    if (pindex) {
+        return pindex;
+    }
+
+    return chainActive.Next(chainActive.FindFork(pindex_prev));
+}
+
+void BlockFilterIndex::ThreadSync()
+{
+    const CBlockIndex* pindex;
+    {
+        LOCK(m_cs);
+        pindex = m_best_block_index;
+    }
+
+    int64_t last_log_time = 0;
+    int64_t last_commit_time = GetTime();
+    while (!m_interrupt) {
+        const CBlockIndex* pindex_next;
+        {
+            LOCK(cs_main);
+            pindex_next = NextSyncBlock(pindex);
+            if (!pindex_next) {
+                // Blocks connected from now on are indexed by BlockConnected()
+                LOCK(m_cs);
+                Commit();
+                m_synced = true;
+                break;
+            }
+        }
+
+        int64_t current_time = GetTime();
+        if (last_log_time + SYNC_LOG_INTERVAL < current_time) {
+            LogPrintf("Syncing block filter index with block chain from height %d\n", pindex_next->nHeight);
+            last_log_time = current_time;
+        }
+
+        CBlock block;
+        if (!ReadBlockFromDisk(block, pindex_next, Params().GetConsensus())) {
+            LogPrintf("%s: Failed to read block %s from disk\n", __func__, pindex_next->GetBlockHash().ToString());
+            return;
+        }
+        if (!WriteBlock(block, pindex_next)) {
+            LogPrintf("%s: Failed to index block %s\n", __func__, pindex_next->GetBlockHash().ToString());
+            return;
+        }
+        pindex = pindex_next;
+
+        if (last_commit_time + SYNC_COMMIT_INTERVAL < current_time) {
+            LOCK(m_cs);
+            Commit();
+            last_commit_time = current_time;
+        }
+    }
+
+    if (m_synced) {
+        LogPrintf("Block filter index is enabled at height %d\n", pindex ? pindex->nHeight : -1);
+    }
+}
+
+void BlockFilterIndex::BlockConnected(const std::shared_ptr<const CBlock>& block, const CBlockIndex* pindex, const std::vector<CTransactionRef>& txnConflicted)
+{
+    if (!m_synced) {
+        return;
+    }
+
+    if (!WriteBlock(*block, pindex)) {
+        LogPrintf("%s: Failed to index block %s\n", __func__, pindex->GetBlockHash().ToString());
+    }
+}
+
+void BlockFilterIndex::SetBestChain(const CBlockLocator& locator)
+{
+    // Commit along with the chainstate rather than on every block
+    LOCK(m_cs);
+    Commit();
+}
+
+void BlockFilterIndex::Start()
+{
+    uint256 best_block_hash;
+    if (m_db.Read(DB_BEST_BLOCK, best_block_hash)) {
+        LOCK2(cs_main, m_cs);
+        DBVal entry;
+        m_best_block_index = LookupBlockIndex(best_block_hash);
+        if (m_best_block_index && m_db.Read(std::make_pair(DB_FILTER, best_block_hash), entry)) {
+            m_best_header = entry.header;
+        } else {
+            m_best_block_index = nullptr;
+        }
+    }
+
+    RegisterValidationInterface(this);
+    m_thread_sync = std::thread(&TraceThread<std::function<void()> >, "blockfilter", std::function<void()>(std::bind(&BlockFilterIndex::ThreadSync, this)));
+}
+
+void BlockFilterIndex::Stop()
+{
+    UnregisterValidationInterface(this);
+
+    m_interrupt();
+    if (m_thread_sync.joinable()) {
+        m_thread_sync.join();
+    }
+
+    LOCK(m_cs);
+    Commit();
+    CloseFilterFile();
+}
+
+bool BlockFilterIndex::LookupFilter(const CBlockIndex* pindex, std::vector<unsigned char>& encoded_filter) const
+{
+    DBVal entry;
+    if (!ReadEntry(pindex->GetBlockHash(), entry)) {
+        return false;
+    }
+    return ReadFilter(pindex->GetBlockHash(), entry.pos, encoded_filter);
+}
+
+bool BlockFilterIndex::LookupFilterHeader(const CBlockIndex* pindex, uint256& header) const
+{
+    bool is_checkpoint = pindex->nHeight % CFCHECKPT_INTERVAL == 0;
+
+    if (is_checkpoint) {
+        LOCK(m_cs_headers_cache);
+        auto it = m_headers_cache.find(pindex->GetBlockHash());
+        if (it != m_headers_cache.end()) {
+            header = it->second;
+            return true;
+        }
+    }
+
+    DBVal entry;
+    if (!ReadEntry(pindex->GetBlockHash(), entry)) {
+        return false;
+    }
+    header = entry.header;
+
+    if (is_checkpoint) {
+        LOCK(m_cs_headers_cache);
+        if (m_headers_cache.size() < CF_HEADERS_CACHE_MAX_SZ) {
+            m_headers_cache.emplace(pindex->GetBlockHash(), header);
+        }
+    }
+    return true;
+}
+
+bool BlockFilterIndex::LookupFilterHashRange(int start_height, const CBlockIndex* stop_index, std::vector<uint256>& hashes) const
+{
+    if (start_height < 0 || start_height > stop_index->nHeight) {
+        return false;
+    }
+
+    hashes.resize(stop_index->nHeight - start_height + 1);
+    for (const CBlockIndex* pindex = stop_index; pindex && pindex->nHeight >= start_height; pindex = pindex->pprev) {
+        DBVal entry;
+        if (!ReadEntry(pindex->GetBlockHash(), entry)) {
+            return false;
+        }
+        hashes[pindex->nHeight - start_height] = entry.hash;
+    }
+    return true;
+}
@@ -0,0 +1,130 @@
+// Copyright (c) 2021 pacprotocol
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_INDEX_BLOCKFILTERINDEX_H
+#define BITCOIN_INDEX_BLOCKFILTERINDEX_H
+
+#include <blockfilter.h>
+#include <chain.h>
+#include <dbwrapper.h>
+#include <saltedhasher.h>
+#include <sync.h>
+#include <threadinterrupt.h>
+#include <validationinterface.h>
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+/** Default for -blockfilterindex */
+static const bool DEFAULT_BLOCKFILTERINDEX = false;
+/** Default for -peerblockfilters */
+static const bool DEFAULT_PEERBLOCKFILTERS = false;
+
+/** Interval between the filter headers of a cfcheckpt message */
+static constexpr int CFCHECKPT_INTERVAL = 1000;
+
+/**
+ * Index of the BIP 158 filters of all blocks on the active chain, used to
+ * answer the BIP 157 getcfilters, getcfheaders and getcfcheckpt messages.
+ *
+ * The filters are appended to flat files (fltr?????.dat) and a LevelDB
+ * database maps every indexed block hash to the position of its filter, the
+ * filter hash and the filter header. Entries are keyed by block hash, so
+ * blocks which get disconnected keep their entries and nothing has to be
+ * undone on a reorg.
+ *
+ * On startup a background thread indexes the blocks connected since the last
+ * run, after that the index follows BlockConnected(). New entries are kept in
+ * memory and written when the chainstate is flushed (SetBestChain()), the
+ * filter file being appended to stays open in between.
+ */
+class BlockFilterIndex final : public CValidationInterface
+{
+public:
+    struct DBVal {
+        uint256 hash;
+        uint256 header;
+        CDiskBlockPos pos;
+
+        ADD_SERIALIZE_METHODS;
+
+        template <typename Stream, typename Operation>
+        inline void SerializationOp(Stream& s, Operation ser_action) {
+            READWRITE(hash);
+            READWRITE(header);
+            READWRITE(pos);
+        }
+    };
+
+private:
+    const BlockFilterType m_filter_type;
+    const fs::path m_path;
+
+    CDBWrapper m_db;
+
+    // Protects writing to the index and the entries not committed yet
+    mutable CCriticalSection m_cs;
+    std::unordered_map<uint256, DBVal, StaticSaltedHasher> m_pending GUARDED_BY(m_cs);
+    const CBlockIndex* m_best_block_index GUARDED_BY(m_cs){nullptr};
+    uint256 m_best_header GUARDED_BY(m_cs);
+    CDiskBlockPos m_next_filter_pos GUARDED_BY(m_cs);
+    // The file filters are appended to, flushed after every filter so readers see it
+    FILE* m_file GUARDED_BY(m_cs){nullptr};
+
+    // Filter headers of checkpoint blocks, asked for by every cfcheckpt request
+    mutable CCriticalSection m_cs_headers_cache;
+    mutable std::unordered_map<uint256, uint256, StaticSaltedHasher> m_headers_cache GUARDED_BY(m_cs_headers_cache);
+
+    // Set once the background thread caught up with the chain, from then on
+    // blocks are indexed as they are connected
+    std::atomic<bool> m_synced{false};
+    std::thread m_thread_sync;
+    CThreadInterrupt m_interrupt;
+
+    FILE* OpenFilterFile(const CDiskBlockPos& pos, bool fReadOnly = false) const;
+    void CloseFilterFile() EXCLUSIVE_LOCKS_REQUIRED(m_cs);
+    bool ReadEntry(const uint256& block_hash, DBVal& entry) const;
+    bool ReadFilter(const uint256& block_hash, const CDiskBlockPos& pos, std::vector<unsigned char>& encoded_filter) const;
+    bool WriteFilter(const BlockFilter& filter, CDiskBlockPos& pos) EXCLUSIVE_LOCKS_REQUIRED(m_cs);
+
+    /** Compute the filter of a connected block and add it to the pending batch */
+    bool WriteBlock(const CBlock& block, const CBlockIndex* pindex);
+    /** Sync the filter file and write the pending entries */
+    bool Commit() EXCLUSIVE_LOCKS_REQUIRED(m_cs);
+
+    void ThreadSync();
+
+protected:
+    void BlockConnected(const std::shared_ptr<const CBlock>& block, const CBlockIndex* pindex, const std::vector<CTransactionRef>& txnConflicted) override;
+    void SetBestChain(const CBlockLocator& locator) override;
+
+public:
+    BlockFilterIndex(BlockFilterType filter_type, size_t n_cache_size, bool f_memory = false, bool f_wipe = false);
+    ~BlockFilterIndex();
+
+    BlockFilterType GetFilterType() const { return m_filter_type; }
+    bool IsSynced() const { return m_synced; }
+
+    /** Start indexing the blocks missing from the index in the background and follow the chain after that */
+    void Start();
+    /** Stop following the chain and write everything indexed so far */
+    void Stop();
+
+    /** Get the encoded filter of a block */
+    bool LookupFilter(const CBlockIndex* pindex, std::vector<unsigned char>& encoded_filter) const;
+
+    /** Get the filter header of a block */
+    bool LookupFilterHeader(const CBlockIndex* pindex, uint256& header) const;
+
+    /** Get the filter hashes of all blocks from start_height up to stop_index */
+    bool LookupFilterHashRange(int start_height, const CBlockIndex* stop_index, std::vector<uint256>& hashes) const;
+};
+
+/** The basic filter index, null unless -blockfilterindex is set */
+extern std::unique_ptr<BlockFilterIndex> g_blockfilterindex;
+
+#endif // BITCOIN_INDEX_BLOCKFILTERINDEX_H
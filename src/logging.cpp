@@ -7,8 +7,12 @@
 #include <util.h>
 #include <utilstrencodings.h>
 
+#include <algorithm>
+#include <condition_variable>
 #include <list>
+#include <memory>
 #include <mutex>
+#include <thread>
 
 const char * const DEFAULT_DEBUGLOGFILE = "debug.log";
 
@@ -49,6 +53,50 @@ static FILE* fileout = nullptr;
 static std::mutex* mutexDebugLog = nullptr;
 static std::list<std::string>* vMsgsBeforeOpenLog;
 
+namespace {
+
+/** Registers the ring of a thread and marks it orphaned when the thread exits */
+struct ThreadLogRing
+{
+    std::shared_ptr<BCLog::LogRing> ring;
+    ~ThreadLogRing() { if (ring) ring->fOrphaned = true; }
+};
+
+struct AsyncLogger
+{
+    //! Guards vRings
+    std::mutex cs;
+    std::vector<std::shared_ptr<BCLog::LogRing>> vRings;
+
+    //! Guards starting and stopping the writer thread
+    std::mutex csThread;
+    std::thread thread;
+
+    std::mutex csWake;
+    std::condition_variable condWake;
+    //! Guarded by csWake, makes sure a wake up that comes while the writer is busy isn't lost
+    bool fWake{false};
+
+    //! Signalled by the writer after it made room, see LogPrintAsync()
+    std::mutex csRoom;
+    std::condition_variable condRoom;
+
+    std::atomic<size_t> nBufferSize{DEFAULT_LOGASYNC_BUFFER};
+    std::atomic<bool> fBlock{DEFAULT_LOGASYNC_BLOCK};
+    std::atomic<bool> fRunning{false};
+    std::atomic<bool> fStop{false};
+
+    std::atomic<uint64_t> nWritten{0};
+    std::atomic<uint64_t> nDropped{0};
+    std::atomic<uint64_t> nBlocked{0};
+};
+
+} // namespace
+
+/** Leaked on exit like mutexDebugLog, see above */
+static AsyncLogger* asyncLogger = nullptr;
+static thread_local ThreadLogRing threadLogRing;
+
 static int FileWriteStr(const std::string &str, FILE *fp)
 {
     return fwrite(str.data(), 1, str.size(), fp);
@@ -59,6 +107,7 @@ static void DebugPrintInit()
     assert(mutexDebugLog == nullptr);
     mutexDebugLog = new std::mutex();
     vMsgsBeforeOpenLog = new std::list<std::string>;
+    asyncLogger = new AsyncLogger();
 }
 
 fs::path GetDebugLogPath()
@@ -224,34 +273,32 @@ std::string ListActiveLogCategoriesString()
     return ret;
 }
 
+static std::string LogTimestampPrefix(int64_t nTimeMicros)
+{
+    std::string strStamped = FormatISO8601DateTime(nTimeMicros/1000000);
+    if (fLogTimeMicros) {
+        strStamped.pop_back();
+        strStamped += strprintf(".%06dZ", nTimeMicros%1000000);
+    }
+    int64_t mocktime = GetMockTime();
+    if (mocktime) {
+        strStamped += " (mocktime: " + FormatISO8601DateTime(mocktime) + ")";
+    }
+    strStamped += ' ';
+    return strStamped;
+}
+
 /**
  * fStartedNewLine is a state variable held by the calling context that will
  * suppress printing of the timestamp when multiple calls are made that don't
- * end in a newline. Initialize it to true, and hold it, in the calling context.
+ * end in a newline.
  */
-static std::string LogTimestampStr(const std::string &str, std::atomic_bool *fStartedNewLine)
+static std::string LogTimestampStr(const std::string &str, bool fStartedNewLine)
 {
-    std::string strStamped;
-
-    if (!fLogTimestamps)
+    if (!fLogTimestamps || !fStartedNewLine)
         return str;
 
-    if (*fStartedNewLine) {
-        int64_t nTimeMicros = GetTimeMicros();
-        strStamped = FormatISO8601DateTime(nTimeMicros/1000000);
-        if (fLogTimeMicros) {
-            strStamped.pop_back();
-            strStamped += strprintf(".%06dZ", nTimeMicros%1000000);
-        }
-        int64_t mocktime = GetMockTime();
-        if (mocktime) {
-            strStamped += " (mocktime: " + FormatISO8601DateTime(mocktime) + ")";
-        }
-        strStamped += ' ' + str;
-    } else
-        strStamped = str;
-
-    return strStamped;
+    return LogTimestampPrefix(GetTimeMicros()) + str;
 }
 
 /**
@@ -276,19 +323,239 @@ static std::string LogThreadNameStr(const std::string &str, std::atomic_bool *fS
     return strThreadLogged;
 }
 
+static BCLog::LogRing& GetThreadLogRing()
+{
+    if (!threadLogRing.ring) {
+        threadLogRing.ring = std::make_shared<BCLog::LogRing>(std::max<size_t>(asyncLogger->nBufferSize, 1));
+        std::lock_guard<std::mutex> lock(asyncLogger->cs);
+        asyncLogger->vRings.push_back(threadLogRing.ring);
+    }
+    return *threadLogRing.ring;
+}
+
+static void WakeAsyncLogWriter(AsyncLogger& logger)
+{
+    {
+        std::lock_guard<std::mutex> lock(logger.csWake);
+        logger.fWake = true;
+    }
+    logger.condWake.notify_one();
+}
+
+/** Queue a message for the writer thread, returns false if it has to be written by the caller */
+static bool LogPrintAsync(std::string&& str, bool fTimestamp)
+{
+    std::call_once(debugPrintInitFlag, &DebugPrintInit);
+    AsyncLogger& logger = *asyncLogger;
+    if (!logger.fRunning.load(std::memory_order_relaxed)) {
+        return false;
+    }
+
+    BCLog::LogRing& ring = GetThreadLogRing();
+    // Check again after flagging the ring, StopAsyncLogging() waits for busy rings
+    ring.fBusy = true;
+    if (!logger.fRunning) {
+        ring.fBusy = false;
+        return false;
+    }
+
+    BCLog::LogRecord record;
+    record.nTimeMicros = GetTimeMicros();
+    record.fTimestamp = fTimestamp;
+    record.str = std::move(str);
+
+    bool fQueued = ring.Push(record);
+    if (!fQueued && logger.fBlock) {
+        logger.nBlocked.fetch_add(1, std::memory_order_relaxed);
+        // The writer takes csRoom before notifying, so room made after the
+        // Push() failed can't be missed
+        std::unique_lock<std::mutex> lock(logger.csRoom);
+        while (!(fQueued = ring.Push(record)) && logger.fRunning) {
+            WakeAsyncLogWriter(logger);
+            logger.condRoom.wait(lock);
+        }
+        if (!fQueued) {
+            // Stopping, write it ourselves
+            str = std::move(record.str);
+            ring.fBusy.store(false, std::memory_order_release);
+            return false;
+        }
+    }
+    if (!fQueued) {
+        logger.nDropped.fetch_add(1, std::memory_order_relaxed);
+    }
+    // Don't wait for the writer to wake up by itself when the ring fills up
+    if (ring.Size() > ring.Capacity() / 2) {
+        WakeAsyncLogWriter(logger);
+    }
+    ring.fBusy.store(false, std::memory_order_release);
+    return true;
+}
+
+static int WriteDebugLogStr(const std::string &str)
+{
+    std::lock_guard<std::mutex> scoped_lock(*mutexDebugLog);
+
+    // buffer if we haven't opened the log yet
+    if (fileout == nullptr) {
+        assert(vMsgsBeforeOpenLog);
+        vMsgsBeforeOpenLog->push_back(str);
+        return str.length();
+    }
+
+    // reopen the log file, if requested
+    if (fReopenDebugLog) {
+        fReopenDebugLog = false;
+        fs::path pathDebug = GetDebugLogPath();
+        if (fsbridge::freopen(pathDebug,"a",fileout) != nullptr)
+            setbuf(fileout, nullptr); // unbuffered
+    }
+
+    return FileWriteStr(str, fileout);
+}
+
+/**
+ * Collects the queued messages of all threads, orders them by the time they
+ * were logged and writes them with a single write.
+ */
+static void AsyncLogWriter()
+{
+    RenameThread("pacprotocol-logger");
+
+    AsyncLogger& logger = *asyncLogger;
+    std::vector<BCLog::LogRecord> vRecords;
+    std::string strBuffer;
+    uint64_t nDroppedReported = logger.nDropped;
+
+    while (true) {
+        // Everything is queued once fStop is set, so one more round drains the rings
+        const bool fStop = logger.fStop;
+        {
+            std::lock_guard<std::mutex> lock(logger.cs);
+            for (auto it = logger.vRings.begin(); it != logger.vRings.end();) {
+                const bool fOrphaned = (*it)->fOrphaned;
+                BCLog::LogRecord record;
+                while ((*it)->Pop(record)) {
+                    vRecords.push_back(std::move(record));
+                }
+                if (fOrphaned && (*it)->Size() == 0) {
+                    it = logger.vRings.erase(it);
+                } else {
+                    ++it;
+                }
+            }
+        }
+
+        std::stable_sort(vRecords.begin(), vRecords.end(), [](const BCLog::LogRecord& a, const BCLog::LogRecord& b) {
+            return a.nTimeMicros < b.nTimeMicros;
+        });
+        for (const BCLog::LogRecord& record : vRecords) {
+            if (record.fTimestamp) {
+                strBuffer += LogTimestampPrefix(record.nTimeMicros);
+            }
+            strBuffer += record.str;
+        }
+        const uint64_t nDropped = logger.nDropped;
+        if (nDropped != nDroppedReported) {
+            strBuffer += strprintf("%s%u log messages dropped, the log buffers were full\n",
+                fLogTimestamps ? LogTimestampPrefix(GetTimeMicros()) : "", nDropped - nDroppedReported);
+            nDroppedReported = nDropped;
+        }
+        if (!strBuffer.empty()) {
+            WriteDebugLogStr(strBuffer);
+        }
+        logger.nWritten.fetch_add(vRecords.size(), std::memory_order_relaxed);
+        if (!vRecords.empty() && logger.fBlock) {
+            { std::lock_guard<std::mutex> lockRoom(logger.csRoom); }
+            logger.condRoom.notify_all();
+        }
+        vRecords.clear();
+        strBuffer.clear();
+
+        if (fStop) {
+            break;
+        }
+        std::unique_lock<std::mutex> lock(logger.csWake);
+        logger.condWake.wait_for(lock, std::chrono::milliseconds(50), [&logger] { return logger.fWake; });
+        logger.fWake = false;
+    }
+}
+
+void StartAsyncLogging(size_t nBufferSize, bool fBlock)
+{
+    std::call_once(debugPrintInitFlag, &DebugPrintInit);
+    AsyncLogger& logger = *asyncLogger;
+    std::lock_guard<std::mutex> lock(logger.csThread);
+    if (logger.thread.joinable()) {
+        return;
+    }
+    logger.nBufferSize = nBufferSize;
+    logger.fBlock = fBlock;
+    logger.fStop = false;
+    logger.thread = std::thread(&AsyncLogWriter);
+    logger.fRunning = true;
+}
+
+void StopAsyncLogging()
+{
+    std::call_once(debugPrintInitFlag, &DebugPrintInit);
+    AsyncLogger& logger = *asyncLogger;
+    std::lock_guard<std::mutex> lock(logger.csThread);
+    if (!logger.thread.joinable()) {
+        return;
+    }
+
+    // New messages are written synchronously from now on, wait for the
+    // threads which saw the writer running to finish queueing theirs
+    logger.fRunning = false;
+    { std::lock_guard<std::mutex> lockRoom(logger.csRoom); }
+    logger.condRoom.notify_all();
+    {
+        std::lock_guard<std::mutex> lockRings(logger.cs);
+        for (const auto& ring : logger.vRings) {
+            while (ring->fBusy) {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+    logger.fStop = true;
+    WakeAsyncLogWriter(logger);
+    logger.thread.join();
+
+    LogPrintf("%s: wrote %u messages, dropped %u, waited for room %u times\n", __func__,
+        logger.nWritten.load(), logger.nDropped.load(), logger.nBlocked.load());
+}
+
+CAsyncLogStats GetAsyncLogStats()
+{
+    std::call_once(debugPrintInitFlag, &DebugPrintInit);
+    return CAsyncLogStats{asyncLogger->nWritten, asyncLogger->nDropped, asyncLogger->nBlocked};
+}
+
 int LogPrintStr(const std::string &str)
 {
     int ret = 0; // Returns total number of characters written
     static std::atomic_bool fStartedNewLine(true);
 
     std::string strThreadLogged = LogThreadNameStr(str, &fStartedNewLine);
-    std::string strTimestamped = LogTimestampStr(strThreadLogged, &fStartedNewLine);
+    const bool fNewLine = fStartedNewLine;
 
     if (!str.empty() && str[str.size()-1] == '\n')
         fStartedNewLine = true;
     else
         fStartedNewLine = false;
 
+    // The writer thread adds the timestamp
+    if (!fPrintToConsole && fPrintToDebugLog) {
+        ret = strThreadLogged.size();
+        if (LogPrintAsync(std::move(strThreadLogged), fLogTimestamps && fNewLine)) {
+            return ret;
+        }
+    }
+
+    std::string strTimestamped = LogTimestampStr(strThreadLogged, fNewLine);
+
     if (fPrintToConsole)
     {
         // print to console
@@ -298,26 +565,7 @@ int LogPrintStr(const std::string &str)
     else if (fPrintToDebugLog)
     {
         std::call_once(debugPrintInitFlag, &DebugPrintInit);
-        std::lock_guard<std::mutex> scoped_lock(*mutexDebugLog);
-
-        // buffer if we haven't opened the log yet
-        if (fileout == nullptr) {
-            assert(vMsgsBeforeOpenLog);
-            ret = strTimestamped.length();
-            vMsgsBeforeOpenLog->push_back(strTimestamped);
-        }
-        else
-        {
-            // reopen the log file, if requested
-            if (fReopenDebugLog) {
-                fReopenDebugLog = false;
-                fs::path pathDebug = GetDebugLogPath();
-                if (fsbridge::freopen(pathDebug,"a",fileout) != nullptr)
-                    setbuf(fileout, nullptr); // unbuffered
-            }
-
-            ret = FileWriteStr(strTimestamped, fileout);
-        }
+        ret = WriteDebugLogStr(strTimestamped);
     }
     return ret;
 }
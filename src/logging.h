@@ -18,6 +18,9 @@ static const bool DEFAULT_LOGTIMEMICROS  = false;
 static const bool DEFAULT_LOGIPS         = false;
 static const bool DEFAULT_LOGTIMESTAMPS  = true;
 static const bool DEFAULT_LOGTHREADNAMES = false;
+static const bool DEFAULT_LOGASYNC       = false;
+static const unsigned int DEFAULT_LOGASYNC_BUFFER = 4096;
+static const bool DEFAULT_LOGASYNC_BLOCK = false;
 extern const char * const DEFAULT_DEBUGLOGFILE;
 
 extern bool fPrintToConsole;
@@ -158,4 +161,81 @@ fs::path GetDebugLogPath();
 bool OpenDebugLog();
 void ShrinkDebugFile();
 
+/** Counters of the asynchronous debug.log writer */
+struct CAsyncLogStats
+{
+    uint64_t nWritten;
+    uint64_t nDropped;
+    uint64_t nBlocked;
+};
+
+namespace BCLog {
+    /** A message queued for the writer thread */
+    struct LogRecord
+    {
+        int64_t nTimeMicros{0};
+        bool fTimestamp{false};
+        std::string str;
+    };
+
+    /**
+     * Ring buffer of the messages of one logging thread. Only that thread pushes
+     * and only the writer thread pops, so the two indexes are all the
+     * synchronization needed.
+     */
+    class LogRing
+    {
+    private:
+        std::vector<LogRecord> vRecords;
+        alignas(64) std::atomic<size_t> nHead{0};
+        alignas(64) std::atomic<size_t> nTail{0};
+
+    public:
+        //! Set while the owning thread is pushing, see StopAsyncLogging()
+        std::atomic<bool> fBusy{false};
+        //! Set once the owning thread exited, the ring is dropped once it is empty
+        std::atomic<bool> fOrphaned{false};
+
+        explicit LogRing(size_t nCapacity) : vRecords(nCapacity) {}
+
+        /** Move record into the ring, returns false and leaves it alone when the ring is full */
+        bool Push(LogRecord& record)
+        {
+            const size_t head = nHead.load(std::memory_order_relaxed);
+            if (head - nTail.load(std::memory_order_acquire) == vRecords.size()) {
+                return false;
+            }
+            vRecords[head % vRecords.size()] = std::move(record);
+            nHead.store(head + 1, std::memory_order_release);
+            return true;
+        }
+
+        bool Pop(LogRecord& record)
+        {
+            const size_t tail = nTail.load(std::memory_order_relaxed);
+            if (tail == nHead.load(std::memory_order_acquire)) {
+                return false;
+            }
+            record = std::move(vRecords[tail % vRecords.size()]);
+            nTail.store(tail + 1, std::memory_order_release);
+            return true;
+        }
+
+        size_t Size() const { return nHead.load(std::memory_order_acquire) - nTail.load(std::memory_order_acquire); }
+        size_t Capacity() const { return vRecords.size(); }
+    };
+} // namespace BCLog
+
+/**
+ * Write debug.log from a background thread instead of the logging threads.
+ * Every logging thread queues its messages in a ring buffer of its own, which
+ * holds nBufferSize messages. When it is full new messages are dropped, or
+ * with fBlock the logging thread waits until the writer made room.
+ */
+void StartAsyncLogging(size_t nBufferSize, bool fBlock);
+/** Write out all queued messages and log from the logging threads again */
+void StopAsyncLogging();
+/** Counters since startup, published to statsd by PeriodicStats() */
+CAsyncLogStats GetAsyncLogStats();
+
 #endif // BITCOIN_LOGGING_H
@@ -0,0 +1,103 @@
+// Copyright (c) 2021 pacprotocol
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <mappedfile.h>
+
+#ifndef WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+CMappedFile::~CMappedFile()
+{
+#ifndef WIN32
+    munmap((void*)m_data, m_size);
+#endif
+}
+
+std::shared_ptr<const CMappedFile> CMappedFile::Open(const fs::path& path)
+{
+#ifndef WIN32
+    int fd = open(path.string().c_str(), O_RDONLY);
+    if (fd == -1) {
+        return nullptr;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+        close(fd);
+        return nullptr;
+    }
+    void* data = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    // The mapping stays valid after closing the descriptor
+    close(fd);
+    if (data == MAP_FAILED) {
+        return nullptr;
+    }
+    return std::shared_ptr<const CMappedFile>(new CMappedFile((const unsigned char*)data, st.st_size));
+#else
+    return nullptr;
+#endif
+}
+
+void CMappedFileCache::EraseLocked(const std::string& key)
+{
+    auto it = mapFiles.find(key);
+    if (it != mapFiles.end()) {
+        listFiles.erase(it->second);
+        mapFiles.erase(it);
+    }
+}
+
+void CMappedFileCache::SetMaxFiles(size_t nMaxFilesIn)
+{
+    LOCK(cs);
+    nMaxFiles = nMaxFilesIn;
+    while (listFiles.size() > nMaxFiles) {
+        mapFiles.erase(listFiles.back().first);
+        listFiles.pop_back();
+    }
+}
+
+bool CMappedFileCache::IsEnabled()
+{
+    LOCK(cs);
+    return nMaxFiles > 0;
+}
+
+std::shared_ptr<const CMappedFile> CMappedFileCache::Get(const fs::path& path, size_t nMinSize)
+{
+    LOCK(cs);
+    if (nMaxFiles == 0) {
+        return nullptr;
+    }
+    const std::string key = path.string();
+    auto it = mapFiles.find(key);
+    if (it != mapFiles.end()) {
+        listFiles.splice(listFiles.begin(), listFiles, it->second);
+        if (it->second->second->size() >= nMinSize) {
+            return it->second->second;
+        }
+        EraseLocked(key);
+    }
+
+    std::shared_ptr<const CMappedFile> file = CMappedFile::Open(path);
+    if (!file) {
+        return nullptr;
+    }
+    listFiles.emplace_front(key, file);
+    mapFiles.emplace(key, listFiles.begin());
+    if (listFiles.size() > nMaxFiles) {
+        mapFiles.erase(listFiles.back().first);
+        listFiles.pop_back();
+    }
+    return file->size() >= nMinSize ? file : nullptr;
+}
+
+void CMappedFileCache::Erase(const fs::path& path)
+{
+    LOCK(cs);
+    EraseLocked(path.string());
+}
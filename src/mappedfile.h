@@ -0,0 +1,71 @@
+// Copyright (c) 2021 pacprotocol
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_MAPPEDFILE_H
+#define BITCOIN_MAPPEDFILE_H
+
+#include <fs.h>
+#include <sync.h>
+
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+/** A read-only memory mapping of a file, covering the file as it was when mapped */
+class CMappedFile
+{
+private:
+    const unsigned char* m_data;
+    size_t m_size;
+
+    CMappedFile(const unsigned char* data, size_t size) : m_data(data), m_size(size) {}
+
+public:
+    ~CMappedFile();
+
+    CMappedFile(const CMappedFile&) = delete;
+    CMappedFile& operator=(const CMappedFile&) = delete;
+
+    //! Map the file at path. Returns nullptr if it is empty, cannot be
+    //! mapped or the platform has no mmap.
+    static std::shared_ptr<const CMappedFile> Open(const fs::path& path);
+
+    const unsigned char* data() const { return m_data; }
+    size_t size() const { return m_size; }
+};
+
+/**
+ * Mappings of the most recently read files of a set, e.g. the block and undo
+ * files. A file which was appended to is mapped again when it is read beyond
+ * the end of its current mapping. Readers keep a mapping alive while they
+ * use it, even if it was dropped from the cache in the meantime.
+ */
+class CMappedFileCache
+{
+private:
+    typedef std::list<std::pair<std::string, std::shared_ptr<const CMappedFile>>> ListType;
+
+    CCriticalSection cs;
+    size_t nMaxFiles GUARDED_BY(cs){0};
+    //! Most recently used first
+    ListType listFiles GUARDED_BY(cs);
+    std::unordered_map<std::string, ListType::iterator> mapFiles GUARDED_BY(cs);
+
+    void EraseLocked(const std::string& key) EXCLUSIVE_LOCKS_REQUIRED(cs);
+
+public:
+    //! Keep up to nMaxFiles files mapped, 0 disables mapping
+    void SetMaxFiles(size_t nMaxFiles);
+    bool IsEnabled();
+
+    //! Get a mapping of path covering at least nMinSize bytes, or nullptr if
+    //! mapping is disabled, fails or the file is shorter
+    std::shared_ptr<const CMappedFile> Get(const fs::path& path, size_t nMinSize);
+    //! Drop the mapping of path, e.g. before the file is truncated or removed
+    void Erase(const fs::path& path);
+};
+
+#endif // BITCOIN_MAPPEDFILE_H
@@ -11,6 +11,7 @@
 #include <chainparams.h>
 #include <consensus/validation.h>
 #include <hash.h>
+#include <index/blockfilterindex.h>
 #include <init.h>
 #include <merkleblock.h>
 #include <netmessagemaker.h>
@@ -21,6 +22,7 @@
 #include <primitives/transaction.h>
 #include <random.h>
 #include <reverse_iterator.h>
+#include <saltedhasher.h>
 #include <scheduler.h>
 #include <tinyformat.h>
 #include <txdb.h>
@@ -30,7 +32,9 @@
 #include <utilmoneystr.h>
 #include <utilstrencodings.h>
 
+#include <list>
 #include <memory>
+#include <unordered_map>
 
 #include <spork.h>
 #include <governance/governance.h>
@@ -1122,7 +1126,7 @@ PeerLogicValidation::PeerLogicValidation(CConnman* connmanIn, CScheduler &schedu
     // combine them in one function and schedule at the quicker (peer-eviction)
     // timer.
     static_assert(EXTRA_PEER_CHECK_INTERVAL < STALE_CHECK_INTERVAL, "peer eviction timer should be less than stale tip check timer");
-    scheduler.scheduleEvery(std::bind(&PeerLogicValidation::CheckForStaleTipAndEvictPeers, this, consensusParams), EXTRA_PEER_CHECK_INTERVAL * 1000);
+    scheduler.scheduleEvery(std::bind(&PeerLogicValidation::CheckForStaleTipAndEvictPeers, this, consensusParams), EXTRA_PEER_CHECK_INTERVAL * 1000, "stalepeers");
 }
 
 /**
@@ -1182,6 +1186,13 @@ static std::shared_ptr<const CBlock> most_recent_block GUARDED_BY(cs_most_recent
 static std::shared_ptr<const CBlockHeaderAndShortTxIDs> most_recent_compact_block GUARDED_BY(cs_most_recent_block);
 static uint256 most_recent_block_hash GUARDED_BY(cs_most_recent_block);
 
+// Serialized blocks recently served to peers, least recently served first, protected by cs_raw_blocks
+static CCriticalSection cs_raw_blocks;
+typedef std::list<std::pair<uint256, std::shared_ptr<const std::vector<uint8_t>>>> RawBlockList;
+static RawBlockList listRawBlocks GUARDED_BY(cs_raw_blocks);
+static std::unordered_map<uint256, RawBlockList::iterator, StaticSaltedHasher> mapRawBlocks GUARDED_BY(cs_raw_blocks);
+static size_t nRawBlocksSize GUARDED_BY(cs_raw_blocks) = 0;
+
 /**
  * Maintain state about the best-seen block and fast-announce a compact block
  * to compatible peers.
@@ -1432,6 +1443,49 @@ static void RelayAddress(const CAddress& addr, bool fReachable, CConnman* connma
     connman->ForEachNodeThen(std::move(sortfunc), std::move(pushfunc));
 }
 
+/**
+ * Get the block as it is serialized on disk, from the cache of recently served
+ * blocks if it's in there. The cache holds up to nMaxSize bytes, the least
+ * recently served blocks are evicted first.
+ */
+std::shared_ptr<const std::vector<uint8_t>> GetRawBlock(const CBlockIndex* pindex, const CChainParams& chainparams, size_t nMaxSize)
+{
+    const uint256& hash = pindex->GetBlockHash();
+    {
+        LOCK(cs_raw_blocks);
+        auto it = mapRawBlocks.find(hash);
+        if (it != mapRawBlocks.end()) {
+            listRawBlocks.splice(listRawBlocks.end(), listRawBlocks, it->second);
+            return it->second->second;
+        }
+    }
+
+    std::shared_ptr<std::vector<uint8_t>> pblockRaw = std::make_shared<std::vector<uint8_t>>();
+    if (!ReadRawBlockFromDisk(*pblockRaw, pindex, chainparams.MessageStart())) {
+        return nullptr;
+    }
+
+    if (pblockRaw->size() > nMaxSize) {
+        return pblockRaw;
+    }
+
+    LOCK(cs_raw_blocks);
+    auto it = mapRawBlocks.find(hash);
+    if (it != mapRawBlocks.end()) {
+        // another thread was faster
+        return it->second->second;
+    }
+    while (!listRawBlocks.empty() && nRawBlocksSize + pblockRaw->size() > nMaxSize) {
+        nRawBlocksSize -= listRawBlocks.front().second->size();
+        mapRawBlocks.erase(listRawBlocks.front().first);
+        listRawBlocks.pop_front();
+    }
+    listRawBlocks.emplace_back(hash, pblockRaw);
+    mapRawBlocks.emplace(hash, std::prev(listRawBlocks.end()));
+    nRawBlocksSize += pblockRaw->size();
+    return pblockRaw;
+}
+
 void static ProcessGetBlockData(CNode* pfrom, const CChainParams& chainparams, const CInv& inv, CConnman* connman)
 {
     bool send = false;
@@ -1503,6 +1557,16 @@ void static ProcessGetBlockData(CNode* pfrom, const CChainParams& chainparams, c
         std::shared_ptr<const CBlock> pblock;
         if (a_recent_block && a_recent_block->GetHash() == pindex->GetBlockHash()) {
             pblock = a_recent_block;
+        } else if (inv.type == MSG_BLOCK) {
+            // Full blocks are sent as they are stored, without deserializing and serializing them again
+            size_t nMaxCacheSize = (size_t)std::max((int64_t)0, gArgs.GetArg("-blockservecachesize", DEFAULT_BLOCK_SERVE_CACHE_SIZE)) * 1000000;
+            std::shared_ptr<const std::vector<uint8_t>> pblockRaw = GetRawBlock(pindex, chainparams, nMaxCacheSize);
+            if (!pblockRaw)
+                assert(!"cannot load block from disk");
+            CSerializedNetMsg msg;
+            msg.command = NetMsgType::BLOCK;
+            msg.data = *pblockRaw;
+            connman->PushMessage(pfrom, std::move(msg));
         } else {
             // Send block from disk
             std::shared_ptr<CBlock> pblockRead = std::make_shared<CBlock>();
@@ -2026,6 +2090,7 @@ void static ProcessOrphanTx(CConnman* connman, std::set<uint256>& orphan_work_se
         CValidationState stateDummy;
 
         if (setMisbehaving.count(fromPeer)) continue;
+        SigCacheCallerScope sigCacheCaller(SIGCACHE_MEMPOOL);
         if (AcceptToMemoryPool(mempool, stateDummy, porphanTx, &fMissingInputs2 /* pfMissingInputs */,
                 false /* bypass_limits */, 0 /* nAbsurdFee */)) {
             LogPrint(BCLog::MEMPOOL, "   accepted orphan tx %s\n", orphanHash.ToString());
@@ -2081,6 +2146,169 @@ std::string RejectCodeToString(const unsigned char code)
     return "";
 }
 
+/**
+ * Validate that a filter request can be answered: the filter type is served,
+ * the stop block is one the peer may ask for and the range isn't too large.
+ * Peers sending requests we don't serve are disconnected.
+ *
+ * @param[in]   pfrom           The peer that we received the request from
+ * @param[in]   chainparams     Chain parameters
+ * @param[in]   filter_type     The filter type the request is for. Must be basic filters.
+ * @param[in]   start_height    The start height for the request
+ * @param[in]   stop_hash       The stop_hash for the request
+ * @param[in]   max_height_diff The maximum number of items permitted to request, as specified in BIP 157
+ * @param[out]  stop_index      The CBlockIndex for the stop_hash block, if the request can be serviced.
+ * @return                      True if the request can be serviced.
+ */
+static bool PrepareBlockFilterRequest(CNode* pfrom, const CChainParams& chainparams,
+                                      uint8_t filter_type, uint32_t start_height,
+                                      const uint256& stop_hash, uint32_t max_height_diff,
+                                      const CBlockIndex*& stop_index)
+{
+    if (filter_type != BlockFilterType::BASIC_FILTER || !(pfrom->GetLocalServices() & NODE_COMPACT_FILTERS) || !g_blockfilterindex) {
+        LogPrint(BCLog::NET, "peer %d requested unsupported block filter type: %d\n", pfrom->GetId(), filter_type);
+        pfrom->fDisconnect = true;
+        return false;
+    }
+
+    {
+        LOCK(cs_main);
+        stop_index = LookupBlockIndex(stop_hash);
+
+        // Check that the stop block exists and the peer would be allowed to fetch it.
+        if (!stop_index || !BlockRequestAllowed(stop_index, chainparams.GetConsensus())) {
+            LogPrint(BCLog::NET, "peer %d requested invalid block hash: %s\n", pfrom->GetId(), stop_hash.ToString());
+            pfrom->fDisconnect = true;
+            return false;
+        }
+    }
+
+    uint32_t stop_height = stop_index->nHeight;
+    if (start_height > stop_height) {
+        LogPrint(BCLog::NET, "peer %d sent invalid getcfilters/getcfheaders with start height %d and stop height %d\n",
+                 pfrom->GetId(), start_height, stop_height);
+        pfrom->fDisconnect = true;
+        return false;
+    }
+    if (stop_height - start_height >= max_height_diff) {
+        LogPrint(BCLog::NET, "peer %d requested too many cfilters/cfheaders: %d / %d\n",
+                 pfrom->GetId(), stop_height - start_height + 1, max_height_diff);
+        pfrom->fDisconnect = true;
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * Handle a getcfilters request. Every filter is sent as it is stored in the
+ * index, without decoding it.
+ */
+static void ProcessGetCFilters(CNode* pfrom, CDataStream& vRecv, const CChainParams& chainparams, CConnman* connman)
+{
+    uint8_t filter_type;
+    uint32_t start_height;
+    uint256 stop_hash;
+
+    vRecv >> filter_type >> start_height >> stop_hash;
+
+    const CBlockIndex* stop_index;
+    if (!PrepareBlockFilterRequest(pfrom, chainparams, filter_type, start_height, stop_hash,
+                                   MAX_GETCFILTERS_SIZE, stop_index)) {
+        return;
+    }
+
+    std::vector<const CBlockIndex*> vBlocks;
+    vBlocks.reserve(stop_index->nHeight - start_height + 1);
+    for (const CBlockIndex* pindex = stop_index; pindex && pindex->nHeight >= (int)start_height; pindex = pindex->pprev) {
+        vBlocks.push_back(pindex);
+    }
+
+    const CNetMsgMaker msgMaker(pfrom->GetSendVersion());
+    std::vector<unsigned char> encoded_filter;
+    for (const CBlockIndex* pindex : reverse_iterate(vBlocks)) {
+        if (!g_blockfilterindex->LookupFilter(pindex, encoded_filter)) {
+            LogPrint(BCLog::NET, "Failed to find block filter in index: filter_type=%d, start_height=%d, stop_hash=%s\n",
+                     filter_type, start_height, stop_hash.ToString());
+            return;
+        }
+        connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::CFILTER, filter_type, pindex->GetBlockHash(), encoded_filter));
+    }
+}
+
+/**
+ * Handle a getcfheaders request.
+ */
+static void ProcessGetCFHeaders(CNode* pfrom, CDataStream& vRecv, const CChainParams& chainparams, CConnman* connman)
+{
+    uint8_t filter_type;
+    uint32_t start_height;
+    uint256 stop_hash;
+
+    vRecv >> filter_type >> start_height >> stop_hash;
+
+    const CBlockIndex* stop_index;
+    if (!PrepareBlockFilterRequest(pfrom, chainparams, filter_type, start_height, stop_hash,
+                                   MAX_GETCFHEADERS_SIZE, stop_index)) {
+        return;
+    }
+
+    uint256 prev_header;
+    if (start_height > 0) {
+        const CBlockIndex* const prev_block = stop_index->GetAncestor(static_cast<int>(start_height - 1));
+        if (!g_blockfilterindex->LookupFilterHeader(prev_block, prev_header)) {
+            LogPrint(BCLog::NET, "Failed to find block filter header in index: filter_type=%d, block_hash=%s\n",
+                     filter_type, prev_block->GetBlockHash().ToString());
+            return;
+        }
+    }
+
+    std::vector<uint256> filter_hashes;
+    if (!g_blockfilterindex->LookupFilterHashRange(start_height, stop_index, filter_hashes)) {
+        LogPrint(BCLog::NET, "Failed to find block filter hashes in index: filter_type=%d, start_height=%d, stop_hash=%s\n",
+                 filter_type, start_height, stop_hash.ToString());
+        return;
+    }
+
+    const CNetMsgMaker msgMaker(pfrom->GetSendVersion());
+    connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::CFHEADERS, filter_type, stop_index->GetBlockHash(), prev_header, filter_hashes));
+}
+
+/**
+ * Handle a getcfcheckpt request. The checkpoint headers are cached by the index.
+ */
+static void ProcessGetCFCheckPt(CNode* pfrom, CDataStream& vRecv, const CChainParams& chainparams, CConnman* connman)
+{
+    uint8_t filter_type;
+    uint256 stop_hash;
+
+    vRecv >> filter_type >> stop_hash;
+
+    const CBlockIndex* stop_index;
+    if (!PrepareBlockFilterRequest(pfrom, chainparams, filter_type, /*start_height=*/0, stop_hash,
+                                   /*max_height_diff=*/std::numeric_limits<uint32_t>::max(), stop_index)) {
+        return;
+    }
+
+    std::vector<uint256> headers(stop_index->nHeight / CFCHECKPT_INTERVAL);
+
+    // Populate headers.
+    const CBlockIndex* block_index = stop_index;
+    for (int i = headers.size() - 1; i >= 0; i--) {
+        int height = (i + 1) * CFCHECKPT_INTERVAL;
+        block_index = block_index->GetAncestor(height);
+
+        if (!g_blockfilterindex->LookupFilterHeader(block_index, headers[i])) {
+            LogPrint(BCLog::NET, "Failed to find block filter header in index: filter_type=%d, block_hash=%s\n",
+                     filter_type, block_index->GetBlockHash().ToString());
+            return;
+        }
+    }
+
+    const CNetMsgMaker msgMaker(pfrom->GetSendVersion());
+    connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::CFCHECKPT, filter_type, stop_index->GetBlockHash(), headers));
+}
+
 bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStream& vRecv, int64_t nTimeReceived, const CChainParams& chainparams, CConnman* connman, const std::atomic<bool>& interruptMsgProc, bool enable_bip61)
 {
     LogPrint(BCLog::NET, "received: %s (%u bytes) peer=%d\n", SanitizeString(strCommand), vRecv.size(), pfrom->GetId());
@@ -2873,6 +3101,7 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
 
         bool fMissingInputs = false;
         CValidationState state;
+        SigCacheCallerScope sigCacheCaller(nInvType == MSG_DSTX ? SIGCACHE_COINJOIN : SIGCACHE_MEMPOOL);
 
         if (!AlreadyHave(inv) && AcceptToMemoryPool(mempool, state, ptx, &fMissingInputs /* pfMissingInputs */,
                 false /* bypass_limits */, 0 /* nAbsurdFee */)) {
@@ -3549,6 +3778,22 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
     }
 
 
+    if (strCommand == NetMsgType::GETCFILTERS) {
+        ProcessGetCFilters(pfrom, vRecv, chainparams, connman);
+        return true;
+    }
+
+    if (strCommand == NetMsgType::GETCFHEADERS) {
+        ProcessGetCFHeaders(pfrom, vRecv, chainparams, connman);
+        return true;
+    }
+
+    if (strCommand == NetMsgType::GETCFCHECKPT) {
+        ProcessGetCFCheckPt(pfrom, vRecv, chainparams, connman);
+        return true;
+    }
+
+
     if (strCommand == NetMsgType::GETMNLISTDIFF) {
         CGetSimplifiedMNListDiff cmd;
         vRecv >> cmd;
@@ -16,6 +16,8 @@
 #include <validation.h>
 #include <wallet/wallet.h>
 
+#include <algorithm>
+#include <atomic>
 #include <numeric>
 
 using namespace std;
@@ -56,46 +58,138 @@ static int64_t GetStakeModifierSelectionInterval()
     return nSelectionInterval;
 }
 
+// ComputeNextStakeModifier runs for every new block index entry, so the log
+// switches are only looked up once
+struct StakeModifierLogFlags {
+    bool fDebug;
+    bool fPrintStakeModifier;
+};
+
+static const StakeModifierLogFlags& GetStakeModifierLogFlags()
+{
+    static const StakeModifierLogFlags flags{gArgs.GetBoolArg("-debug", false), gArgs.GetBoolArg("-printstakemodifier", false)};
+    return flags;
+}
+
+StakeModifierCandidate::StakeModifierCandidate(const CBlockIndex* pindexIn) : nTime(pindexIn->GetBlockTime()), pindex(pindexIn), fSelected(false) {}
+
+bool StakeModifierCandidate::operator<(const StakeModifierCandidate& other) const
+{
+    if (nTime != other.nTime)
+        return nTime < other.nTime;
+    return pindex->GetBlockHash() < other.pindex->GetBlockHash();
+}
+
+void CStakeModifierWindow::PushBoundary(const CBlockIndex* pindex)
+{
+    while (!vBoundaries.empty() && vBoundaries.back()->GetBlockTime() >= pindex->GetBlockTime())
+        vBoundaries.pop_back();
+    vBoundaries.push_back(pindex);
+}
+
+void CStakeModifierWindow::Rebuild(const CBlockIndex* pindexPrev, int64_t nSelectionIntervalStart)
+{
+    vCandidates.clear();
+    vBoundaries.clear();
+    const CBlockIndex* pindex = pindexPrev;
+    while (pindex && pindex->GetBlockTime() >= nSelectionIntervalStart) {
+        vCandidates.emplace_back(pindex);
+        pindex = pindex->pprev;
+    }
+    nHeightFirst = pindex ? (pindex->nHeight + 1) : 0;
+    if (pindex)
+        vBoundaries.push_back(pindex);
+    for (auto it = vCandidates.rbegin(); it != vCandidates.rend(); ++it)
+        PushBoundary(it->pindex);
+    std::sort(vCandidates.begin(), vCandidates.end());
+}
+
+void CStakeModifierWindow::Update(const CBlockIndex* pindexPrev, int64_t nSelectionIntervalStart)
+{
+    // The boundary can only move up while the start time does not go back
+    bool fExtends = pindexTip && nSelectionIntervalStart >= nIntervalStart &&
+                    pindexPrev->nHeight >= pindexTip->nHeight && pindexPrev->GetAncestor(pindexTip->nHeight) == pindexTip;
+    const int nHeightOldTip = pindexTip ? pindexTip->nHeight : -1;
+    pindexTip = pindexPrev;
+    nIntervalStart = nSelectionIntervalStart;
+    if (!fExtends) {
+        Rebuild(pindexPrev, nSelectionIntervalStart);
+        return;
+    }
+
+    std::vector<StakeModifierCandidate> vNew;
+    for (const CBlockIndex* pindex = pindexPrev; pindex->nHeight > nHeightOldTip; pindex = pindex->pprev)
+        vNew.emplace_back(pindex);
+    for (auto it = vNew.rbegin(); it != vNew.rend(); ++it)
+        PushBoundary(it->pindex);
+
+    // The new boundary is the highest block older than the start time
+    while (vBoundaries.size() >= 2 && vBoundaries[1]->GetBlockTime() < nSelectionIntervalStart)
+        vBoundaries.pop_front();
+    if (!vBoundaries.empty() && vBoundaries.front()->GetBlockTime() < nSelectionIntervalStart)
+        nHeightFirst = vBoundaries.front()->nHeight + 1;
+
+    const int nHeightFirstNew = nHeightFirst;
+    vCandidates.erase(std::remove_if(vCandidates.begin(), vCandidates.end(),
+                          [nHeightFirstNew](const StakeModifierCandidate& c) { return c.pindex->nHeight < nHeightFirstNew; }),
+        vCandidates.end());
+    vNew.erase(std::remove_if(vNew.begin(), vNew.end(),
+                   [nHeightFirstNew](const StakeModifierCandidate& c) { return c.pindex->nHeight < nHeightFirstNew; }),
+        vNew.end());
+    std::sort(vNew.begin(), vNew.end());
+    size_t nOld = vCandidates.size();
+    vCandidates.insert(vCandidates.end(), vNew.begin(), vNew.end());
+    std::inplace_merge(vCandidates.begin(), vCandidates.begin() + nOld, vCandidates.end());
+}
+
+void CStakeModifierWindow::Clear()
+{
+    pindexTip = nullptr;
+    nIntervalStart = 0;
+    nHeightFirst = 0;
+    vCandidates.clear();
+    vBoundaries.clear();
+}
+
+static CCriticalSection cs_stakeModifierWindow;
+static CStakeModifierWindow stakeModifierWindow GUARDED_BY(cs_stakeModifierWindow);
+
+void ResetStakeModifierWindow()
+{
+    LOCK(cs_stakeModifierWindow);
+    stakeModifierWindow.Clear();
+}
+
 static bool SelectBlockFromCandidates(
-    vector<pair<int64_t, uint256>>& vSortedByTimestamp,
-    map<uint256, const CBlockIndex*>& mapSelectedBlocks,
-    int64_t nSelectionIntervalStop, uint64_t nStakeModifierPrev,
-    const CBlockIndex** pindexSelected)
+    const std::vector<StakeModifierCandidate>& vSortedByTimestamp,
+    int64_t nSelectionIntervalStop,
+    size_t& nSelected)
 {
     bool fSelected = false;
     arith_uint256 hashBest = 0;
-    *pindexSelected = nullptr;
-    for (const auto& item : vSortedByTimestamp) {
-        if (!mapBlockIndex.count(item.second))
-            return error("SelectBlockFromCandidates: failed to find block index for candidate block %s", item.second.ToString().c_str());
-        const CBlockIndex* pindex = mapBlockIndex[item.second];
-        if (fSelected && pindex->GetBlockTime() > nSelectionIntervalStop)
+    for (size_t i = 0; i < vSortedByTimestamp.size(); i++) {
+        const StakeModifierCandidate& candidate = vSortedByTimestamp[i];
+        if (fSelected && candidate.nTime > nSelectionIntervalStop)
             break;
-        if (mapSelectedBlocks.count(pindex->GetBlockHash()) > 0)
+        if (candidate.fSelected)
             continue;
-        uint256 hashProof = pindex->IsProofOfStake() ? pindex->hashProofOfStake : pindex->GetBlockHash();
-        CDataStream ss(SER_GETHASH, 0);
-        ss << hashProof << nStakeModifierPrev;
-        arith_uint256 hashSelection = UintToArith256(Hash(ss.begin(), ss.end()));
-        if (pindex->IsProofOfStake())
-            hashSelection >>= 32;
-        if (fSelected && hashSelection < hashBest) {
-            hashBest = hashSelection;
-            *pindexSelected = (const CBlockIndex*)pindex;
+        if (fSelected && candidate.hashSelection < hashBest) {
+            hashBest = candidate.hashSelection;
+            nSelected = i;
         } else if (!fSelected) {
             fSelected = true;
-            hashBest = hashSelection;
-            *pindexSelected = (const CBlockIndex*)pindex;
+            hashBest = candidate.hashSelection;
+            nSelected = i;
         }
     }
-    if (gArgs.GetBoolArg("-printstakemodifier", false))
+    if (GetStakeModifierLogFlags().fPrintStakeModifier)
         LogPrintf("%s : selection hash=%s\n", __func__, hashBest.ToString().c_str());
     return fSelected;
 }
 
 bool ComputeNextStakeModifier(const CBlockIndex* pindexPrev, uint64_t& nStakeModifier, bool& fGeneratedStakeModifier)
 {
-    const Consensus::Params& params = Params().GetConsensus();
+    const StakeModifierLogFlags& logFlags = GetStakeModifierLogFlags();
     nStakeModifier = 0;
     fGeneratedStakeModifier = false;
     if (!pindexPrev) {
@@ -105,59 +199,69 @@ bool ComputeNextStakeModifier(const CBlockIndex* pindexPrev, uint64_t& nStakeMod
     int64_t nModifierTime = 0;
     if (!GetLastStakeModifier(pindexPrev, nStakeModifier, nModifierTime))
         return error("ComputeNextStakeModifier: unable to get last modifier");
-    if (gArgs.GetBoolArg("-debug", false))
+    if (logFlags.fDebug)
         LogPrintf("ComputeNextStakeModifier: prev modifier=0x%016x time=%s epoch=%u\n", nStakeModifier, DateTimeStrFormat("%Y-%m-%d %H:%M:%S", nModifierTime).c_str(), (unsigned int)nModifierTime);
     if (nModifierTime / oldModifierInterval >= pindexPrev->GetBlockTime() / oldModifierInterval)
         return true;
 
     // Sort candidate blocks by timestamp
-    vector<pair<int64_t, uint256>> vSortedByTimestamp;
-    vSortedByTimestamp.reserve(64 * oldModifierInterval / params.nPosTargetSpacing);
     int64_t nSelectionInterval = GetStakeModifierSelectionInterval();
     int64_t nSelectionIntervalStart = (pindexPrev->GetBlockTime() / oldModifierInterval) * oldModifierInterval - nSelectionInterval;
-    const CBlockIndex* pindex = pindexPrev;
-    while (pindex && pindex->GetBlockTime() >= nSelectionIntervalStart) {
-        vSortedByTimestamp.push_back(make_pair(pindex->GetBlockTime(), pindex->GetBlockHash()));
-        pindex = pindex->pprev;
+
+    LOCK(cs_stakeModifierWindow);
+    stakeModifierWindow.Update(pindexPrev, nSelectionIntervalStart);
+    int nHeightFirstCandidate = stakeModifierWindow.GetHeightFirst();
+    std::vector<StakeModifierCandidate>& vSortedByTimestamp = stakeModifierWindow.GetCandidates();
+
+    // The selection hash of a candidate only depends on the previous modifier, so it is the same for every round
+    for (StakeModifierCandidate& candidate : vSortedByTimestamp) {
+        const CBlockIndex* pindex = candidate.pindex;
+        uint256 hashProof = pindex->IsProofOfStake() ? pindex->hashProofOfStake : pindex->GetBlockHash();
+        CDataStream ss(SER_GETHASH, 0);
+        ss << hashProof << nStakeModifier;
+        candidate.hashSelection = UintToArith256(Hash(ss.begin(), ss.end()));
+        if (pindex->IsProofOfStake())
+            candidate.hashSelection >>= 32;
+        candidate.fSelected = false;
     }
-    int nHeightFirstCandidate = pindex ? (pindex->nHeight + 1) : 0;
-    reverse(vSortedByTimestamp.begin(), vSortedByTimestamp.end());
-    sort(vSortedByTimestamp.begin(), vSortedByTimestamp.end());
 
     // Select 64 blocks from candidate blocks to generate stake modifier
     uint64_t nStakeModifierNew = 0;
     int64_t nSelectionIntervalStop = nSelectionIntervalStart;
-    map<uint256, const CBlockIndex*> mapSelectedBlocks;
+    std::vector<const CBlockIndex*> vSelectedBlocks;
     for (int nRound = 0; nRound < min(64, (int)vSortedByTimestamp.size()); nRound++) {
         // add an interval section to the current selection round
         nSelectionIntervalStop += GetStakeModifierSelectionIntervalSection(nRound);
         // select a block from the candidates of current round
-        if (!SelectBlockFromCandidates(vSortedByTimestamp, mapSelectedBlocks, nSelectionIntervalStop, nStakeModifier, &pindex))
+        size_t nSelected = 0;
+        if (!SelectBlockFromCandidates(vSortedByTimestamp, nSelectionIntervalStop, nSelected))
             return error("ComputeNextStakeModifier: unable to select block at round %d", nRound);
+        const CBlockIndex* pindex = vSortedByTimestamp[nSelected].pindex;
         // write the entropy bit of the selected block
         nStakeModifierNew |= (((uint64_t)pindex->GetStakeEntropyBit()) << nRound);
         // add the selected block from candidates to selected list
-        mapSelectedBlocks.insert(make_pair(pindex->GetBlockHash(), pindex));
-        if (gArgs.GetBoolArg("-printstakemodifier", false))
+        vSortedByTimestamp[nSelected].fSelected = true;
+        vSelectedBlocks.push_back(pindex);
+        if (logFlags.fPrintStakeModifier)
             LogPrintf("%s : selected round %d stop=%s height=%d bit=%d\n", __func__, nRound, DateTimeStrFormat("%Y-%m-%d %H:%M:%S", nSelectionIntervalStop).c_str(), pindex->nHeight, pindex->GetStakeEntropyBit());
     }
 
     // Print selection map for visualization of the selected blocks
-    if (gArgs.GetBoolArg("-debug", false) && gArgs.GetBoolArg("-printstakemodifier", false)) {
+    if (logFlags.fDebug && logFlags.fPrintStakeModifier) {
         string strSelectionMap = "";
         // '-' indicates proof-of-work blocks not selected
         strSelectionMap.insert(0, pindexPrev->nHeight - nHeightFirstCandidate + 1, '-');
-        pindex = pindexPrev;
+        const CBlockIndex* pindex = pindexPrev;
         while (pindex && pindex->nHeight >= nHeightFirstCandidate) {
             // '=' indicates proof-of-stake blocks not selected
             if (pindex->IsProofOfStake())
                 strSelectionMap.replace(pindex->nHeight - nHeightFirstCandidate, 1, "=");
             pindex = pindex->pprev;
         }
-        for (const auto& item : mapSelectedBlocks) {
+        for (const CBlockIndex* pindexSelected : vSelectedBlocks) {
             // 'S' indicates selected proof-of-stake blocks
             // 'W' indicates selected proof-of-work blocks
-            strSelectionMap.replace(item.second->nHeight - nHeightFirstCandidate, 1, item.second->IsProofOfStake() ? "S" : "W");
+            strSelectionMap.replace(pindexSelected->nHeight - nHeightFirstCandidate, 1, pindexSelected->IsProofOfStake() ? "S" : "W");
         }
         LogPrintf("ComputeNextStakeModifier: selection height [%d, %d] map %s\n", nHeightFirstCandidate, pindexPrev->nHeight, strSelectionMap);
     }
@@ -226,9 +330,8 @@ bool StakeKernelMode(const CBlockIndex* pindexPrev)
     return true;
 }
 
-bool CheckStakeKernelHash(unsigned int nBits, const CBlockIndex* pindexPrev, const CBlockHeader& blockFrom, unsigned int nTxPrevOffset, const CTransactionRef& txPrev, const COutPoint& prevout, unsigned int nTimeTx, uint256& hashProofOfStake)
+static bool CheckStakeKernelSanity(const CBlockHeader& blockFrom, const CTransactionRef& txPrev, const COutPoint& prevout, unsigned int nTimeTx)
 {
-    bool fKernelMode = StakeKernelMode(pindexPrev);
     const Consensus::Params& params = Params().GetConsensus();
 
     // basic sanity checks
@@ -244,6 +347,18 @@ bool CheckStakeKernelHash(unsigned int nBits, const CBlockIndex* pindexPrev, con
     if (nValueIn < params.nMinimumStakeValue)
         return error("CheckStakeKernelHash() : min amount violation");
 
+    return true;
+}
+
+// Hash the kernel with an already selected stake modifier and check it against the target
+static bool CheckStakeKernelTarget(unsigned int nBits, bool fKernelMode, uint64_t nStakeModifier, const CBlockHeader& blockFrom, unsigned int nTxPrevOffset, const CTransactionRef& txPrev, const COutPoint& prevout, unsigned int nTimeTx, uint256& hashProofOfStake)
+{
+    const Consensus::Params& params = Params().GetConsensus();
+
+    auto txPrevTime = blockFrom.GetBlockTime();
+    unsigned int nTimeBlockFrom = blockFrom.GetBlockTime();
+    CAmount nValueIn = txPrev->vout[prevout.n].nValue;
+
     // old algorithm parameters
     arith_uint256 bnTargetPerCoinDay;
     bnTargetPerCoinDay.SetCompact(nBits);
@@ -260,18 +375,10 @@ bool CheckStakeKernelHash(unsigned int nBits, const CBlockIndex* pindexPrev, con
 
     // calculate hash
     CDataStream ss(SER_GETHASH, 0);
-    uint64_t nStakeModifier = 0;
-    int nStakeModifierHeight = 0;
-    int64_t nStakeModifierTime = 0;
-
-    if (!GetKernelStakeModifier(pindexPrev, blockFrom.GetHash(), nTimeTx, nStakeModifier, nStakeModifierHeight, nStakeModifierTime, false))
-        return false;
-
     ss << nStakeModifier;
     ss << nTimeBlockFrom << nTxPrevOffset << txPrevTime << prevout.n << nTimeTx;
     hashProofOfStake = Hash(ss.begin(), ss.end());
 
-    // LogPrintf("height: %d\n", pindexPrev->nHeight+1);
     // LogPrintf("ss << %016llx\n", nStakeModifier);
     // LogPrintf("ss << %08x << %08x << %08x << %08x << %08x\n", txPrevTime, nTxPrevOffset, txPrevTime, prevout.n, nTimeTx);
     // LogPrintf("(ss == %s, hashproof == %s)\n", HexStr(ss), hashProofOfStake.ToString());
@@ -288,6 +395,23 @@ bool CheckStakeKernelHash(unsigned int nBits, const CBlockIndex* pindexPrev, con
     return true;
 }
 
+bool CheckStakeKernelHash(unsigned int nBits, const CBlockIndex* pindexPrev, const CBlockHeader& blockFrom, unsigned int nTxPrevOffset, const CTransactionRef& txPrev, const COutPoint& prevout, unsigned int nTimeTx, uint256& hashProofOfStake)
+{
+    bool fKernelMode = StakeKernelMode(pindexPrev);
+
+    if (!CheckStakeKernelSanity(blockFrom, txPrev, prevout, nTimeTx))
+        return false;
+
+    uint64_t nStakeModifier = 0;
+    int nStakeModifierHeight = 0;
+    int64_t nStakeModifierTime = 0;
+
+    if (!GetKernelStakeModifier(pindexPrev, blockFrom.GetHash(), nTimeTx, nStakeModifier, nStakeModifierHeight, nStakeModifierTime, false))
+        return false;
+
+    return CheckStakeKernelTarget(nBits, fKernelMode, nStakeModifier, blockFrom, nTxPrevOffset, txPrev, prevout, nTimeTx, hashProofOfStake);
+}
+
 bool CheckKernelScript(CScript scriptVin, CScript scriptVout)
 {
     auto extractKeyID = [](CScript scriptPubKey) {
@@ -349,3 +473,86 @@ bool CheckProofOfStake(const CBlock& block, uint256& hashProofOfStake, const CBl
 
     return true;
 }
+
+bool CStakeKernelCheck::IsCurrent(const uint256& hash, const CBlockIndex* pindexPrevIn) const
+{
+    AssertLockHeld(cs_main);
+    return fChecked && hashBlock == hash && pindexPrev == pindexPrevIn &&
+           pindexTip == chainActive.Tip() && fIbdComplete == isIbdComplete;
+}
+
+// Prevalidation runs on whichever thread submitted the block, so the counters are shared
+static std::atomic<int64_t> nTimeStakeLocked{0};
+static std::atomic<int64_t> nTimeStakeFetch{0};
+static std::atomic<int64_t> nTimeStakeKernel{0};
+static std::atomic<int64_t> nStakeChecks{0};
+
+void PrevalidateProofOfStake(const CBlock& block, CStakeKernelCheck& check)
+{
+    AssertLockNotHeld(cs_main);
+
+    check = CStakeKernelCheck();
+    check.hashBlock = block.GetHash();
+
+    if (block.vtx.size() < 2 || !block.vtx[1]->IsCoinStake())
+        return;
+    const CTransactionRef& tx = block.vtx[1];
+    const CTxIn& txin = tx->vin[0];
+
+    int64_t nTimeStart = GetTimeMicros();
+    {
+        LOCK(cs_main);
+        BlockMap::const_iterator mi = mapBlockIndex.find(check.hashBlock);
+        if (mi != mapBlockIndex.end() && (mi->second->nStatus & BLOCK_HAVE_DATA))
+            return;
+        mi = mapBlockIndex.find(block.hashPrevBlock);
+        if (mi == mapBlockIndex.end())
+            return;
+        check.pindexPrev = mi->second;
+    }
+    int64_t nTime1 = GetTimeMicros();
+
+    // get txprev from the txindex, this is the disk read that used to happen under cs_main
+    uint256 blockHash;
+    CTransactionRef txPrev;
+    if (!pblocktree->FindTx(txin.prevout.hash, blockHash, txPrev))
+        return;
+    int64_t nTime2 = GetTimeMicros();
+
+    CBlockHeader header;
+    uint64_t nStakeModifier = 0;
+    bool fModifier = false;
+    {
+        LOCK(cs_main);
+        check.pindexTip = chainActive.Tip();
+        check.fIbdComplete = isIbdComplete;
+        // The outcome is settled from here on, any failure below is final for this chain state
+        check.fChecked = true;
+
+        BlockMap::const_iterator mi = mapBlockIndex.find(blockHash);
+        if (mi == mapBlockIndex.end() || !mi->second)
+            return;
+        header = mi->second->GetBlockHeader();
+
+        int nStakeModifierHeight = 0;
+        int64_t nStakeModifierTime = 0;
+        fModifier = GetKernelStakeModifier(check.pindexPrev, blockHash, block.nTime, nStakeModifier, nStakeModifierHeight, nStakeModifierTime, false);
+    }
+    int64_t nTime3 = GetTimeMicros();
+
+    if (check.fIbdComplete && !CheckKernelScript(txPrev->vout[txin.prevout.n].scriptPubKey, tx->vout[1].scriptPubKey)) {
+        error("CheckProofOfStake: VerifyScript failed on coinstake %s", tx->GetHash().ToString());
+    } else if (CheckStakeKernelSanity(header, txPrev, txin.prevout, block.nTime) && fModifier &&
+               CheckStakeKernelTarget(block.nBits, StakeKernelMode(check.pindexPrev), nStakeModifier, header, sizeof(CBlock), txPrev, txin.prevout, block.nTime, check.hashProofOfStake)) {
+        check.fValid = true;
+    }
+    int64_t nTime4 = GetTimeMicros();
+
+    nStakeChecks++;
+    nTimeStakeLocked += (nTime1 - nTimeStart) + (nTime3 - nTime2);
+    nTimeStakeFetch += nTime2 - nTime1;
+    nTimeStakeKernel += nTime4 - nTime3;
+    LogPrint(BCLog::BENCHMARK, "  - Stake prevalidation: locked %.2fms, fetch %.2fms, kernel %.2fms [%.2fs, %.2fs, %.2fs (%d blk)]\n",
+        0.001 * ((nTime1 - nTimeStart) + (nTime3 - nTime2)), 0.001 * (nTime2 - nTime1), 0.001 * (nTime4 - nTime3),
+        nTimeStakeLocked.load() * 0.000001, nTimeStakeFetch.load() * 0.000001, nTimeStakeKernel.load() * 0.000001, nStakeChecks.load());
+}
@@ -12,6 +12,9 @@
 #include <boost/assign/list_of.hpp>
 #include <boost/lexical_cast.hpp>
 
+#include <deque>
+#include <vector>
+
 class CBlock;
 class CWallet;
 class COutPoint;
@@ -24,9 +27,57 @@ extern int64_t nLastCoinStakeSearchInterval;
 // ratio of group interval length between the last group and the first group
 static const int MODIFIER_INTERVAL_RATIO = 3;
 
+struct StakeModifierCandidate {
+    int64_t nTime;
+    const CBlockIndex* pindex;
+    arith_uint256 hashSelection;
+    bool fSelected;
+
+    explicit StakeModifierCandidate(const CBlockIndex* pindexIn);
+
+    // Same order as sorting (time, hash) pairs
+    bool operator<(const StakeModifierCandidate& other) const;
+};
+
+/**
+ * Time-sorted candidate blocks of the last modifier selection. Consecutive
+ * selection intervals of one chain overlap, so when the next selection builds
+ * on the same chain only the blocks connected since are walked and merged in,
+ * and the ones that fell out of the interval are dropped, instead of walking
+ * and re-sorting the whole interval.
+ *
+ * The interval starts above the highest block older than its start time.
+ * Block times are not monotonic, so the window also keeps the blocks which
+ * can still become that boundary: those older than every block above them,
+ * from the current boundary up to the tip, in ascending height and time.
+ */
+class CStakeModifierWindow
+{
+private:
+    const CBlockIndex* pindexTip = nullptr;
+    int64_t nIntervalStart = 0;
+    int nHeightFirst = 0;
+    std::vector<StakeModifierCandidate> vCandidates;
+    std::deque<const CBlockIndex*> vBoundaries;
+
+    void PushBoundary(const CBlockIndex* pindex);
+    void Rebuild(const CBlockIndex* pindexPrev, int64_t nSelectionIntervalStart);
+
+public:
+    // Make the window hold the ancestors of pindexPrev back to the first one older than nSelectionIntervalStart
+    void Update(const CBlockIndex* pindexPrev, int64_t nSelectionIntervalStart);
+    void Clear();
+
+    int GetHeightFirst() const { return nHeightFirst; }
+    std::vector<StakeModifierCandidate>& GetCandidates() { return vCandidates; }
+};
+
 // Compute the hash modifier for proof-of-stake
 bool ComputeNextStakeModifier(const CBlockIndex* pindexPrev, uint64_t& nStakeModifier, bool& fGeneratedStakeModifier);
 
+// Drop the cached modifier candidate window, must be called before block index entries are freed
+void ResetStakeModifierWindow();
+
 // Check whether stake kernel meets hash target
 // Sets hashProofOfStake on success return
 bool CheckStakeKernelHash(unsigned int nBits, const CBlockIndex* pindexPrev, const CBlockHeader& blockFrom, unsigned int nTxPrevOffset, const CTransactionRef& txPrev, const COutPoint& prevout, unsigned int nTimeTx, uint256& hashProofOfStake);
@@ -38,4 +89,25 @@ bool CheckStake(unsigned int nBits, const CBlock blockFrom, const CTransaction t
 // Sets hashProofOfStake on success return
 bool CheckProofOfStake(const CBlock &block, uint256& hashProofOfStake, const CBlockIndex* pindexPrev);
 
+/** Result of checking a proof-of-stake kernel ahead of AcceptBlock */
+struct CStakeKernelCheck
+{
+    uint256 hashBlock;
+    //! Chain state the kernel was checked against
+    const CBlockIndex* pindexPrev = nullptr;
+    const CBlockIndex* pindexTip = nullptr;
+    bool fIbdComplete = false;
+    //! Set once the check ran to completion; fValid and hashProofOfStake are meaningless otherwise
+    bool fChecked = false;
+    bool fValid = false;
+    uint256 hashProofOfStake;
+
+    //! Whether the result can stand in for CheckProofOfStake on this block at the current tip (requires cs_main)
+    bool IsCurrent(const uint256& hash, const CBlockIndex* pindexPrevIn) const;
+};
+
+// Check the kernel of a proof-of-stake block without holding cs_main across the
+// txindex read and kernel hashing; cs_main is only taken for block index lookups
+void PrevalidateProofOfStake(const CBlock& block, CStakeKernelCheck& check);
+
 #endif // BITCOIN_KERNEL_H
@@ -1988,6 +1988,31 @@ static UniValue getblockstats(const JSONRPCRequest& request)
     std::vector<CAmount> feerate_array;
     std::vector<int64_t> txsize_array;
 
+    // Look up all spent transactions at once, so they are read in block file order
+    std::map<uint256, CTransactionRef> mapPrevTxs;
+    if (loop_inputs && fTxIndex) {
+        std::vector<uint256> vPrevHashes;
+        for (const auto& tx : block.vtx) {
+            if (tx->IsCoinBase()) {
+                continue;
+            }
+            for (const CTxIn& in : tx->vin) {
+                vPrevHashes.push_back(in.prevout.hash);
+            }
+        }
+        std::sort(vPrevHashes.begin(), vPrevHashes.end());
+        vPrevHashes.erase(std::unique(vPrevHashes.begin(), vPrevHashes.end()), vPrevHashes.end());
+
+        std::vector<uint256> vBlockHashes;
+        std::vector<CTransactionRef> vPrevTxs;
+        pblocktree->FindTxs(vPrevHashes, vBlockHashes, vPrevTxs);
+        for (size_t i = 0; i < vPrevHashes.size(); i++) {
+            if (vPrevTxs[i]) {
+                mapPrevTxs.emplace(vPrevHashes[i], vPrevTxs[i]);
+            }
+        }
+    }
+
     for (const auto& tx : block.vtx) {
         outputs += tx->vout.size();
 
@@ -2025,13 +2050,12 @@ static UniValue getblockstats(const JSONRPCRequest& request)
             }
             CAmount tx_total_in = 0;
             for (const CTxIn& in : tx->vin) {
-                CTransactionRef tx_in;
-                uint256 hashBlock;
-                if (!GetTransaction(in.prevout.hash, tx_in, Params().GetConsensus(), hashBlock, false)) {
+                auto it = mapPrevTxs.find(in.prevout.hash);
+                if (it == mapPrevTxs.end()) {
                     throw JSONRPCError(RPC_INTERNAL_ERROR, std::string("Unexpected internal error (tx index seems corrupt)"));
                 }
 
-                CTxOut prevoutput = tx_in->vout[in.prevout.n];
+                CTxOut prevoutput = it->second->vout[in.prevout.n];
 
                 tx_total_in += prevoutput.nValue;
                 utxo_size_inc -= GetSerializeSize(prevoutput, SER_NETWORK, PROTOCOL_VERSION) + PER_UTXO_OVERHEAD;
@@ -531,6 +531,165 @@ bool timestampSort(std::pair<CMempoolAddressDeltaKey, CMempoolAddressDelta> a,
     return a.second.time < b.second.time;
 }
 
+/** Upper bound for "limit" of the paginated address index calls */
+static const size_t MAX_ADDRESS_INDEX_PAGE_SIZE = 100000;
+/** Number of index entries read at once when streaming a full result */
+static const size_t ADDRESS_INDEX_STREAM_BATCH = 1000;
+/** Tags preventing the cursor of one call from being used with another index */
+static const char ADDRESS_CURSOR_INDEX = 'a';
+static const char ADDRESS_CURSOR_UNSPENT = 'u';
+
+/** Returns true if the caller asked for a paginated result via "limit" or "cursor" */
+static bool getPaginationFromParams(const UniValue& params, size_t& nLimit, std::string& strCursor)
+{
+    if (!params[0].isObject()) {
+        return false;
+    }
+    const UniValue& limitValue = find_value(params[0].get_obj(), "limit");
+    const UniValue& cursorValue = find_value(params[0].get_obj(), "cursor");
+    if (limitValue.isNull() && cursorValue.isNull()) {
+        return false;
+    }
+
+    nLimit = MAX_ADDRESS_INDEX_PAGE_SIZE;
+    if (!limitValue.isNull()) {
+        int64_t nValue = limitValue.get_int64();
+        if (nValue < 1 || (uint64_t)nValue > MAX_ADDRESS_INDEX_PAGE_SIZE) {
+            throw JSONRPCError(RPC_INVALID_PARAMETER, strprintf("limit must be between 1 and %d", MAX_ADDRESS_INDEX_PAGE_SIZE));
+        }
+        nLimit = (size_t)nValue;
+    }
+    if (!cursorValue.isNull()) {
+        strCursor = cursorValue.get_str();
+    }
+    return true;
+}
+
+/** The cursor is the position in the address list plus the last index key returned */
+template<typename Key>
+static std::string encodeAddressIndexCursor(char tag, uint32_t nAddress, const Key& key)
+{
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss << tag << nAddress << key;
+    return HexStr(ss.begin(), ss.end());
+}
+
+template<typename Key>
+static void decodeAddressIndexCursor(const std::string& strCursor, char tag,
+                                     const std::vector<std::pair<uint160, int> >& addresses,
+                                     uint32_t& nAddress, Key& key)
+{
+    if (!IsHex(strCursor)) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid cursor");
+    }
+    std::vector<unsigned char> data(ParseHex(strCursor));
+    CDataStream ss(data, SER_DISK, CLIENT_VERSION);
+    char tagIn;
+    try {
+        ss >> tagIn >> nAddress >> key;
+    } catch (const std::exception&) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid cursor");
+    }
+    if (tagIn != tag || !ss.empty() || nAddress >= addresses.size() ||
+        key.hashBytes != addresses[nAddress].first || (int)key.type != addresses[nAddress].second) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid cursor");
+    }
+}
+
+static UniValue addressUnspentToJSON(const std::pair<CAddressUnspentKey, CAddressUnspentValue>& unspent)
+{
+    std::string address;
+    if (!getAddressFromIndex(unspent.first.type, unspent.first.hashBytes, address)) {
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Unknown address type");
+    }
+
+    UniValue output(UniValue::VOBJ);
+    output.pushKV("address", address);
+    output.pushKV("txid", unspent.first.txhash.GetHex());
+    output.pushKV("outputIndex", (int)unspent.first.index);
+    output.pushKV("script", HexStr(unspent.second.script.begin(), unspent.second.script.end()));
+    output.pushKV("satoshis", unspent.second.satoshis);
+    output.pushKV("height", unspent.second.blockHeight);
+    return output;
+}
+
+static UniValue addressDeltaToJSON(const std::pair<CAddressIndexKey, CAmount>& index)
+{
+    std::string address;
+    if (!getAddressFromIndex(index.first.type, index.first.hashBytes, address)) {
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Unknown address type");
+    }
+
+    UniValue delta(UniValue::VOBJ);
+    delta.pushKV("satoshis", index.second);
+    delta.pushKV("txid", index.first.txhash.GetHex());
+    delta.pushKV("index", (int)index.first.index);
+    delta.pushKV("blockindex", (int)index.first.txindex);
+    delta.pushKV("height", index.first.blockHeight);
+    delta.pushKV("address", address);
+    return delta;
+}
+
+/**
+ * Reads one page of address index entries over all requested addresses,
+ * starting at the cursor. fnEntry is called for every entry in index order.
+ * Returns the cursor for the next page, or null if there is none.
+ */
+static UniValue readAddressIndexPage(const std::vector<std::pair<uint160, int> >& addresses, int start, int end,
+                                     size_t nLimit, const std::string& strCursor,
+                                     const std::function<void(const std::pair<CAddressIndexKey, CAmount>&, const CAddressIndexKey*)>& fnEntry)
+{
+    uint32_t nAddress = 0;
+    CAddressIndexKey afterKey;
+    bool fAfter = !strCursor.empty();
+    if (fAfter) {
+        decodeAddressIndexCursor(strCursor, ADDRESS_CURSOR_INDEX, addresses, nAddress, afterKey);
+    }
+
+    size_t nRemaining = nLimit;
+    for (; nAddress < addresses.size(); nAddress++, fAfter = false) {
+        std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
+        if (!GetAddressIndexPage(addresses[nAddress].first, addresses[nAddress].second, addressIndex,
+                                 start, end, fAfter ? &afterKey : nullptr, nRemaining)) {
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
+        }
+        for (const auto& entry : addressIndex) {
+            fnEntry(entry, fAfter ? &afterKey : nullptr);
+        }
+        nRemaining -= addressIndex.size();
+        if (nRemaining == 0) {
+            return encodeAddressIndexCursor(ADDRESS_CURSOR_INDEX, nAddress, addressIndex.back().first);
+        }
+    }
+    return NullUniValue;
+}
+
+/**
+ * Reads all address index entries of one address in batches of
+ * ADDRESS_INDEX_STREAM_BATCH, so that at most one batch is held in memory.
+ */
+static void streamAddressIndex(const std::pair<uint160, int>& address, int start, int end,
+                               const std::function<void(const std::pair<CAddressIndexKey, CAmount>&)>& fnEntry)
+{
+    CAddressIndexKey afterKey;
+    bool fAfter = false;
+    while (true) {
+        std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
+        if (!GetAddressIndexPage(address.first, address.second, addressIndex,
+                                 start, end, fAfter ? &afterKey : nullptr, ADDRESS_INDEX_STREAM_BATCH)) {
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
+        }
+        for (const auto& entry : addressIndex) {
+            fnEntry(entry);
+        }
+        if (addressIndex.size() < ADDRESS_INDEX_STREAM_BATCH) {
+            break;
+        }
+        afterKey = addressIndex.back().first;
+        fAfter = true;
+    }
+}
+
 UniValue getaddressmempool(const JSONRPCRequest& request)
 {
     if (request.fHelp || request.params.size() != 1)
@@ -615,6 +774,8 @@ UniValue getaddressutxos(const JSONRPCRequest& request)
             "      \"address\"  (string) The base58check encoded address\n"
             "      ,...\n"
             "    ]\n"
+            "  \"limit\" (number, optional) Return a page of at most this many outputs\n"
+            "  \"cursor\" (string, optional) Continue after the page that returned this cursor\n"
             "}\n"
             "\nResult:\n"
             "[\n"
@@ -627,8 +788,14 @@ UniValue getaddressutxos(const JSONRPCRequest& request)
             "    \"height\"  (number) The block height\n"
             "  }\n"
             "]\n"
+            "\nResult (with limit or cursor):\n"
+            "{\n"
+            "  \"utxos\": [...]  (array) As above, ordered by address and txid instead of height\n"
+            "  \"cursor\"  (string) Pass to the next call to get the next page, null after the last page\n"
+            "}\n"
             "\nExamples:\n"
             + HelpExampleCli("getaddressutxos", "'{\"addresses\": [\"XwnLY9Tf7Zsef8gMGL2fhWA9ZmMjt4KPwg\"]}'")
+            + HelpExampleCli("getaddressutxos", "'{\"addresses\": [\"XwnLY9Tf7Zsef8gMGL2fhWA9ZmMjt4KPwg\"], \"limit\": 1000}'")
             + HelpExampleRpc("getaddressutxos", "{\"addresses\": [\"XwnLY9Tf7Zsef8gMGL2fhWA9ZmMjt4KPwg\"]}")
         );
 
@@ -638,6 +805,41 @@ UniValue getaddressutxos(const JSONRPCRequest& request)
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid address");
     }
 
+    size_t nLimit = 0;
+    std::string strCursor;
+    if (getPaginationFromParams(request.params, nLimit, strCursor)) {
+        uint32_t nAddress = 0;
+        CAddressUnspentKey afterKey;
+        bool fAfter = !strCursor.empty();
+        if (fAfter) {
+            decodeAddressIndexCursor(strCursor, ADDRESS_CURSOR_UNSPENT, addresses, nAddress, afterKey);
+        }
+
+        UniValue utxos(UniValue::VARR);
+        UniValue cursor(NullUniValue);
+        size_t nRemaining = nLimit;
+        for (; nAddress < addresses.size(); nAddress++, fAfter = false) {
+            std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > unspentOutputs;
+            if (!GetAddressUnspentPage(addresses[nAddress].first, addresses[nAddress].second, unspentOutputs,
+                                       fAfter ? &afterKey : nullptr, nRemaining)) {
+                throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
+            }
+            for (const auto& unspent : unspentOutputs) {
+                utxos.push_back(addressUnspentToJSON(unspent));
+            }
+            nRemaining -= unspentOutputs.size();
+            if (nRemaining == 0) {
+                cursor = encodeAddressIndexCursor(ADDRESS_CURSOR_UNSPENT, nAddress, unspentOutputs.back().first);
+                break;
+            }
+        }
+
+        UniValue result(UniValue::VOBJ);
+        result.pushKV("utxos", utxos);
+        result.pushKV("cursor", cursor);
+        return result;
+    }
+
     std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > unspentOutputs;
 
     for (std::vector<std::pair<uint160, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
@@ -651,19 +853,7 @@ UniValue getaddressutxos(const JSONRPCRequest& request)
     UniValue result(UniValue::VARR);
 
     for (std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >::const_iterator it=unspentOutputs.begin(); it!=unspentOutputs.end(); it++) {
-        UniValue output(UniValue::VOBJ);
-        std::string address;
-        if (!getAddressFromIndex(it->first.type, it->first.hashBytes, address)) {
-            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Unknown address type");
-        }
-
-        output.pushKV("address", address);
-        output.pushKV("txid", it->first.txhash.GetHex());
-        output.pushKV("outputIndex", (int)it->first.index);
-        output.pushKV("script", HexStr(it->second.script.begin(), it->second.script.end()));
-        output.pushKV("satoshis", it->second.satoshis);
-        output.pushKV("height", it->second.blockHeight);
-        result.push_back(output);
+        result.push_back(addressUnspentToJSON(*it));
     }
 
     return result;
@@ -684,6 +874,8 @@ UniValue getaddressdeltas(const JSONRPCRequest& request)
             "    ]\n"
             "  \"start\" (number) The start block height\n"
             "  \"end\" (number) The end block height\n"
+            "  \"limit\" (number, optional) Return a page of at most this many deltas\n"
+            "  \"cursor\" (string, optional) Continue after the page that returned this cursor\n"
             "}\n"
             "\nResult:\n"
             "[\n"
@@ -696,6 +888,11 @@ UniValue getaddressdeltas(const JSONRPCRequest& request)
             "    \"address\"  (string) The base58check encoded address\n"
             "  }\n"
             "]\n"
+            "\nResult (with limit or cursor):\n"
+            "{\n"
+            "  \"deltas\": [...]  (array) As above\n"
+            "  \"cursor\"  (string) Pass to the next call to get the next page, null after the last page\n"
+            "}\n"
             "\nExamples:\n"
             + HelpExampleCli("getaddressdeltas", "'{\"addresses\": [\"XwnLY9Tf7Zsef8gMGL2fhWA9ZmMjt4KPwg\"]}'")
             + HelpExampleRpc("getaddressdeltas", "{\"addresses\": [\"XwnLY9Tf7Zsef8gMGL2fhWA9ZmMjt4KPwg\"]}")
@@ -722,36 +919,49 @@ UniValue getaddressdeltas(const JSONRPCRequest& request)
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid address");
     }
 
+    if (!(start > 0 && end > 0)) {
+        start = end = 0;
+    }
+
+    size_t nLimit = 0;
+    std::string strCursor;
+    if (getPaginationFromParams(request.params, nLimit, strCursor)) {
+        UniValue deltas(UniValue::VARR);
+        UniValue cursor = readAddressIndexPage(addresses, start, end, nLimit, strCursor,
+            [&deltas](const std::pair<CAddressIndexKey, CAmount>& entry, const CAddressIndexKey*) {
+                deltas.push_back(addressDeltaToJSON(entry));
+            });
+
+        UniValue result(UniValue::VOBJ);
+        result.pushKV("deltas", deltas);
+        result.pushKV("cursor", cursor);
+        return result;
+    }
+
+    if (request.replyStream) {
+        // Same result as below, without holding all deltas in memory
+        JSONRPCArrayWriter writer(*request.replyStream, request.id);
+        for (const auto& address : addresses) {
+            streamAddressIndex(address, start, end, [&writer](const std::pair<CAddressIndexKey, CAmount>& entry) {
+                writer.push_back(addressDeltaToJSON(entry));
+            });
+        }
+        writer.Finish();
+        return NullUniValue;
+    }
+
     std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
 
     for (std::vector<std::pair<uint160, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
-        if (start > 0 && end > 0) {
-            if (!GetAddressIndex((*it).first, (*it).second, addressIndex, start, end)) {
-                throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
-            }
-        } else {
-            if (!GetAddressIndex((*it).first, (*it).second, addressIndex)) {
-                throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
-            }
+        if (!GetAddressIndex((*it).first, (*it).second, addressIndex, start, end)) {
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
         }
     }
 
     UniValue result(UniValue::VARR);
 
     for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=addressIndex.begin(); it!=addressIndex.end(); it++) {
-        std::string address;
-        if (!getAddressFromIndex(it->first.type, it->first.hashBytes, address)) {
-            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Unknown address type");
-        }
-
-        UniValue delta(UniValue::VOBJ);
-        delta.pushKV("satoshis", it->second);
-        delta.pushKV("txid", it->first.txhash.GetHex());
-        delta.pushKV("index", (int)it->first.index);
-        delta.pushKV("blockindex", (int)it->first.txindex);
-        delta.pushKV("height", it->first.blockHeight);
-        delta.pushKV("address", address);
-        result.push_back(delta);
+        result.push_back(addressDeltaToJSON(*it));
     }
 
     return result;
@@ -845,12 +1055,19 @@ UniValue getaddresstxids(const JSONRPCRequest& request)
             "    ]\n"
             "  \"start\" (number) The start block height\n"
             "  \"end\" (number) The end block height\n"
+            "  \"limit\" (number, optional) Return a page read from at most this many index entries\n"
+            "  \"cursor\" (string, optional) Continue after the page that returned this cursor\n"
             "}\n"
             "\nResult:\n"
             "[\n"
             "  \"transactionid\"  (string) The transaction id\n"
             "  ,...\n"
             "]\n"
+            "\nResult (with limit or cursor):\n"
+            "{\n"
+            "  \"txids\": [...]  (array) As above, ordered by address and height\n"
+            "  \"cursor\"  (string) Pass to the next call to get the next page, null after the last page\n"
+            "}\n"
             "\nExamples:\n"
             + HelpExampleCli("getaddresstxids", "'{\"addresses\": [\"XwnLY9Tf7Zsef8gMGL2fhWA9ZmMjt4KPwg\"]}'")
             + HelpExampleRpc("getaddresstxids", "{\"addresses\": [\"XwnLY9Tf7Zsef8gMGL2fhWA9ZmMjt4KPwg\"]}")
@@ -873,17 +1090,52 @@ UniValue getaddresstxids(const JSONRPCRequest& request)
         }
     }
 
+    if (!(start > 0 && end > 0)) {
+        start = end = 0;
+    }
+
+    size_t nLimit = 0;
+    std::string strCursor;
+    if (getPaginationFromParams(request.params, nLimit, strCursor)) {
+        // All entries of a transaction are adjacent in the index, also skip the
+        // ones of the transaction the previous page ended in
+        UniValue txids(UniValue::VARR);
+        uint256 lastTxid;
+        UniValue cursor = readAddressIndexPage(addresses, start, end, nLimit, strCursor,
+            [&txids, &lastTxid](const std::pair<CAddressIndexKey, CAmount>& entry, const CAddressIndexKey* pAfter) {
+                if (entry.first.txhash == lastTxid || (pAfter && entry.first.txhash == pAfter->txhash)) {
+                    return;
+                }
+                lastTxid = entry.first.txhash;
+                txids.push_back(lastTxid.GetHex());
+            });
+
+        UniValue result(UniValue::VOBJ);
+        result.pushKV("txids", txids);
+        result.pushKV("cursor", cursor);
+        return result;
+    }
+
+    if (request.replyStream && addresses.size() == 1) {
+        // Index order is height order for a single address, so the txids can be
+        // streamed without collecting them first
+        JSONRPCArrayWriter writer(*request.replyStream, request.id);
+        uint256 lastTxid;
+        streamAddressIndex(addresses[0], start, end, [&writer, &lastTxid](const std::pair<CAddressIndexKey, CAmount>& entry) {
+            if (entry.first.txhash != lastTxid) {
+                lastTxid = entry.first.txhash;
+                writer.push_back(lastTxid.GetHex());
+            }
+        });
+        writer.Finish();
+        return NullUniValue;
+    }
+
     std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
 
     for (std::vector<std::pair<uint160, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
-        if (start > 0 && end > 0) {
-            if (!GetAddressIndex((*it).first, (*it).second, addressIndex, start, end)) {
-                throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
-            }
-        } else {
-            if (!GetAddressIndex((*it).first, (*it).second, addressIndex)) {
-                throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
-            }
+        if (!GetAddressIndex((*it).first, (*it).second, addressIndex, start, end)) {
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
         }
     }
 
@@ -1241,12 +1493,98 @@ static UniValue getinfo_deprecated(const JSONRPCRequest& request)
     );
 }
 
+static UniValue SigCacheInfo(size_t nElements, const CCacheHitStats& stats)
+{
+    UniValue obj(UniValue::VOBJ);
+    obj.pushKV("elements", (uint64_t)nElements);
+    obj.pushKV("bytes", (uint64_t)(nElements * sizeof(uint256)));
+    UniValue callers(UniValue::VOBJ);
+    for (int i = 0; i < SIGCACHE_CALLER_COUNT; i++) {
+        SigCacheCaller caller = (SigCacheCaller)i;
+        uint64_t nHits = stats.GetHits(caller);
+        uint64_t nMisses = stats.GetMisses(caller);
+        UniValue entry(UniValue::VOBJ);
+        entry.pushKV("hits", nHits);
+        entry.pushKV("misses", nMisses);
+        entry.pushKV("hitrate", nHits + nMisses ? (double)nHits / (nHits + nMisses) : 0.0);
+        callers.pushKV(SigCacheCallerName(caller), entry);
+    }
+    obj.pushKV("callers", callers);
+    return obj;
+}
+
+UniValue getsigcacheinfo(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() != 0)
+        throw std::runtime_error(
+            "getsigcacheinfo\n"
+            "Returns the size of the signature and script execution caches and their hit rates per caller.\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"signatures\": {            (json object) The signature cache\n"
+            "    \"elements\": xxxxx,       (numeric) Number of entries the cache can store\n"
+            "    \"bytes\": xxxxx,          (numeric) Memory used by the entries in bytes\n"
+            "    \"callers\": {             (json object) Lookups by \"mempool\", \"block\" and \"coinjoin\"\n"
+            "      \"mempool\": {\n"
+            "        \"hits\": xxxxx,       (numeric) Number of lookups which found the entry\n"
+            "        \"misses\": xxxxx,     (numeric) Number of lookups which did not\n"
+            "        \"hitrate\": x.xxx,    (numeric) Share of lookups which found the entry\n"
+            "      },\n"
+            "      ...\n"
+            "    }\n"
+            "  },\n"
+            "  \"scripts\": {               (json object) The script execution cache, same fields as above\n"
+            "    ...\n"
+            "  }\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getsigcacheinfo", "")
+            + HelpExampleRpc("getsigcacheinfo", "")
+        );
+
+    UniValue obj(UniValue::VOBJ);
+    obj.pushKV("signatures", SigCacheInfo(GetSignatureCacheElements(), GetSignatureCacheStats()));
+    obj.pushKV("scripts", SigCacheInfo(GetScriptExecutionCacheElements(), GetScriptExecutionCacheStats()));
+    return obj;
+}
+
+UniValue setsigcachesize(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() != 1)
+        throw std::runtime_error(
+            "setsigcachesize size\n"
+            "Resizes the signature and script execution caches, like -maxsigcachesize does on startup.\n"
+            "Entries are kept as long as they fit into the new size.\n"
+            "\nArguments:\n"
+            "1. size      (numeric, required) Sum of both cache sizes in MiB\n"
+            "\nResult:\n"
+            "Same as getsigcacheinfo\n"
+            "\nExamples:\n"
+            + HelpExampleCli("setsigcachesize", "64")
+            + HelpExampleRpc("setsigcachesize", "64")
+        );
+
+    int64_t nSize = request.params[0].get_int64();
+    if (nSize < 0 || nSize > MAX_MAX_SIG_CACHE_SIZE * 2) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, strprintf("size must be between 0 and %d", MAX_MAX_SIG_CACHE_SIZE * 2));
+    }
+    size_t nBytes = GetSigCacheBytes(nSize);
+    ResizeSignatureCache(nBytes);
+    ResizeScriptExecutionCache(nBytes);
+
+    JSONRPCRequest infoRequest;
+    infoRequest.params.setArray();
+    return getsigcacheinfo(infoRequest);
+}
+
 static const CRPCCommand commands[] =
 { //  category              name                      actor (function)         argNames
   //  --------------------- ------------------------  -----------------------  ----------
     { "control",            "debug",                  &debug,                  {} },
     { "control",            "getmemoryinfo",          &getmemoryinfo,          {"mode"} },
     { "control",            "logging",                &logging,                {"include", "exclude"}},
+    { "control",            "getsigcacheinfo",        &getsigcacheinfo,        {} },
+    { "control",            "setsigcachesize",        &setsigcachesize,        {"size"} },
     { "util",               "validateaddress",        &validateaddress,        {"address"} }, /* uses wallet if enabled */
     { "util",               "createmultisig",         &createmultisig,         {"nrequired","keys"} },
     { "util",               "verifymessage",          &verifymessage,          {"address","signature","message"} },
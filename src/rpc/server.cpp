@@ -470,10 +470,43 @@ bool IsDeprecatedRPCEnabled(const std::string& method)
     return find(enabled_methods.begin(), enabled_methods.end(), method) != enabled_methods.end();
 }
 
+JSONRPCArrayWriter::JSONRPCArrayWriter(JSONRPCReplyStream& streamIn, const UniValue& idIn) :
+    stream(streamIn),
+    id(idIn),
+    strBuffer("{\"result\":["),
+    fEmpty(true)
+{
+}
+
+void JSONRPCArrayWriter::push_back(const UniValue& value)
+{
+    if (!fEmpty) {
+        strBuffer += ',';
+    }
+    strBuffer += value.write();
+    fEmpty = false;
+    if (strBuffer.size() >= CHUNK_SIZE) {
+        stream.Write(strBuffer);
+        strBuffer.clear();
+    }
+}
+
+void JSONRPCArrayWriter::Finish()
+{
+    // Same layout as JSONRPCReply
+    strBuffer += "],\"error\":null,\"id\":" + id.write() + "}\n";
+    stream.Write(strBuffer);
+    strBuffer.clear();
+    stream.End();
+}
+
 static UniValue JSONRPCExecOne(JSONRPCRequest jreq, const UniValue& req)
 {
     UniValue rpc_result(UniValue::VOBJ);
 
+    // Batch replies are assembled as a whole, streaming is not possible here
+    jreq.replyStream.reset();
+
     try {
         jreq.parse(req);
 
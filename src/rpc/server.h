@@ -12,6 +12,7 @@
 
 #include <list>
 #include <map>
+#include <memory>
 #include <stdint.h>
 #include <string>
 
@@ -34,6 +35,25 @@ struct UniValueType {
     UniValue::VType type;
 };
 
+/**
+ * Transport for replies that are written in chunks instead of being returned
+ * as a single UniValue. Only available for singleton HTTP requests.
+ */
+class JSONRPCReplyStream
+{
+public:
+    virtual ~JSONRPCReplyStream() {}
+
+    /** Write a chunk of the reply, the first call starts the reply */
+    virtual void Write(const std::string& strChunk) = 0;
+
+    /** Finish the reply */
+    virtual void End() = 0;
+
+    /** Whether the reply was started, the caller must not send another one then */
+    virtual bool IsStarted() const = 0;
+};
+
 class JSONRPCRequest
 {
 public:
@@ -44,11 +64,35 @@ public:
     std::string URI;
     std::string authUser;
     std::string peerAddr;
+    /** Optional, set when the reply may be streamed (see JSONRPCArrayWriter) */
+    std::shared_ptr<JSONRPCReplyStream> replyStream;
 
     JSONRPCRequest() : id(NullUniValue), params(NullUniValue), fHelp(false) {}
     void parse(const UniValue& valRequest);
 };
 
+/**
+ * Writes a reply whose result is a JSON array element by element through a
+ * JSONRPCReplyStream, buffering at most CHUNK_SIZE bytes. The RPC handler
+ * must return NullUniValue after calling Finish().
+ */
+class JSONRPCArrayWriter
+{
+private:
+    JSONRPCReplyStream& stream;
+    const UniValue id;
+    std::string strBuffer;
+    bool fEmpty;
+
+public:
+    static const size_t CHUNK_SIZE = 64 * 1024;
+
+    JSONRPCArrayWriter(JSONRPCReplyStream& streamIn, const UniValue& idIn);
+
+    void push_back(const UniValue& value);
+    void Finish();
+};
+
 /** Query whether RPC is running */
 bool IsRPCRunning();
 
@@ -7,6 +7,7 @@
 #include <random.h>
 #include <reverselock.h>
 
+#include <algorithm>
 #include <assert.h>
 #include <boost/bind.hpp>
 #include <utility>
@@ -30,7 +31,37 @@ static boost::system_time toPosixTime(const boost::chrono::system_clock::time_po
 }
 #endif
 
+// Tasks get due on the first tick at or after their time
+static int64_t TimeToTick(const boost::chrono::system_clock::time_point& t)
+{
+    const int64_t nMicros = boost::chrono::duration_cast<boost::chrono::microseconds>(t.time_since_epoch()).count();
+    return nMicros / 1000 + (nMicros % 1000 > 0 ? 1 : 0);
+}
+
+static int64_t NowTick()
+{
+    return boost::chrono::duration_cast<boost::chrono::milliseconds>(boost::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+static boost::chrono::system_clock::time_point TickToTime(int64_t nTick)
+{
+    return boost::chrono::system_clock::time_point(boost::chrono::milliseconds(nTick));
+}
+
+bool CScheduler::queueEmpty() const
+{
+    for (const auto& lane : taskQueue) {
+        if (!lane.empty()) return false;
+    }
+    return true;
+}
+
 void CScheduler::serviceQueue()
+{
+    serviceQueueUpTo(LANE_MAINTENANCE);
+}
+
+void CScheduler::serviceQueueUpTo(Lane maxLane)
 {
     boost::unique_lock<boost::mutex> lock(newTaskMutex);
     ++nThreadsServicingQueue;
@@ -40,55 +71,69 @@ void CScheduler::serviceQueue()
     // is called.
     while (!shouldStop()) {
         try {
-            if (!shouldStop() && taskQueue.empty()) {
+            if (!shouldStop() && queueEmpty()) {
                 reverse_lock<boost::unique_lock<boost::mutex> > rlock(lock);
                 // Use this chance to get a tiny bit more entropy
                 RandAddSeedSleep();
             }
-            while (!shouldStop() && taskQueue.empty()) {
-                // Wait until there is something to do.
-                newTaskScheduled.wait(lock);
-            }
 
-            // Wait until either there is a new task, or until
-            // the time of the first item on the queue:
+            // Wait until one of our lanes has a task which is due. The
+            // lanes are advanced to now by whichever thread checks first.
+            while (!shouldStop()) {
+                const int64_t nNowTick = NowTick();
+                int64_t nNextTick = std::numeric_limits<int64_t>::max();
+                for (int lane = 0; lane <= maxLane; lane++) {
+                    taskQueue[lane].Advance(nNowTick);
+                    nNextTick = std::min(nNextTick, taskQueue[lane].NextTick());
+                }
+                if (nNextTick <= nNowTick)
+                    break;
+                if (nNextTick == std::numeric_limits<int64_t>::max()) {
+                    // Wait until there is something to do.
+                    newTaskScheduled.wait(lock);
+                    continue;
+                }
 
 // wait_until needs boost 1.50 or later; older versions have timed_wait:
 #if BOOST_VERSION < 105000
-            while (!shouldStop() && !taskQueue.empty() &&
-                   newTaskScheduled.timed_wait(lock, toPosixTime(taskQueue.begin()->first))) {
-                // Keep waiting until timeout
-            }
+                newTaskScheduled.timed_wait(lock, toPosixTime(TickToTime(nNextTick)));
 #else
-            // Some boost versions have a conflicting overload of wait_until that returns void.
-            // Explicitly use a template here to avoid hitting that overload.
-            while (!shouldStop() && !taskQueue.empty()) {
-                boost::chrono::system_clock::time_point timeToWaitFor = taskQueue.begin()->first;
-                if (newTaskScheduled.wait_until<>(lock, timeToWaitFor) == boost::cv_status::timeout)
-                    break; // Exit loop after timeout, it means we reached the time of the event
-            }
+                // Some boost versions have a conflicting overload of wait_until that returns void.
+                // Explicitly use a template here to avoid hitting that overload.
+                newTaskScheduled.wait_until<>(lock, TickToTime(nNextTick));
 #endif
-            // If there are multiple threads, the queue can empty while we're waiting (another
-            // thread may service the task we were waiting on).
-            if (shouldStop() || taskQueue.empty())
+            }
+            if (shouldStop())
                 continue;
 
-            Function f = taskQueue.begin()->second;
-            taskQueue.erase(taskQueue.begin());
+            // Run the due task of the highest priority lane
+            int lane = 0;
+            while (!taskQueue[lane].HasReady())
+                lane++;
+            Task task = taskQueue[lane].PopReady();
 
+            const boost::chrono::system_clock::time_point start = boost::chrono::system_clock::now();
             {
                 // Unlock before calling f, so it can reschedule itself or another task
                 // without deadlocking:
                 reverse_lock<boost::unique_lock<boost::mutex> > rlock(lock);
-                f();
+                task.f();
             }
+
+            const int64_t nDelayMicros = std::max<int64_t>(0, boost::chrono::duration_cast<boost::chrono::microseconds>(start - task.time).count());
+            const int64_t nRunMicros = boost::chrono::duration_cast<boost::chrono::microseconds>(boost::chrono::system_clock::now() - start).count();
+            TaskStats& stats = mapTaskStats[task.name];
+            stats.nRuns++;
+            stats.nTotalDelayMicros += nDelayMicros;
+            stats.nMaxDelayMicros = std::max(stats.nMaxDelayMicros, nDelayMicros);
+            stats.nTotalRunMicros += nRunMicros;
         } catch (...) {
             --nThreadsServicingQueue;
             throw;
         }
     }
     --nThreadsServicingQueue;
-    newTaskScheduled.notify_one();
+    newTaskScheduled.notify_all();
 }
 
 void CScheduler::stop(bool drain)
@@ -103,39 +148,43 @@ void CScheduler::stop(bool drain)
     newTaskScheduled.notify_all();
 }
 
-void CScheduler::schedule(CScheduler::Function f, boost::chrono::system_clock::time_point t)
+void CScheduler::schedule(CScheduler::Function f, boost::chrono::system_clock::time_point t, Lane lane, const char* name)
 {
     {
         boost::unique_lock<boost::mutex> lock(newTaskMutex);
-        taskQueue.insert(std::make_pair(t, f));
+        taskQueue[lane].Insert(TimeToTick(t), Task{t, std::move(f), name});
     }
-    newTaskScheduled.notify_one();
+    // Not every thread services every lane
+    newTaskScheduled.notify_all();
 }
 
-void CScheduler::scheduleFromNow(CScheduler::Function f, int64_t deltaMilliSeconds)
+void CScheduler::scheduleFromNow(CScheduler::Function f, int64_t deltaMilliSeconds, Lane lane, const char* name)
 {
-    schedule(f, boost::chrono::system_clock::now() + boost::chrono::milliseconds(deltaMilliSeconds));
+    schedule(f, boost::chrono::system_clock::now() + boost::chrono::milliseconds(deltaMilliSeconds), lane, name);
 }
 
-static void Repeat(CScheduler* s, CScheduler::Function f, int64_t deltaMilliSeconds)
+static void Repeat(CScheduler* s, CScheduler::Function f, int64_t deltaMilliSeconds, const char* name)
 {
     f();
-    s->scheduleFromNow(boost::bind(&Repeat, s, f, deltaMilliSeconds), deltaMilliSeconds);
+    s->scheduleFromNow(boost::bind(&Repeat, s, f, deltaMilliSeconds, name), deltaMilliSeconds, CScheduler::LANE_MAINTENANCE, name);
 }
 
-void CScheduler::scheduleEvery(CScheduler::Function f, int64_t deltaMilliSeconds)
+void CScheduler::scheduleEvery(CScheduler::Function f, int64_t deltaMilliSeconds, const char* name)
 {
-    scheduleFromNow(boost::bind(&Repeat, this, f, deltaMilliSeconds), deltaMilliSeconds);
+    scheduleFromNow(boost::bind(&Repeat, this, f, deltaMilliSeconds, name), deltaMilliSeconds, LANE_MAINTENANCE, name);
 }
 
 size_t CScheduler::getQueueInfo(boost::chrono::system_clock::time_point &first,
                              boost::chrono::system_clock::time_point &last) const
 {
     boost::unique_lock<boost::mutex> lock(newTaskMutex);
-    size_t result = taskQueue.size();
-    if (!taskQueue.empty()) {
-        first = taskQueue.begin()->first;
-        last = taskQueue.rbegin()->first;
+    size_t result = 0;
+    for (const auto& lane : taskQueue) {
+        lane.ForEach([&](const Task& task) {
+            if (result == 0 || task.time < first) first = task.time;
+            if (result == 0 || task.time > last) last = task.time;
+            result++;
+        });
     }
     return result;
 }
@@ -145,6 +194,12 @@ bool CScheduler::AreThreadsServicingQueue() const {
     return nThreadsServicingQueue;
 }
 
+std::map<std::string, CScheduler::TaskStats> CScheduler::GetTaskStats() const
+{
+    boost::unique_lock<boost::mutex> lock(newTaskMutex);
+    return mapTaskStats;
+}
+
 
 void SingleThreadedSchedulerClient::MaybeScheduleProcessQueue() {
     {
@@ -155,7 +210,7 @@ void SingleThreadedSchedulerClient::MaybeScheduleProcessQueue() {
         if (m_are_callbacks_running) return;
         if (m_callbacks_pending.empty()) return;
     }
-    m_pscheduler->schedule(std::bind(&SingleThreadedSchedulerClient::ProcessQueue, this));
+    m_pscheduler->schedule(std::bind(&SingleThreadedSchedulerClient::ProcessQueue, this), boost::chrono::system_clock::now(), m_lane, m_name);
 }
 
 void SingleThreadedSchedulerClient::ProcessQueue() {
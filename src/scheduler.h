@@ -12,10 +12,189 @@
 //
 #include <boost/chrono/chrono.hpp>
 #include <boost/thread.hpp>
+#include <array>
+#include <assert.h>
+#include <deque>
+#include <limits>
 #include <map>
+#include <string>
+#include <vector>
 
 #include <sync.h>
 
+/** Default for -schedulerthreads */
+static const int DEFAULT_SCHEDULER_THREADS = 2;
+static const int MAX_SCHEDULER_THREADS = 16;
+
+/**
+ * Hierarchical timer wheel with millisecond ticks. Level L has 64 slots of
+ * 64^L ticks each and holds the tasks due within the current 64^(L+1) ticks,
+ * so scheduling a task is O(1) and a task moves down at most one level each
+ * time the wheel reaches its slot. Tasks due further out than the wheel
+ * covers wait in an ordered overflow map.
+ */
+template<typename T>
+class CTimerWheel
+{
+private:
+    static const int BITS = 6;
+    static const int SLOTS = 1 << BITS;
+    static const int LEVELS = 4;
+
+    struct Entry {
+        int64_t nTick;
+        T value;
+    };
+
+    int64_t nCurrentTick{0};
+    std::array<std::array<std::vector<Entry>, SLOTS>, LEVELS> slots;
+    std::array<uint64_t, LEVELS> occupied{};
+    std::multimap<int64_t, Entry> overflow;
+    std::deque<T> ready;
+    size_t nSize{0};
+
+    void Place(Entry&& entry);
+    void MigrateOverflow();
+    /** Tick of the first occupied slot and its level, LEVELS for the overflow map */
+    int64_t NextSlot(int& nLevel) const;
+
+public:
+    /** Add a value which gets ready once the wheel advanced to nTick */
+    void Insert(int64_t nTick, T value);
+    /** Advance the wheel to nTick, making everything due up to then ready */
+    void Advance(int64_t nTick);
+
+    /** The earliest tick something may get ready at, INT64_MAX if the wheel is empty */
+    int64_t NextTick() const;
+
+    bool HasReady() const { return !ready.empty(); }
+    T PopReady();
+
+    size_t size() const { return nSize; }
+    bool empty() const { return nSize == 0; }
+    template<typename Callable> void ForEach(Callable func) const;
+};
+
+template<typename T>
+void CTimerWheel<T>::Place(Entry&& entry)
+{
+    if (entry.nTick <= nCurrentTick) {
+        ready.push_back(std::move(entry.value));
+        return;
+    }
+    for (int nLevel = 0; nLevel < LEVELS; nLevel++) {
+        // The lowest level whose slots cover the whole range from now to the tick
+        const int nShift = BITS * (nLevel + 1);
+        if ((entry.nTick >> nShift) == (nCurrentTick >> nShift)) {
+            const int nSlot = (entry.nTick >> (BITS * nLevel)) & (SLOTS - 1);
+            slots[nLevel][nSlot].push_back(std::move(entry));
+            occupied[nLevel] |= uint64_t{1} << nSlot;
+            return;
+        }
+    }
+    const int64_t nTick = entry.nTick;
+    overflow.emplace(nTick, std::move(entry));
+}
+
+template<typename T>
+void CTimerWheel<T>::MigrateOverflow()
+{
+    const int nShift = BITS * LEVELS;
+    while (!overflow.empty() && (overflow.begin()->first >> nShift) <= (nCurrentTick >> nShift)) {
+        Place(std::move(overflow.begin()->second));
+        overflow.erase(overflow.begin());
+    }
+}
+
+template<typename T>
+int64_t CTimerWheel<T>::NextSlot(int& nLevel) const
+{
+    for (nLevel = 0; nLevel < LEVELS; nLevel++) {
+        if (occupied[nLevel]) {
+            const int nShift = BITS * (nLevel + 1);
+            const int64_t nSlot = __builtin_ctzll(occupied[nLevel]);
+            return ((nCurrentTick >> nShift) << nShift) | (nSlot << (BITS * nLevel));
+        }
+    }
+    return overflow.empty() ? std::numeric_limits<int64_t>::max() : overflow.begin()->first;
+}
+
+template<typename T>
+void CTimerWheel<T>::Insert(int64_t nTick, T value)
+{
+    Place(Entry{nTick, std::move(value)});
+    nSize++;
+}
+
+template<typename T>
+void CTimerWheel<T>::Advance(int64_t nTick)
+{
+    while (true) {
+        int nLevel;
+        const int64_t nNextTick = NextSlot(nLevel);
+        if (nNextTick > nTick) {
+            // Nothing due until then, the occupied slots stay where they are
+            if (nTick > nCurrentTick) {
+                nCurrentTick = nTick;
+                MigrateOverflow();
+            }
+            return;
+        }
+        nCurrentTick = nNextTick;
+        if (nLevel == LEVELS) {
+            MigrateOverflow();
+            continue;
+        }
+        // Everything in the slot is due now or moves to a lower level
+        const int nSlot = (nNextTick >> (BITS * nLevel)) & (SLOTS - 1);
+        std::vector<Entry> vEntries;
+        vEntries.swap(slots[nLevel][nSlot]);
+        occupied[nLevel] &= ~(uint64_t{1} << nSlot);
+        for (Entry& entry : vEntries) {
+            Place(std::move(entry));
+        }
+    }
+}
+
+template<typename T>
+int64_t CTimerWheel<T>::NextTick() const
+{
+    if (!ready.empty()) {
+        return nCurrentTick;
+    }
+    int nLevel;
+    return NextSlot(nLevel);
+}
+
+template<typename T>
+T CTimerWheel<T>::PopReady()
+{
+    assert(!ready.empty());
+    T value = std::move(ready.front());
+    ready.pop_front();
+    nSize--;
+    return value;
+}
+
+template<typename T>
+template<typename Callable>
+void CTimerWheel<T>::ForEach(Callable func) const
+{
+    for (const T& value : ready) {
+        func(value);
+    }
+    for (const auto& level : slots) {
+        for (const auto& slot : level) {
+            for (const Entry& entry : slot) {
+                func(entry.value);
+            }
+        }
+    }
+    for (const auto& item : overflow) {
+        func(item.second.value);
+    }
+}
+
 //
 // Simple class for background tasks that should be run
 // periodically or once "after a while"
@@ -33,6 +212,11 @@
 // delete t;
 // delete s; // Must be done after thread is interrupted/joined.
 //
+// Tasks are queued in lanes. Due tasks of a higher priority lane are run
+// first, and threads can be dedicated to the higher priority lanes with
+// serviceQueueUpTo(), so slow maintenance tasks never delay latency
+// critical ones.
+//
 
 class CScheduler
 {
@@ -42,18 +226,33 @@ public:
 
     typedef std::function<void(void)> Function;
 
+    enum Lane {
+        LANE_VALIDATION,  // Latency critical, like the validation interface callbacks
+        LANE_MAINTENANCE, // Periodic housekeeping
+        LANE_COUNT
+    };
+
+    // How long the tasks of one name waited past their time and ran for
+    struct TaskStats {
+        uint64_t nRuns{0};
+        int64_t nTotalDelayMicros{0};
+        int64_t nMaxDelayMicros{0};
+        int64_t nTotalRunMicros{0};
+    };
+
     // Call func at/after time t
-    void schedule(Function f, boost::chrono::system_clock::time_point t=boost::chrono::system_clock::now());
+    void schedule(Function f, boost::chrono::system_clock::time_point t=boost::chrono::system_clock::now(),
+                  Lane lane=LANE_MAINTENANCE, const char* name="other");
 
     // Convenience method: call f once deltaSeconds from now
-    void scheduleFromNow(Function f, int64_t deltaMilliSeconds);
+    void scheduleFromNow(Function f, int64_t deltaMilliSeconds, Lane lane=LANE_MAINTENANCE, const char* name="other");
 
     // Another convenience method: call f approximately
     // every deltaSeconds forever, starting deltaSeconds from now.
     // To be more precise: every time f is finished, it
     // is rescheduled to run deltaSeconds later. If you
     // need more accurate scheduling, don't use this method.
-    void scheduleEvery(Function f, int64_t deltaMilliSeconds);
+    void scheduleEvery(Function f, int64_t deltaMilliSeconds, const char* name="other");
 
     // To keep things as simple as possible, there is no unschedule.
 
@@ -61,6 +260,10 @@ public:
     // and interrupted using boost::interrupt_thread
     void serviceQueue();
 
+    // Like serviceQueue(), but only runs the tasks of lane and the
+    // lanes of a higher priority
+    void serviceQueueUpTo(Lane lane);
+
     // Tell any threads running serviceQueue to stop as soon as they're
     // done servicing whatever task they're currently servicing (drain=false)
     // or when there is no work left to be done (drain=true)
@@ -74,14 +277,25 @@ public:
     // Returns true if there are threads actively running in serviceQueue()
     bool AreThreadsServicingQueue() const;
 
+    // Returns the delay and run time statistics by task name
+    std::map<std::string, TaskStats> GetTaskStats() const;
+
 private:
-    std::multimap<boost::chrono::system_clock::time_point, Function> taskQueue;
+    struct Task {
+        boost::chrono::system_clock::time_point time;
+        Function f;
+        const char* name;
+    };
+
+    std::array<CTimerWheel<Task>, LANE_COUNT> taskQueue;
+    std::map<std::string, TaskStats> mapTaskStats;
     boost::condition_variable newTaskScheduled;
     mutable boost::mutex newTaskMutex;
     int nThreadsServicingQueue;
     bool stopRequested;
     bool stopWhenEmpty;
-    bool shouldStop() const { return stopRequested || (stopWhenEmpty && taskQueue.empty()); }
+    bool queueEmpty() const;
+    bool shouldStop() const { return stopRequested || (stopWhenEmpty && queueEmpty()); }
 };
 
 /**
@@ -97,6 +311,8 @@ private:
 class SingleThreadedSchedulerClient {
 private:
     CScheduler *m_pscheduler;
+    const CScheduler::Lane m_lane;
+    const char* const m_name;
 
     CCriticalSection m_cs_callbacks_pending;
     std::list<std::function<void (void)>> m_callbacks_pending GUARDED_BY(m_cs_callbacks_pending);
@@ -106,7 +322,8 @@ private:
     void ProcessQueue();
 
 public:
-    explicit SingleThreadedSchedulerClient(CScheduler *pschedulerIn) : m_pscheduler(pschedulerIn) {}
+    explicit SingleThreadedSchedulerClient(CScheduler *pschedulerIn, CScheduler::Lane lane = CScheduler::LANE_VALIDATION, const char* name = "callbacks")
+        : m_pscheduler(pschedulerIn), m_lane(lane), m_name(name) {}
 
     /**
      * Add a callback to be executed. Callbacks are executed serially
@@ -27,9 +27,12 @@ private:
     uint256 nonce;
     typedef CuckooCache::cache<uint256, SignatureCacheHasher> map_type;
     map_type setValid;
+    size_t nElements{0};
     boost::shared_mutex cs_sigcache;
 
 public:
+    CCacheHitStats stats;
+
     CSignatureCache()
     {
         GetRandBytes(nonce.begin(), 32);
@@ -55,7 +58,44 @@ public:
     }
     uint32_t setup_bytes(size_t n)
     {
-        return setValid.setup_bytes(n);
+        boost::unique_lock<boost::shared_mutex> lock(cs_sigcache);
+        return nElements = setValid.setup_bytes(n);
+    }
+
+    size_t Resize(size_t n)
+    {
+        boost::unique_lock<boost::shared_mutex> lock(cs_sigcache);
+        std::vector<uint256> entries;
+        setValid.for_each([&](const uint256& entry) { entries.push_back(entry); });
+        nElements = setValid.setup_bytes(n);
+        for (const uint256& entry : entries) {
+            setValid.insert(entry);
+        }
+        return nElements;
+    }
+
+    size_t GetElements()
+    {
+        boost::shared_lock<boost::shared_mutex> lock(cs_sigcache);
+        return nElements;
+    }
+
+    void Dump(uint256& nonceOut, std::vector<uint256>& entries)
+    {
+        boost::shared_lock<boost::shared_mutex> lock(cs_sigcache);
+        nonceOut = nonce;
+        setValid.for_each([&](const uint256& entry) { entries.push_back(entry); });
+    }
+
+    void Load(const uint256& nonceIn, const std::vector<uint256>& entries)
+    {
+        boost::unique_lock<boost::shared_mutex> lock(cs_sigcache);
+        // Entries computed with the old nonce would never match again
+        setValid.setup(nElements);
+        nonce = nonceIn;
+        for (const uint256& entry : entries) {
+            setValid.insert(entry);
+        }
     }
 };
 
@@ -66,25 +106,88 @@ public:
  * signatureCache could be made local to VerifySignature.
 */
 static CSignatureCache signatureCache;
+
+thread_local SigCacheCaller g_sigcache_caller = SIGCACHE_MEMPOOL;
 } // namespace
 
+const char* SigCacheCallerName(SigCacheCaller caller)
+{
+    switch (caller) {
+    case SIGCACHE_MEMPOOL: return "mempool";
+    case SIGCACHE_BLOCK: return "block";
+    case SIGCACHE_COINJOIN: return "coinjoin";
+    case SIGCACHE_CALLER_COUNT: break;
+    }
+    assert(false);
+    return "";
+}
+
+SigCacheCaller GetSigCacheCaller()
+{
+    return g_sigcache_caller;
+}
+
+SigCacheCallerScope::SigCacheCallerScope(SigCacheCaller caller) : prevCaller(g_sigcache_caller)
+{
+    g_sigcache_caller = caller;
+}
+
+SigCacheCallerScope::~SigCacheCallerScope()
+{
+    g_sigcache_caller = prevCaller;
+}
+
+size_t GetSigCacheBytes(int64_t nMaxSizeMiB)
+{
+    // The result is unsigned. If -maxsigcachesize is set to zero,
+    // setup_bytes creates the minimum possible cache (2 elements).
+    return std::min(std::max((int64_t)0, nMaxSizeMiB / 2), MAX_MAX_SIG_CACHE_SIZE) * ((size_t) 1 << 20);
+}
+
 // To be called once in AppInitMain/BasicTestingSetup to initialize the
 // signatureCache.
 void InitSignatureCache()
 {
-    // nMaxCacheSize is unsigned. If -maxsigcachesize is set to zero,
-    // setup_bytes creates the minimum possible cache (2 elements).
-    size_t nMaxCacheSize = std::min(std::max((int64_t)0, gArgs.GetArg("-maxsigcachesize", DEFAULT_MAX_SIG_CACHE_SIZE) / 2), MAX_MAX_SIG_CACHE_SIZE) * ((size_t) 1 << 20);
+    size_t nMaxCacheSize = GetSigCacheBytes(gArgs.GetArg("-maxsigcachesize", DEFAULT_MAX_SIG_CACHE_SIZE));
     size_t nElems = signatureCache.setup_bytes(nMaxCacheSize);
     LogPrintf("Using %zu MiB out of %zu/2 requested for signature cache, able to store %zu elements\n",
             (nElems*sizeof(uint256)) >>20, (nMaxCacheSize*2)>>20, nElems);
 }
 
+size_t ResizeSignatureCache(size_t nBytes)
+{
+    size_t nElems = signatureCache.Resize(nBytes);
+    LogPrintf("Resized signature cache to %zu MiB, able to store %zu elements\n", (nElems*sizeof(uint256)) >> 20, nElems);
+    return nElems;
+}
+
+size_t GetSignatureCacheElements()
+{
+    return signatureCache.GetElements();
+}
+
+const CCacheHitStats& GetSignatureCacheStats()
+{
+    return signatureCache.stats;
+}
+
+void DumpSignatureCache(uint256& nonce, std::vector<uint256>& entries)
+{
+    signatureCache.Dump(nonce, entries);
+}
+
+void LoadSignatureCache(const uint256& nonce, const std::vector<uint256>& entries)
+{
+    signatureCache.Load(nonce, entries);
+}
+
 bool CachingTransactionSignatureChecker::VerifySignature(const std::vector<unsigned char>& vchSig, const CPubKey& pubkey, const uint256& sighash) const
 {
     uint256 entry;
     signatureCache.ComputeEntry(entry, sighash, vchSig, pubkey);
-    if (signatureCache.Get(entry, !store))
+    bool fHit = signatureCache.Get(entry, !store);
+    signatureCache.stats.Record(caller, fHit);
+    if (fHit)
         return true;
     if (!TransactionSignatureChecker::VerifySignature(vchSig, pubkey, sighash))
         return false;
@@ -8,6 +8,7 @@
 
 #include <script/interpreter.h>
 
+#include <atomic>
 #include <vector>
 
 // DoS prevention: limit cache size to 32MB (over 1000000 entries on 64-bit
@@ -19,6 +20,58 @@ static const int64_t MAX_MAX_SIG_CACHE_SIZE = 16384;
 
 class CPubKey;
 
+/** The code path a cache lookup is made for, to report hit rates per caller */
+enum SigCacheCaller : uint8_t {
+    SIGCACHE_MEMPOOL,   //!< Mempool acceptance, also used outside of any SigCacheCallerScope
+    SIGCACHE_BLOCK,     //!< Connecting or testing a block
+    SIGCACHE_COINJOIN,  //!< CoinJoin collaterals and final transactions
+    SIGCACHE_CALLER_COUNT
+};
+
+const char* SigCacheCallerName(SigCacheCaller caller);
+
+/** The caller that cache lookups made on this thread are counted for */
+SigCacheCaller GetSigCacheCaller();
+
+/** Count the cache lookups made on this thread for caller while in scope */
+class SigCacheCallerScope
+{
+private:
+    SigCacheCaller prevCaller;
+
+public:
+    explicit SigCacheCallerScope(SigCacheCaller caller);
+    ~SigCacheCallerScope();
+
+    SigCacheCallerScope(const SigCacheCallerScope&) = delete;
+    SigCacheCallerScope& operator=(const SigCacheCallerScope&) = delete;
+};
+
+/** Hits and misses of the signature or script execution cache, per caller */
+class CCacheHitStats
+{
+private:
+    std::atomic<uint64_t> nHits[SIGCACHE_CALLER_COUNT];
+    std::atomic<uint64_t> nMisses[SIGCACHE_CALLER_COUNT];
+
+public:
+    CCacheHitStats()
+    {
+        for (int i = 0; i < SIGCACHE_CALLER_COUNT; i++) {
+            nHits[i] = 0;
+            nMisses[i] = 0;
+        }
+    }
+
+    void Record(SigCacheCaller caller, bool fHit)
+    {
+        (fHit ? nHits : nMisses)[caller].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    uint64_t GetHits(SigCacheCaller caller) const { return nHits[caller].load(std::memory_order_relaxed); }
+    uint64_t GetMisses(SigCacheCaller caller) const { return nMisses[caller].load(std::memory_order_relaxed); }
+};
+
 /**
  * We're hashing a nonce into the entries themselves, so we don't need extra
  * blinding in the set hash computation.
@@ -44,13 +97,26 @@ class CachingTransactionSignatureChecker : public TransactionSignatureChecker
 {
 private:
     bool store;
+    SigCacheCaller caller;
 
 public:
-    CachingTransactionSignatureChecker(const CTransaction* txToIn, unsigned int nInIn, const CAmount& amount, PrecomputedTransactionData& txdataIn, bool storeIn=true) : TransactionSignatureChecker(txToIn, nInIn, amount, txdataIn), store(storeIn) {}
+    CachingTransactionSignatureChecker(const CTransaction* txToIn, unsigned int nInIn, const CAmount& amount, PrecomputedTransactionData& txdataIn, bool storeIn=true, SigCacheCaller callerIn=GetSigCacheCaller()) : TransactionSignatureChecker(txToIn, nInIn, amount, txdataIn), store(storeIn), caller(callerIn) {}
 
     bool VerifySignature(const std::vector<unsigned char>& vchSig, const CPubKey& vchPubKey, const uint256& sighash) const override;
 };
 
+//! Bytes given to each of the signature and script execution caches for -maxsigcachesize=nMaxSizeMiB
+size_t GetSigCacheBytes(int64_t nMaxSizeMiB);
+
 void InitSignatureCache();
+//! Resize the signature cache to about nBytes, keeping the entries which still fit.
+//! Returns the number of elements it can store.
+size_t ResizeSignatureCache(size_t nBytes);
+size_t GetSignatureCacheElements();
+const CCacheHitStats& GetSignatureCacheStats();
+//! Copy the nonce and the entries of the signature cache, to persist them
+void DumpSignatureCache(uint256& nonce, std::vector<uint256>& entries);
+//! Replace the nonce and the entries of the signature cache by ones from DumpSignatureCache
+void LoadSignatureCache(const uint256& nonce, const std::vector<uint256>& entries);
 
 #endif // BITCOIN_SCRIPT_SIGCACHE_H
@@ -0,0 +1,198 @@
+// Copyright (c) 2021 pacprotocol
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_SUPPORT_ALLOCATORS_POOL_H
+#define BITCOIN_SUPPORT_ALLOCATORS_POOL_H
+
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <new>
+#include <vector>
+
+/**
+ * Memory resource that hands out small blocks carved from large chunks.
+ *
+ * Node based containers allocate one node per element. Going to malloc for
+ * each of them costs a malloc header per node and fragments the heap. Here
+ * blocks up to MAX_BLOCK_SIZE_BYTES are rounded up to ELEM_ALIGN_BYTES and
+ * taken from chunks of m_chunk_size_bytes; freed blocks go to a free list per
+ * size and are reused for the next allocation of that size. Chunks are only
+ * released when the resource is destroyed. Larger or over-aligned requests
+ * fall through to operator new.
+ *
+ * This resource is NOT thread safe, it must be protected by the same lock as
+ * the container using it.
+ */
+template <std::size_t MAX_BLOCK_SIZE_BYTES, std::size_t ALIGN_BYTES>
+class PoolResource
+{
+    static_assert(ALIGN_BYTES > 0 && (ALIGN_BYTES & (ALIGN_BYTES - 1)) == 0, "ALIGN_BYTES must be a power of two");
+
+    //! In-place linked list of the free blocks of one size
+    struct ListNode {
+        ListNode* m_next;
+    };
+
+    static constexpr std::size_t ELEM_ALIGN_BYTES = ALIGN_BYTES > alignof(ListNode) ? ALIGN_BYTES : alignof(ListNode);
+    static_assert(ELEM_ALIGN_BYTES <= alignof(std::max_align_t), "chunks from operator new are only aligned to max_align_t");
+    static_assert(MAX_BLOCK_SIZE_BYTES >= sizeof(ListNode), "blocks must be able to hold a free list node");
+
+    const std::size_t m_chunk_size_bytes;
+    std::vector<char*> m_allocated_chunks;
+    std::array<ListNode*, (MAX_BLOCK_SIZE_BYTES + ELEM_ALIGN_BYTES - 1) / ELEM_ALIGN_BYTES + 1> m_free_lists;
+    char* m_available_memory_it = nullptr;
+    char* m_available_memory_end = nullptr;
+    //! Bytes sitting in the free lists
+    std::size_t m_free_bytes = 0;
+
+    static constexpr std::size_t NumElemAlignBytes(std::size_t bytes)
+    {
+        return (bytes + ELEM_ALIGN_BYTES - 1) / ELEM_ALIGN_BYTES + (bytes == 0);
+    }
+
+    static constexpr bool IsFreeListUsable(std::size_t bytes, std::size_t alignment)
+    {
+        return alignment <= ELEM_ALIGN_BYTES && bytes <= MAX_BLOCK_SIZE_BYTES;
+    }
+
+    void AddToFreeList(void* p, std::size_t num_alignments)
+    {
+        m_free_lists[num_alignments] = new (p) ListNode{m_free_lists[num_alignments]};
+        m_free_bytes += num_alignments * ELEM_ALIGN_BYTES;
+    }
+
+    void AllocateChunk()
+    {
+        // Keep what is left of the current chunk, it is smaller than any block we still need from it
+        std::size_t remaining_bytes = m_available_memory_end - m_available_memory_it;
+        if (remaining_bytes != 0) {
+            AddToFreeList(m_available_memory_it, remaining_bytes / ELEM_ALIGN_BYTES);
+        }
+        char* chunk = static_cast<char*>(::operator new(m_chunk_size_bytes));
+        m_allocated_chunks.push_back(chunk);
+        m_available_memory_it = chunk;
+        m_available_memory_end = chunk + m_chunk_size_bytes;
+    }
+
+public:
+    explicit PoolResource(std::size_t chunk_size_bytes) : m_chunk_size_bytes(NumElemAlignBytes(chunk_size_bytes) * ELEM_ALIGN_BYTES)
+    {
+        assert(m_chunk_size_bytes >= MAX_BLOCK_SIZE_BYTES);
+        m_free_lists.fill(nullptr);
+    }
+
+    PoolResource() : PoolResource(262144) {}
+
+    PoolResource(const PoolResource&) = delete;
+    PoolResource& operator=(const PoolResource&) = delete;
+
+    ~PoolResource()
+    {
+        for (char* chunk : m_allocated_chunks) {
+            ::operator delete(chunk);
+        }
+    }
+
+    void* Allocate(std::size_t bytes, std::size_t alignment)
+    {
+        if (!IsFreeListUsable(bytes, alignment)) {
+            return ::operator new(bytes);
+        }
+        const std::size_t num_alignments = NumElemAlignBytes(bytes);
+        ListNode*& head = m_free_lists[num_alignments];
+        if (head != nullptr) {
+            ListNode* node = head;
+            head = node->m_next;
+            m_free_bytes -= num_alignments * ELEM_ALIGN_BYTES;
+            return node;
+        }
+        const std::size_t round_bytes = num_alignments * ELEM_ALIGN_BYTES;
+        if (round_bytes > static_cast<std::size_t>(m_available_memory_end - m_available_memory_it)) {
+            AllocateChunk();
+        }
+        void* p = m_available_memory_it;
+        m_available_memory_it += round_bytes;
+        return p;
+    }
+
+    void Deallocate(void* p, std::size_t bytes, std::size_t alignment) noexcept
+    {
+        if (!IsFreeListUsable(bytes, alignment)) {
+            ::operator delete(p);
+            return;
+        }
+        AddToFreeList(p, NumElemAlignBytes(bytes));
+    }
+
+    std::size_t ChunkSizeBytes() const { return m_chunk_size_bytes; }
+    std::size_t NumAllocatedChunks() const { return m_allocated_chunks.size(); }
+
+    //! Bytes of the chunks that are handed out, free blocks are reused before new chunks are allocated
+    std::size_t UsedBytes() const
+    {
+        std::size_t unused = m_free_bytes + (m_available_memory_end - m_available_memory_it);
+        return m_allocated_chunks.size() * m_chunk_size_bytes - unused;
+    }
+};
+
+/**
+ * Allocator that takes its memory from a PoolResource. A default constructed
+ * allocator has no resource and uses operator new, so containers that are
+ * not set up with a resource keep working as with std::allocator.
+ */
+template <class T, std::size_t MAX_BLOCK_SIZE_BYTES, std::size_t ALIGN_BYTES = alignof(T)>
+class PoolAllocator
+{
+public:
+    using value_type = T;
+    using ResourceType = PoolResource<MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES>;
+
+    template <typename U>
+    struct rebind {
+        using other = PoolAllocator<U, MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES>;
+    };
+
+    PoolAllocator() noexcept : m_resource(nullptr) {}
+    PoolAllocator(ResourceType* resource) noexcept : m_resource(resource) {}
+
+    template <typename U>
+    PoolAllocator(const PoolAllocator<U, MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES>& other) noexcept : m_resource(other.resource()) {}
+
+    T* allocate(std::size_t n)
+    {
+        if (m_resource == nullptr) {
+            return static_cast<T*>(::operator new(n * sizeof(T)));
+        }
+        return static_cast<T*>(m_resource->Allocate(n * sizeof(T), alignof(T)));
+    }
+
+    void deallocate(T* p, std::size_t n) noexcept
+    {
+        if (m_resource == nullptr) {
+            ::operator delete(p);
+            return;
+        }
+        m_resource->Deallocate(p, n * sizeof(T), alignof(T));
+    }
+
+    ResourceType* resource() const noexcept { return m_resource; }
+
+private:
+    ResourceType* m_resource;
+};
+
+template <class T1, class T2, std::size_t MAX_BLOCK_SIZE_BYTES, std::size_t ALIGN_BYTES>
+bool operator==(const PoolAllocator<T1, MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES>& a, const PoolAllocator<T2, MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES>& b) noexcept
+{
+    return a.resource() == b.resource();
+}
+
+template <class T1, class T2, std::size_t MAX_BLOCK_SIZE_BYTES, std::size_t ALIGN_BYTES>
+bool operator!=(const PoolAllocator<T1, MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES>& a, const PoolAllocator<T2, MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES>& b) noexcept
+{
+    return !(a == b);
+}
+
+#endif // BITCOIN_SUPPORT_ALLOCATORS_POOL_H
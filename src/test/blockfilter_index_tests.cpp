@@ -0,0 +1,165 @@
+// Copyright (c) 2021 pacprotocol
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <blockfilter.h>
+#include <chainparams.h>
+#include <consensus/validation.h>
+#include <index/blockfilterindex.h>
+#include <test/test_dash.h>
+#include <undo.h>
+#include <validation.h>
+#include <validationinterface.h>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_AUTO_TEST_SUITE(blockfilter_index_tests)
+
+static void CheckFilterLookups(BlockFilterIndex& filter_index, const CBlockIndex* block_index, uint256& last_header)
+{
+    CBlock block;
+    BOOST_REQUIRE(ReadBlockFromDisk(block, block_index, Params().GetConsensus()));
+    CBlockUndo block_undo;
+    if (block_index->nHeight > 0) {
+        BOOST_REQUIRE(UndoReadFromDisk(block_undo, block_index));
+    }
+    BlockFilter expected_filter(BlockFilterType::BASIC_FILTER, block, block_undo);
+
+    std::vector<unsigned char> encoded_filter;
+    uint256 filter_header;
+    std::vector<uint256> filter_hashes;
+
+    BOOST_REQUIRE(filter_index.LookupFilter(block_index, encoded_filter));
+    BOOST_REQUIRE(filter_index.LookupFilterHeader(block_index, filter_header));
+    BOOST_REQUIRE(filter_index.LookupFilterHashRange(block_index->nHeight, block_index, filter_hashes));
+
+    BOOST_CHECK(encoded_filter == expected_filter.GetEncodedFilter());
+    BOOST_CHECK(filter_header == expected_filter.ComputeHeader(last_header));
+    BOOST_CHECK_EQUAL(filter_hashes.size(), 1);
+    BOOST_CHECK(filter_hashes[0] == expected_filter.GetHash());
+
+    last_header = filter_header;
+}
+
+BOOST_FIXTURE_TEST_CASE(blockfilter_index_initial_sync, TestChain100Setup)
+{
+    BlockFilterIndex filter_index(BlockFilterType::BASIC_FILTER, 1 << 20, true);
+
+    // Nothing is indexed before the index is started
+    {
+        LOCK(cs_main);
+        std::vector<unsigned char> encoded_filter;
+        BOOST_CHECK(!filter_index.LookupFilter(chainActive.Tip(), encoded_filter));
+    }
+
+    filter_index.Start();
+
+    // Allow the filter index to catch up with the chain
+    int64_t time_start = GetTimeMillis();
+    while (!filter_index.IsSynced()) {
+        BOOST_REQUIRE(time_start + 10 * 1000 > GetTimeMillis());
+        MilliSleep(100);
+    }
+
+    // Check that the filter index has all blocks that were in the chain before it started
+    uint256 last_header;
+    const CBlockIndex* last_index;
+    {
+        LOCK(cs_main);
+        for (const CBlockIndex* block_index = chainActive.Genesis(); block_index; block_index = chainActive.Next(block_index)) {
+            CheckFilterLookups(filter_index, block_index, last_header);
+        }
+        last_index = chainActive.Tip();
+    }
+
+    // Blocks connected after the initial sync are indexed as they come in
+    for (int i = 0; i < 10; i++) {
+        CreateAndProcessBlock({}, coinbaseKey);
+    }
+    SyncWithValidationInterfaceQueue();
+
+    {
+        LOCK(cs_main);
+        for (const CBlockIndex* block_index = chainActive.Next(last_index); block_index; block_index = chainActive.Next(block_index)) {
+            CheckFilterLookups(filter_index, block_index, last_header);
+        }
+
+        std::vector<uint256> filter_hashes;
+        BOOST_CHECK(filter_index.LookupFilterHashRange(0, chainActive.Tip(), filter_hashes));
+        BOOST_CHECK_EQUAL(filter_hashes.size(), chainActive.Height() + 1);
+    }
+
+    filter_index.Stop();
+}
+
+BOOST_FIXTURE_TEST_CASE(blockfilter_index_reorg, TestChain100Setup)
+{
+    BlockFilterIndex filter_index(BlockFilterType::BASIC_FILTER, 1 << 20, true);
+    filter_index.Start();
+
+    int64_t time_start = GetTimeMillis();
+    while (!filter_index.IsSynced()) {
+        BOOST_REQUIRE(time_start + 10 * 1000 > GetTimeMillis());
+        MilliSleep(100);
+    }
+
+    // Disconnect the last three blocks
+    const CBlockIndex* fork_index;
+    std::vector<const CBlockIndex*> stale_blocks;
+    uint256 fork_header;
+    {
+        LOCK(cs_main);
+        fork_index = chainActive[chainActive.Height() - 3];
+        for (const CBlockIndex* block_index = chainActive.Next(fork_index); block_index; block_index = chainActive.Next(block_index)) {
+            stale_blocks.push_back(block_index);
+        }
+        BOOST_REQUIRE(filter_index.LookupFilterHeader(fork_index, fork_header));
+
+        CValidationState state;
+        BOOST_REQUIRE(InvalidateBlock(state, Params(), chainActive.Next(fork_index)));
+        BOOST_CHECK(chainActive.Tip() == fork_index);
+    }
+    SyncWithValidationInterfaceQueue();
+
+    {
+        LOCK(cs_main);
+        uint256 filter_header;
+        BOOST_REQUIRE(filter_index.LookupFilterHeader(chainActive.Tip(), filter_header));
+        BOOST_CHECK(filter_header == fork_header);
+    }
+
+    // Connect a longer branch in their place, its coinbases pay to another
+    // script so the blocks differ from the stale ones
+    for (int i = 0; i < 4; i++) {
+        CreateAndProcessBlock({}, CScript() << OP_TRUE);
+    }
+    SyncWithValidationInterfaceQueue();
+
+    auto check_branches = [&]() {
+        LOCK(cs_main);
+        BOOST_CHECK_EQUAL(chainActive.Height(), fork_index->nHeight + 4);
+
+        // The headers of the new branch build on the fork point
+        uint256 last_header = fork_header;
+        for (const CBlockIndex* block_index = chainActive.Next(fork_index); block_index; block_index = chainActive.Next(block_index)) {
+            CheckFilterLookups(filter_index, block_index, last_header);
+        }
+
+        // The disconnected blocks keep their entries
+        last_header = fork_header;
+        for (const CBlockIndex* block_index : stale_blocks) {
+            CheckFilterLookups(filter_index, block_index, last_header);
+        }
+    };
+
+    // Served from the entries not committed yet, then from the database once
+    // they are written along with the chainstate
+    check_branches();
+    FlushStateToDisk();
+    SyncWithValidationInterfaceQueue();
+    check_branches();
+
+    filter_index.Stop();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
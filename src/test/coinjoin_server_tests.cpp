@@ -0,0 +1,109 @@
+// Copyright (c) 2021 pacprotocol
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <coinjoin/coinjoin-server.h>
+#include <keystore.h>
+#include <net.h>
+#include <script/sign.h>
+#include <script/standard.h>
+#include <test/test_dash.h>
+
+#include <boost/test/unit_test.hpp>
+
+struct CCoinJoinServerTest {
+    static void AddEntry(CCoinJoinServer& server, const CCoinJoinEntry& entry) { server.vecEntries.push_back(entry); }
+    static void CreateFinalTransaction(CCoinJoinServer& server, CConnman& connman) { server.CreateFinalTransaction(connman); }
+    static const CMutableTransaction& GetFinalTransaction(const CCoinJoinServer& server) { return server.finalMutableTransaction; }
+    static bool IsInputScriptSigValid(CCoinJoinServer& server, const CTxIn& txin) { return server.IsInputScriptSigValid(txin); }
+    static bool AreInputScriptSigsValid(CCoinJoinServer& server, const std::vector<CTxIn>& vecTxIn) { return server.AreInputScriptSigsValid(vecTxIn); }
+};
+
+namespace {
+
+// Sign the input spending prevout, as if it was at position nIn of the final transaction
+CTxIn SignFinalInput(const CKeyStore& keystore, const CMutableTransaction& txFinal, const COutPoint& prevout, const CScript& prevPubKey, unsigned int nIn)
+{
+    CMutableTransaction tx(txFinal);
+    BOOST_REQUIRE(SignSignature(keystore, prevPubKey, tx, nIn, 0, SIGHASH_ALL | SIGHASH_ANYONECANPAY));
+    CTxIn txin(prevout);
+    txin.scriptSig = tx.vin[nIn].scriptSig;
+    return txin;
+}
+
+unsigned int FindInput(const CMutableTransaction& tx, const COutPoint& prevout)
+{
+    for (unsigned int i = 0; i < tx.vin.size(); i++) {
+        if (tx.vin[i].prevout == prevout) {
+            return i;
+        }
+    }
+    BOOST_FAIL("input not found");
+    return 0;
+}
+
+} // namespace
+
+BOOST_FIXTURE_TEST_SUITE(coinjoin_server_tests, TestingSetup)
+
+BOOST_AUTO_TEST_CASE(coinjoin_server_scriptsigs)
+{
+    CBasicKeyStore keystore;
+    std::vector<COutPoint> vPrevouts;
+    std::vector<CScript> vPrevPubKeys;
+    CCoinJoinServer server;
+
+    // Two participants, the first one with two inputs
+    for (int nEntry = 0; nEntry < 2; nEntry++) {
+        CCoinJoinEntry entry;
+        for (int i = 0; i < 2 - nEntry; i++) {
+            CKey key;
+            key.MakeNewKey(true);
+            keystore.AddKey(key);
+            CScript prevPubKey = GetScriptForDestination(key.GetPubKey().GetID());
+            COutPoint prevout(InsecureRand256(), InsecureRandRange(4));
+            entry.vecTxDSIn.emplace_back(CTxIn(prevout), prevPubKey, 0);
+            vPrevouts.push_back(prevout);
+            vPrevPubKeys.push_back(prevPubKey);
+
+            CKey keyOut;
+            keyOut.MakeNewKey(true);
+            entry.vecTxOut.emplace_back(COIN, GetScriptForDestination(keyOut.GetPubKey().GetID()));
+        }
+        CCoinJoinServerTest::AddEntry(server, entry);
+    }
+    CCoinJoinServerTest::CreateFinalTransaction(server, *connman);
+    const CMutableTransaction& txFinal = CCoinJoinServerTest::GetFinalTransaction(server);
+    BOOST_REQUIRE_EQUAL(txFinal.vin.size(), 3U);
+
+    // Valid signatures pass, one by one and as a batch
+    std::vector<CTxIn> vecSigned;
+    for (size_t i = 0; i < vPrevouts.size(); i++) {
+        CTxIn txin = SignFinalInput(keystore, txFinal, vPrevouts[i], vPrevPubKeys[i], FindInput(txFinal, vPrevouts[i]));
+        BOOST_CHECK(CCoinJoinServerTest::IsInputScriptSigValid(server, txin));
+        vecSigned.push_back(txin);
+    }
+    BOOST_CHECK(CCoinJoinServerTest::AreInputScriptSigsValid(server, vecSigned));
+
+    // A signature made for another position in the final transaction fails
+    unsigned int nIn = FindInput(txFinal, vPrevouts[0]);
+    CTxIn txinWrongIndex = SignFinalInput(keystore, txFinal, vPrevouts[0], vPrevPubKeys[0], (nIn + 1) % txFinal.vin.size());
+    BOOST_CHECK(!CCoinJoinServerTest::IsInputScriptSigValid(server, txinWrongIndex));
+    BOOST_CHECK(!CCoinJoinServerTest::AreInputScriptSigsValid(server, {txinWrongIndex, vecSigned[1], vecSigned[2]}));
+
+    // An input that is not part of the session fails, even if it is signed
+    CKey keyForeign;
+    keyForeign.MakeNewKey(true);
+    keystore.AddKey(keyForeign);
+    CMutableTransaction txForeign(txFinal);
+    COutPoint prevoutForeign(InsecureRand256(), 0);
+    txForeign.vin.emplace_back(prevoutForeign);
+    CTxIn txinForeign = SignFinalInput(keystore, txForeign, prevoutForeign, GetScriptForDestination(keyForeign.GetPubKey().GetID()), txForeign.vin.size() - 1);
+    BOOST_CHECK(!CCoinJoinServerTest::IsInputScriptSigValid(server, txinForeign));
+    BOOST_CHECK(!CCoinJoinServerTest::AreInputScriptSigsValid(server, {vecSigned[0], txinForeign}));
+
+    // The same input twice in a batch fails
+    BOOST_CHECK(!CCoinJoinServerTest::AreInputScriptSigsValid(server, {vecSigned[0], vecSigned[0]}));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
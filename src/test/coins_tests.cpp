@@ -7,10 +7,15 @@
 #include <uint256.h>
 #include <undo.h>
 #include <utilstrencodings.h>
+#include <utiltime.h>
 #include <test/test_dash.h>
+#include <txdb.h>
 #include <validation.h>
 #include <consensus/validation.h>
 
+#include <condition_variable>
+#include <mutex>
+#include <thread>
 #include <vector>
 #include <map>
 
@@ -52,7 +57,7 @@ public:
 
     uint256 GetBestBlock() const override { return hashBestBlock_; }
 
-    bool BatchWrite(CCoinsMap& mapCoins, const uint256& hashBlock) override
+    bool BatchWrite(CCoinsMap& mapCoins, const uint256& hashBlock, bool erase = true) override
     {
         for (CCoinsMap::iterator it = mapCoins.begin(); it != mapCoins.end(); ) {
             if (it->second.flags & CCoinsCacheEntry::DIRTY) {
@@ -63,7 +68,11 @@ public:
                     map_.erase(it->first);
                 }
             }
-            mapCoins.erase(it++);
+            if (erase) {
+                mapCoins.erase(it++);
+            } else {
+                ++it;
+            }
         }
         if (!hashBlock.IsNull())
             hashBestBlock_ = hashBlock;
@@ -76,6 +85,8 @@ class CCoinsViewCacheTest : public CCoinsViewCache
 public:
     explicit CCoinsViewCacheTest(CCoinsView* _base) : CCoinsViewCache(_base) {}
 
+    using CCoinsViewCache::UsedMemoryUsage;
+
     void SelfTest() const
     {
         // Manually recompute the dynamic usage of the whole data, and compare it.
@@ -93,6 +104,51 @@ public:
     size_t& usage() const { return cachedCoinsUsage; }
 };
 
+//! CCoinsViewDB whose coin writes can be held back or made to fail
+class CCoinsViewDBTest : public CCoinsViewDB
+{
+    std::mutex mutex;
+    std::condition_variable cond;
+    bool fHold = false;
+    int nFailWrites = 0;
+
+protected:
+    bool WriteCoins(CCoinsMap& mapCoins, const uint256& hashBlock, bool erase) override
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            cond.wait(lock, [this] { return !fHold; });
+            if (nFailWrites > 0) {
+                nFailWrites--;
+                return false;
+            }
+        }
+        return CCoinsViewDB::WriteCoins(mapCoins, hashBlock, erase);
+    }
+
+public:
+    CCoinsViewDBTest() : CCoinsViewDB(1 << 20, true) {}
+    ~CCoinsViewDBTest()
+    {
+        // The writer thread calls back into this class
+        Hold(false);
+        WaitForPendingWrite();
+    }
+
+    void Hold(bool hold)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        fHold = hold;
+        cond.notify_all();
+    }
+
+    void FailWrites(int count)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        nFailWrites = count;
+    }
+};
+
 } // namespace
 
 BOOST_FIXTURE_TEST_SUITE(coins_tests, BasicTestingSetup)
@@ -855,4 +911,232 @@ BOOST_AUTO_TEST_CASE(ccoins_write)
                     CheckWriteCoins(parent_value, child_value, parent_value, parent_flags, child_flags, parent_flags);
 }
 
+BOOST_AUTO_TEST_CASE(ccoins_sync_trim)
+{
+    CCoinsViewTest base;
+    CCoinsViewCacheTest cache(&base);
+    cache.SetBestBlock(InsecureRand256());
+
+    std::vector<COutPoint> outpoints;
+    for (int i = 0; i < 10; i++) {
+        COutPoint outpoint(InsecureRand256(), 0);
+        Coin coin;
+        coin.out.nValue = 1 + InsecureRandRange(1000);
+        coin.nHeight = i + 1;
+        cache.AddCoin(outpoint, std::move(coin), false);
+        outpoints.push_back(outpoint);
+    }
+
+    // Syncing writes the coins but keeps them cached as clean entries
+    BOOST_CHECK(cache.Sync());
+    BOOST_CHECK_EQUAL(cache.GetCacheSize(), 10U);
+    for (const COutPoint& outpoint : outpoints) {
+        Coin coin;
+        BOOST_CHECK(base.GetCoin(outpoint, coin) && !coin.IsSpent());
+        BOOST_CHECK_EQUAL(cache.map().at(outpoint).flags, 0);
+    }
+    cache.SelfTest();
+
+    // Spent entries are written and then dropped from the cache
+    BOOST_CHECK(cache.SpendCoin(outpoints[0]));
+    BOOST_CHECK(cache.Sync());
+    Coin spent;
+    BOOST_CHECK(!base.GetCoin(outpoints[0], spent) || spent.IsSpent());
+    BOOST_CHECK(cache.map().count(outpoints[0]) == 0);
+    BOOST_CHECK_EQUAL(cache.GetCacheSize(), 9U);
+    cache.SelfTest();
+
+    // Trimming evicts the oldest coins first
+    cache.Trim(cache.UsedMemoryUsage() - 1);
+    BOOST_CHECK(cache.map().count(outpoints[1]) == 0);
+    BOOST_CHECK(cache.map().count(outpoints[9]) == 1);
+    cache.SelfTest();
+
+    // Modified coins are never trimmed
+    Coin coin;
+    coin.out.nValue = 1;
+    coin.nHeight = 1;
+    cache.AddCoin(COutPoint(InsecureRand256(), 0), std::move(coin), false);
+    cache.Trim(0);
+    BOOST_CHECK_EQUAL(cache.GetCacheSize(), 1U);
+    cache.SelfTest();
+}
+
+BOOST_AUTO_TEST_CASE(ccoins_trim_pool)
+{
+    CCoinsViewTest base;
+    CCoinsViewCacheTest cache(&base);
+    cache.SetBestBlock(InsecureRand256());
+
+    // Enough coins to take several pool chunks
+    std::vector<COutPoint> outpoints;
+    for (int i = 0; i < 20000; i++) {
+        COutPoint outpoint(InsecureRand256(), 0);
+        Coin coin;
+        coin.out.nValue = 1 + InsecureRandRange(1000);
+        coin.nHeight = i + 1;
+        cache.AddCoin(outpoint, std::move(coin), false);
+        outpoints.push_back(outpoint);
+    }
+    BOOST_CHECK(cache.Sync());
+    const size_t nFullUsage = cache.DynamicMemoryUsage();
+    cache.SelfTest();
+
+    // Uncached entries go back to the pool, which keeps its chunks
+    for (size_t i = 100; i < outpoints.size(); i++) {
+        cache.Uncache(outpoints[i]);
+    }
+    BOOST_CHECK_EQUAL(cache.GetCacheSize(), 100U);
+    BOOST_CHECK_EQUAL(cache.DynamicMemoryUsage(), nFullUsage);
+    BOOST_CHECK(cache.UsedMemoryUsage() < nFullUsage / 10);
+    cache.SelfTest();
+
+    // Trimming moves the remaining coins to a new pool and frees the chunks
+    cache.Trim(nFullUsage / 2);
+    BOOST_CHECK_EQUAL(cache.GetCacheSize(), 100U);
+    BOOST_CHECK(cache.DynamicMemoryUsage() <= nFullUsage / 2);
+    for (size_t i = 0; i < 100; i++) {
+        BOOST_CHECK(cache.HaveCoinInCache(outpoints[i]));
+        BOOST_CHECK_EQUAL(cache.map().at(outpoints[i]).flags, 0);
+    }
+    cache.SelfTest();
+}
+
+BOOST_AUTO_TEST_CASE(ccoins_add_fetched)
+{
+    CCoinsViewTest base;
+    CCoinsViewCacheTest cache(&base);
+    cache.SetBestBlock(InsecureRand256());
+
+    std::vector<COutPoint> outpoints;
+    for (int i = 0; i < 5; i++) {
+        COutPoint outpoint(InsecureRand256(), 0);
+        Coin coin;
+        coin.out.nValue = 1 + InsecureRandRange(1000);
+        coin.nHeight = i + 1;
+        cache.AddCoin(outpoint, std::move(coin), false);
+        outpoints.push_back(outpoint);
+    }
+    BOOST_CHECK(cache.Flush());
+    BOOST_CHECK_EQUAL(cache.GetCacheSize(), 0U);
+
+    // A fresh read is added as a clean entry, but never replaces one
+    uint64_t nFlushSequence = cache.GetFlushSequence();
+    Coin coin;
+    BOOST_CHECK(base.GetCoin(outpoints[0], coin));
+    BOOST_CHECK(cache.AddFetchedCoin(outpoints[0], std::move(coin), nFlushSequence));
+    BOOST_CHECK_EQUAL(cache.map().at(outpoints[0]).flags, 0);
+    BOOST_CHECK(base.GetCoin(outpoints[0], coin));
+    BOOST_CHECK(!cache.AddFetchedCoin(outpoints[0], std::move(coin), nFlushSequence));
+    cache.SelfTest();
+
+    // A coin spent in the cache since the read stays spent
+    BOOST_CHECK(base.GetCoin(outpoints[1], coin));
+    BOOST_CHECK(cache.SpendCoin(outpoints[1]));
+    BOOST_CHECK(!cache.AddFetchedCoin(outpoints[1], std::move(coin), nFlushSequence));
+    BOOST_CHECK(!cache.HaveCoin(outpoints[1]));
+
+    // Also once the spend was synced and dropped from the cache
+    nFlushSequence = cache.GetFlushSequence();
+    BOOST_CHECK(base.GetCoin(outpoints[2], coin));
+    BOOST_CHECK(cache.SpendCoin(outpoints[2]));
+    BOOST_CHECK(cache.Sync());
+    BOOST_CHECK(cache.map().count(outpoints[2]) == 0);
+    BOOST_CHECK(!cache.AddFetchedCoin(outpoints[2], std::move(coin), nFlushSequence));
+    BOOST_CHECK(!cache.HaveCoin(outpoints[2]));
+    cache.SelfTest();
+
+    // Reads from before a flush are dropped
+    nFlushSequence = cache.GetFlushSequence();
+    BOOST_CHECK(base.GetCoin(outpoints[3], coin));
+    BOOST_CHECK(cache.Flush());
+    BOOST_CHECK(!cache.AddFetchedCoin(outpoints[3], std::move(coin), nFlushSequence));
+    BOOST_CHECK_EQUAL(cache.GetCacheSize(), 0U);
+
+    // Spent coins are never added
+    nFlushSequence = cache.GetFlushSequence();
+    Coin spent;
+    BOOST_CHECK(!cache.AddFetchedCoin(outpoints[4], std::move(spent), nFlushSequence));
+    BOOST_CHECK_EQUAL(cache.GetCacheSize(), 0U);
+    cache.SelfTest();
+}
+
+BOOST_AUTO_TEST_CASE(ccoins_background_write)
+{
+    SetDataDir("coins_background_write");
+    CCoinsViewDBTest db;
+    CCoinsViewCacheTest cache(&db);
+    uint256 hashBlock = InsecureRand256();
+    cache.SetBestBlock(hashBlock);
+
+    std::vector<COutPoint> outpoints;
+    for (int i = 0; i < 10; i++) {
+        COutPoint outpoint(InsecureRand256(), 0);
+        Coin coin;
+        coin.out.nValue = 1 + InsecureRandRange(1000);
+        coin.nHeight = i + 1;
+        cache.AddCoin(outpoint, std::move(coin), false);
+        outpoints.push_back(outpoint);
+    }
+
+    // While the write is in flight, the database is marked as moving to
+    // hashBlock and the coins are read from the snapshot
+    CCoinsMap mapDirty;
+    cache.SnapshotDirty(mapDirty);
+    db.Hold(true);
+    BOOST_CHECK(db.BatchWriteInBackground(std::move(mapDirty), hashBlock));
+    BOOST_CHECK(db.GetBestBlock().IsNull());
+    BOOST_CHECK(db.GetHeadBlocks().size() == 2 && db.GetHeadBlocks()[0] == hashBlock);
+    BOOST_CHECK(db.PendingMemoryUsage() > 0);
+    for (const COutPoint& outpoint : outpoints) {
+        Coin coin;
+        BOOST_CHECK(db.GetCoin(outpoint, coin) && coin.nHeight > 0);
+        BOOST_CHECK(db.HaveCoin(outpoint));
+    }
+    db.Hold(false);
+    BOOST_CHECK(db.WaitForPendingWrite());
+    BOOST_CHECK(db.GetBestBlock() == hashBlock);
+    BOOST_CHECK(db.GetHeadBlocks().empty());
+    BOOST_CHECK_EQUAL(db.PendingMemoryUsage(), 0U);
+    for (const COutPoint& outpoint : outpoints) {
+        BOOST_CHECK(db.HaveCoin(outpoint));
+    }
+
+    // A failed write keeps serving the snapshot and is retried by the next
+    // wait, until it succeeds
+    BOOST_CHECK(cache.SpendCoin(outpoints[0]));
+    hashBlock = InsecureRand256();
+    cache.SetBestBlock(hashBlock);
+    CCoinsMap mapSpent;
+    cache.SnapshotDirty(mapSpent);
+    db.FailWrites(2);
+    BOOST_CHECK(db.BatchWriteInBackground(std::move(mapSpent), hashBlock));
+    BOOST_CHECK(!db.WaitForPendingWrite());
+    BOOST_CHECK(!db.HaveCoin(outpoints[0]));
+    BOOST_CHECK(db.PendingMemoryUsage() > 0);
+    BOOST_CHECK(db.GetBestBlock().IsNull());
+    BOOST_CHECK(db.WaitForPendingWrite());
+    BOOST_CHECK(!db.HaveCoin(outpoints[0]));
+    BOOST_CHECK(db.HaveCoin(outpoints[1]));
+    BOOST_CHECK(db.GetBestBlock() == hashBlock);
+    BOOST_CHECK_EQUAL(db.PendingMemoryUsage(), 0U);
+
+    // Other writes wait for the background write first
+    BOOST_CHECK(cache.SpendCoin(outpoints[1]));
+    CCoinsMap mapHeld;
+    cache.SnapshotDirty(mapHeld);
+    db.Hold(true);
+    BOOST_CHECK(db.BatchWriteInBackground(std::move(mapHeld), hashBlock));
+    BOOST_CHECK(cache.SpendCoin(outpoints[2]));
+    std::thread release([&db] {
+        MilliSleep(50);
+        db.Hold(false);
+    });
+    BOOST_CHECK(cache.Sync());
+    release.join();
+    BOOST_CHECK(!db.HaveCoin(outpoints[1]));
+    BOOST_CHECK(!db.HaveCoin(outpoints[2]));
+    BOOST_CHECK_EQUAL(db.PendingMemoryUsage(), 0U);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
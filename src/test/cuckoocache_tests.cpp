@@ -377,4 +377,41 @@ BOOST_AUTO_TEST_CASE(cuckoocache_generations)
     test_cache_generations<CuckooCache::cache<uint256, SignatureCacheHasher>>();
 }
 
+/* Test that for_each visits exactly the elements which were not erased, and
+ * that a cache can be set up again with them, as done when resizing the
+ * signature cache.
+ */
+BOOST_AUTO_TEST_CASE(cuckoocache_for_each_resize)
+{
+    local_rand_ctx = FastRandomContext(true);
+    CuckooCache::cache<uint256, SignatureCacheHasher> cc{};
+    cc.setup_bytes(1 << 20);
+    std::vector<uint256> hashes(1000);
+    for (uint256& h : hashes) {
+        insecure_GetRandHash(h);
+        cc.insert(h);
+    }
+    for (size_t i = 0; i < hashes.size(); i += 2) {
+        BOOST_CHECK(cc.contains(hashes[i], true));
+    }
+
+    std::vector<uint256> kept;
+    cc.for_each([&](const uint256& h) { kept.push_back(h); });
+    BOOST_CHECK_EQUAL(kept.size(), hashes.size() / 2);
+    for (size_t i = 1; i < hashes.size(); i += 2) {
+        BOOST_CHECK(std::find(kept.begin(), kept.end(), hashes[i]) != kept.end());
+    }
+
+    cc.setup_bytes(2 << 20);
+    for (const uint256& h : hashes) {
+        BOOST_CHECK(!cc.contains(h, false));
+    }
+    for (const uint256& h : kept) {
+        cc.insert(h);
+    }
+    for (const uint256& h : kept) {
+        BOOST_CHECK(cc.contains(h, false));
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END();
@@ -0,0 +1,119 @@
+// Copyright (c) 2021 pacprotocol
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <governance/governance-db.h>
+#include <governance/governance-object.h>
+#include <governance/governance-vote.h>
+
+#include <test/test_dash.h>
+
+#include <map>
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(governance_db_tests, BasicTestingSetup)
+
+static CGovernanceObject MakeObject(int64_t nTime)
+{
+    return CGovernanceObject(uint256(), 1, nTime, InsecureRand256(), "");
+}
+
+static CGovernanceVote MakeVote(const CGovernanceObject& govobj)
+{
+    CGovernanceVote vote(COutPoint(InsecureRand256(), 0), govobj.GetHash(), VOTE_SIGNAL_FUNDING, VOTE_OUTCOME_YES);
+    vote.SetTime(govobj.GetCreationTime() + 1);
+    return vote;
+}
+
+static void AddVotes(std::map<uint256, CGovernanceObject>& mapObjects, const uint256& nHash, int nVotes)
+{
+    CGovernanceObject& govobj = mapObjects.at(nHash);
+    for (int i = 0; i < nVotes; i++) {
+        govobj.LoadVote(MakeVote(govobj));
+    }
+    // ProcessVote flags the object like this
+    govobj.SetDirtyDB(true);
+}
+
+static std::map<uint256, CGovernanceObject> Reload(CGovernanceDB& db, std::vector<unsigned char>& vchState)
+{
+    std::map<uint256, CGovernanceObject> mapLoaded;
+    BOOST_CHECK(db.Load(vchState, mapLoaded));
+    return mapLoaded;
+}
+
+BOOST_AUTO_TEST_CASE(governance_db_roundtrip)
+{
+    CGovernanceDB db(SetDataDir("governance_db"), 1 << 20, true, true);
+    std::vector<unsigned char> vchState{1, 2, 3};
+    std::vector<unsigned char> vchLoadedState;
+
+    std::map<uint256, CGovernanceObject> mapObjects;
+    std::vector<uint256> vecHashes;
+    for (int i = 0; i < 3; i++) {
+        CGovernanceObject govobj = MakeObject(1000 + i);
+        vecHashes.push_back(govobj.GetHash());
+        mapObjects.emplace(govobj.GetHash(), govobj);
+        AddVotes(mapObjects, govobj.GetHash(), i + 1);
+    }
+
+    // Everything is new, so everything is written and comes back on load
+    BOOST_CHECK(db.Flush(vchState, mapObjects, true));
+    for (const auto& p : mapObjects) {
+        BOOST_CHECK(!p.second.IsDirtyDB());
+    }
+    std::map<uint256, CGovernanceObject> mapLoaded = Reload(db, vchLoadedState);
+    BOOST_CHECK(vchLoadedState == vchState);
+    BOOST_CHECK_EQUAL(mapLoaded.size(), 3U);
+    for (int i = 0; i < 3; i++) {
+        const CGovernanceObject& govobj = mapLoaded.at(vecHashes[i]);
+        BOOST_CHECK_EQUAL(govobj.GetVoteFile().GetVoteCount(), i + 1);
+        BOOST_CHECK(!govobj.IsDirtyDB());
+    }
+
+    // Only dirty objects are looked at, changes to a clean one are not written
+    AddVotes(mapObjects, vecHashes[0], 2);
+    mapObjects.at(vecHashes[1]).LoadVote(MakeVote(mapObjects.at(vecHashes[1])));
+    vchState.push_back(4);
+    BOOST_CHECK(db.Flush(vchState, mapObjects, false));
+    BOOST_CHECK(!mapObjects.at(vecHashes[0]).IsDirtyDB());
+    mapLoaded = Reload(db, vchLoadedState);
+    BOOST_CHECK(vchLoadedState == vchState);
+    BOOST_CHECK_EQUAL(mapLoaded.at(vecHashes[0]).GetVoteFile().GetVoteCount(), 3);
+    BOOST_CHECK_EQUAL(mapLoaded.at(vecHashes[1]).GetVoteFile().GetVoteCount(), 2);
+    BOOST_CHECK_EQUAL(mapLoaded.at(vecHashes[2]).GetVoteFile().GetVoteCount(), 3);
+
+    // Loading resets what the database is known to hold, the next flush only
+    // writes the vote of the object flagged dirty now
+    mapObjects.at(vecHashes[1]).SetDirtyDB(true);
+    BOOST_CHECK(db.Flush(vchState, mapObjects, false));
+    mapLoaded = Reload(db, vchLoadedState);
+    BOOST_CHECK_EQUAL(mapLoaded.at(vecHashes[1]).GetVoteFile().GetVoteCount(), 3);
+
+    // Erased objects take their votes with them
+    int64_t nErasedTime = mapObjects.at(vecHashes[2]).GetCreationTime();
+    uint256 nErasedCollateral = mapObjects.at(vecHashes[2]).GetCollateralHash();
+    mapObjects.erase(vecHashes[2]);
+    BOOST_CHECK(db.Flush(vchState, mapObjects, false));
+    mapLoaded = Reload(db, vchLoadedState);
+    BOOST_CHECK_EQUAL(mapLoaded.size(), 2U);
+    BOOST_CHECK(!mapLoaded.count(vecHashes[2]));
+
+    // Bringing the object back without votes doesn't revive the old ones
+    CGovernanceObject revived(uint256(), 1, nErasedTime, nErasedCollateral, "");
+    BOOST_CHECK(revived.GetHash() == vecHashes[2]);
+    mapObjects.emplace(vecHashes[2], revived);
+    BOOST_CHECK(db.Flush(vchState, mapObjects, false));
+    mapLoaded = Reload(db, vchLoadedState);
+    BOOST_CHECK_EQUAL(mapLoaded.size(), 3U);
+    BOOST_CHECK_EQUAL(mapLoaded.at(vecHashes[2]).GetVoteFile().GetVoteCount(), 0);
+
+    // Nothing dirty and the same state, nothing to write
+    BOOST_CHECK(db.Flush(vchState, mapObjects, false));
+    mapLoaded = Reload(db, vchLoadedState);
+    BOOST_CHECK_EQUAL(mapLoaded.size(), 3U);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
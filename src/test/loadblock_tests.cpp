@@ -0,0 +1,119 @@
+// Copyright (c) 2021 pacprotocol
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <chain.h>
+#include <chainparams.h>
+#include <clientversion.h>
+#include <consensus/consensus.h>
+#include <consensus/merkle.h>
+#include <consensus/validation.h>
+#include <pow.h>
+#include <streams.h>
+#include <validation.h>
+
+#include <test/test_dash.h>
+
+#include <limits>
+#include <memory>
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(loadblock_tests, TestChain100Setup)
+
+/** Mine a block on top of parent, which doesn't have to be known to the node */
+static CBlock MineChild(const CBlock& parent, const CBlockIndex* pindexParent)
+{
+    const Consensus::Params& params = Params().GetConsensus();
+    CBlock block(parent);
+    block.hashPrevBlock = parent.GetHash();
+    block.nTime = parent.nTime + 1;
+
+    CMutableTransaction coinbase(*block.vtx[0]);
+    coinbase.vin[0].scriptSig = CScript() << (pindexParent->nHeight + 1) << OP_0;
+    block.vtx[0] = MakeTransactionRef(coinbase);
+    block.hashMerkleRoot = BlockMerkleRoot(block);
+
+    block.nBits = GetNextWorkRequired(pindexParent, &block, params);
+    block.nNonce = 0;
+    while (!CheckProofOfWork(block.GetHash(), block.nBits, params)) ++block.nNonce;
+    return block;
+}
+
+static void WriteRecordHeader(CAutoFile& file, unsigned int nSize)
+{
+    file << Params().MessageStart() << nSize;
+}
+
+BOOST_AUTO_TEST_CASE(loadblock_damaged_out_of_order)
+{
+    CBlockIndex* tip;
+    {
+        LOCK(cs_main);
+        tip = chainActive.Tip();
+    }
+
+    // Three blocks on top of the tip which the node doesn't know yet
+    std::vector<CBlock> blocks{CreateBlock({}, coinbaseKey)};
+    std::vector<uint256> hashes;
+    hashes.reserve(3);
+    hashes.push_back(blocks[0].GetHash());
+    std::vector<std::unique_ptr<CBlockIndex>> indexes;
+    for (int i = 1; i < 3; i++) {
+        indexes.emplace_back(new CBlockIndex(blocks.back()));
+        CBlockIndex& index = *indexes.back();
+        index.phashBlock = &hashes.back();
+        index.pprev = i == 1 ? tip : indexes[i - 2].get();
+        index.nHeight = index.pprev->nHeight + 1;
+        index.BuildSkip();
+        blocks.push_back(MineChild(blocks.back(), &index));
+        hashes.push_back(blocks.back().GetHash());
+    }
+
+    // Written to a block file of their own, the out of order blocks are read back from there
+    const CDiskBlockPos pos(1, 0);
+    {
+        CAutoFile file(fsbridge::fopen(GetBlockPosFilename(pos, "blk"), "wb"), SER_DISK, CLIENT_VERSION);
+        BOOST_REQUIRE(!file.IsNull());
+        file.write("junk", 4);
+
+        // A record larger than any block is skipped
+        WriteRecordHeader(file, MaxBlockSize() + 1);
+
+        // A truncated record, which runs into the next records and doesn't
+        // decode. The scan starts over right after its message start.
+        CDataStream truncated(SER_DISK, CLIENT_VERSION);
+        truncated << static_cast<const CBlockHeader&>(blocks[2]);
+        truncated << (unsigned char)0xff << std::numeric_limits<uint64_t>::max();
+        WriteRecordHeader(file, 200);
+        file.write(truncated.data(), truncated.size());
+
+        // Children ahead of their parents
+        for (int i = 2; i >= 0; i--) {
+            WriteRecordHeader(file, ::GetSerializeSize(blocks[i], SER_DISK, CLIENT_VERSION));
+            file << blocks[i];
+        }
+    }
+
+    CDiskBlockPos dbp(pos);
+    BOOST_CHECK(LoadExternalBlockFile(Params(), fsbridge::fopen(GetBlockPosFilename(pos, "blk"), "rb"), &dbp));
+
+    {
+        LOCK(cs_main);
+        for (const uint256& hash : hashes) {
+            const CBlockIndex* pindex = LookupBlockIndex(hash);
+            BOOST_REQUIRE(pindex);
+            BOOST_CHECK(pindex->nStatus & BLOCK_HAVE_DATA);
+            BOOST_CHECK_EQUAL(pindex->GetBlockPos().nFile, pos.nFile);
+        }
+    }
+
+    CValidationState state;
+    BOOST_CHECK(ActivateBestChain(state, Params()));
+    LOCK(cs_main);
+    BOOST_CHECK(chainActive.Tip()->GetBlockHash() == hashes[2]);
+    BOOST_CHECK_EQUAL(chainActive.Height(), tip->nHeight + 3);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,144 @@
+// Copyright (c) 2021 pacprotocol
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <logging.h>
+#include <tinyformat.h>
+
+#include <test/test_dash.h>
+
+#include <thread>
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(logging_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(logring_push_pop)
+{
+    BCLog::LogRing ring(3);
+    BOOST_CHECK_EQUAL(ring.Capacity(), 3U);
+    BOOST_CHECK_EQUAL(ring.Size(), 0U);
+
+    BCLog::LogRecord record;
+    BOOST_CHECK(!ring.Pop(record));
+
+    for (int i = 0; i < 3; i++) {
+        record.nTimeMicros = i;
+        record.str = strprintf("%d", i);
+        BOOST_CHECK(ring.Push(record));
+    }
+    BOOST_CHECK_EQUAL(ring.Size(), 3U);
+
+    // A full ring leaves the record to the caller
+    record.str = "full";
+    BOOST_CHECK(!ring.Push(record));
+    BOOST_CHECK_EQUAL(record.str, "full");
+
+    // Make room and wrap around
+    BOOST_CHECK(ring.Pop(record));
+    BOOST_CHECK_EQUAL(record.str, "0");
+    record.nTimeMicros = 3;
+    record.str = "3";
+    BOOST_CHECK(ring.Push(record));
+
+    for (int i = 1; i < 4; i++) {
+        BOOST_CHECK(ring.Pop(record));
+        BOOST_CHECK_EQUAL(record.nTimeMicros, i);
+        BOOST_CHECK_EQUAL(record.str, strprintf("%d", i));
+    }
+    BOOST_CHECK(!ring.Pop(record));
+    BOOST_CHECK_EQUAL(ring.Size(), 0U);
+}
+
+BOOST_AUTO_TEST_CASE(logring_threads)
+{
+    const int nRecords = 100000;
+    BCLog::LogRing ring(16);
+
+    std::thread producer([&] {
+        for (int i = 0; i < nRecords; i++) {
+            BCLog::LogRecord record;
+            record.nTimeMicros = i;
+            while (!ring.Push(record)) {
+                std::this_thread::yield();
+            }
+        }
+    });
+
+    // Everything arrives exactly once and in order
+    int nNext = 0;
+    while (nNext < nRecords) {
+        BCLog::LogRecord record;
+        if (ring.Pop(record)) {
+            BOOST_REQUIRE_EQUAL(record.nTimeMicros, nNext);
+            nNext++;
+        } else {
+            std::this_thread::yield();
+        }
+    }
+    producer.join();
+    BOOST_CHECK_EQUAL(ring.Size(), 0U);
+}
+
+static void LogMessages(int nThreads, int nMessages)
+{
+    std::vector<std::thread> threads;
+    for (int t = 0; t < nThreads; t++) {
+        threads.emplace_back([t, nMessages] {
+            for (int i = 0; i < nMessages; i++) {
+                LogPrintf("logging_tests thread %d message %d\n", t, i);
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
+
+BOOST_AUTO_TEST_CASE(async_logging_drop)
+{
+    // Messages only go through the writer thread when they go to debug.log,
+    // which stays unopened here so they are just buffered
+    fPrintToDebugLog = true;
+
+    StartAsyncLogging(4, false);
+    // Starting twice is harmless
+    StartAsyncLogging(4, false);
+    const CAsyncLogStats before = GetAsyncLogStats();
+    LogMessages(4, 1000);
+    StopAsyncLogging();
+    const CAsyncLogStats after = GetAsyncLogStats();
+
+    // Every message is either written or counted as dropped, nothing waits
+    BOOST_CHECK_EQUAL(after.nWritten - before.nWritten + after.nDropped - before.nDropped, 4000U);
+    BOOST_CHECK_EQUAL(after.nBlocked, before.nBlocked);
+
+    // Once stopped messages are written synchronously and stopping twice is harmless
+    LogMessages(1, 10);
+    StopAsyncLogging();
+    const CAsyncLogStats stopped = GetAsyncLogStats();
+    BOOST_CHECK_EQUAL(stopped.nWritten, after.nWritten);
+    BOOST_CHECK_EQUAL(stopped.nDropped, after.nDropped);
+
+    fPrintToDebugLog = false;
+}
+
+BOOST_AUTO_TEST_CASE(async_logging_block)
+{
+    fPrintToDebugLog = true;
+
+    StartAsyncLogging(4, true);
+    const CAsyncLogStats before = GetAsyncLogStats();
+    LogMessages(4, 1000);
+    StopAsyncLogging();
+    const CAsyncLogStats after = GetAsyncLogStats();
+
+    // Full rings make the logging threads wait instead of dropping
+    BOOST_CHECK_EQUAL(after.nDropped, before.nDropped);
+    BOOST_CHECK_EQUAL(after.nWritten - before.nWritten, 4000U);
+
+    fPrintToDebugLog = false;
+}
+
+BOOST_AUTO_TEST_SUITE_END()
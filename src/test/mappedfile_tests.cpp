@@ -0,0 +1,132 @@
+// Copyright (c) 2021 pacprotocol
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <fs.h>
+#include <mappedfile.h>
+
+#include <test/test_dash.h>
+
+#include <memory>
+#include <string>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(mappedfile_tests, BasicTestingSetup)
+
+#ifndef WIN32
+static void AppendToFile(const fs::path& path, const std::string& str)
+{
+    FILE* file = fsbridge::fopen(path, "ab");
+    BOOST_REQUIRE(file);
+    BOOST_REQUIRE_EQUAL(fwrite(str.data(), 1, str.size(), file), str.size());
+    fclose(file);
+}
+
+static std::string MappedString(const std::shared_ptr<const CMappedFile>& file)
+{
+    return std::string((const char*)file->data(), file->size());
+}
+
+BOOST_AUTO_TEST_CASE(mappedfile_cache_remap)
+{
+    const fs::path dir = SetDataDir("mappedfile_cache_remap");
+    const fs::path path = dir / "a.dat";
+    AppendToFile(path, "abcd");
+
+    CMappedFileCache cache;
+    BOOST_CHECK(!cache.IsEnabled());
+    BOOST_CHECK(!cache.Get(path, 0));
+    cache.SetMaxFiles(2);
+    BOOST_CHECK(cache.IsEnabled());
+
+    std::shared_ptr<const CMappedFile> first = cache.Get(path, 4);
+    BOOST_REQUIRE(first);
+    BOOST_CHECK_EQUAL(MappedString(first), "abcd");
+    BOOST_CHECK(cache.Get(path, 2) == first);
+
+    // Appended data is mapped once it is read
+    AppendToFile(path, "efgh");
+    BOOST_CHECK(cache.Get(path, 4) == first);
+    std::shared_ptr<const CMappedFile> second = cache.Get(path, 8);
+    BOOST_REQUIRE(second);
+    BOOST_CHECK(second != first);
+    BOOST_CHECK_EQUAL(MappedString(second), "abcdefgh");
+    BOOST_CHECK(cache.Get(path, 8) == second);
+    // The old mapping stays usable for whoever still holds it
+    BOOST_CHECK_EQUAL(MappedString(first), "abcd");
+
+    // Nothing is returned for data beyond the end of the file
+    BOOST_CHECK(!cache.Get(path, 9));
+    BOOST_CHECK(!cache.Get(dir / "missing.dat", 0));
+    AppendToFile(dir / "empty.dat", "");
+    BOOST_CHECK(!cache.Get(dir / "empty.dat", 0));
+
+    cache.SetMaxFiles(0);
+    BOOST_CHECK(!cache.IsEnabled());
+    BOOST_CHECK(!cache.Get(path, 0));
+}
+
+BOOST_AUTO_TEST_CASE(mappedfile_cache_eviction)
+{
+    const fs::path dir = SetDataDir("mappedfile_cache_eviction");
+    const fs::path a = dir / "a.dat", b = dir / "b.dat", c = dir / "c.dat";
+    AppendToFile(a, "a");
+    AppendToFile(b, "b");
+    AppendToFile(c, "c");
+
+    CMappedFileCache cache;
+    cache.SetMaxFiles(2);
+    std::shared_ptr<const CMappedFile> a1 = cache.Get(a, 1);
+    std::shared_ptr<const CMappedFile> b1 = cache.Get(b, 1);
+    BOOST_REQUIRE(a1 && b1);
+
+    // Reading a makes b the least recently used file, which c evicts
+    BOOST_CHECK(cache.Get(a, 1) == a1);
+    std::shared_ptr<const CMappedFile> c1 = cache.Get(c, 1);
+    BOOST_REQUIRE(c1);
+    BOOST_CHECK(cache.Get(a, 1) == a1);
+    BOOST_CHECK(cache.Get(c, 1) == c1);
+
+    // Mapping b again evicts a
+    std::shared_ptr<const CMappedFile> b2 = cache.Get(b, 1);
+    BOOST_REQUIRE(b2);
+    BOOST_CHECK(b2 != b1);
+    BOOST_CHECK_EQUAL(MappedString(b1), "b");
+
+    // Shrinking the cache keeps the most recently used files
+    cache.SetMaxFiles(1);
+    BOOST_CHECK(cache.Get(b, 1) == b2);
+    BOOST_CHECK(cache.Get(c, 1) != c1);
+    BOOST_CHECK(cache.Get(a, 1) != a1);
+}
+
+BOOST_AUTO_TEST_CASE(mappedfile_cache_erase)
+{
+    const fs::path dir = SetDataDir("mappedfile_cache_erase");
+    const fs::path path = dir / "a.dat";
+    AppendToFile(path, "abcd");
+
+    CMappedFileCache cache;
+    cache.SetMaxFiles(2);
+    std::shared_ptr<const CMappedFile> first = cache.Get(path, 4);
+    BOOST_REQUIRE(first);
+
+    // Erasing a file which isn't mapped does nothing
+    cache.Erase(dir / "missing.dat");
+    BOOST_CHECK(cache.Get(path, 4) == first);
+
+    cache.Erase(path);
+    std::shared_ptr<const CMappedFile> second = cache.Get(path, 4);
+    BOOST_REQUIRE(second);
+    BOOST_CHECK(second != first);
+    BOOST_CHECK_EQUAL(MappedString(first), "abcd");
+
+    // A file removed after it was erased isn't mapped again
+    cache.Erase(path);
+    fs::remove(path);
+    BOOST_CHECK(!cache.Get(path, 0));
+}
+#endif // WIN32
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,169 @@
+// Copyright (c) 2021 pacprotocol
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <chain.h>
+#include <pos/kernel.h>
+#include <test/test_dash.h>
+
+#include <algorithm>
+#include <deque>
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+namespace {
+
+struct TestBlockTree {
+    std::deque<uint256> vHashes;
+    std::deque<CBlockIndex> vIndex;
+
+    const CBlockIndex* Add(const CBlockIndex* pprev, int64_t nTime)
+    {
+        vHashes.push_back(InsecureRand256());
+        vIndex.emplace_back();
+        CBlockIndex& index = vIndex.back();
+        index.phashBlock = &vHashes.back();
+        index.pprev = const_cast<CBlockIndex*>(pprev);
+        index.nHeight = pprev ? pprev->nHeight + 1 : 0;
+        index.nTime = nTime;
+        index.BuildSkip();
+        return &index;
+    }
+
+    // Times wander around the target spacing and often go back, some blocks share a time
+    const CBlockIndex* Extend(const CBlockIndex* pindex, int nBlocks)
+    {
+        for (int i = 0; i < nBlocks; i++) {
+            int64_t nTime = pindex->GetBlockTime();
+            if (!InsecureRandBits(3))
+                pindex = Add(pindex, nTime);
+            else
+                pindex = Add(pindex, nTime + 60 - 600 + (int64_t)InsecureRandRange(1200));
+        }
+        return pindex;
+    }
+};
+
+// The candidate selection ComputeNextStakeModifier did before the window was kept
+void FullWalk(const CBlockIndex* pindexPrev, int64_t nSelectionIntervalStart, std::vector<std::pair<int64_t, uint256>>& vSortedByTimestamp, int& nHeightFirstCandidate)
+{
+    vSortedByTimestamp.clear();
+    const CBlockIndex* pindex = pindexPrev;
+    while (pindex && pindex->GetBlockTime() >= nSelectionIntervalStart) {
+        vSortedByTimestamp.push_back(std::make_pair(pindex->GetBlockTime(), pindex->GetBlockHash()));
+        pindex = pindex->pprev;
+    }
+    nHeightFirstCandidate = pindex ? (pindex->nHeight + 1) : 0;
+    std::reverse(vSortedByTimestamp.begin(), vSortedByTimestamp.end());
+    std::sort(vSortedByTimestamp.begin(), vSortedByTimestamp.end());
+}
+
+void CheckWindow(CStakeModifierWindow& window, const CBlockIndex* pindexPrev, int64_t nSelectionIntervalStart)
+{
+    window.Update(pindexPrev, nSelectionIntervalStart);
+
+    std::vector<std::pair<int64_t, uint256>> vExpected;
+    int nHeightFirst;
+    FullWalk(pindexPrev, nSelectionIntervalStart, vExpected, nHeightFirst);
+
+    BOOST_CHECK_EQUAL(window.GetHeightFirst(), nHeightFirst);
+    const std::vector<StakeModifierCandidate>& vCandidates = window.GetCandidates();
+    BOOST_REQUIRE_EQUAL(vCandidates.size(), vExpected.size());
+    for (size_t i = 0; i < vCandidates.size(); i++) {
+        BOOST_CHECK_EQUAL(vCandidates[i].nTime, vExpected[i].first);
+        BOOST_CHECK(vCandidates[i].pindex->GetBlockHash() == vExpected[i].second);
+    }
+}
+
+} // namespace
+
+BOOST_FIXTURE_TEST_SUITE(pos_kernel_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(stake_modifier_window_boundary)
+{
+    TestBlockTree tree;
+    CStakeModifierWindow window;
+
+    // A block above the boundary older than the start time moves the boundary up to it
+    const CBlockIndex* pindex = nullptr;
+    for (int64_t nTime : {1000, 2000, 3000, 1500, 4000, 5000})
+        pindex = tree.Add(pindex, nTime);
+    CheckWindow(window, pindex, 1600);
+    BOOST_CHECK_EQUAL(window.GetHeightFirst(), 4);
+
+    pindex = tree.Add(pindex, 6000);
+    CheckWindow(window, pindex, 2500);
+    BOOST_CHECK_EQUAL(window.GetHeightFirst(), 4);
+
+    pindex = tree.Add(pindex, 7000);
+    CheckWindow(window, pindex, 4500);
+    BOOST_CHECK_EQUAL(window.GetHeightFirst(), 5);
+
+    // The start time going back pulls older blocks in again
+    CheckWindow(window, pindex, 1200);
+    BOOST_CHECK_EQUAL(window.GetHeightFirst(), 1);
+
+    // Switching to a fork below the window
+    const CBlockIndex* pfork = tree.Add(pindex->GetAncestor(2), 3500);
+    CheckWindow(window, pfork, 2500);
+    BOOST_CHECK_EQUAL(window.GetHeightFirst(), 2);
+
+    // Starting before the genesis block
+    CheckWindow(window, pindex, 0);
+    BOOST_CHECK_EQUAL(window.GetHeightFirst(), 0);
+
+    // A block connected below the time of the one before it becomes the boundary in its place
+    pindex = tree.Add(pindex, 8000);
+    CheckWindow(window, pindex, 2500);
+    pindex = tree.Add(pindex, 3000);
+    CheckWindow(window, pindex, 2500);
+    pindex = tree.Add(pindex, 9000);
+    CheckWindow(window, pindex, 4000);
+    BOOST_CHECK_EQUAL(window.GetHeightFirst(), 10);
+}
+
+BOOST_AUTO_TEST_CASE(stake_modifier_window_matches_full_walk)
+{
+    const int64_t nSelectionInterval = 6000;
+    const int64_t nModifierInterval = 1200;
+
+    TestBlockTree tree;
+    CStakeModifierWindow window;
+
+    const CBlockIndex* pindexTip = tree.Extend(tree.Add(nullptr, 1500000000), 200);
+    std::vector<const CBlockIndex*> vTips{pindexTip};
+    for (int i = 0; i < 3000; i++) {
+        int64_t nSelectionIntervalStart = (pindexTip->GetBlockTime() / nModifierInterval) * nModifierInterval - nSelectionInterval;
+        int nAction = InsecureRandRange(100);
+        if (nAction < 70) {
+            // Connect a few blocks
+            pindexTip = tree.Extend(pindexTip, 1 + InsecureRandRange(3));
+            nSelectionIntervalStart = (pindexTip->GetBlockTime() / nModifierInterval) * nModifierInterval - nSelectionInterval;
+        } else if (nAction < 80) {
+            // Same chain, but the start time moves back
+            nSelectionIntervalStart -= InsecureRandRange(3 * nSelectionInterval);
+        } else if (nAction < 88) {
+            // Reorganize onto a new branch
+            vTips.push_back(pindexTip);
+            const CBlockIndex* pindexFork = pindexTip->GetAncestor(std::max(0, pindexTip->nHeight - 1 - (int)InsecureRandRange(40)));
+            pindexTip = tree.Extend(pindexFork, 1 + InsecureRandRange(50));
+            nSelectionIntervalStart = (pindexTip->GetBlockTime() / nModifierInterval) * nModifierInterval - nSelectionInterval;
+        } else if (nAction < 94) {
+            // Disconnect back to an ancestor
+            pindexTip = pindexTip->GetAncestor(std::max(0, pindexTip->nHeight - 1 - (int)InsecureRandRange(20)));
+            nSelectionIntervalStart = (pindexTip->GetBlockTime() / nModifierInterval) * nModifierInterval - nSelectionInterval;
+        } else {
+            // Switch back to an earlier branch
+            std::swap(pindexTip, vTips[InsecureRandRange(vTips.size())]);
+            nSelectionIntervalStart = (pindexTip->GetBlockTime() / nModifierInterval) * nModifierInterval - nSelectionInterval;
+        }
+        CheckWindow(window, pindexTip, nSelectionIntervalStart);
+    }
+
+    // A cleared window starts over from a full walk
+    window.Clear();
+    CheckWindow(window, pindexTip, pindexTip->GetBlockTime() - nSelectionInterval);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
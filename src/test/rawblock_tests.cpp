@@ -0,0 +1,125 @@
+// Copyright (c) 2021 pacprotocol
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <chain.h>
+#include <chainparams.h>
+#include <clientversion.h>
+#include <streams.h>
+#include <validation.h>
+
+#include <test/test_dash.h>
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+// Tests this internal-to-net_processing.cpp method:
+extern std::shared_ptr<const std::vector<uint8_t>> GetRawBlock(const CBlockIndex* pindex, const CChainParams& chainparams, size_t nMaxSize);
+
+static std::vector<uint8_t> SerializeBlock(const CBlockIndex* pindex)
+{
+    CBlock block;
+    BOOST_REQUIRE(ReadBlockFromDisk(block, pindex, Params().GetConsensus()));
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << block;
+    return std::vector<uint8_t>(ss.begin(), ss.end());
+}
+
+BOOST_FIXTURE_TEST_SUITE(rawblock_tests, TestChain100Setup)
+
+BOOST_AUTO_TEST_CASE(rawblock_read)
+{
+    LOCK(cs_main);
+    const CBlockIndex* pindex = chainActive[50];
+    const std::vector<uint8_t> expected = SerializeBlock(pindex);
+
+    // The stored bytes are the block as it is sent, read with stdio and mapped
+    std::vector<uint8_t> raw;
+    BOOST_CHECK(ReadRawBlockFromDisk(raw, pindex, Params().MessageStart()));
+    BOOST_CHECK(raw == expected);
+    SetMappedBlockFiles(2);
+    raw.clear();
+    BOOST_CHECK(ReadRawBlockFromDisk(raw, pindex, Params().MessageStart()));
+    BOOST_CHECK(raw == expected);
+    SetMappedBlockFiles(0);
+
+    // Another network's magic is refused
+    CMessageHeader::MessageStartChars wrong_start;
+    std::copy(Params().MessageStart(), Params().MessageStart() + CMessageHeader::MESSAGE_START_SIZE, wrong_start);
+    wrong_start[0] ^= 0xff;
+    BOOST_CHECK(!ReadRawBlockFromDisk(raw, pindex, wrong_start));
+
+    // So is another block than the index expects
+    CBlockIndex indexOther(*chainActive[51]);
+    indexOther.nFile = pindex->nFile;
+    indexOther.nDataPos = pindex->nDataPos;
+    BOOST_CHECK(!ReadRawBlockFromDisk(raw, &indexOther, Params().MessageStart()));
+
+    // A damaged transaction leaves the header intact, the merkle root catches it
+    CBlock block;
+    BOOST_REQUIRE(ReadBlockFromDisk(block, pindex, Params().GetConsensus()));
+    CDataStream ssTx(SER_NETWORK, PROTOCOL_VERSION);
+    ssTx << block.vtx[0];
+    const std::vector<uint8_t> tx(ssTx.begin(), ssTx.end());
+    auto itTx = std::search(expected.begin(), expected.end(), tx.begin(), tx.end());
+    BOOST_REQUIRE(itTx != expected.end());
+    // The last byte of the coinbase is part of its lock time or payload, the block still deserializes
+    const long nOffset = pindex->GetBlockPos().nPos + (itTx - expected.begin()) + tx.size() - 1;
+    const uint8_t nDamaged = tx.back() ^ 0x01;
+    FILE* file = OpenBlockFile(pindex->GetBlockPos(), false);
+    BOOST_REQUIRE(file);
+    BOOST_REQUIRE_EQUAL(fseek(file, nOffset, SEEK_SET), 0);
+    BOOST_REQUIRE_EQUAL(fputc(nDamaged, file), nDamaged);
+    fclose(file);
+    BOOST_CHECK(!ReadRawBlockFromDisk(raw, pindex, Params().MessageStart()));
+    SetMappedBlockFiles(2);
+    BOOST_CHECK(!ReadRawBlockFromDisk(raw, pindex, Params().MessageStart()));
+    SetMappedBlockFiles(0);
+}
+
+BOOST_AUTO_TEST_CASE(rawblock_serve_cache)
+{
+    LOCK(cs_main);
+    const CBlockIndex* pindex1 = chainActive[10];
+    const CBlockIndex* pindex2 = chainActive[11];
+    const CBlockIndex* pindex3 = chainActive[12];
+    const CBlockIndex* pindex4 = chainActive[13];
+    const size_t nSize1 = SerializeBlock(pindex1).size();
+    const size_t nSize2 = SerializeBlock(pindex2).size();
+    const size_t nSize3 = SerializeBlock(pindex3).size();
+
+    // Room for the first block and one of the other two
+    const size_t nMaxSize = nSize1 + std::max(nSize2, nSize3);
+    const CChainParams& chainparams = Params();
+
+    std::shared_ptr<const std::vector<uint8_t>> p1 = GetRawBlock(pindex1, chainparams, nMaxSize);
+    std::shared_ptr<const std::vector<uint8_t>> p2 = GetRawBlock(pindex2, chainparams, nMaxSize);
+    BOOST_REQUIRE(p1 && p2);
+    BOOST_CHECK(*p1 == SerializeBlock(pindex1));
+    BOOST_CHECK(*p2 == SerializeBlock(pindex2));
+
+    // Serving the first block again makes the second the least recently served one
+    BOOST_CHECK(GetRawBlock(pindex1, chainparams, nMaxSize) == p1);
+    std::shared_ptr<const std::vector<uint8_t>> p3 = GetRawBlock(pindex3, chainparams, nMaxSize);
+    BOOST_REQUIRE(p3);
+    BOOST_CHECK(GetRawBlock(pindex1, chainparams, nMaxSize) == p1);
+    BOOST_CHECK(GetRawBlock(pindex3, chainparams, nMaxSize) == p3);
+
+    // The evicted block is read again, which in turn evicts the first one
+    std::shared_ptr<const std::vector<uint8_t>> p2Again = GetRawBlock(pindex2, chainparams, nMaxSize);
+    BOOST_REQUIRE(p2Again);
+    BOOST_CHECK(p2Again != p2);
+    BOOST_CHECK(*p2Again == *p2);
+    BOOST_CHECK(GetRawBlock(pindex3, chainparams, nMaxSize) == p3);
+    BOOST_CHECK(GetRawBlock(pindex1, chainparams, nMaxSize) != p1);
+
+    // Blocks larger than the cache are served without being kept
+    std::shared_ptr<const std::vector<uint8_t>> p4 = GetRawBlock(pindex4, chainparams, 0);
+    BOOST_REQUIRE(p4);
+    BOOST_CHECK(GetRawBlock(pindex4, chainparams, 0) != p4);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -4,6 +4,7 @@
 
 #include <random.h>
 #include <scheduler.h>
+#include <utiltime.h>
 
 #include <test/test_dash.h>
 
@@ -11,6 +12,9 @@
 #include <boost/thread.hpp>
 #include <boost/test/unit_test.hpp>
 
+#include <algorithm>
+#include <set>
+
 BOOST_AUTO_TEST_SUITE(scheduler_tests)
 
 static void microTask(CScheduler& s, boost::mutex& mutex, int& counter, int delta, boost::chrono::system_clock::time_point rescheduleTime)
@@ -154,4 +158,76 @@ BOOST_AUTO_TEST_CASE(singlethreadedscheduler_ordered)
     BOOST_CHECK_EQUAL(counter2, 100);
 }
 
+BOOST_AUTO_TEST_CASE(timer_wheel)
+{
+    FastRandomContext rng(42);
+    CTimerWheel<int64_t> wheel;
+    int64_t nNow = 1500000000000;
+    wheel.Advance(nNow);
+
+    // Spread the ticks over all levels and the overflow map
+    std::multiset<int64_t> expected;
+    for (int i = 0; i < 1000; i++) {
+        int64_t nTick = nNow + 1 + rng.randrange(uint64_t{1} << (6 * rng.randrange(5) + 4));
+        wheel.Insert(nTick, nTick);
+        expected.insert(nTick);
+    }
+    BOOST_CHECK_EQUAL(wheel.size(), 1000U);
+
+    std::vector<int64_t> popped;
+    while (!wheel.empty()) {
+        int64_t nNextTick = wheel.NextTick();
+        BOOST_CHECK(nNextTick >= nNow);
+        // Sometimes stop short of the next slot
+        nNow = rng.randbool() ? nNextTick : nNow + rng.randrange(nNextTick - nNow + 1);
+        wheel.Advance(nNow);
+        while (wheel.HasReady()) {
+            int64_t nTick = wheel.PopReady();
+            BOOST_CHECK(nTick <= nNow);
+            popped.push_back(nTick);
+        }
+    }
+    BOOST_CHECK(std::is_sorted(popped.begin(), popped.end()));
+    BOOST_CHECK(std::vector<int64_t>(expected.begin(), expected.end()) == popped);
+
+    // Anything due already is ready right away
+    wheel.Insert(nNow - 10, nNow - 10);
+    BOOST_CHECK(wheel.HasReady());
+    BOOST_CHECK_EQUAL(wheel.NextTick(), nNow);
+}
+
+BOOST_AUTO_TEST_CASE(priority_lanes)
+{
+    CScheduler scheduler;
+
+    // One thread for the validation lane only, one for everything
+    boost::thread_group threads;
+    threads.create_thread(boost::bind(&CScheduler::serviceQueueUpTo, &scheduler, CScheduler::LANE_VALIDATION));
+    threads.create_thread(boost::bind(&CScheduler::serviceQueue, &scheduler));
+
+    // A maintenance task which only finishes once the validation task ran
+    boost::mutex mutex;
+    boost::condition_variable cond;
+    bool fValidationDone = false;
+    bool fMaintenanceWaited = false;
+    scheduler.schedule([&] {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        fMaintenanceWaited = cond.wait_for(lock, boost::chrono::seconds(10), [&] { return fValidationDone; });
+    }, boost::chrono::system_clock::now(), CScheduler::LANE_MAINTENANCE, "maintenance");
+    MilliSleep(10);
+    scheduler.schedule([&] {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        fValidationDone = true;
+        cond.notify_all();
+    }, boost::chrono::system_clock::now(), CScheduler::LANE_VALIDATION, "validation");
+
+    scheduler.stop(true);
+    threads.join_all();
+
+    BOOST_CHECK(fMaintenanceWaited);
+    std::map<std::string, CScheduler::TaskStats> stats = scheduler.GetTaskStats();
+    BOOST_CHECK_EQUAL(stats["maintenance"].nRuns, 1U);
+    BOOST_CHECK_EQUAL(stats["validation"].nRuns, 1U);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
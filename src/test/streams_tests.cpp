@@ -2,6 +2,7 @@
 // Distributed under the MIT software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#include <clientversion.h>
 #include <streams.h>
 #include <support/allocators/zeroafterfree.h>
 #include <test/test_dash.h>
@@ -113,6 +114,44 @@ BOOST_AUTO_TEST_CASE(streams_vector_reader)
     BOOST_CHECK_THROW(reader >> d, std::ios_base::failure);
 }
 
+BOOST_AUTO_TEST_CASE(streams_span_reader)
+{
+    const std::vector<unsigned char> vch = {1, 255, 3, 4, 5, 6, 7};
+
+    // Only the bytes of the span are readable, not the ones following it
+    SpanReader reader(SER_DISK, CLIENT_VERSION, Span<const unsigned char>(vch.data(), 6));
+    BOOST_CHECK_EQUAL(reader.size(), 6);
+    BOOST_CHECK(!reader.empty());
+
+    unsigned char a;
+    reader >> a;
+    BOOST_CHECK_EQUAL(a, 1);
+    BOOST_CHECK_EQUAL(reader.size(), 5);
+
+    reader.ignore(1);
+    BOOST_CHECK_EQUAL(reader.size(), 4);
+    BOOST_CHECK_THROW(reader.ignore(5), std::ios_base::failure);
+    BOOST_CHECK_EQUAL(reader.size(), 4);
+
+    // A failed read consumes nothing
+    uint64_t b;
+    BOOST_CHECK_THROW(reader >> b, std::ios_base::failure);
+    BOOST_CHECK_EQUAL(reader.size(), 4);
+
+    unsigned int c;
+    reader >> c;
+    BOOST_CHECK_EQUAL(c, 100992003); // 3,4,5,6 in little-endian base-256
+    BOOST_CHECK(reader.empty());
+    BOOST_CHECK_THROW(reader >> a, std::ios_base::failure);
+
+    // Reading nothing from an empty span is fine
+    SpanReader empty(SER_DISK, CLIENT_VERSION, Span<const unsigned char>(vch.data(), 0));
+    BOOST_CHECK(empty.empty());
+    empty.read(nullptr, 0);
+    empty.ignore(0);
+    BOOST_CHECK_THROW(empty >> a, std::ios_base::failure);
+}
+
 BOOST_AUTO_TEST_CASE(bitstream_reader_writer)
 {
     CDataStream data(SER_NETWORK, INIT_PROTO_VERSION);
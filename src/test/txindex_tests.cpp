@@ -0,0 +1,145 @@
+// Copyright (c) 2021 pacprotocol
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <chain.h>
+#include <chainparams.h>
+#include <serialize.h>
+#include <txdb.h>
+#include <validation.h>
+
+#include <test/test_dash.h>
+
+#include <map>
+#include <utility>
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(txindex_tests, TestChain100Setup)
+
+/** A tx index entry as written before the block height was stored */
+struct OldDiskTxPos : public CDiskBlockPos
+{
+    unsigned int nTxOffset;
+
+    explicit OldDiskTxPos(const CDiskTxPos& pos) : CDiskBlockPos(pos.nFile, pos.nPos), nTxOffset(pos.nTxOffset) {}
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITEAS(CDiskBlockPos, *this);
+        READWRITE(VARINT(nTxOffset));
+    }
+};
+
+static const char DB_TXINDEX = 't';
+
+BOOST_AUTO_TEST_CASE(txindex_find_txs)
+{
+    CBlockTreeDB db(1 << 20, true);
+
+    // Index the transactions of a few blocks like WriteTxIndexDataForBlock does
+    std::vector<std::pair<uint256, CDiskTxPos>> vEntries;
+    std::map<uint256, uint256> mapBlockHashes;
+    for (int nHeight = 1; nHeight <= 5; nHeight++) {
+        const CBlockIndex* pindex;
+        {
+            LOCK(cs_main);
+            pindex = chainActive[nHeight];
+        }
+        CBlock block;
+        BOOST_REQUIRE(ReadBlockFromDisk(block, pindex, Params().GetConsensus()));
+        CDiskTxPos pos(pindex->GetBlockPos(), GetSizeOfCompactSize(block.vtx.size()), pindex->nHeight);
+        for (const CTransactionRef& tx : block.vtx) {
+            vEntries.emplace_back(tx->GetHash(), pos);
+            mapBlockHashes.emplace(tx->GetHash(), pindex->GetBlockHash());
+            pos.nTxOffset += ::GetSerializeSize(*tx, SER_DISK, CLIENT_VERSION);
+        }
+    }
+    BOOST_REQUIRE(vEntries.size() >= 5);
+    BOOST_REQUIRE(db.WriteTxIndex(vEntries));
+
+    CDiskTxPos pos;
+    BOOST_REQUIRE(db.ReadTxPos(vEntries[0].first, pos));
+    BOOST_CHECK_EQUAL(pos.nHeight, 1);
+
+    // Entries written before the height was stored are still read, the
+    // block hash comes from the block header then
+    BOOST_REQUIRE(db.Write(std::make_pair(DB_TXINDEX, vEntries[1].first), OldDiskTxPos(vEntries[1].second)));
+    BOOST_REQUIRE(db.ReadTxPos(vEntries[1].first, pos));
+    BOOST_CHECK_EQUAL(pos.nHeight, -1);
+    BOOST_CHECK(pos.nFile == vEntries[1].second.nFile && pos.nPos == vEntries[1].second.nPos);
+    BOOST_CHECK_EQUAL(pos.nTxOffset, vEntries[1].second.nTxOffset);
+
+    // So does an entry whose height doesn't lead to the block it points to
+    CDiskTxPos posWrongHeight(vEntries[2].second);
+    posWrongHeight.nHeight = 50;
+    BOOST_REQUIRE(db.WriteTxIndex({{vEntries[2].first, posWrongHeight}}));
+
+    // Look up everything in reverse order, plus a transaction which isn't indexed
+    std::vector<uint256> vQuery;
+    for (auto it = vEntries.rbegin(); it != vEntries.rend(); ++it) {
+        vQuery.push_back(it->first);
+    }
+    vQuery.insert(vQuery.begin() + 2, InsecureRand256());
+
+    // The second time everything comes from the cache
+    for (int i = 0; i < 2; i++) {
+        std::vector<uint256> vBlockHashes;
+        std::vector<CTransactionRef> vTxs;
+        BOOST_CHECK_EQUAL(db.FindTxs(vQuery, vBlockHashes, vTxs), vEntries.size());
+        BOOST_REQUIRE_EQUAL(vTxs.size(), vQuery.size());
+        BOOST_REQUIRE_EQUAL(vBlockHashes.size(), vQuery.size());
+        for (size_t j = 0; j < vQuery.size(); j++) {
+            auto it = mapBlockHashes.find(vQuery[j]);
+            if (it == mapBlockHashes.end()) {
+                BOOST_CHECK(!vTxs[j]);
+                BOOST_CHECK(vBlockHashes[j].IsNull());
+                continue;
+            }
+            BOOST_REQUIRE(vTxs[j]);
+            BOOST_CHECK(vTxs[j]->GetHash() == vQuery[j]);
+            BOOST_CHECK(vBlockHashes[j] == it->second);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(txindex_cache_invalidation)
+{
+    CBlockTreeDB db(1 << 20, true);
+
+    std::vector<std::pair<uint256, CDiskTxPos>> vEntries;
+    for (int nHeight = 1; nHeight <= 2; nHeight++) {
+        const CBlockIndex* pindex;
+        {
+            LOCK(cs_main);
+            pindex = chainActive[nHeight];
+        }
+        CBlock block;
+        BOOST_REQUIRE(ReadBlockFromDisk(block, pindex, Params().GetConsensus()));
+        vEntries.emplace_back(block.vtx[0]->GetHash(), CDiskTxPos(pindex->GetBlockPos(), GetSizeOfCompactSize(block.vtx.size()), pindex->nHeight));
+    }
+    BOOST_REQUIRE(db.WriteTxIndex(vEntries));
+
+    uint256 hashBlock;
+    CTransactionRef tx;
+    BOOST_REQUIRE(db.FindTx(vEntries[0].first, hashBlock, tx));
+    BOOST_CHECK(tx->GetHash() == vEntries[0].first);
+
+    // Rewriting the entry drops the cached transaction. The entry points to
+    // another transaction now, so it isn't found anymore.
+    BOOST_REQUIRE(db.WriteTxIndex({{vEntries[0].first, vEntries[1].second}}));
+    BOOST_CHECK(!db.FindTx(vEntries[0].first, hashBlock, tx));
+
+    BOOST_REQUIRE(db.WriteTxIndex({vEntries[0]}));
+    BOOST_REQUIRE(db.FindTx(vEntries[0].first, hashBlock, tx));
+    BOOST_CHECK(tx->GetHash() == vEntries[0].first);
+    {
+        LOCK(cs_main);
+        BOOST_CHECK(hashBlock == chainActive[1]->GetBlockHash());
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
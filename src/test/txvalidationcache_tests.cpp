@@ -2,6 +2,7 @@
 // Distributed under the MIT software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#include <clientversion.h>
 #include <consensus/validation.h>
 #include <key.h>
 #include <validation.h>
@@ -307,4 +308,35 @@ BOOST_FIXTURE_TEST_CASE(checkinputs_test, TestChain100Setup)
     // TODO: add tests for remaining script flags
 }
 
+static void WriteScriptCachesHeader(uint64_t version, int nClientVersion, const std::string& strClientBuild)
+{
+    CAutoFile file(fsbridge::fopen(GetDataDir() / "sigcache.dat", "wb"), SER_DISK, CLIENT_VERSION);
+    BOOST_REQUIRE(!file.IsNull());
+    file << version << nClientVersion << strClientBuild;
+}
+
+BOOST_FIXTURE_TEST_CASE(script_caches_persist, TestingSetup)
+{
+    BOOST_CHECK(DumpScriptCaches());
+    BOOST_CHECK(LoadScriptCaches());
+
+    uint64_t version;
+    {
+        CAutoFile file(fsbridge::fopen(GetDataDir() / "sigcache.dat", "rb"), SER_DISK, CLIENT_VERSION);
+        BOOST_REQUIRE(!file.IsNull());
+        file >> version;
+    }
+
+    // Entries written by any other build are discarded
+    WriteScriptCachesHeader(version, CLIENT_VERSION + 1, CLIENT_BUILD);
+    BOOST_CHECK(!LoadScriptCaches());
+    WriteScriptCachesHeader(version, CLIENT_VERSION, CLIENT_BUILD + "-other");
+    BOOST_CHECK(!LoadScriptCaches());
+    WriteScriptCachesHeader(version + 1, CLIENT_VERSION, CLIENT_BUILD);
+    BOOST_CHECK(!LoadScriptCaches());
+
+    fs::remove(GetDataDir() / "sigcache.dat");
+    BOOST_CHECK(!LoadScriptCaches());
+}
+
 BOOST_AUTO_TEST_SUITE_END()
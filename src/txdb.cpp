@@ -8,6 +8,7 @@
 #include <chainparams.h>
 #include <hash.h>
 #include <init.h>
+#include <memusage.h>
 #include <random.h>
 #include <pow.h>
 #include <uint256.h>
@@ -17,6 +18,11 @@
 
 #include <stdint.h>
 
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <tuple>
+
 #include <boost/thread.hpp>
 
 static const char DB_COIN = 'C';
@@ -63,11 +69,36 @@ CCoinsViewDB::CCoinsViewDB(size_t nCacheSize, bool fMemory, bool fWipe) : db(Get
 {
 }
 
+CCoinsViewDB::~CCoinsViewDB()
+{
+    WaitForPendingWrite();
+}
+
+std::shared_ptr<CCoinsMap> CCoinsViewDB::GetPendingCoins() const {
+    LOCK(cs_pending);
+    return pendingCoins;
+}
+
 bool CCoinsViewDB::GetCoin(const COutPoint &outpoint, Coin &coin) const {
+    std::shared_ptr<CCoinsMap> pending = GetPendingCoins();
+    if (pending) {
+        CCoinsMap::const_iterator it = pending->find(outpoint);
+        if (it != pending->end()) {
+            coin = it->second.coin;
+            return !coin.IsSpent();
+        }
+    }
     return db.Read(CoinEntry(&outpoint), coin);
 }
 
 bool CCoinsViewDB::HaveCoin(const COutPoint &outpoint) const {
+    std::shared_ptr<CCoinsMap> pending = GetPendingCoins();
+    if (pending) {
+        CCoinsMap::const_iterator it = pending->find(outpoint);
+        if (it != pending->end()) {
+            return !it->second.coin.IsSpent();
+        }
+    }
     return db.Exists(CoinEntry(&outpoint));
 }
 
@@ -86,14 +117,7 @@ std::vector<uint256> CCoinsViewDB::GetHeadBlocks() const {
     return vhashHeadBlocks;
 }
 
-bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) {
-    CDBBatch batch(db);
-    size_t count = 0;
-    size_t changed = 0;
-    size_t batch_size = (size_t)gArgs.GetArg("-dbbatchsize", nDefaultDbBatchSize);
-    int crash_simulate = gArgs.GetArg("-dbcrashratio", 0);
-    assert(!hashBlock.IsNull());
-
+void CCoinsViewDB::BeginHeadTransition(CDBBatch& batch, const uint256& hashBlock) {
     uint256 old_tip = GetBestBlock();
     if (old_tip.IsNull()) {
         // We may be in the middle of replaying.
@@ -110,6 +134,23 @@ bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) {
     // interrupting after partial writes from multiple independent reorgs.
     batch.Erase(DB_BEST_BLOCK);
     batch.Write(DB_HEAD_BLOCKS, std::vector<uint256>{hashBlock, old_tip});
+}
+
+bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock, bool erase) {
+    if (!WaitForPendingWrite())
+        return false;
+    return WriteCoins(mapCoins, hashBlock, erase);
+}
+
+bool CCoinsViewDB::WriteCoins(CCoinsMap &mapCoins, const uint256 &hashBlock, bool erase) {
+    CDBBatch batch(db);
+    size_t count = 0;
+    size_t changed = 0;
+    size_t batch_size = (size_t)gArgs.GetArg("-dbbatchsize", nDefaultDbBatchSize);
+    int crash_simulate = gArgs.GetArg("-dbcrashratio", 0);
+    assert(!hashBlock.IsNull());
+
+    BeginHeadTransition(batch, hashBlock);
 
     for (CCoinsMap::iterator it = mapCoins.begin(); it != mapCoins.end();) {
         if (it->second.flags & CCoinsCacheEntry::DIRTY) {
@@ -121,8 +162,11 @@ bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) {
             changed++;
         }
         count++;
-        CCoinsMap::iterator itOld = it++;
-        mapCoins.erase(itOld);
+        if (erase) {
+            it = mapCoins.erase(it);
+        } else {
+            ++it;
+        }
         if (batch.SizeEstimate() > batch_size) {
             LogPrint(BCLog::COINDB, "Writing partial batch of %.2f MiB\n", batch.SizeEstimate() * (1.0 / 1048576.0));
             db.WriteBatch(batch);
@@ -147,6 +191,71 @@ bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) {
     return ret;
 }
 
+bool CCoinsViewDB::BatchWriteInBackground(CCoinsMap&& mapCoins, const uint256& hashBlock) {
+    if (!WaitForPendingWrite())
+        return false;
+
+    // The head blocks are on disk before this returns, so if the node stops
+    // before the coins are written, ReplayBlocks rolls the chainstate forward
+    // to hashBlock as it does for any interrupted flush.
+    CDBBatch batch(db);
+    BeginHeadTransition(batch, hashBlock);
+    if (!db.WriteBatch(batch, true))
+        return false;
+
+    std::shared_ptr<CCoinsMap> pending = std::make_shared<CCoinsMap>(std::move(mapCoins));
+    size_t nUsage = memusage::DynamicUsage(*pending);
+    for (const auto& entry : *pending) {
+        nUsage += entry.second.coin.DynamicMemoryUsage();
+    }
+    {
+        LOCK(cs_pending);
+        pendingCoins = pending;
+    }
+    hashPendingBlock = hashBlock;
+    nPendingUsage = nUsage;
+    pendingWriter = std::thread([this, pending, hashBlock] {
+        RenameThread("dash-coinsflush");
+        int64_t nStart = GetTimeMicros();
+        try {
+            if (!WriteCoins(*pending, hashBlock, false))
+                fPendingWriteFailed = true;
+        } catch (const std::exception& e) {
+            LogPrintf("CCoinsViewDB::BatchWriteInBackground: %s\n", e.what());
+            fPendingWriteFailed = true;
+        }
+        LogPrint(BCLog::COINDB, "Background coins write took %.2fms\n", (GetTimeMicros() - nStart) * 0.001);
+        // On failure the coins stay readable until WaitForPendingWrite has retried them
+        if (!fPendingWriteFailed) {
+            LOCK(cs_pending);
+            pendingCoins.reset();
+            nPendingUsage = 0;
+        }
+    });
+    return true;
+}
+
+bool CCoinsViewDB::WaitForPendingWrite() {
+    if (pendingWriter.joinable())
+        pendingWriter.join();
+    if (!fPendingWriteFailed)
+        return true;
+
+    std::shared_ptr<CCoinsMap> pending = GetPendingCoins();
+    try {
+        if (!WriteCoins(*pending, hashPendingBlock, false))
+            return false;
+    } catch (const std::exception& e) {
+        LogPrintf("CCoinsViewDB::WaitForPendingWrite: %s\n", e.what());
+        return false;
+    }
+    fPendingWriteFailed = false;
+    LOCK(cs_pending);
+    pendingCoins.reset();
+    nPendingUsage = 0;
+    return true;
+}
+
 size_t CCoinsViewDB::EstimateSize() const
 {
     return db.EstimateSize(DB_COIN, (char)(DB_COIN+1));
@@ -267,6 +376,14 @@ bool CBlockTreeDB::WriteTxIndex(const std::vector<std::pair<uint256, CDiskTxPos>
     for (std::vector<std::pair<uint256,CDiskTxPos> >::const_iterator it=vect.begin(); it!=vect.end(); it++)
         batch.Write(std::make_pair(DB_TXINDEX, it->first), it->second);
     bool ret = WriteBatch(batch);
+    {
+        // The entries may point to another block now, e.g. after a reorg
+        LOCK(cs_txCache);
+        for (auto& p : vect) {
+            txCache.erase(p.first);
+        }
+        nTxCacheGeneration++;
+    }
     LOCK(cs);
     for (auto& p : vect) {
         mapHasTxIndexCache.insert_or_update(std::make_pair(p.first, true));
@@ -303,19 +420,34 @@ bool CBlockTreeDB::UpdateAddressUnspentIndex(const std::vector<std::pair<CAddres
 }
 
 bool CBlockTreeDB::ReadAddressUnspentIndex(uint160 addressHash, int type,
-                                           std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &unspentOutputs) {
+                                           std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &unspentOutputs,
+                                           const CAddressUnspentKey* pAfter, size_t nLimit) {
 
     std::unique_ptr<CDBIterator> pcursor(NewIterator());
 
-    pcursor->Seek(std::make_pair(DB_ADDRESSUNSPENTINDEX, CAddressIndexIteratorKey(type, addressHash)));
+    if (pAfter) {
+        pcursor->Seek(std::make_pair(DB_ADDRESSUNSPENTINDEX, *pAfter));
+    } else {
+        pcursor->Seek(std::make_pair(DB_ADDRESSUNSPENTINDEX, CAddressIndexIteratorKey(type, addressHash)));
+    }
 
+    size_t nCount = 0;
     while (pcursor->Valid()) {
         boost::this_thread::interruption_point();
         std::pair<char,CAddressUnspentKey> key;
         if (pcursor->GetKey(key) && key.first == DB_ADDRESSUNSPENTINDEX && key.second.hashBytes == addressHash) {
+            if (pAfter && key.second.txhash == pAfter->txhash && key.second.index == pAfter->index) {
+                // resume key itself was returned by the previous page
+                pcursor->Next();
+                continue;
+            }
+            if (nLimit > 0 && nCount >= nLimit) {
+                break;
+            }
             CAddressUnspentValue nValue;
             if (pcursor->GetValue(nValue)) {
                 unspentOutputs.push_back(std::make_pair(key.second, nValue));
+                nCount++;
                 pcursor->Next();
             } else {
                 return error("failed to get address unspent value");
@@ -344,16 +476,20 @@ bool CBlockTreeDB::EraseAddressIndex(const std::vector<std::pair<CAddressIndexKe
 
 bool CBlockTreeDB::ReadAddressIndex(uint160 addressHash, int type,
                                     std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex,
-                                    int start, int end) {
+                                    int start, int end,
+                                    const CAddressIndexKey* pAfter, size_t nLimit) {
 
     std::unique_ptr<CDBIterator> pcursor(NewIterator());
 
-    if (start > 0 && end > 0) {
+    if (pAfter) {
+        pcursor->Seek(std::make_pair(DB_ADDRESSINDEX, *pAfter));
+    } else if (start > 0 && end > 0) {
         pcursor->Seek(std::make_pair(DB_ADDRESSINDEX, CAddressIndexIteratorHeightKey(type, addressHash, start)));
     } else {
         pcursor->Seek(std::make_pair(DB_ADDRESSINDEX, CAddressIndexIteratorKey(type, addressHash)));
     }
 
+    size_t nCount = 0;
     while (pcursor->Valid()) {
         boost::this_thread::interruption_point();
         std::pair<char,CAddressIndexKey> key;
@@ -361,9 +497,20 @@ bool CBlockTreeDB::ReadAddressIndex(uint160 addressHash, int type,
             if (end > 0 && key.second.blockHeight > end) {
                 break;
             }
+            if (pAfter && key.second.blockHeight == pAfter->blockHeight && key.second.txindex == pAfter->txindex &&
+                key.second.txhash == pAfter->txhash && key.second.index == pAfter->index &&
+                key.second.spending == pAfter->spending) {
+                // resume key itself was returned by the previous page
+                pcursor->Next();
+                continue;
+            }
+            if (nLimit > 0 && nCount >= nLimit) {
+                break;
+            }
             CAmount nValue;
             if (pcursor->GetValue(nValue)) {
                 addressIndex.push_back(std::make_pair(key.second, nValue));
+                nCount++;
                 pcursor->Next();
             } else {
                 return error("failed to get address index value");
@@ -421,77 +568,178 @@ bool CBlockTreeDB::ReadTxPos(const uint256 &txid, CDiskTxPos& pos) const
 
 bool CBlockTreeDB::FindTx(const uint256& tx_hash, uint256& block_hash, CTransactionRef& tx) const
 {
-    CDiskTxPos postx;
-    if (!ReadTxPos(tx_hash, postx)) {
+    std::vector<uint256> block_hashes;
+    std::vector<CTransactionRef> txs;
+    if (FindTxs({tx_hash}, block_hashes, txs) == 0) {
         return false;
     }
+    block_hash = block_hashes[0];
+    tx = txs[0];
+    return true;
+}
+
+size_t CBlockTreeDB::FindTxs(const std::vector<uint256>& tx_hashes, std::vector<uint256>& block_hashes, std::vector<CTransactionRef>& txs) const
+{
+    block_hashes.assign(tx_hashes.size(), uint256());
+    txs.assign(tx_hashes.size(), nullptr);
 
-    CAutoFile file(OpenBlockFile(postx, true), SER_DISK, CLIENT_VERSION);
-    if (file.IsNull()) {
-        return error("%s: OpenBlockFile failed", __func__);
+    size_t nFound = 0;
+    std::vector<size_t> vMissing;
+    uint64_t nGeneration;
+    {
+        LOCK(cs_txCache);
+        nGeneration = nTxCacheGeneration;
+        std::pair<uint256, CTransactionRef> entry;
+        for (size_t i = 0; i < tx_hashes.size(); i++) {
+            if (txCache.get(tx_hashes[i], entry)) {
+                block_hashes[i] = entry.first;
+                txs[i] = entry.second;
+                nFound++;
+            } else {
+                vMissing.push_back(i);
+            }
+        }
     }
-    CBlockHeader header;
-    try {
-        file >> header;
-        if (fseek(file.Get(), postx.nTxOffset, SEEK_CUR)) {
-            return error("%s: fseek(...) failed", __func__);
+    if (vMissing.empty()) {
+        return nFound;
+    }
+
+    // Look up the positions in key order, then read the transactions in the
+    // order they are stored, so each block file is read front to back
+    std::sort(vMissing.begin(), vMissing.end(), [&](size_t a, size_t b) { return tx_hashes[a] < tx_hashes[b]; });
+    std::vector<std::pair<CDiskTxPos, size_t>> vPos;
+    vPos.reserve(vMissing.size());
+    for (size_t i : vMissing) {
+        CDiskTxPos postx;
+        if (ReadTxPos(tx_hashes[i], postx)) {
+            vPos.emplace_back(postx, i);
         }
-        file >> tx;
-    } catch (const std::exception& e) {
-        return error("%s: Deserialize or I/O error - %s", __func__, e.what());
     }
-    if (tx->GetHash() != tx_hash) {
-        return error("%s: txid mismatch", __func__);
+    std::sort(vPos.begin(), vPos.end(), [](const std::pair<CDiskTxPos, size_t>& a, const std::pair<CDiskTxPos, size_t>& b) {
+        return std::tie(a.first.nFile, a.first.nPos, a.first.nTxOffset) < std::tie(b.first.nFile, b.first.nPos, b.first.nTxOffset);
+    });
+
+    std::vector<CDiskTxPos> positions;
+    positions.reserve(vPos.size());
+    for (const auto& p : vPos) {
+        positions.push_back(p.first);
     }
-    block_hash = header.GetHash();
-    return true;
+    std::vector<CTransactionRef> vRead;
+    std::vector<uint256> vBlockHashes;
+    ReadTxsFromDisk(positions, vRead, vBlockHashes);
+
+    LOCK(cs_txCache);
+    // The positions may be outdated if the index was written in the meantime
+    const bool fCache = nGeneration == nTxCacheGeneration;
+    for (size_t j = 0; j < vPos.size(); j++) {
+        const size_t i = vPos[j].second;
+        if (!vRead[j]) {
+            continue;
+        }
+        if (vRead[j]->GetHash() != tx_hashes[i]) {
+            error("%s: txid mismatch for %s", __func__, tx_hashes[i].ToString());
+            continue;
+        }
+        block_hashes[i] = vBlockHashes[j];
+        txs[i] = vRead[j];
+        if (fCache) {
+            txCache.insert(tx_hashes[i], std::make_pair(block_hashes[i], txs[i]));
+        }
+        nFound++;
+    }
+    return nFound;
 }
 
-bool CBlockTreeDB::LoadBlockIndexGuts(const Consensus::Params& consensusParams, std::function<CBlockIndex*(const uint256&)> insertBlockIndex)
+bool CBlockTreeDB::LoadBlockIndexGuts(const Consensus::Params& consensusParams, std::function<CBlockIndex*(const uint256&)> insertBlockIndex,
+                                      std::function<void(size_t)> reserveBlockIndex)
 {
-    std::unique_ptr<CDBIterator> pcursor(NewIterator());
+    int64_t nStart = GetTimeMillis();
 
-    pcursor->Seek(std::make_pair(DB_BLOCK_INDEX, uint256()));
-
-    // Load mapBlockIndex
-    while (pcursor->Valid()) {
-        boost::this_thread::interruption_point();
-        std::pair<char, uint256> key;
-        if (pcursor->GetKey(key) && key.first == DB_BLOCK_INDEX) {
-            CDiskBlockIndex diskindex;
-            if (pcursor->GetValue(diskindex)) {
-                // Construct block index object
-                CBlockIndex* pindexNew = insertBlockIndex(diskindex.GetBlockHash());
-                pindexNew->pprev          = insertBlockIndex(diskindex.hashPrev);
-                pindexNew->nHeight        = diskindex.nHeight;
-                pindexNew->nFile          = diskindex.nFile;
-                pindexNew->nDataPos       = diskindex.nDataPos;
-                pindexNew->nUndoPos       = diskindex.nUndoPos;
-                pindexNew->nVersion       = diskindex.nVersion;
-                pindexNew->hashMerkleRoot = diskindex.hashMerkleRoot;
-                pindexNew->nTime          = diskindex.nTime;
-                pindexNew->nBits          = diskindex.nBits;
-                pindexNew->nNonce         = diskindex.nNonce;
-                pindexNew->nStatus        = diskindex.nStatus;
-                pindexNew->nTx            = diskindex.nTx;
-
-                //Proof Of Stake
-                pindexNew->nMint            = diskindex.nMint;
-                pindexNew->nMoneySupply     = diskindex.nMoneySupply;
-                pindexNew->nFlags           = diskindex.nFlags;
-                pindexNew->nStakeModifier   = diskindex.nStakeModifier;
-                pindexNew->prevoutStake     = diskindex.prevoutStake;
-                pindexNew->nStakeTime       = diskindex.nStakeTime;
-                pindexNew->hashProofOfStake = diskindex.hashProofOfStake;
+    // Read the raw entries first, LevelDB iteration is sequential anyway
+    std::vector<CDataStream> vEntries;
+    {
+        std::unique_ptr<CDBIterator> pcursor(NewIterator());
+        pcursor->Seek(std::make_pair(DB_BLOCK_INDEX, uint256()));
+        while (pcursor->Valid()) {
+            boost::this_thread::interruption_point();
+            std::pair<char, uint256> key;
+            if (!pcursor->GetKey(key) || key.first != DB_BLOCK_INDEX) {
+                break;
+            }
+            vEntries.emplace_back(pcursor->GetValue());
+            pcursor->Next();
+        }
+    }
 
-                pcursor->Next();
-            } else {
-                return error("%s: failed to read value", __func__);
+    // Decode them in chunks, one per thread
+    std::vector<CDiskBlockIndex> vDiskIndex(vEntries.size());
+    std::atomic<bool> fFailed{false};
+    auto decode = [&vEntries, &vDiskIndex, &fFailed](size_t nBegin, size_t nEnd) {
+        for (size_t i = nBegin; i < nEnd && !fFailed; i++) {
+            try {
+                vEntries[i] >> vDiskIndex[i];
+            } catch (const std::exception&) {
+                fFailed = true;
             }
-        } else {
-            break;
         }
+    };
+
+    const int nThreads = std::max(1, std::min(GetNumCores(), MAX_BLOCK_INDEX_LOAD_THREADS));
+    const size_t nPerThread = (vEntries.size() + nThreads - 1) / nThreads;
+    std::vector<std::thread> vThreads;
+    for (int i = 1; i < nThreads && i * nPerThread < vEntries.size(); i++) {
+        vThreads.emplace_back(decode, i * nPerThread, std::min(vEntries.size(), (i + 1) * nPerThread));
+    }
+    decode(0, std::min(vEntries.size(), nPerThread));
+    for (auto& thread : vThreads) {
+        thread.join();
+    }
+    if (fFailed) {
+        return error("%s: failed to read value", __func__);
     }
+    std::vector<CDataStream>().swap(vEntries);
+
+    // Insert them ordered by height, so every parent exists before its children
+    // and the entries are allocated next to each other in chain order
+    std::vector<uint32_t> vOrder(vDiskIndex.size());
+    for (size_t i = 0; i < vOrder.size(); i++) {
+        vOrder[i] = i;
+    }
+    std::sort(vOrder.begin(), vOrder.end(), [&vDiskIndex](uint32_t a, uint32_t b) {
+        return vDiskIndex[a].nHeight < vDiskIndex[b].nHeight;
+    });
+
+    reserveBlockIndex(vDiskIndex.size());
+    for (uint32_t i : vOrder) {
+        boost::this_thread::interruption_point();
+        const CDiskBlockIndex& diskindex = vDiskIndex[i];
+
+        // Construct block index object
+        CBlockIndex* pindexNew = insertBlockIndex(diskindex.GetBlockHash());
+        pindexNew->pprev          = insertBlockIndex(diskindex.hashPrev);
+        pindexNew->nHeight        = diskindex.nHeight;
+        pindexNew->nFile          = diskindex.nFile;
+        pindexNew->nDataPos       = diskindex.nDataPos;
+        pindexNew->nUndoPos       = diskindex.nUndoPos;
+        pindexNew->nVersion       = diskindex.nVersion;
+        pindexNew->hashMerkleRoot = diskindex.hashMerkleRoot;
+        pindexNew->nTime          = diskindex.nTime;
+        pindexNew->nBits          = diskindex.nBits;
+        pindexNew->nNonce         = diskindex.nNonce;
+        pindexNew->nStatus        = diskindex.nStatus;
+        pindexNew->nTx            = diskindex.nTx;
+
+        //Proof Of Stake
+        pindexNew->nMint            = diskindex.nMint;
+        pindexNew->nMoneySupply     = diskindex.nMoneySupply;
+        pindexNew->nFlags           = diskindex.nFlags;
+        pindexNew->nStakeModifier   = diskindex.nStakeModifier;
+        pindexNew->prevoutStake     = diskindex.prevoutStake;
+        pindexNew->nStakeTime       = diskindex.nStakeTime;
+        pindexNew->hashProofOfStake = diskindex.hashProofOfStake;
+    }
+
+    LogPrintf("%s: loaded %u block index entries using %d threads in %dms\n", __func__, vDiskIndex.size(), nThreads, GetTimeMillis() - nStart);
 
     return true;
 }
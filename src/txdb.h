@@ -10,12 +10,16 @@
 #include <dbwrapper.h>
 #include <chain.h>
 #include <limitedmap.h>
+#include <saltedhasher.h>
 #include <spentindex.h>
 #include <sync.h>
+#include <unordered_lru_cache.h>
 
+#include <atomic>
 #include <map>
 #include <memory>
 #include <string>
+#include <thread>
 #include <utility>
 #include <vector>
 
@@ -29,6 +33,8 @@ static constexpr int MAX_BLOCK_COINSDB_USAGE = 10;
 static const int64_t nDefaultDbCache = 300;
 //! -dbbatchsize default (bytes)
 static const int64_t nDefaultDbBatchSize = 16 << 20;
+//! -coinsbackgroundflush default
+static const bool DEFAULT_COINS_BACKGROUND_FLUSH = false;
 //! max. -dbcache (MiB)
 static const int64_t nMaxDbCache = sizeof(void*) > 4 ? 16384 : 1024;
 //! min. -dbcache (MiB)
@@ -39,22 +45,51 @@ static const int64_t nMaxBlockDBCache = 2;
 // Unlike for the UTXO database, for the txindex scenario the leveldb cache make
 // a meaningful difference: https://github.com/bitcoin/bitcoin/pull/8273#issuecomment-229601991
 static const int64_t nMaxBlockDBAndTxIndexCache = 1024;
+//! Max memory allocated to the block filter index DB specific cache, if -blockfilterindex (MiB)
+static const int64_t nMaxBlockFilterIndexCache = 1024;
 //! Max memory allocated to coin DB specific cache (MiB)
 static const int64_t nMaxCoinsDBCache = 8;
+//! Max threads decoding the block index entries on startup
+static constexpr int MAX_BLOCK_INDEX_LOAD_THREADS = 8;
+//! Number of transactions recently found through the tx index to keep in memory
+static constexpr size_t TXINDEX_CACHE_SIZE = 10000;
 
 struct CDiskTxPos : public CDiskBlockPos
 {
     unsigned int nTxOffset; // after header
+    //! Height of the block containing the tx, so readers can take its hash
+    //! from the block index instead of hashing the header. -1 for index
+    //! entries written before it was stored.
+    int nHeight;
+
+    template <typename Stream>
+    void Serialize(Stream& s) const {
+        s << static_cast<const CDiskBlockPos&>(*this);
+        s << VARINT(nTxOffset);
+        if (nHeight >= 0) {
+            s << VARINT(nHeight, VarIntMode::NONNEGATIVE_SIGNED);
+        }
+    }
 
-    ADD_SERIALIZE_METHODS;
-
-    template <typename Stream, typename Operation>
-    inline void SerializationOp(Stream& s, Operation ser_action) {
-        READWRITEAS(CDiskBlockPos, *this);
-        READWRITE(VARINT(nTxOffset));
+    /**
+     * Older entries end before the height. That can only be told from the
+     * stream running out, which works for database values as each is read
+     * from a stream of its own, so don't embed CDiskTxPos in other
+     * serialized structures.
+     */
+    template <typename Stream>
+    void Unserialize(Stream& s) {
+        s >> static_cast<CDiskBlockPos&>(*this);
+        s >> VARINT(nTxOffset);
+        if (!s.empty()) {
+            s >> VARINT(nHeight, VarIntMode::NONNEGATIVE_SIGNED);
+        } else {
+            nHeight = -1;
+        }
     }
 
-    CDiskTxPos(const CDiskBlockPos &blockIn, unsigned int nTxOffsetIn) : CDiskBlockPos(blockIn.nFile, blockIn.nPos), nTxOffset(nTxOffsetIn) {
+    CDiskTxPos(const CDiskBlockPos &blockIn, unsigned int nTxOffsetIn, int nHeightIn = -1) :
+        CDiskBlockPos(blockIn.nFile, blockIn.nPos), nTxOffset(nTxOffsetIn), nHeight(nHeightIn) {
     }
 
     CDiskTxPos() {
@@ -64,25 +99,53 @@ struct CDiskTxPos : public CDiskBlockPos
     void SetNull() {
         CDiskBlockPos::SetNull();
         nTxOffset = 0;
+        nHeight = -1;
     }
 };
 
 /** CCoinsView backed by the coin database (chainstate/) */
-class CCoinsViewDB final : public CCoinsView
+class CCoinsViewDB : public CCoinsView
 {
 protected:
     CDBWrapper db;
+
+    //! Coins handed to the background writer; reads are served from here until they are on disk
+    mutable CCriticalSection cs_pending;
+    std::shared_ptr<CCoinsMap> pendingCoins;
+    uint256 hashPendingBlock;
+    std::atomic<size_t> nPendingUsage{0};
+    std::thread pendingWriter;
+    std::atomic<bool> fPendingWriteFailed{false};
+
+    std::shared_ptr<CCoinsMap> GetPendingCoins() const;
+    void BeginHeadTransition(CDBBatch& batch, const uint256& hashBlock);
+    virtual bool WriteCoins(CCoinsMap& mapCoins, const uint256& hashBlock, bool erase);
 public:
     explicit CCoinsViewDB(size_t nCacheSize, bool fMemory = false, bool fWipe = false);
-
+    ~CCoinsViewDB();
 
     bool GetCoin(const COutPoint &outpoint, Coin &coin) const override;
     bool HaveCoin(const COutPoint &outpoint) const override;
     uint256 GetBestBlock() const override;
     std::vector<uint256> GetHeadBlocks() const override;
-    bool BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) override;
+    bool BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock, bool erase = true) override;
     CCoinsViewCursor *Cursor() const override;
 
+    /**
+     * Write mapCoins on a background thread and return once the database is
+     * marked as moving to hashBlock, so an interrupted write is replayed at
+     * startup like any other. Waits for an earlier background write first.
+     */
+    bool BatchWriteInBackground(CCoinsMap&& mapCoins, const uint256& hashBlock);
+    /**
+     * Wait for the background write to finish. If it failed, the coins are
+     * still served from memory and writing them is retried here; returns
+     * false only if that fails too.
+     */
+    bool WaitForPendingWrite();
+    //! Memory held by the coins of the background write, which counts against -dbcache
+    size_t PendingMemoryUsage() const { return nPendingUsage; }
+
     //! Attempt to update from an older database format. Returns whether an error occurred.
     bool Upgrade();
     size_t EstimateSize() const override;
@@ -117,6 +180,12 @@ private:
     CCriticalSection cs;
     unordered_limitedmap<uint256, bool> mapHasTxIndexCache;
 
+    //! Transactions recently found through the tx index, with the hash of their block
+    mutable CCriticalSection cs_txCache;
+    mutable unordered_lru_cache<uint256, std::pair<uint256, CTransactionRef>, StaticSaltedHasher, TXINDEX_CACHE_SIZE> txCache GUARDED_BY(cs_txCache);
+    //! Bumped by WriteTxIndex, FindTxs doesn't cache what it read from an older index
+    uint64_t nTxCacheGeneration GUARDED_BY(cs_txCache){0};
+
 public:
     explicit CBlockTreeDB(size_t nCacheSize, bool fMemory = false, bool fWipe = false);
 
@@ -134,20 +203,34 @@ public:
     bool ReadSpentIndex(CSpentIndexKey &key, CSpentIndexValue &value);
     bool UpdateSpentIndex(const std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> >&vect);
     bool UpdateAddressUnspentIndex(const std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue > >&vect);
+    //! Reads entries for an address. For pagination, reading resumes after pAfter (if set)
+    //! and stops after nLimit entries (if non-zero).
     bool ReadAddressUnspentIndex(uint160 addressHash, int type,
-                                 std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &vect);
+                                 std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &vect,
+                                 const CAddressUnspentKey* pAfter = nullptr, size_t nLimit = 0);
     bool WriteAddressIndex(const std::vector<std::pair<CAddressIndexKey, CAmount> > &vect);
     bool EraseAddressIndex(const std::vector<std::pair<CAddressIndexKey, CAmount> > &vect);
+    //! Reads entries for an address, optionally limited to heights [start, end]. Pagination
+    //! works like in ReadAddressUnspentIndex, start is ignored when pAfter is set.
     bool ReadAddressIndex(uint160 addressHash, int type,
                           std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex,
-                          int start = 0, int end = 0);
+                          int start = 0, int end = 0,
+                          const CAddressIndexKey* pAfter = nullptr, size_t nLimit = 0);
     bool WriteTimestampIndex(const CTimestampIndexKey &timestampIndex);
     bool ReadTimestampIndex(const unsigned int &high, const unsigned int &low, std::vector<uint256> &vect);
     bool WriteFlag(const std::string &name, bool fValue);
     bool ReadFlag(const std::string &name, bool &fValue);
     bool ReadTxPos(const uint256 &txid, CDiskTxPos& pos) const;
     bool FindTx(const uint256& tx_hash, uint256& block_hash, CTransactionRef& tx) const;
-    bool LoadBlockIndexGuts(const Consensus::Params& consensusParams, std::function<CBlockIndex*(const uint256&)> insertBlockIndex);
+    //! Find several transactions at once. Those which are not cached are read in
+    //! block file order. txs[i] is null if tx_hashes[i] was not found. Returns
+    //! the number of transactions found.
+    size_t FindTxs(const std::vector<uint256>& tx_hashes, std::vector<uint256>& block_hashes, std::vector<CTransactionRef>& txs) const;
+    //! Load the block index entries. They are decoded on several threads and
+    //! handed to insertBlockIndex ordered by height, after reserveBlockIndex
+    //! was told how many there are.
+    bool LoadBlockIndexGuts(const Consensus::Params& consensusParams, std::function<CBlockIndex*(const uint256&)> insertBlockIndex,
+                            std::function<void(size_t)> reserveBlockIndex);
 };
 
 #endif // BITCOIN_TXDB_H
@@ -463,73 +463,111 @@ bool CTxMemPool::addUnchecked(const uint256& hash, const CTxMemPoolEntry &entry,
     return true;
 }
 
+/** Extracts the address index key of a P2SH, P2PKH or P2PK script, type 0 if none applies */
+static void GetIndexAddress(const CScript& script, uint160& addressHash, int& addressType)
+{
+    if (script.IsPayToScriptHash()) {
+        memcpy(addressHash.begin(), &script[2], 20);
+        addressType = 2;
+    } else if (script.IsPayToPublicKeyHash()) {
+        memcpy(addressHash.begin(), &script[3], 20);
+        addressType = 1;
+    } else if (script.IsPayToPublicKey()) {
+        addressHash = Hash160(script.begin()+1, script.end()-1);
+        addressType = 1;
+    } else {
+        addressHash.SetNull();
+        addressType = 0;
+    }
+}
+
+CMempoolAddressIndex::SaltedAddressHasher::SaltedAddressHasher() : k0(GetRand(std::numeric_limits<uint64_t>::max())), k1(GetRand(std::numeric_limits<uint64_t>::max())) {}
+
+size_t CMempoolAddressIndex::SaltedAddressHasher::operator()(const Address& address) const
+{
+    return CSipHasher(k0, k1).Write(address.first.begin(), address.first.size()).Write(address.second).Finalize();
+}
+
+void CMempoolAddressIndex::Add(const uint256& txhash, const Address& address, unsigned int index, int spending, const CMempoolAddressDelta& delta)
+{
+    mapEntries[address].emplace(EntryKey(txhash, index, spending), delta);
+
+    std::vector<Address>& addresses = mapTxAddresses[txhash];
+    if (std::find(addresses.begin(), addresses.end(), address) == addresses.end()) {
+        addresses.push_back(address);
+    }
+}
+
+void CMempoolAddressIndex::Get(const Address& address, std::vector<std::pair<CMempoolAddressDeltaKey, CMempoolAddressDelta> >& results) const
+{
+    auto it = mapEntries.find(address);
+    if (it == mapEntries.end()) {
+        return;
+    }
+    results.reserve(results.size() + it->second.size());
+    for (const auto& entry : it->second) {
+        results.emplace_back(CMempoolAddressDeltaKey(address.second, address.first, std::get<0>(entry.first), std::get<1>(entry.first), std::get<2>(entry.first)), entry.second);
+    }
+}
+
+void CMempoolAddressIndex::Remove(const uint256& txhash)
+{
+    auto txit = mapTxAddresses.find(txhash);
+    if (txit == mapTxAddresses.end()) {
+        return;
+    }
+    for (const Address& address : txit->second) {
+        auto it = mapEntries.find(address);
+        if (it == mapEntries.end()) {
+            continue;
+        }
+        Entries& entries = it->second;
+        auto begin = entries.lower_bound(EntryKey(txhash, 0, std::numeric_limits<int>::min()));
+        auto end = begin;
+        while (end != entries.end() && std::get<0>(end->first) == txhash) {
+            ++end;
+        }
+        entries.erase(begin, end);
+        if (entries.empty()) {
+            mapEntries.erase(it);
+        }
+    }
+    mapTxAddresses.erase(txit);
+}
+
 void CTxMemPool::addAddressIndex(const CTxMemPoolEntry &entry, const CCoinsViewCache &view)
 {
     LOCK(cs);
     const CTransaction& tx = entry.GetTx();
-    std::vector<CMempoolAddressDeltaKey> inserted;
+    const uint256& txhash = tx.GetHash();
+    CMempoolAddressIndex::Address address;
 
-    uint256 txhash = tx.GetHash();
     for (unsigned int j = 0; j < tx.vin.size(); j++) {
-        const CTxIn input = tx.vin[j];
+        const CTxIn& input = tx.vin[j];
         const Coin& coin = view.AccessCoin(input.prevout);
         const CTxOut &prevout = coin.out;
-        if (prevout.scriptPubKey.IsPayToScriptHash()) {
-            std::vector<unsigned char> hashBytes(prevout.scriptPubKey.begin()+2, prevout.scriptPubKey.begin()+22);
-            CMempoolAddressDeltaKey key(2, uint160(hashBytes), txhash, j, 1);
-            CMempoolAddressDelta delta(entry.GetTime(), prevout.nValue * -1, input.prevout.hash, input.prevout.n);
-            mapAddress.insert(std::make_pair(key, delta));
-            inserted.push_back(key);
-        } else if (prevout.scriptPubKey.IsPayToPublicKeyHash()) {
-            std::vector<unsigned char> hashBytes(prevout.scriptPubKey.begin()+3, prevout.scriptPubKey.begin()+23);
-            CMempoolAddressDeltaKey key(1, uint160(hashBytes), txhash, j, 1);
-            CMempoolAddressDelta delta(entry.GetTime(), prevout.nValue * -1, input.prevout.hash, input.prevout.n);
-            mapAddress.insert(std::make_pair(key, delta));
-            inserted.push_back(key);
-        } else if (prevout.scriptPubKey.IsPayToPublicKey()) {
-            uint160 hashBytes(Hash160(prevout.scriptPubKey.begin()+1, prevout.scriptPubKey.end()-1));
-            CMempoolAddressDeltaKey key(1, hashBytes, txhash, j, 1);
+        GetIndexAddress(prevout.scriptPubKey, address.first, address.second);
+        if (address.second != 0) {
             CMempoolAddressDelta delta(entry.GetTime(), prevout.nValue * -1, input.prevout.hash, input.prevout.n);
-            mapAddress.insert(std::make_pair(key, delta));
-            inserted.push_back(key);
+            addressIndex.Add(txhash, address, j, 1, delta);
         }
     }
 
     for (unsigned int k = 0; k < tx.vout.size(); k++) {
         const CTxOut &out = tx.vout[k];
-        if (out.scriptPubKey.IsPayToScriptHash()) {
-            std::vector<unsigned char> hashBytes(out.scriptPubKey.begin()+2, out.scriptPubKey.begin()+22);
-            CMempoolAddressDeltaKey key(2, uint160(hashBytes), txhash, k, 0);
-            mapAddress.insert(std::make_pair(key, CMempoolAddressDelta(entry.GetTime(), out.nValue)));
-            inserted.push_back(key);
-        } else if (out.scriptPubKey.IsPayToPublicKeyHash()) {
-            std::vector<unsigned char> hashBytes(out.scriptPubKey.begin()+3, out.scriptPubKey.begin()+23);
-            std::pair<addressDeltaMap::iterator,bool> ret;
-            CMempoolAddressDeltaKey key(1, uint160(hashBytes), txhash, k, 0);
-            mapAddress.insert(std::make_pair(key, CMempoolAddressDelta(entry.GetTime(), out.nValue)));
-            inserted.push_back(key);
-        } else if (out.scriptPubKey.IsPayToPublicKey()) {
-            uint160 hashBytes(Hash160(out.scriptPubKey.begin()+1, out.scriptPubKey.end()-1));
-            std::pair<addressDeltaMap::iterator,bool> ret;
-            CMempoolAddressDeltaKey key(1, hashBytes, txhash, k, 0);
-            mapAddress.insert(std::make_pair(key, CMempoolAddressDelta(entry.GetTime(), out.nValue)));
-            inserted.push_back(key);
+        GetIndexAddress(out.scriptPubKey, address.first, address.second);
+        if (address.second != 0) {
+            addressIndex.Add(txhash, address, k, 0, CMempoolAddressDelta(entry.GetTime(), out.nValue));
         }
     }
-
-    mapAddressInserted.insert(std::make_pair(txhash, inserted));
 }
 
 bool CTxMemPool::getAddressIndex(std::vector<std::pair<uint160, int> > &addresses,
                                  std::vector<std::pair<CMempoolAddressDeltaKey, CMempoolAddressDelta> > &results)
 {
     LOCK(cs);
-    for (std::vector<std::pair<uint160, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
-        addressDeltaMap::iterator ait = mapAddress.lower_bound(CMempoolAddressDeltaKey((*it).second, (*it).first));
-        while (ait != mapAddress.end() && (*ait).first.addressBytes == (*it).first && (*ait).first.type == (*it).second) {
-            results.push_back(*ait);
-            ait++;
-        }
+    for (const auto& address : addresses) {
+        addressIndex.Get(address, results);
     }
     return true;
 }
@@ -537,16 +575,7 @@ bool CTxMemPool::getAddressIndex(std::vector<std::pair<uint160, int> > &addresse
 bool CTxMemPool::removeAddressIndex(const uint256 txhash)
 {
     LOCK(cs);
-    addressDeltaMapInserted::iterator it = mapAddressInserted.find(txhash);
-
-    if (it != mapAddressInserted.end()) {
-        std::vector<CMempoolAddressDeltaKey> keys = (*it).second;
-        for (std::vector<CMempoolAddressDeltaKey>::iterator mit = keys.begin(); mit != keys.end(); mit++) {
-            mapAddress.erase(*mit);
-        }
-        mapAddressInserted.erase(it);
-    }
-
+    addressIndex.Remove(txhash);
     return true;
 }
 
@@ -556,28 +585,16 @@ void CTxMemPool::addSpentIndex(const CTxMemPoolEntry &entry, const CCoinsViewCac
 
     const CTransaction& tx = entry.GetTx();
     std::vector<CSpentIndexKey> inserted;
+    inserted.reserve(tx.vin.size());
 
-    uint256 txhash = tx.GetHash();
+    const uint256& txhash = tx.GetHash();
     for (unsigned int j = 0; j < tx.vin.size(); j++) {
-        const CTxIn input = tx.vin[j];
+        const CTxIn& input = tx.vin[j];
         const Coin& coin = view.AccessCoin(input.prevout);
         const CTxOut &prevout = coin.out;
         uint160 addressHash;
         int addressType;
-
-        if (prevout.scriptPubKey.IsPayToScriptHash()) {
-            addressHash = uint160(std::vector<unsigned char> (prevout.scriptPubKey.begin()+2, prevout.scriptPubKey.begin()+22));
-            addressType = 2;
-        } else if (prevout.scriptPubKey.IsPayToPublicKeyHash()) {
-            addressHash = uint160(std::vector<unsigned char> (prevout.scriptPubKey.begin()+3, prevout.scriptPubKey.begin()+23));
-            addressType = 1;
-        } else if (prevout.scriptPubKey.IsPayToPublicKey()) {
-            addressHash = Hash160(prevout.scriptPubKey.begin()+1, prevout.scriptPubKey.end()-1);
-            addressType = 1;
-        } else {
-            addressHash.SetNull();
-            addressType = 0;
-        }
+        GetIndexAddress(prevout.scriptPubKey, addressHash, addressType);
 
         CSpentIndexKey key = CSpentIndexKey(input.prevout.hash, input.prevout.n);
         CSpentIndexValue value = CSpentIndexValue(txhash, j, -1, prevout.nValue, addressType, addressHash);
@@ -587,7 +604,7 @@ void CTxMemPool::addSpentIndex(const CTxMemPoolEntry &entry, const CCoinsViewCac
 
     }
 
-    mapSpentInserted.insert(make_pair(txhash, inserted));
+    mapSpentInserted.insert(make_pair(txhash, std::move(inserted)));
 }
 
 bool CTxMemPool::getSpentIndex(CSpentIndexKey &key, CSpentIndexValue &value)
@@ -609,9 +626,8 @@ bool CTxMemPool::removeSpentIndex(const uint256 txhash)
     mapSpentIndexInserted::iterator it = mapSpentInserted.find(txhash);
 
     if (it != mapSpentInserted.end()) {
-        std::vector<CSpentIndexKey> keys = (*it).second;
-        for (std::vector<CSpentIndexKey>::iterator mit = keys.begin(); mit != keys.end(); mit++) {
-            mapSpent.erase(*mit);
+        for (const CSpentIndexKey& key : it->second) {
+            mapSpent.erase(key);
         }
         mapSpentInserted.erase(it);
     }
@@ -1591,3 +1607,5 @@ void CTxMemPool::GetTransactionAncestry(const uint256& txid, size_t& ancestors,
 }
 
 SaltedTxidHasher::SaltedTxidHasher() : k0(GetRand(std::numeric_limits<uint64_t>::max())), k1(GetRand(std::numeric_limits<uint64_t>::max())) {}
+
+SaltedSpentIndexKeyHasher::SaltedSpentIndexKeyHasher() : k0(GetRand(std::numeric_limits<uint64_t>::max())), k1(GetRand(std::numeric_limits<uint64_t>::max())) {}
@@ -9,9 +9,11 @@
 #include <memory>
 #include <set>
 #include <map>
+#include <unordered_map>
 #include <vector>
 #include <utility>
 #include <string>
+#include <tuple>
 
 #include <addressindex.h>
 #include <spentindex.h>
@@ -372,6 +374,61 @@ public:
     }
 };
 
+class SaltedSpentIndexKeyHasher
+{
+private:
+    /** Salt */
+    const uint64_t k0, k1;
+
+public:
+    SaltedSpentIndexKeyHasher();
+
+    size_t operator()(const CSpentIndexKey& key) const {
+        return SipHashUint256Extra(k0, k1, key.txid, key.outputIndex);
+    }
+};
+
+/**
+ * Mempool part of the address index (-addressindex).
+ *
+ * Deltas are bucketed by address in a hash map, and within a bucket ordered by
+ * (txhash, index, spending) like the on-disk index. Each transaction remembers
+ * the addresses it touched, so that removing it only visits those buckets and
+ * finds its entries there with a single lookup.
+ */
+class CMempoolAddressIndex
+{
+public:
+    //! (addressHash, type) as used by the address index RPCs
+    typedef std::pair<uint160, int> Address;
+
+private:
+    //! (txhash, index, spending)
+    typedef std::tuple<uint256, unsigned int, int> EntryKey;
+
+    class SaltedAddressHasher
+    {
+    private:
+        /** Salt */
+        const uint64_t k0, k1;
+
+    public:
+        SaltedAddressHasher();
+
+        size_t operator()(const Address& address) const;
+    };
+
+    typedef std::map<EntryKey, CMempoolAddressDelta> Entries;
+
+    std::unordered_map<Address, Entries, SaltedAddressHasher> mapEntries;
+    std::unordered_map<uint256, std::vector<Address>, SaltedTxidHasher> mapTxAddresses;
+
+public:
+    void Add(const uint256& txhash, const Address& address, unsigned int index, int spending, const CMempoolAddressDelta& delta);
+    void Get(const Address& address, std::vector<std::pair<CMempoolAddressDeltaKey, CMempoolAddressDelta> >& results) const;
+    void Remove(const uint256& txhash);
+};
+
 /**
  * CTxMemPool stores valid-according-to-the-current-best-chain transactions
  * that may be included in the next block.
@@ -516,16 +573,12 @@ private:
     typedef std::map<txiter, TxLinks, CompareIteratorByHash> txlinksMap;
     txlinksMap mapLinks;
 
-    typedef std::map<CMempoolAddressDeltaKey, CMempoolAddressDelta, CMempoolAddressDeltaKeyCompare> addressDeltaMap;
-    addressDeltaMap mapAddress;
-
-    typedef std::map<uint256, std::vector<CMempoolAddressDeltaKey> > addressDeltaMapInserted;
-    addressDeltaMapInserted mapAddressInserted;
+    CMempoolAddressIndex addressIndex;
 
-    typedef std::map<CSpentIndexKey, CSpentIndexValue, CSpentIndexKeyCompare> mapSpentIndex;
+    typedef std::unordered_map<CSpentIndexKey, CSpentIndexValue, SaltedSpentIndexKeyHasher> mapSpentIndex;
     mapSpentIndex mapSpent;
 
-    typedef std::map<uint256, std::vector<CSpentIndexKey> > mapSpentIndexInserted;
+    typedef std::unordered_map<uint256, std::vector<CSpentIndexKey>, SaltedTxidHasher> mapSpentIndexInserted;
     mapSpentIndexInserted mapSpentInserted;
 
     std::multimap<uint256, uint256> mapProTxRefs; // proTxHash -> transaction (all TXs that refer to an existing proTx)
@@ -11,6 +11,8 @@
 #include <chainparams.h>
 #include <checkpoints.h>
 #include <checkqueue.h>
+#include <clientversion.h>
+#include <coinsprefetch.h>
 #include <consensus/consensus.h>
 #include <consensus/merkle.h>
 #include <consensus/tx_verify.h>
@@ -18,6 +20,7 @@
 #include <cuckoocache.h>
 #include <hash.h>
 #include <init.h>
+#include <mappedfile.h>
 #include <policy/fees.h>
 #include <policy/policy.h>
 #include <pos/prevstake.h>
@@ -52,8 +55,12 @@
 
 #include <pos/kernel.h>
 
+#include <condition_variable>
+#include <deque>
 #include <future>
+#include <mutex>
 #include <sstream>
+#include <thread>
 
 #include <boost/algorithm/string/replace.hpp>
 #include <boost/thread.hpp>
@@ -159,6 +166,8 @@ public:
     CChain chainActive;
     BlockMap mapBlockIndex;
     PrevBlockMap mapPrevBlockIndex;
+    /** Owns the entries of mapBlockIndex */
+    CBlockIndexArena blockIndexArena;
     std::multimap<CBlockIndex*, CBlockIndex*> mapBlocksUnlinked;
     CBlockIndex *pindexBestInvalid = nullptr;
 
@@ -171,7 +180,7 @@ public:
      * that it doesn't descend from an invalid block, and then add it to mapBlockIndex.
      */
     bool AcceptBlockHeader(const CBlockHeader& block, CValidationState& state, const CChainParams& chainparams, CBlockIndex** ppindex) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
-    bool AcceptBlock(const std::shared_ptr<const CBlock>& pblock, CValidationState& state, const CChainParams& chainparams, CBlockIndex** ppindex, bool fRequested, const CDiskBlockPos* dbp, bool* fNewBlock) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+    bool AcceptBlock(const std::shared_ptr<const CBlock>& pblock, CValidationState& state, const CChainParams& chainparams, CBlockIndex** ppindex, bool fRequested, const CDiskBlockPos* dbp, bool* fNewBlock, const CStakeKernelCheck* pstakeCheck = nullptr) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
 
     // Block (dis)connection on a given view:
     DisconnectResult DisconnectBlock(const CBlock& block, const CBlockIndex* pindex, CCoinsViewCache& view);
@@ -224,8 +233,6 @@ CCriticalSection cs_main;
 bool isIbdComplete{false};
 bool havePassedPoS{false};
 bool fGlobalStakingToggle{false};
-static std::map<uint256, uint256> mapProofOfStake;
-std::set<std::pair<uint256, unsigned int>> setStakeSeen;
 BlockMap& mapBlockIndex = g_chainstate.mapBlockIndex;
 PrevBlockMap& mapPrevBlockIndex = g_chainstate.mapPrevBlockIndex;
 CChain& chainActive = g_chainstate.chainActive;
@@ -248,6 +255,7 @@ unsigned int nBytesPerSigOp = DEFAULT_BYTES_PER_SIGOP;
 bool fCheckBlockIndex = false;
 bool fCheckpointsEnabled = DEFAULT_CHECKPOINTS_ENABLED;
 size_t nCoinCacheUsage = 5000 * 300;
+bool fCoinsBackgroundFlush = DEFAULT_COINS_BACKGROUND_FLUSH;
 uint64_t nPruneTarget = 0;
 int64_t nMaxTipAge = DEFAULT_MAX_TIP_AGE;
 
@@ -979,6 +987,32 @@ bool GetAddressUnspent(uint160 addressHash, int type,
     return true;
 }
 
+bool GetAddressIndexPage(uint160 addressHash, int type,
+                         std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex,
+                         int start, int end, const CAddressIndexKey* pAfter, size_t nLimit)
+{
+    if (!fAddressIndex)
+        return error("address index not enabled");
+
+    if (!pblocktree->ReadAddressIndex(addressHash, type, addressIndex, start, end, pAfter, nLimit))
+        return error("unable to get txids for address");
+
+    return true;
+}
+
+bool GetAddressUnspentPage(uint160 addressHash, int type,
+                           std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &unspentOutputs,
+                           const CAddressUnspentKey* pAfter, size_t nLimit)
+{
+    if (!fAddressIndex)
+        return error("address index not enabled");
+
+    if (!pblocktree->ReadAddressUnspentIndex(addressHash, type, unspentOutputs, pAfter, nLimit))
+        return error("unable to get txids for address");
+
+    return true;
+}
+
 /**
  * Return transaction in txOut, and if it was found inside a block, its hash is placed in hashBlock.
  * If blockIndex is provided, the transaction is fetched from the corresponding block.
@@ -997,22 +1031,7 @@ bool GetTransaction(const uint256& hash, CTransactionRef& txOut, const Consensus
         }
 
         if (fTxIndex) {
-            CDiskTxPos postx;
-            if (pblocktree->ReadTxIndex(hash, postx)) {
-                CAutoFile file(OpenBlockFile(postx, true), SER_DISK, CLIENT_VERSION);
-                if (file.IsNull())
-                    return error("%s: OpenBlockFile failed", __func__);
-                CBlockHeader header;
-                try {
-                    file >> header;
-                    fseek(file.Get(), postx.nTxOffset, SEEK_CUR);
-                    file >> txOut;
-                } catch (const std::exception& e) {
-                    return error("%s: Deserialize or I/O error - %s", __func__, e.what());
-                }
-                hashBlock = header.GetHash();
-                if (txOut->GetHash() != hash)
-                    return error("%s: txid mismatch", __func__);
+            if (pblocktree->FindTx(hash, hashBlock, txOut)) {
                 if (!mapBlockIndex.count(hashBlock)) {
                     return error("%s: hashBlock %s not in mapBlockIndex", __func__, hashBlock.ToString());
                 }
@@ -1076,21 +1095,73 @@ static bool WriteBlockToDisk(const CBlock& block, CDiskBlockPos& pos, const CMes
     return true;
 }
 
+/** Mappings of the most recently read block and undo files, see -mmapblockfiles */
+static CMappedFileCache g_mapped_block_files;
+
+void SetMappedBlockFiles(size_t nMaxFiles)
+{
+    g_mapped_block_files.SetMaxFiles(nMaxFiles);
+}
+
+/**
+ * Find the record stored at pos, plus nExtra bytes following it, in a mapping
+ * of its file. The size of the record is taken from the header in front of it.
+ * Returns false if mapping is disabled or fails, the caller then reads the
+ * file with stdio, which also reports any errors.
+ */
+static bool MapDiskRecord(const CDiskBlockPos& pos, const char* prefix, size_t nExtra, std::shared_ptr<const CMappedFile>& file, Span<const unsigned char>& record)
+{
+    if (!g_mapped_block_files.IsEnabled() || pos.IsNull() || pos.nPos < 8) {
+        return false;
+    }
+
+    const fs::path path = GetBlockPosFilename(pos, prefix);
+    file = g_mapped_block_files.Get(path, pos.nPos);
+    if (!file) {
+        return false;
+    }
+    const uint32_t nSize = ReadLE32(file->data() + pos.nPos - 4);
+    if (nSize > MAX_SIZE) {
+        return false;
+    }
+    const size_t nEnd = (size_t)pos.nPos + nSize + nExtra;
+    if (file->size() < nEnd) {
+        // Written after the file was mapped
+        file = g_mapped_block_files.Get(path, nEnd);
+        if (!file) {
+            return false;
+        }
+    }
+    record = Span<const unsigned char>(file->data() + pos.nPos, nSize + nExtra);
+    return true;
+}
+
 bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos, const Consensus::Params& consensusParams)
 {
     block.SetNull();
 
-    // Open history file to read
-    CAutoFile filein(OpenBlockFile(pos, true), SER_DISK, CLIENT_VERSION);
-    if (filein.IsNull())
-        return error("ReadBlockFromDisk: OpenBlockFile failed for %s", pos.ToString());
+    std::shared_ptr<const CMappedFile> file;
+    Span<const unsigned char> record;
+    if (MapDiskRecord(pos, "blk", 0, file, record)) {
+        try {
+            SpanReader(SER_DISK, CLIENT_VERSION, record) >> block;
+        }
+        catch (const std::exception& e) {
+            return error("%s: Deserialize error - %s at %s", __func__, e.what(), pos.ToString());
+        }
+    } else {
+        // Open history file to read
+        CAutoFile filein(OpenBlockFile(pos, true), SER_DISK, CLIENT_VERSION);
+        if (filein.IsNull())
+            return error("ReadBlockFromDisk: OpenBlockFile failed for %s", pos.ToString());
 
-    // Read block
-    try {
-        filein >> block;
-    }
-    catch (const std::exception& e) {
-        return error("%s: Deserialize or I/O error - %s at %s", __func__, e.what(), pos.ToString());
+        // Read block
+        try {
+            filein >> block;
+        }
+        catch (const std::exception& e) {
+            return error("%s: Deserialize or I/O error - %s at %s", __func__, e.what(), pos.ToString());
+        }
     }
 
     // Check the header
@@ -1116,6 +1187,78 @@ bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex, const Consensus
     return true;
 }
 
+bool ReadRawBlockFromDisk(std::vector<uint8_t>& block, const CBlockIndex* pindex, const CMessageHeader::MessageStartChars& message_start)
+{
+    CDiskBlockPos hpos;
+    {
+        LOCK(cs_main);
+        hpos = pindex->GetBlockPos();
+    }
+
+    std::shared_ptr<const CMappedFile> file;
+    Span<const unsigned char> record;
+    if (MapDiskRecord(hpos, "blk", 0, file, record)) {
+        // The magic is checked here, the size was used to find the end of the record
+        if (memcmp(record.data() - 8, message_start, CMessageHeader::MESSAGE_START_SIZE)) {
+            return error("%s: Block magic mismatch for %s: %s versus expected %s", __func__, hpos.ToString(),
+                    HexStr(record.data() - 8, record.data() - 8 + CMessageHeader::MESSAGE_START_SIZE),
+                    HexStr(message_start, message_start + CMessageHeader::MESSAGE_START_SIZE));
+        }
+        block.assign(record.data(), record.data() + record.size());
+    } else {
+        hpos.nPos -= 8; // Seek back 8 bytes for meta header
+        CAutoFile filein(OpenBlockFile(hpos, true), SER_DISK, CLIENT_VERSION);
+        if (filein.IsNull()) {
+            return error("%s: OpenBlockFile failed for %s", __func__, hpos.ToString());
+        }
+        hpos.nPos += 8;
+
+        try {
+            CMessageHeader::MessageStartChars blk_start;
+            unsigned int blk_size;
+
+            filein >> blk_start >> blk_size;
+
+            if (memcmp(blk_start, message_start, CMessageHeader::MESSAGE_START_SIZE)) {
+                return error("%s: Block magic mismatch for %s: %s versus expected %s", __func__, hpos.ToString(),
+                        HexStr(blk_start, blk_start + CMessageHeader::MESSAGE_START_SIZE),
+                        HexStr(message_start, message_start + CMessageHeader::MESSAGE_START_SIZE));
+            }
+
+            if (blk_size > MAX_SIZE) {
+                return error("%s: Block data is larger than maximum deserialization size for %s: %s versus %s", __func__, hpos.ToString(),
+                        blk_size, MAX_SIZE);
+            }
+
+            block.resize(blk_size); // Zeroing of memory is intentional here
+            filein.read((char*)block.data(), blk_size);
+        } catch(const std::exception& e) {
+            return error("%s: Read from block file failed: %s for %s", __func__, e.what(), hpos.ToString());
+        }
+    }
+
+    // The bytes are sent as they are, make sure they still hold the block we
+    // expect: the header has to match the index and the transactions the
+    // merkle root in it. This is the only time they are deserialized, callers
+    // keep the bytes to serve the block again.
+    CBlock blockCheck;
+    try {
+        VectorReader(SER_DISK, CLIENT_VERSION, block, 0) >> blockCheck;
+    } catch (const std::exception& e) {
+        return error("%s: Deserialize error: %s for %s", __func__, e.what(), hpos.ToString());
+    }
+    if (blockCheck.GetHash() != pindex->GetBlockHash()) {
+        return error("%s: GetHash() doesn't match index for %s at %s", __func__,
+                pindex->ToString(), hpos.ToString());
+    }
+    if (BlockMerkleRoot(blockCheck) != blockCheck.hashMerkleRoot) {
+        return error("%s: Merkle root mismatch for %s at %s", __func__,
+                pindex->ToString(), hpos.ToString());
+    }
+
+    return true;
+}
+
 double ConvertBitsToDouble(unsigned int nBits)
 {
     int nShift = (nBits >> 24) & 0xff;
@@ -1424,8 +1567,7 @@ void UpdateCoins(const CTransaction& tx, CCoinsViewCache& inputs, int nHeight)
 
 bool CScriptCheck::operator()() {
     const CScript &scriptSig = ptxTo->vin[nIn].scriptSig;
-    PrecomputedTransactionData txdata(*ptxTo);
-    return VerifyScript(scriptSig, m_tx_out.scriptPubKey, nFlags, CachingTransactionSignatureChecker(ptxTo, nIn, m_tx_out.nValue, txdata, cacheStore), &error);
+    return VerifyScript(scriptSig, m_tx_out.scriptPubKey, nFlags, CachingTransactionSignatureChecker(ptxTo, nIn, m_tx_out.nValue, *txdata, cacheStore, cacheCaller), &error);
 }
 
 int GetSpendHeight(const CCoinsViewCache& inputs)
@@ -1436,18 +1578,43 @@ int GetSpendHeight(const CCoinsViewCache& inputs)
 }
 
 
-static CuckooCache::cache<uint256, SignatureCacheHasher> scriptExecutionCache;
-static uint256 scriptExecutionCacheNonce(GetRandHash());
+static CuckooCache::cache<uint256, SignatureCacheHasher> scriptExecutionCache GUARDED_BY(cs_main);
+static uint256 scriptExecutionCacheNonce GUARDED_BY(cs_main) = GetRandHash();
+static size_t nScriptExecutionCacheElements GUARDED_BY(cs_main) = 0;
+static CCacheHitStats scriptExecutionCacheStats;
 
 void InitScriptExecutionCache() {
-    // nMaxCacheSize is unsigned. If -maxsigcachesize is set to zero,
-    // setup_bytes creates the minimum possible cache (2 elements).
-    size_t nMaxCacheSize = std::min(std::max((int64_t)0, gArgs.GetArg("-maxsigcachesize", DEFAULT_MAX_SIG_CACHE_SIZE) / 2), MAX_MAX_SIG_CACHE_SIZE) * ((size_t) 1 << 20);
-    size_t nElems = scriptExecutionCache.setup_bytes(nMaxCacheSize);
+    size_t nMaxCacheSize = GetSigCacheBytes(gArgs.GetArg("-maxsigcachesize", DEFAULT_MAX_SIG_CACHE_SIZE));
+    LOCK(cs_main);
+    size_t nElems = nScriptExecutionCacheElements = scriptExecutionCache.setup_bytes(nMaxCacheSize);
     LogPrintf("Using %zu MiB out of %zu/2 requested for script execution cache, able to store %zu elements\n",
             (nElems*sizeof(uint256)) >>20, (nMaxCacheSize*2)>>20, nElems);
 }
 
+size_t ResizeScriptExecutionCache(size_t nBytes)
+{
+    LOCK(cs_main);
+    std::vector<uint256> entries;
+    scriptExecutionCache.for_each([&](const uint256& entry) { entries.push_back(entry); });
+    size_t nElems = nScriptExecutionCacheElements = scriptExecutionCache.setup_bytes(nBytes);
+    for (const uint256& entry : entries) {
+        scriptExecutionCache.insert(entry);
+    }
+    LogPrintf("Resized script execution cache to %zu MiB, able to store %zu elements\n", (nElems*sizeof(uint256)) >> 20, nElems);
+    return nElems;
+}
+
+size_t GetScriptExecutionCacheElements()
+{
+    LOCK(cs_main);
+    return nScriptExecutionCacheElements;
+}
+
+const CCacheHitStats& GetScriptExecutionCacheStats()
+{
+    return scriptExecutionCacheStats;
+}
+
 /**
  * Check whether all inputs of this transaction are valid (no double spends, scripts & sigs, amounts)
  * This does not modify the UTXO set.
@@ -1491,7 +1658,9 @@ bool CheckInputs(const CTransaction& tx, CValidationState &state, const CCoinsVi
             static_assert(55 - sizeof(flags) - 32 >= 128/8, "Want at least 128 bits of nonce for script execution cache");
             CSHA256().Write(scriptExecutionCacheNonce.begin(), 55 - sizeof(flags) - 32).Write(tx.GetHash().begin(), 32).Write((unsigned char*)&flags, sizeof(flags)).Finalize(hashCacheEntry.begin());
             AssertLockHeld(cs_main); //TODO: Remove this requirement by making CuckooCache not require external locks
-            if (scriptExecutionCache.contains(hashCacheEntry, !cacheFullScriptStore)) {
+            bool fCacheHit = scriptExecutionCache.contains(hashCacheEntry, !cacheFullScriptStore);
+            scriptExecutionCacheStats.Record(GetSigCacheCaller(), fCacheHit);
+            if (fCacheHit) {
                 return true;
             }
 
@@ -1587,37 +1756,139 @@ bool UndoWriteToDisk(const CBlockUndo& blockundo, CDiskBlockPos& pos, const uint
     return true;
 }
 
-static bool UndoReadFromDisk(CBlockUndo& blockundo, const CBlockIndex *pindex)
-{
-    CDiskBlockPos pos = pindex->GetUndoPos();
-    if (pos.IsNull()) {
-        return error("%s: no undo data available", __func__);
-    }
-
-    // Open history file to read
-    CAutoFile filein(OpenUndoFile(pos, true), SER_DISK, CLIENT_VERSION);
-    if (filein.IsNull())
-        return error("%s: OpenUndoFile failed", __func__);
+} // namespace
 
+template <typename Stream>
+static bool UndoReadFromStream(CBlockUndo& blockundo, const CBlockIndex* pindex, Stream& filein)
+{
     // Read block
     uint256 hashChecksum;
-    CHashVerifier<CAutoFile> verifier(&filein); // We need a CHashVerifier as reserializing may lose data
+    CHashVerifier<Stream> verifier(&filein); // We need a CHashVerifier as reserializing may lose data
     try {
         verifier << pindex->pprev->GetBlockHash();
         verifier >> blockundo;
         filein >> hashChecksum;
     }
     catch (const std::exception& e) {
-        return error("%s: Deserialize or I/O error - %s", __func__, e.what());
+        return error("UndoReadFromDisk: Deserialize or I/O error - %s", e.what());
     }
 
     // Verify checksum
     if (hashChecksum != verifier.GetHash())
-        return error("%s: Checksum mismatch", __func__);
+        return error("UndoReadFromDisk: Checksum mismatch");
 
     return true;
 }
 
+bool UndoReadFromDisk(CBlockUndo& blockundo, const CBlockIndex *pindex)
+{
+    CDiskBlockPos pos;
+    {
+        LOCK(cs_main);
+        pos = pindex->GetUndoPos();
+    }
+    if (pos.IsNull()) {
+        return error("%s: no undo data available", __func__);
+    }
+
+    std::shared_ptr<const CMappedFile> file;
+    Span<const unsigned char> record;
+    if (MapDiskRecord(pos, "rev", sizeof(uint256), file, record)) {
+        SpanReader reader(SER_DISK, CLIENT_VERSION, record);
+        return UndoReadFromStream(blockundo, pindex, reader);
+    }
+
+    // Open history file to read
+    CAutoFile filein(OpenUndoFile(pos, true), SER_DISK, CLIENT_VERSION);
+    if (filein.IsNull())
+        return error("%s: OpenUndoFile failed", __func__);
+
+    return UndoReadFromStream(blockundo, pindex, filein);
+}
+
+bool ReadTxFromDisk(const CDiskTxPos& postx, CTransactionRef& tx, uint256& hashBlock)
+{
+    std::vector<CTransactionRef> txs;
+    std::vector<uint256> hashBlocks;
+    ReadTxsFromDisk({postx}, txs, hashBlocks);
+    tx = txs[0];
+    hashBlock = hashBlocks[0];
+    return tx != nullptr;
+}
+
+void ReadTxsFromDisk(const std::vector<CDiskTxPos>& positions, std::vector<CTransactionRef>& txs, std::vector<uint256>& hashBlocks)
+{
+    txs.assign(positions.size(), nullptr);
+    hashBlocks.assign(positions.size(), uint256());
+
+    // Take the block hashes from the block index where the entries have the
+    // height. An entry can still point to a block that was reorged out, so
+    // the active block at that height must be stored where the entry says.
+    {
+        LOCK(cs_main);
+        for (size_t i = 0; i < positions.size(); i++) {
+            const CDiskTxPos& postx = positions[i];
+            const CBlockIndex* pindex = postx.nHeight >= 0 ? chainActive[postx.nHeight] : nullptr;
+            if (pindex && pindex->GetBlockPos() == postx) {
+                hashBlocks[i] = pindex->GetBlockHash();
+            }
+        }
+    }
+
+    // Opened on the first read from a file which is not mapped, reused while
+    // the following transactions are in the same file
+    std::unique_ptr<CAutoFile> filein;
+    int nFileOpen = -1;
+    for (size_t i = 0; i < positions.size(); i++) {
+        const CDiskTxPos& postx = positions[i];
+        CBlockHeader header;
+        std::shared_ptr<const CMappedFile> file;
+        Span<const unsigned char> record;
+        if (MapDiskRecord(postx, "blk", 0, file, record)) {
+            try {
+                SpanReader reader(SER_DISK, CLIENT_VERSION, record);
+                reader >> header;
+                reader.ignore(postx.nTxOffset);
+                reader >> txs[i];
+            } catch (const std::exception& e) {
+                txs[i] = nullptr;
+                error("ReadTxFromDisk: Deserialize error - %s at %s", e.what(), postx.ToString());
+                continue;
+            }
+        } else {
+            if (!filein || postx.nFile != nFileOpen || fseek(filein->Get(), postx.nPos, SEEK_SET)) {
+                filein.reset(new CAutoFile(OpenBlockFile(postx, true), SER_DISK, CLIENT_VERSION));
+                nFileOpen = postx.nFile;
+            }
+            if (filein->IsNull()) {
+                filein.reset();
+                error("ReadTxFromDisk: OpenBlockFile failed for %s", postx.ToString());
+                continue;
+            }
+            try {
+                *filein >> header;
+                if (fseek(filein->Get(), postx.nTxOffset, SEEK_CUR)) {
+                    filein.reset();
+                    error("ReadTxFromDisk: fseek(...) failed for %s", postx.ToString());
+                    continue;
+                }
+                *filein >> txs[i];
+            } catch (const std::exception& e) {
+                txs[i] = nullptr;
+                filein.reset();
+                error("ReadTxFromDisk: Deserialize or I/O error - %s at %s", e.what(), postx.ToString());
+                continue;
+            }
+        }
+        // Hash the header only if the block index didn't have the block
+        if (hashBlocks[i].IsNull()) {
+            hashBlocks[i] = header.GetHash();
+        }
+    }
+}
+
+namespace {
+
 /** Abort with a message */
 bool AbortNode(const std::string& strMessage, const std::string& userMessage="")
 {
@@ -1856,6 +2127,12 @@ void static FlushBlockFile(bool fFinalize = false)
     CDiskBlockPos posOld(nLastBlockFile, 0);
     bool status = true;
 
+    if (fFinalize) {
+        // Reading beyond the end of a truncated file through an old mapping would fault
+        g_mapped_block_files.Erase(GetBlockPosFilename(posOld, "blk"));
+        g_mapped_block_files.Erase(GetBlockPosFilename(posOld, "rev"));
+    }
+
     FILE *fileOld = OpenBlockFile(posOld);
     if (fileOld) {
         if (fFinalize)
@@ -1902,7 +2179,7 @@ static bool WriteTxIndexDataForBlock(const CBlock& block, CValidationState& stat
 {
     if (!fTxIndex) return true;
 
-    CDiskTxPos pos(pindex->GetBlockPos(), GetSizeOfCompactSize(block.vtx.size()));
+    CDiskTxPos pos(pindex->GetBlockPos(), GetSizeOfCompactSize(block.vtx.size()), pindex->nHeight);
     std::vector<std::pair<uint256, CDiskTxPos> > vPos;
     vPos.reserve(block.vtx.size());
     for (const CTransactionRef& tx : block.vtx)
@@ -1918,13 +2195,30 @@ static bool WriteTxIndexDataForBlock(const CBlock& block, CValidationState& stat
     return true;
 }
 
-static CCheckQueue<CScriptCheck> scriptcheckqueue(128);
+typedef CWorkStealingCheckQueue<CScriptCheck> ScriptCheckQueue;
+static ScriptCheckQueue scriptcheckqueue(128, MAX_SCRIPTCHECK_THREADS);
 
 void ThreadScriptCheck() {
     RenameThread("pacprotocol-scriptch");
     scriptcheckqueue.Thread();
 }
 
+bool RunScriptChecks(std::vector<CScriptCheck>& vChecks)
+{
+    if (!nScriptCheckThreads) {
+        for (auto& check : vChecks) {
+            if (!check()) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    CCheckQueueControl<CScriptCheck, ScriptCheckQueue> control(&scriptcheckqueue);
+    control.Add(vChecks);
+    return control.Wait();
+}
+
 // Protected by cs_main
 VersionBitsCache versionbitscache;
 
@@ -2050,6 +2344,7 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
     assert(pindex);
     assert(*pindex->phashBlock == block.GetHash());
     int64_t nTimeStart = GetTimeMicros();
+    SigCacheCallerScope sigCacheCaller(SIGCACHE_BLOCK);
 
     // Check it again in case a previous version let a bad block in
     // NOTE: We don't currently (re-)invoke ContextualCheckBlock() or
@@ -2201,7 +2496,7 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
 
     CBlockUndo blockundo;
 
-    CCheckQueueControl<CScriptCheck> control(fScriptChecks && nScriptCheckThreads ? &scriptcheckqueue : nullptr);
+    CCheckQueueControl<CScriptCheck, ScriptCheckQueue> control(fScriptChecks && nScriptCheckThreads ? &scriptcheckqueue : nullptr);
 
     std::vector<int> prevheights;
     CAmount nFees = 0;
@@ -2209,7 +2504,7 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
     CAmount nValueOut = 0;
     CAmount nValueIn = 0;
     unsigned int nSigOps = 0;
-    CDiskTxPos pos(pindex->GetBlockPos(), GetSizeOfCompactSize(block.vtx.size()));
+    CDiskTxPos pos(pindex->GetBlockPos(), GetSizeOfCompactSize(block.vtx.size()), pindex->nHeight);
     std::vector<std::pair<uint256, CDiskTxPos> > vPos;
     vPos.reserve(block.vtx.size());
     blockundo.vtxundo.reserve(block.vtx.size() - 1);
@@ -2570,6 +2865,7 @@ bool static FlushStateToDisk(const CChainParams& chainparams, CValidationState &
         int64_t nMempoolSizeMax = gArgs.GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000;
         int64_t cacheSize = pcoinsTip->DynamicMemoryUsage();
         cacheSize += evoDb->GetMemoryUsage();
+        cacheSize += pcoinsdbview->PendingMemoryUsage();
         int64_t nTotalSpace = nCoinCacheUsage + std::max<int64_t>(nMempoolSizeMax - nMempoolUsage, 0);
         // The cache is large and we're within 10% and 10 MiB of the limit, but we have time now (not in the middle of a block processing).
         bool fCacheLarge = mode == FlushStateMode::PERIODIC && cacheSize > std::max((9 * nTotalSpace) / 10, nTotalSpace - MAX_BLOCK_COINSDB_USAGE * 1024 * 1024);
@@ -2621,11 +2917,23 @@ bool static FlushStateToDisk(const CChainParams& chainparams, CValidationState &
             if (!CheckDiskSpace(48 * 2 * 2 * pcoinsTip->GetCacheSize()))
                 return state.Error("out of disk space");
             // Flush the chainstate (which may refer to block index entries).
-            if (!pcoinsTip->Flush())
+            // Only the modified coins are written, the rest stay cached and
+            // the cache is trimmed below if it is over budget.
+            if (fCoinsBackgroundFlush && mode != FlushStateMode::ALWAYS && !fFlushForPrune) {
+                CCoinsMap mapDirty;
+                pcoinsTip->SnapshotDirty(mapDirty);
+                if (!pcoinsdbview->BatchWriteInBackground(std::move(mapDirty), pcoinsTip->GetBestBlock()))
+                    return AbortNode(state, "Failed to write to coin database");
+            } else if (!pcoinsTip->Sync()) {
                 return AbortNode(state, "Failed to write to coin database");
+            }
             if (!evoDb->CommitRootTransaction()) {
                 return AbortNode(state, "Failed to commit EvoDB");
             }
+            if (fCacheLarge || fCacheCritical) {
+                int64_t nTrimTarget = (fCacheCritical ? (int64_t)nCoinCacheUsage : nTotalSpace) * COINS_CACHE_TRIM_PERCENT / 100 - (int64_t)evoDb->GetMemoryUsage() - (int64_t)pcoinsdbview->PendingMemoryUsage();
+                pcoinsTip->Trim(std::max<int64_t>(nTrimTarget, 0));
+            }
             nLastFlush = nNow;
         }
     }
@@ -3477,16 +3785,13 @@ CBlockIndex* CChainState::AddToBlockIndex(const CBlockHeader& block, enum BlockS
         return it->second;
 
     // Construct new block index object
-    CBlockIndex* pindexNew = new CBlockIndex(block);
-    assert(pindexNew);
+    CBlockIndex* pindexNew = blockIndexArena.Allocate(block);
 
     // We assign the sequence id to blocks only when the full data is available,
     // to avoid miners withholding blocks but broadcasting headers, to get a
     // competitive advantage.
     pindexNew->nSequenceId = 0;
     BlockMap::iterator mi = mapBlockIndex.insert(std::make_pair(hash, pindexNew)).first;
-    if (pindexNew->IsProofOfStake())
-        setStakeSeen.insert(std::make_pair(hash, pindexNew->nTime));
     pindexNew->phashBlock = &((*mi).first);
     BlockMap::iterator miPrev = mapBlockIndex.find(block.hashPrevBlock);
     if (miPrev != mapBlockIndex.end())
@@ -3500,13 +3805,6 @@ CBlockIndex* CChainState::AddToBlockIndex(const CBlockHeader& block, enum BlockS
         if (!pindexNew->SetStakeEntropyBit(pindexNew->GetStakeEntropyBit()))
             LogPrintf("AddToBlockIndex() : SetStakeEntropyBit() failed \n");
 
-        // ppcoin: record proof-of-stake hash value
-        if (pindexNew->IsProofOfStake()) {
-            if (!mapProofOfStake.count(hash))
-                LogPrintf("AddToBlockIndex() : hashProofOfStake not found in map \n");
-            pindexNew->hashProofOfStake = mapProofOfStake[hash];
-        }
-
         // ppcoin: compute stake modifier
         uint64_t nStakeModifier = 0;
         bool fGeneratedStakeModifier = false;
@@ -3700,22 +3998,11 @@ static bool CheckBlockHeader(const CBlockHeader& block, CValidationState& state,
     return true;
 }
 
-bool CheckBlock(const CBlock& block, CValidationState& state, const Consensus::Params& consensusParams, bool fCheckPOW, bool fCheckMerkleRoot)
+/** The checks of CheckBlock which do not need the block index: merkle root, size, coinbase/coinstake and transactions */
+static bool CheckBlockContents(const CBlock& block, CValidationState& state, bool fCheckMerkleRoot, bool fIgnoreSigopsLimits)
 {
-    // These are checks that are independent of context.
-
-    boost::posix_time::ptime start = boost::posix_time::microsec_clock::local_time();
-
-    if (block.fChecked)
-        return true;
-
     const bool fProofOfStake = block.IsProofOfStake();
 
-    // Check that the header is valid (particularly PoW).  This is mostly
-    // redundant with the call in AcceptBlockHeader.
-    if (!CheckBlockHeader(block, state, consensusParams, fCheckPOW))
-        return false;
-
     // Check the merkle root.
     if (fCheckMerkleRoot) {
         bool mutated;
@@ -3756,14 +4043,14 @@ bool CheckBlock(const CBlock& block, CValidationState& state, const Consensus::P
     }
 
     // Check transactions
-    if (!ignoreSigopsLimits(SIGOPBYPASS))
+    if (!fIgnoreSigopsLimits)
         for (const auto& tx : block.vtx)
             if (!CheckTransaction(*tx, state))
                 return state.Invalid(false, state.GetRejectCode(), state.GetRejectReason(),
                                      strprintf("Transaction check failed (tx hash %s) %s", tx->GetHash().ToString(), state.GetDebugMessage()));
 
     // Don't have access to height here, use failsafe method
-    if (!ignoreSigopsLimits(SIGOPBYPASS)) {
+    if (!fIgnoreSigopsLimits) {
         unsigned int nSigOps = 0;
         for (const auto& tx : block.vtx) {
             nSigOps += GetLegacySigOpCount(*tx);
@@ -3772,6 +4059,26 @@ bool CheckBlock(const CBlock& block, CValidationState& state, const Consensus::P
         }
     }
 
+    return true;
+}
+
+bool CheckBlock(const CBlock& block, CValidationState& state, const Consensus::Params& consensusParams, bool fCheckPOW, bool fCheckMerkleRoot)
+{
+    // These are checks that are independent of context.
+
+    boost::posix_time::ptime start = boost::posix_time::microsec_clock::local_time();
+
+    if (block.fChecked)
+        return true;
+
+    // Check that the header is valid (particularly PoW).  This is mostly
+    // redundant with the call in AcceptBlockHeader.
+    if (!CheckBlockHeader(block, state, consensusParams, fCheckPOW))
+        return false;
+
+    if (!CheckBlockContents(block, state, fCheckMerkleRoot, ignoreSigopsLimits(SIGOPBYPASS)))
+        return false;
+
     if (fCheckPOW && fCheckMerkleRoot)
         block.fChecked = true;
 
@@ -4020,7 +4327,7 @@ static CDiskBlockPos SaveBlockToDisk(const CBlock& block, int nHeight, const CCh
 }
 
 /** Store block on disk. If dbp is non-nullptr, the file is known to already reside on disk */
-bool CChainState::AcceptBlock(const std::shared_ptr<const CBlock>& pblock, CValidationState& state, const CChainParams& chainparams, CBlockIndex** ppindex, bool fRequested, const CDiskBlockPos* dbp, bool* fNewBlock)
+bool CChainState::AcceptBlock(const std::shared_ptr<const CBlock>& pblock, CValidationState& state, const CChainParams& chainparams, CBlockIndex** ppindex, bool fRequested, const CDiskBlockPos* dbp, bool* fNewBlock, const CStakeKernelCheck* pstakeCheck)
 {
     boost::posix_time::ptime start = boost::posix_time::microsec_clock::local_time();
 
@@ -4079,15 +4386,22 @@ bool CChainState::AcceptBlock(const std::shared_ptr<const CBlock>& pblock, CVali
     //// hashproof test
     uint256 hashProofOfStake = uint256();
     if (block.IsProofOfStake()) {
-        if (!CheckProofOfStake(block, hashProofOfStake, pindex->pprev))
+        // Reuse the kernel check done outside cs_main if the chain hasn't moved since
+        bool fStakeOk;
+        if (pstakeCheck && pstakeCheck->IsCurrent(pindex->GetBlockHash(), pindex->pprev)) {
+            fStakeOk = pstakeCheck->fValid;
+            hashProofOfStake = pstakeCheck->hashProofOfStake;
+        } else {
+            fStakeOk = CheckProofOfStake(block, hashProofOfStake, pindex->pprev);
+        }
+        if (!fStakeOk)
             return error("%s: check proof-of-stake failed for block %s\n", __func__, block.GetHash().ToString());
         if (hashProofOfStake == uint256())
             return error("%s: hashproof returned empty!\n", __func__);
         if (isIbdComplete && !checkPrevStake(hashProofOfStake, chainparams))
             return error("%s: hashproof has already been used!\n", __func__);
-        uint256 hash = block.GetHash();
-        if (!mapProofOfStake.count(hash)) // add to mapProofOfStake
-            mapProofOfStake.insert(std::make_pair(hash, hashProofOfStake));
+        // ppcoin: record proof-of-stake hash value, the index entry was created without it
+        pindex->hashProofOfStake = hashProofOfStake;
         LogPrintf("%s: hashProofOfStake %s\n", __func__, hashProofOfStake.ToString());
     }
 
@@ -4134,11 +4448,20 @@ bool ProcessNewBlock(const CChainParams& chainparams, const std::shared_ptr<cons
         // belt-and-suspenders.
         bool ret = CheckBlock(*pblock, state, chainparams.GetConsensus());
 
+        // Do the txindex read and kernel hashing before taking cs_main for AcceptBlock
+        CStakeKernelCheck stakeCheck;
+        if (ret && pblock->IsProofOfStake())
+            PrevalidateProofOfStake(*pblock, stakeCheck);
+
+        // Warm the coins cache with the block's inputs while the merkle root is known good
+        if (ret)
+            coinsPrefetcher.Prefetch(*pblock);
+
         LOCK(cs_main);
 
         if (ret) {
             // Store to disk
-            ret = g_chainstate.AcceptBlock(pblock, state, chainparams, &pindex, fForceProcessing, nullptr, fNewBlock);
+            ret = g_chainstate.AcceptBlock(pblock, state, chainparams, &pindex, fForceProcessing, nullptr, fNewBlock, &stakeCheck);
         }
         if (!ret) {
             GetMainSignals().BlockChecked(*pblock, state);
@@ -4245,6 +4568,8 @@ void UnlinkPrunedFiles(const std::set<int>& setFilesToPrune)
 {
     for (std::set<int>::iterator it = setFilesToPrune.begin(); it != setFilesToPrune.end(); ++it) {
         CDiskBlockPos pos(*it, 0);
+        g_mapped_block_files.Erase(GetBlockPosFilename(pos, "blk"));
+        g_mapped_block_files.Erase(GetBlockPosFilename(pos, "rev"));
         fs::remove(GetBlockPosFilename(pos, "blk"));
         fs::remove(GetBlockPosFilename(pos, "rev"));
         LogPrintf("Prune: %s deleted blk/rev (%05u)\n", __func__, *it);
@@ -4402,6 +4727,12 @@ fs::path GetBlockPosFilename(const CDiskBlockPos &pos, const char *prefix)
     return GetBlocksDir() / strprintf("%s%05u.dat", prefix, pos.nFile);
 }
 
+CBlockIndex* AllocateBlockIndex()
+{
+    AssertLockHeld(cs_main);
+    return g_chainstate.blockIndexArena.Allocate();
+}
+
 CBlockIndex * CChainState::InsertBlockIndex(const uint256& hash)
 {
     AssertLockHeld(cs_main);
@@ -4415,7 +4746,7 @@ CBlockIndex * CChainState::InsertBlockIndex(const uint256& hash)
         return (*mi).second;
 
     // Create new
-    CBlockIndex* pindexNew = new CBlockIndex();
+    CBlockIndex* pindexNew = blockIndexArena.Allocate();
     mi = mapBlockIndex.insert(std::make_pair(hash, pindexNew)).first;
     pindexNew->phashBlock = &((*mi).first);
 
@@ -4424,11 +4755,17 @@ CBlockIndex * CChainState::InsertBlockIndex(const uint256& hash)
 
 bool CChainState::LoadBlockIndex(const Consensus::Params& consensus_params, CBlockTreeDB& blocktree)
 {
-    if (!blocktree.LoadBlockIndexGuts(consensus_params, [this](const uint256& hash) EXCLUSIVE_LOCKS_REQUIRED(cs_main) { return this->InsertBlockIndex(hash); }))
+    auto reserve = [this](size_t n) EXCLUSIVE_LOCKS_REQUIRED(cs_main) {
+        mapBlockIndex.reserve(mapBlockIndex.size() + n);
+        blockIndexArena.Reserve(n);
+    };
+    if (!blocktree.LoadBlockIndexGuts(consensus_params, [this](const uint256& hash) EXCLUSIVE_LOCKS_REQUIRED(cs_main) { return this->InsertBlockIndex(hash); }, reserve))
         return false;
 
     boost::this_thread::interruption_point();
 
+    int64_t nStart = GetTimeMillis();
+
     // Calculate nChainWork
     std::vector<std::pair<int, CBlockIndex*> > vSortedByHeight;
     vSortedByHeight.reserve(mapBlockIndex.size());
@@ -4476,6 +4813,8 @@ bool CChainState::LoadBlockIndex(const Consensus::Params& consensus_params, CBlo
             pindexBestHeader = pindex;
     }
 
+    LogPrintf("%s: linked %u block index entries in %dms\n", __func__, vSortedByHeight.size(), GetTimeMillis() - nStart);
+
     return true;
 }
 
@@ -4820,10 +5159,9 @@ void UnloadBlockIndex()
         warningcache[b].clear();
     }
 
-    for (BlockMap::value_type& entry : mapBlockIndex) {
-        delete entry.second;
-    }
+    ResetStakeModifierWindow();
     mapBlockIndex.clear();
+    g_chainstate.blockIndexArena.Clear();
     fHavePruned = false;
 
     g_chainstate.UnloadBlockIndex();
@@ -4914,6 +5252,262 @@ bool LoadGenesisBlock(const CChainParams& chainparams)
     return g_chainstate.LoadGenesisBlock(chainparams);
 }
 
+namespace {
+
+/** A block found by the import scanner, which the import workers decode and check */
+struct CImportBlock
+{
+    uint64_t nMagicPos;
+    uint64_t nBlockPos;
+    unsigned int nSize;
+    //! Where the scan continues after this block, like in a serial scan
+    uint64_t nEndPos{0};
+    CDataStream data{SER_DISK, CLIENT_VERSION};
+
+    //! Set by the worker, pblock is null if the block could not be decoded
+    bool fDone{false};
+    std::shared_ptr<CBlock> pblock;
+    uint256 hash;
+    std::string strError;
+};
+typedef std::shared_ptr<CImportBlock> CImportBlockRef;
+
+/** Memory of raw blocks read ahead of the connecting thread */
+static const uint64_t MAX_IMPORT_BYTES_IN_FLIGHT = 64 << 20;
+
+/** Run the context free checks of an imported block, so AcceptBlock can skip CheckBlock */
+static void PrecheckImportedBlock(const CBlock& block, const uint256& hash, const Consensus::Params& consensusParams)
+{
+    // AcceptBlockHeader checks the header again. The transaction and sigops
+    // checks always run here, even where CheckBlock would skip them because
+    // of the block connected last, so a block passing them passes CheckBlock.
+    CValidationState state;
+    if (!block.IsProofOfStake() && !CheckProofOfWork(hash, block.nBits, consensusParams))
+        return;
+    if (CheckBlockContents(block, state, true, false))
+        block.fChecked = true;
+}
+
+/**
+ * Imports a block file in three stages. One thread scans the file for
+ * blocks, a pool of workers deserializes, X11-hashes and checks them in
+ * parallel, and the caller takes them in file order through Next().
+ */
+class CBlockImportPipeline
+{
+private:
+    const CChainParams& chainparams;
+    CBufferedFile blkdat;
+
+    std::mutex cs;
+    std::condition_variable condScanner;
+    std::condition_variable condWorkers;
+    std::condition_variable condConnector;
+    //! All blocks not taken by Next() yet, in file order (guarded by cs)
+    std::deque<CImportBlockRef> queueOrdered;
+    //! Blocks waiting for a worker (guarded by cs)
+    std::deque<CImportBlockRef> queueDecode;
+    uint64_t nBytesInFlight{0};
+    //! Bumped when the scan has to continue at nRewindTo instead (guarded by cs)
+    int nGeneration{0};
+    uint64_t nRewindTo{0};
+    bool fScanDone{false};
+    bool fStop{false};
+
+    std::thread scanner;
+    std::vector<std::thread> workers;
+
+    void ThreadScan();
+    void ThreadDecode();
+
+public:
+    std::atomic<int64_t> nScanned{0};
+    std::atomic<int64_t> nScanMicros{0};
+    std::atomic<int64_t> nDecoded{0};
+    std::atomic<int64_t> nDecodeMicros{0};
+    int64_t nWaitMicros{0};
+
+    //! Takes over fileIn and calls fclose() on it in the CBufferedFile destructor
+    CBlockImportPipeline(const CChainParams& chainparamsIn, FILE* fileIn, int nThreads);
+    ~CBlockImportPipeline();
+
+    //! Wait for the next block in file order, returns nullptr at the end of the file
+    CImportBlockRef Next();
+};
+
+CBlockImportPipeline::CBlockImportPipeline(const CChainParams& chainparamsIn, FILE* fileIn, int nThreads) :
+    chainparams(chainparamsIn),
+    blkdat(fileIn, 2*MaxBlockSize(), MaxBlockSize()+8, SER_DISK, CLIENT_VERSION)
+{
+    scanner = std::thread(&CBlockImportPipeline::ThreadScan, this);
+    for (int i = 0; i < nThreads; i++) {
+        workers.emplace_back(&CBlockImportPipeline::ThreadDecode, this);
+    }
+}
+
+CBlockImportPipeline::~CBlockImportPipeline()
+{
+    {
+        std::unique_lock<std::mutex> lock(cs);
+        fStop = true;
+    }
+    condScanner.notify_all();
+    condWorkers.notify_all();
+    scanner.join();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+void CBlockImportPipeline::ThreadScan()
+{
+    RenameThread("pacprotocol-loadscan");
+    const unsigned int nMaxBlockSize = MaxBlockSize();
+    uint64_t nRewind = blkdat.GetPos();
+    int nScanGeneration = 0;
+    bool fEnd = false;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(cs);
+            if (fEnd && nScanGeneration == nGeneration && !fScanDone) {
+                fScanDone = true;
+                condConnector.notify_one();
+            }
+            condScanner.wait(lock, [&] { return fStop || nScanGeneration != nGeneration || (!fEnd && nBytesInFlight < MAX_IMPORT_BYTES_IN_FLIGHT); });
+            if (fStop) {
+                return;
+            }
+            if (nScanGeneration != nGeneration) {
+                nScanGeneration = nGeneration;
+                nRewind = nRewindTo;
+                fEnd = !blkdat.Seek(nRewind);
+                continue;
+            }
+        }
+        if (blkdat.eof()) {
+            fEnd = true;
+            continue;
+        }
+
+        int64_t nStart = GetTimeMicros();
+        blkdat.SetPos(nRewind);
+        nRewind++; // start one byte further next time, in case of failure
+        blkdat.SetLimit(); // remove former limit
+        CImportBlockRef block = std::make_shared<CImportBlock>();
+        try {
+            // locate a header
+            unsigned char buf[CMessageHeader::MESSAGE_START_SIZE];
+            blkdat.FindByte(chainparams.MessageStart()[0]);
+            block->nMagicPos = blkdat.GetPos();
+            nRewind = block->nMagicPos + 1;
+            blkdat >> buf;
+            if (memcmp(buf, chainparams.MessageStart(), CMessageHeader::MESSAGE_START_SIZE))
+                continue;
+            // read size
+            blkdat >> block->nSize;
+            if (block->nSize < 80 || block->nSize > nMaxBlockSize)
+                continue;
+        } catch (const std::exception&) {
+            // no valid block header found; don't complain
+            fEnd = true;
+            continue;
+        }
+        try {
+            // read block
+            block->nBlockPos = blkdat.GetPos();
+            blkdat.SetLimit(block->nBlockPos + block->nSize);
+            blkdat.SetPos(block->nBlockPos);
+            block->data.resize(block->nSize);
+            blkdat.read(block->data.data(), block->nSize);
+            nRewind = block->nBlockPos + block->nSize;
+        } catch (const std::exception& e) {
+            LogPrintf("%s: Deserialize or I/O error - %s\n", __func__, e.what());
+            continue;
+        }
+        nScanMicros += GetTimeMicros() - nStart;
+        nScanned++;
+
+        {
+            std::unique_lock<std::mutex> lock(cs);
+            if (nScanGeneration != nGeneration) {
+                continue;
+            }
+            queueOrdered.push_back(block);
+            queueDecode.push_back(block);
+            nBytesInFlight += block->nSize;
+        }
+        condWorkers.notify_one();
+    }
+}
+
+void CBlockImportPipeline::ThreadDecode()
+{
+    RenameThread("pacprotocol-loaddec");
+    while (true) {
+        CImportBlockRef block;
+        {
+            std::unique_lock<std::mutex> lock(cs);
+            condWorkers.wait(lock, [&] { return fStop || !queueDecode.empty(); });
+            if (fStop) {
+                return;
+            }
+            block = queueDecode.front();
+            queueDecode.pop_front();
+        }
+
+        int64_t nStart = GetTimeMicros();
+        std::shared_ptr<CBlock> pblock = std::make_shared<CBlock>();
+        try {
+            block->data >> *pblock;
+            block->nEndPos = block->nBlockPos + block->nSize - block->data.size();
+            block->hash = pblock->GetHash();
+            PrecheckImportedBlock(*pblock, block->hash, chainparams.GetConsensus());
+            block->pblock = std::move(pblock);
+        } catch (const std::exception& e) {
+            block->strError = e.what();
+            block->nEndPos = block->nMagicPos + 1;
+        }
+        block->data.clear();
+        nDecodeMicros += GetTimeMicros() - nStart;
+        nDecoded++;
+
+        {
+            std::unique_lock<std::mutex> lock(cs);
+            block->fDone = true;
+        }
+        condConnector.notify_one();
+    }
+}
+
+CImportBlockRef CBlockImportPipeline::Next()
+{
+    std::unique_lock<std::mutex> lock(cs);
+    int64_t nStart = GetTimeMicros();
+    condConnector.wait(lock, [&] { return queueOrdered.empty() ? fScanDone : queueOrdered.front()->fDone; });
+    nWaitMicros += GetTimeMicros() - nStart;
+    if (queueOrdered.empty()) {
+        return nullptr;
+    }
+
+    CImportBlockRef block = queueOrdered.front();
+    queueOrdered.pop_front();
+    nBytesInFlight -= block->nSize;
+    if (block->nEndPos != block->nBlockPos + block->nSize) {
+        // The block did not decode to its stated size, so the blocks found
+        // after it may be bogus. Scan again from where a serial scan would.
+        queueOrdered.clear();
+        queueDecode.clear();
+        nBytesInFlight = 0;
+        nRewindTo = block->nEndPos;
+        nGeneration++;
+        fScanDone = false;
+    }
+    condScanner.notify_one();
+    return block;
+}
+
+} // namespace
+
 bool LoadExternalBlockFile(const CChainParams& chainparams, FILE* fileIn, CDiskBlockPos *dbp)
 {
     // Map of disk positions for blocks with unknown parent (only used for reindex)
@@ -4922,46 +5516,27 @@ bool LoadExternalBlockFile(const CChainParams& chainparams, FILE* fileIn, CDiskB
 
     int nLoaded = 0;
     try {
-        unsigned int nMaxBlockSize = MaxBlockSize();
+        int nThreads = gArgs.GetArg("-importthreads", DEFAULT_IMPORT_THREADS);
+        if (nThreads <= 0)
+            nThreads = GetNumCores() - 1;
+        nThreads = std::max(1, std::min(nThreads, MAX_IMPORT_THREADS));
         // This takes over fileIn and calls fclose() on it in the CBufferedFile destructor
-        CBufferedFile blkdat(fileIn, 2*nMaxBlockSize, nMaxBlockSize+8, SER_DISK, CLIENT_VERSION);
-        uint64_t nRewind = blkdat.GetPos();
-        while (!blkdat.eof()) {
+        CBlockImportPipeline pipeline(chainparams, fileIn, nThreads);
+        int64_t nConnectStart = GetTimeMicros();
+        while (CImportBlockRef imported = pipeline.Next()) {
             boost::this_thread::interruption_point();
 
-            blkdat.SetPos(nRewind);
-            nRewind++; // start one byte further next time, in case of failure
-            blkdat.SetLimit(); // remove former limit
-            unsigned int nSize = 0;
-            try {
-                // locate a header
-                unsigned char buf[CMessageHeader::MESSAGE_START_SIZE];
-                blkdat.FindByte(chainparams.MessageStart()[0]);
-                nRewind = blkdat.GetPos()+1;
-                blkdat >> buf;
-                if (memcmp(buf, chainparams.MessageStart(), CMessageHeader::MESSAGE_START_SIZE))
-                    continue;
-                // read size
-                blkdat >> nSize;
-                if (nSize < 80 || nSize > nMaxBlockSize)
-                    continue;
-            } catch (const std::exception&) {
-                // no valid block header found; don't complain
-                break;
+            if (!imported->pblock) {
+                LogPrintf("%s: Deserialize or I/O error - %s\n", __func__, imported->strError);
+                continue;
             }
             try {
-                // read block
-                uint64_t nBlockPos = blkdat.GetPos();
                 if (dbp)
-                    dbp->nPos = nBlockPos;
-                blkdat.SetLimit(nBlockPos + nSize);
-                blkdat.SetPos(nBlockPos);
-                std::shared_ptr<CBlock> pblock = std::make_shared<CBlock>();
+                    dbp->nPos = imported->nBlockPos;
+                std::shared_ptr<CBlock> pblock = imported->pblock;
                 CBlock& block = *pblock;
-                blkdat >> block;
-                nRewind = blkdat.GetPos();
 
-                uint256 hash = block.GetHash();
+                const uint256& hash = imported->hash;
                 {
                     LOCK(cs_main);
                     // detect out of order blocks, and store them for later
@@ -5029,6 +5604,13 @@ bool LoadExternalBlockFile(const CChainParams& chainparams, FILE* fileIn, CDiskB
                 LogPrintf("%s: Deserialize or I/O error - %s\n", __func__, e.what());
             }
         }
+        int64_t nConnectMicros = GetTimeMicros() - nConnectStart - pipeline.nWaitMicros;
+        LogPrint(BCLog::REINDEX, "%s: scanned %d blocks in %.2fs, decoded %d in %.2fs on %d threads, connected in %.2fs after waiting %.2fs for blocks\n", __func__,
+                 pipeline.nScanned.load(), pipeline.nScanMicros.load() * MICRO, pipeline.nDecoded.load(), pipeline.nDecodeMicros.load() * MICRO, nThreads,
+                 nConnectMicros * MICRO, pipeline.nWaitMicros * MICRO);
+        statsClient.timing("LoadExternalBlockFile.scan_ms", pipeline.nScanMicros / 1000, 1.0f);
+        statsClient.timing("LoadExternalBlockFile.decode_ms", pipeline.nDecodeMicros / 1000, 1.0f);
+        statsClient.timing("LoadExternalBlockFile.connect_ms", nConnectMicros / 1000, 1.0f);
     } catch (const std::runtime_error& e) {
         AbortNode(std::string("System error: ") + e.what());
     }
@@ -5385,6 +5967,104 @@ bool DumpMempool(void)
     return true;
 }
 
+/**
+ * Cache entries only say that a script passed the checks of the binary that
+ * wrote them, so the dump is tied to the exact client build and discarded by
+ * any other
+ */
+static const uint64_t SCRIPT_CACHES_DUMP_VERSION = 2;
+
+bool LoadScriptCaches()
+{
+    int64_t nStart = GetTimeMillis();
+    FILE* filestr = fsbridge::fopen(GetDataDir() / "sigcache.dat", "rb");
+    CAutoFile file(filestr, SER_DISK, CLIENT_VERSION);
+    if (file.IsNull()) {
+        LogPrintf("Failed to open signature cache file from disk. Continuing anyway.\n");
+        return false;
+    }
+
+    uint256 sigCacheNonce, scriptCacheNonce;
+    std::vector<uint256> sigCacheEntries, scriptCacheEntries;
+    try {
+        uint64_t version;
+        file >> version;
+        if (version != SCRIPT_CACHES_DUMP_VERSION) {
+            LogPrintf("Discarding signature cache file with unknown version %u\n", version);
+            return false;
+        }
+        int nClientVersion;
+        std::string strClientBuild;
+        file >> nClientVersion >> strClientBuild;
+        if (nClientVersion != CLIENT_VERSION || strClientBuild != CLIENT_BUILD) {
+            LogPrintf("Discarding signature cache file written by %s %s\n", FormatVersion(nClientVersion), strClientBuild);
+            return false;
+        }
+        file >> sigCacheNonce >> sigCacheEntries;
+        file >> scriptCacheNonce >> scriptCacheEntries;
+    } catch (const std::exception& e) {
+        LogPrintf("Failed to deserialize signature cache data on disk: %s. Continuing anyway.\n", e.what());
+        return false;
+    }
+
+    LoadSignatureCache(sigCacheNonce, sigCacheEntries);
+    {
+        LOCK(cs_main);
+        // Like the signature cache, drop the entries made with the old nonce
+        scriptExecutionCache.setup(nScriptExecutionCacheElements);
+        scriptExecutionCacheNonce = scriptCacheNonce;
+        for (const uint256& entry : scriptCacheEntries) {
+            scriptExecutionCache.insert(entry);
+        }
+    }
+
+    LogPrintf("Imported %u signature cache and %u script execution cache entries from disk in %dms\n",
+              sigCacheEntries.size(), scriptCacheEntries.size(), GetTimeMillis() - nStart);
+    return true;
+}
+
+bool DumpScriptCaches()
+{
+    int64_t start = GetTimeMicros();
+
+    uint256 sigCacheNonce, scriptCacheNonce;
+    std::vector<uint256> sigCacheEntries, scriptCacheEntries;
+    DumpSignatureCache(sigCacheNonce, sigCacheEntries);
+    {
+        LOCK(cs_main);
+        scriptCacheNonce = scriptExecutionCacheNonce;
+        scriptExecutionCache.for_each([&](const uint256& entry) { scriptCacheEntries.push_back(entry); });
+    }
+
+    int64_t mid = GetTimeMicros();
+
+    try {
+        FILE* filestr = fsbridge::fopen(GetDataDir() / "sigcache.dat.new", "wb");
+        if (!filestr) {
+            return false;
+        }
+
+        CAutoFile file(filestr, SER_DISK, CLIENT_VERSION);
+
+        uint64_t version = SCRIPT_CACHES_DUMP_VERSION;
+        file << version;
+        file << CLIENT_VERSION << CLIENT_BUILD;
+        file << sigCacheNonce << sigCacheEntries;
+        file << scriptCacheNonce << scriptCacheEntries;
+
+        if (!FileCommit(file.Get()))
+            throw std::runtime_error("FileCommit failed");
+        file.fclose();
+        RenameOver(GetDataDir() / "sigcache.dat.new", GetDataDir() / "sigcache.dat");
+        int64_t last = GetTimeMicros();
+        LogPrintf("Dumped signature cache: %gs to copy, %gs to dump\n", (mid-start)*MICRO, (last-mid)*MICRO);
+    } catch (const std::exception& e) {
+        LogPrintf("Failed to dump signature cache: %s. Continuing anyway.\n", e.what());
+        return false;
+    }
+    return true;
+}
+
 //! Guess how far we are in the verification process at the given block index
 //! require cs_main if pindex has not been validated yet (because nChainTx might be unset)
 double GuessVerificationProgress(const ChainTxData& data, const CBlockIndex *pindex) {
@@ -5442,10 +6122,7 @@ class CMainCleanup
 public:
     CMainCleanup() {}
     ~CMainCleanup() {
-        // block headers
-        BlockMap::iterator it1 = mapBlockIndex.begin();
-        for (; it1 != mapBlockIndex.end(); it1++)
-            delete (*it1).second;
+        // block headers, the entries themselves are freed with their arena
         mapBlockIndex.clear();
     }
 } instance_of_cmaincleanup;
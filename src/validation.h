@@ -17,6 +17,7 @@
 #include <protocol.h> // For CMessageHeader::MessageStartChars
 #include <policy/feerate.h>
 #include <script/script_error.h>
+#include <script/sigcache.h>
 #include <sync.h>
 #include <versionbits.h>
 #include <spentindex.h>
@@ -38,6 +39,7 @@
 using namespace boost::placeholders;
 
 class CBlockIndex;
+class CBlockUndo;
 class CBlockTreeDB;
 class CChainParams;
 class CCoinsViewDB;
@@ -48,6 +50,7 @@ class CBlockPolicyEstimator;
 class CTxMemPool;
 class CValidationState;
 class PrecomputedTransactionData;
+struct CDiskTxPos;
 struct ChainTxData;
 
 struct LockPoints;
@@ -112,6 +115,8 @@ static const unsigned int BLOCK_DOWNLOAD_WINDOW = 1024;
 static const unsigned int DATABASE_WRITE_INTERVAL = 60 * 60;
 /** Time to wait (in seconds) between flushing chainstate to disk. */
 static const unsigned int DATABASE_FLUSH_INTERVAL = 24 * 60 * 60;
+/** Share of the coins cache budget that is kept when the cache has to be trimmed after a flush. */
+static const int COINS_CACHE_TRIM_PERCENT = 75;
 /** Maximum length of reject messages. */
 static const unsigned int MAX_REJECT_MESSAGE_LENGTH = 111;
 /** Block download timeout base, expressed in millionths of the block interval (i.e. 2.5 min) */
@@ -132,8 +137,20 @@ static const bool DEFAULT_ADDRESSINDEX = false;
 static const bool DEFAULT_TIMESTAMPINDEX = false;
 static const bool DEFAULT_SPENTINDEX = false;
 static const unsigned int DEFAULT_BANSCORE_THRESHOLD = 100;
+/** Default for -importthreads, 0 = one less than the number of cores */
+static const int DEFAULT_IMPORT_THREADS = 0;
+/** Maximum number of threads decoding blocks for -reindex and -loadblock */
+static const int MAX_IMPORT_THREADS = 16;
+/**
+ * Default for -mmapblockfiles. Off, because a mapped block file which is
+ * truncated or hits an I/O error while it's read kills the node with SIGBUS,
+ * where reading it with stdio fails the read.
+ */
+static const int DEFAULT_MMAP_BLOCK_FILES = 0;
 /** Default for -persistmempool */
 static const bool DEFAULT_PERSIST_MEMPOOL = true;
+/** Default for -persistsigcache */
+static const bool DEFAULT_PERSIST_SIGCACHE = true;
 /** Default for -syncmempool */
 static const bool DEFAULT_SYNC_MEMPOOL = true;
 
@@ -182,6 +199,7 @@ extern unsigned int nBytesPerSigOp;
 extern bool fCheckBlockIndex;
 extern bool fCheckpointsEnabled;
 extern size_t nCoinCacheUsage;
+extern bool fCoinsBackgroundFlush;
 /** A fee rate smaller than this is considered zero fee (for relaying, mining and transaction creation) */
 extern CFeeRate minRelayTxFee;
 /** Absolute maximum transaction fee (in duffs) used by wallet and mempool (rejects high fee in sendrawtransaction) */
@@ -274,7 +292,7 @@ bool CheckDiskSpace(uint64_t nAdditionalBytes = 0, bool blocks_dir = false);
 FILE* OpenBlockFile(const CDiskBlockPos &pos, bool fReadOnly = false);
 /** Translation to a filesystem path */
 fs::path GetBlockPosFilename(const CDiskBlockPos &pos, const char *prefix);
-/** Import blocks from an external file */
+/** Import blocks from an external file, decoding them on -importthreads threads */
 bool LoadExternalBlockFile(const CChainParams& chainparams, FILE* fileIn, CDiskBlockPos *dbp = nullptr);
 /** Ensures we have a genesis block in the block tree, possibly writing one to disk. */
 bool LoadGenesisBlock(const CChainParams& chainparams);
@@ -287,6 +305,12 @@ bool LoadChainTip(const CChainParams& chainparams);
 void UnloadBlockIndex();
 /** Run an instance of the script checking thread */
 void ThreadScriptCheck();
+/**
+ * Run script checks outside of block validation on the script checking
+ * threads, or inline if there are none. Waits while a block is being
+ * connected. Returns true if all of them pass.
+ */
+bool RunScriptChecks(std::vector<CScriptCheck>& vChecks);
 /** Check whether we are doing an initial block download (synchronizing from disk or network) */
 bool IsInitialBlockDownload();
 /** Retrieve a transaction (from memory pool, or from disk, if possible) */
@@ -394,13 +418,15 @@ private:
     unsigned int nIn;
     unsigned int nFlags;
     bool cacheStore;
+    //! Taken from the creating thread, checks may run on a script check thread
+    SigCacheCaller cacheCaller;
     ScriptError error;
     PrecomputedTransactionData *txdata;
 
 public:
-    CScriptCheck(): ptxTo(nullptr), nIn(0), nFlags(0), cacheStore(false), error(SCRIPT_ERR_UNKNOWN_ERROR) {}
+    CScriptCheck(): ptxTo(nullptr), nIn(0), nFlags(0), cacheStore(false), cacheCaller(SIGCACHE_MEMPOOL), error(SCRIPT_ERR_UNKNOWN_ERROR) {}
     CScriptCheck(const CTxOut& outIn, const CTransaction& txToIn, unsigned int nInIn, unsigned int nFlagsIn, bool cacheIn, PrecomputedTransactionData* txdataIn) :
-        m_tx_out(outIn), ptxTo(&txToIn), nIn(nInIn), nFlags(nFlagsIn), cacheStore(cacheIn), error(SCRIPT_ERR_UNKNOWN_ERROR), txdata(txdataIn) { }
+        m_tx_out(outIn), ptxTo(&txToIn), nIn(nInIn), nFlags(nFlagsIn), cacheStore(cacheIn), cacheCaller(GetSigCacheCaller()), error(SCRIPT_ERR_UNKNOWN_ERROR), txdata(txdataIn) { }
 
     bool operator()();
 
@@ -410,6 +436,7 @@ public:
         std::swap(nIn, check.nIn);
         std::swap(nFlags, check.nFlags);
         std::swap(cacheStore, check.cacheStore);
+        std::swap(cacheCaller, check.cacheCaller);
         std::swap(error, check.error);
         std::swap(txdata, check.txdata);
     }
@@ -424,13 +451,40 @@ bool GetAddressIndex(uint160 addressHash, int type,
                      int start = 0, int end = 0);
 bool GetAddressUnspent(uint160 addressHash, int type,
                        std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &unspentOutputs);
+/** Paginated variants, reading at most nLimit entries after pAfter (see CBlockTreeDB) */
+bool GetAddressIndexPage(uint160 addressHash, int type,
+                         std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex,
+                         int start, int end, const CAddressIndexKey* pAfter, size_t nLimit);
+bool GetAddressUnspentPage(uint160 addressHash, int type,
+                           std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &unspentOutputs,
+                           const CAddressUnspentKey* pAfter, size_t nLimit);
 /** Initializes the script-execution cache */
 void InitScriptExecutionCache();
+//! Resize the script execution cache to about nBytes, keeping the entries which still fit.
+//! Returns the number of elements it can store.
+size_t ResizeScriptExecutionCache(size_t nBytes);
+size_t GetScriptExecutionCacheElements();
+const CCacheHitStats& GetScriptExecutionCacheStats();
+
+/** Dump the signature and script execution caches to disk. */
+bool DumpScriptCaches();
+
+/** Load the signature and script execution caches from disk. */
+bool LoadScriptCaches();
 
 
 /** Functions for disk access for blocks */
 bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos, const Consensus::Params& consensusParams);
 bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex, const Consensus::Params& consensusParams);
+/** Read the serialized block as it is stored on disk, checking that its header matches the index and its transactions the merkle root */
+bool ReadRawBlockFromDisk(std::vector<uint8_t>& block, const CBlockIndex* pindex, const CMessageHeader::MessageStartChars& message_start);
+bool UndoReadFromDisk(CBlockUndo& blockundo, const CBlockIndex* pindex);
+/** Read the transaction at postx and the hash of the block containing it */
+bool ReadTxFromDisk(const CDiskTxPos& postx, CTransactionRef& tx, uint256& hashBlock);
+/** Read the transactions at positions, best ordered by file and offset. txs[i] is null if reading positions[i] failed. */
+void ReadTxsFromDisk(const std::vector<CDiskTxPos>& positions, std::vector<CTransactionRef>& txs, std::vector<uint256>& hashBlocks);
+/** Keep up to nMaxFiles block and undo files memory mapped for reading, 0 reads them with stdio */
+void SetMappedBlockFiles(size_t nMaxFiles);
 
 /** Functions for validating blocks and updating the block tree */
 
@@ -458,6 +512,9 @@ inline CBlockIndex* LookupBlockIndex(const uint256& hash)
     return it == mapBlockIndex.end() ? nullptr : it->second;
 }
 
+/** Allocate a block index entry which lives until the block index is unloaded, for entries put in mapBlockIndex */
+CBlockIndex* AllocateBlockIndex() EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+
 /** Find the last common block between the parameter chain and a locator. */
 CBlockIndex* FindForkInGlobalIndex(const CChain& chain, const CBlockLocator& locator);
 
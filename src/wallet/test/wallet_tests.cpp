@@ -11,6 +11,7 @@
 #include <utility>
 #include <vector>
 
+#include <coinjoin/coinjoin.h>
 #include <consensus/validation.h>
 #include <key_io.h>
 #include <rpc/server.h>
@@ -27,6 +28,38 @@ extern UniValue dumpwallet(const JSONRPCRequest& request);
 extern UniValue importwallet(const JSONRPCRequest& request);
 extern UniValue getnewaddress(const JSONRPCRequest& request);
 
+struct CWalletUTXOTest {
+    // The destination index has to hold exactly setWalletUTXO, and every output
+    // a full scan of mapWallet finds unspent and ours has to be in it
+    static void CheckUTXOIndexes(const CWallet& wallet)
+    {
+        LOCK2(cs_main, wallet.cs_wallet);
+        std::map<CTxDestination, std::set<COutPoint>> mapExpected;
+        for (const COutPoint& outpoint : wallet.setWalletUTXO) {
+            auto it = wallet.mapWallet.find(outpoint.hash);
+            BOOST_REQUIRE(it != wallet.mapWallet.end());
+            CTxDestination dest;
+            if (ExtractDestination(it->second.tx->vout[outpoint.n].scriptPubKey, dest)) {
+                mapExpected[dest].insert(outpoint);
+            }
+        }
+        BOOST_CHECK(mapExpected == wallet.mapWalletUTXOByDest);
+
+        for (const auto& entry : wallet.mapWallet) {
+            for (unsigned int i = 0; i < entry.second.tx->vout.size(); i++) {
+                const CTxOut& txout = entry.second.tx->vout[i];
+                if (!wallet.IsMine(txout) || wallet.IsSpent(entry.first, i)) {
+                    continue;
+                }
+                CTxDestination dest;
+                BOOST_REQUIRE(ExtractDestination(txout.scriptPubKey, dest));
+                auto it = wallet.mapWalletUTXOByDest.find(dest);
+                BOOST_CHECK(it != wallet.mapWalletUTXOByDest.end() && it->second.count(COutPoint(entry.first, i)));
+            }
+        }
+    }
+};
+
 BOOST_FIXTURE_TEST_SUITE(wallet_tests, WalletTestingSetup)
 
 static void AddKey(CWallet& wallet, const CKey& key)
@@ -208,7 +241,7 @@ static int64_t AddTx(CWallet& wallet, uint32_t lockTime, int64_t mockTime, int64
     CBlockIndex* block = nullptr;
     if (blockTime > 0) {
         LOCK(cs_main);
-        auto inserted = mapBlockIndex.emplace(GetRandHash(), new CBlockIndex);
+        auto inserted = mapBlockIndex.emplace(GetRandHash(), AllocateBlockIndex());
         assert(inserted.second);
         const uint256& hash = inserted.first->first;
         block = inserted.first->second;
@@ -369,6 +402,230 @@ BOOST_FIXTURE_TEST_CASE(ListCoins, ListCoinsTestingSetup)
     BOOST_CHECK_EQUAL(list.begin()->second.size(), 2);
 }
 
+// Check that the cached balances are recomputed after the wallet changes
+BOOST_FIXTURE_TEST_CASE(cached_balances, ListCoinsTestingSetup)
+{
+    BOOST_CHECK_EQUAL(500 * COIN, wallet->GetBalance());
+    BOOST_CHECK_EQUAL(0, wallet->GetUnconfirmedBalance());
+
+    // Spending the coin has to invalidate the cached value
+    AddTx(CRecipient{GetScriptForRawPubKey({}), 1 * COIN, false /* subtract fee */});
+    CAmount nBalance = wallet->GetBalance();
+    BOOST_CHECK(nBalance < 499 * COIN);
+    BOOST_CHECK_EQUAL(nBalance, wallet->GetAvailableBalance());
+
+    // Repeated queries are served from the cache, which stays valid while
+    // nothing marks the balances dirty
+    uint64_t nGeneration = wallet->GetBalancesGeneration();
+    BOOST_CHECK_EQUAL(nBalance, wallet->GetBalance());
+    BOOST_CHECK_EQUAL(nBalance, wallet->GetAvailableBalance());
+    BOOST_CHECK_EQUAL(nGeneration, wallet->GetBalancesGeneration());
+
+    // Recomputing after MarkDirty() gives the same result
+    wallet->MarkDirty();
+    BOOST_CHECK(wallet->GetBalancesGeneration() != nGeneration);
+    BOOST_CHECK_EQUAL(nBalance, wallet->GetBalance());
+
+    // Connecting a block invalidates the cache
+    CBlock block = CreateAndProcessBlock({}, GetScriptForRawPubKey({}));
+    nGeneration = wallet->GetBalancesGeneration();
+    const CBlockIndex* pindexTip;
+    {
+        LOCK(cs_main);
+        pindexTip = chainActive.Tip();
+    }
+    wallet->BlockConnected(std::make_shared<const CBlock>(block), pindexTip, {});
+    BOOST_CHECK(wallet->GetBalancesGeneration() != nGeneration);
+    nBalance = wallet->GetBalance();
+
+    // So do locking and unlocking a coin
+    COutPoint outpoint;
+    {
+        LOCK2(cs_main, wallet->cs_wallet);
+        std::vector<COutput> available;
+        wallet->AvailableCoins(available);
+        BOOST_REQUIRE(!available.empty());
+        outpoint = COutPoint(available[0].tx->GetHash(), available[0].i);
+    }
+    nGeneration = wallet->GetBalancesGeneration();
+    {
+        LOCK(wallet->cs_wallet);
+        wallet->LockCoin(outpoint);
+    }
+    BOOST_CHECK(wallet->GetBalancesGeneration() != nGeneration);
+    nGeneration = wallet->GetBalancesGeneration();
+    {
+        LOCK(wallet->cs_wallet);
+        wallet->UnlockCoin(outpoint);
+    }
+    BOOST_CHECK(wallet->GetBalancesGeneration() != nGeneration);
+    BOOST_CHECK_EQUAL(nBalance, wallet->GetBalance());
+}
+
+// Check that the wallet UTXOs grouped by destination follow spends, abandoned
+// transactions and conflicts
+BOOST_FIXTURE_TEST_CASE(wallet_utxo_by_dest, ListCoinsTestingSetup)
+{
+    CWalletUTXOTest::CheckUTXOIndexes(*wallet);
+
+    // Spend a coin, sending part of it back to us
+    AddTx(CRecipient{GetScriptForRawPubKey(coinbaseKey.GetPubKey()), 10 * COIN, false /* subtract fee */});
+    CWalletUTXOTest::CheckUTXOIndexes(*wallet);
+
+    // Outputs spent by a transaction that is abandoned are unspent again
+    CTransactionRef tx;
+    {
+        CReserveKey reservekey(wallet.get());
+        CAmount fee;
+        int changePos = -1;
+        std::string error;
+        CCoinControl dummy;
+        BOOST_REQUIRE(wallet->CreateTransaction({CRecipient{GetScriptForRawPubKey({}), 1 * COIN, false}}, tx, reservekey, fee, changePos, error, dummy));
+    }
+    {
+        LOCK2(cs_main, wallet->cs_wallet);
+        BOOST_CHECK(wallet->AddToWallet(CWalletTx(wallet.get(), tx)));
+    }
+    CWalletUTXOTest::CheckUTXOIndexes(*wallet);
+    BOOST_CHECK(wallet->AbandonTransaction(tx->GetHash()));
+    CWalletUTXOTest::CheckUTXOIndexes(*wallet);
+
+    // A transaction spending two of our coins is conflicted by a block that
+    // spends only one of them, the other one is unspent again
+    std::vector<COutput> available;
+    {
+        LOCK2(cs_main, wallet->cs_wallet);
+        wallet->AvailableCoins(available);
+    }
+    BOOST_REQUIRE(available.size() >= 2);
+    CMutableTransaction txSpendBoth;
+    txSpendBoth.vin.emplace_back(available[0].tx->GetHash(), available[0].i);
+    txSpendBoth.vin.emplace_back(available[1].tx->GetHash(), available[1].i);
+    txSpendBoth.vout.emplace_back(available[0].tx->tx->vout[available[0].i].nValue, GetScriptForRawPubKey({}));
+    CMutableTransaction txSpendOne;
+    txSpendOne.vin.emplace_back(available[0].tx->GetHash(), available[0].i);
+    txSpendOne.vout.emplace_back(available[0].tx->tx->vout[available[0].i].nValue / 2, GetScriptForRawPubKey({}));
+    {
+        LOCK2(cs_main, wallet->cs_wallet);
+        BOOST_REQUIRE(wallet->SignTransaction(txSpendBoth));
+        BOOST_REQUIRE(wallet->SignTransaction(txSpendOne));
+        BOOST_CHECK(wallet->AddToWallet(CWalletTx(wallet.get(), MakeTransactionRef(txSpendBoth))));
+    }
+    CWalletUTXOTest::CheckUTXOIndexes(*wallet);
+
+    CBlock block = CreateAndProcessBlock({txSpendOne}, GetScriptForRawPubKey({}));
+    const CBlockIndex* pindexBlock;
+    {
+        LOCK(cs_main);
+        pindexBlock = chainActive.Tip();
+        BOOST_REQUIRE(pindexBlock->GetBlockHash() == block.GetHash());
+    }
+    wallet->BlockConnected(std::make_shared<const CBlock>(block), pindexBlock, {});
+    BOOST_CHECK(!wallet->IsSpent(available[1].tx->GetHash(), available[1].i));
+    CWalletUTXOTest::CheckUTXOIndexes(*wallet);
+
+    // And the block is disconnected again
+    {
+        LOCK(cs_main);
+        CValidationState state;
+        BOOST_REQUIRE(InvalidateBlock(state, Params(), const_cast<CBlockIndex*>(pindexBlock)));
+    }
+    wallet->BlockDisconnected(std::make_shared<const CBlock>(block), pindexBlock);
+    CWalletUTXOTest::CheckUTXOIndexes(*wallet);
+}
+
+// The outputs AvailableCoins() returned before it went through the amount
+// buckets, found by checking every output of every wallet transaction
+static std::set<COutPoint> AvailableCoinsFullScan(const CWallet& wallet, CoinType nCoinType)
+{
+    AssertLockHeld(cs_main);
+    AssertLockHeld(wallet.cs_wallet);
+
+    std::set<COutPoint> setCoins;
+    for (const auto& entry : wallet.mapWallet) {
+        const CWalletTx& wtx = entry.second;
+        if (!CheckFinalTx(*wtx.tx) || (wtx.IsCoinBase() && wtx.GetBlocksToMaturity() > 0)) continue;
+        if ((wtx.GetDepthInMainChain() == 0 && !wtx.InMempool()) || !wtx.IsTrusted()) continue;
+
+        for (unsigned int i = 0; i < wtx.tx->vout.size(); i++) {
+            const COutPoint outpoint(entry.first, i);
+            const CAmount nValue = wtx.tx->vout[i].nValue;
+            bool found;
+            switch (nCoinType) {
+            case CoinType::ONLY_FULLY_MIXED:
+                found = CCoinJoin::IsDenominatedAmount(nValue) && wallet.IsFullyMixed(outpoint);
+                break;
+            case CoinType::ONLY_READY_TO_MIX:
+                found = CCoinJoin::IsDenominatedAmount(nValue) && !wallet.IsFullyMixed(outpoint);
+                break;
+            case CoinType::ONLY_NONDENOMINATED:
+                found = !CCoinJoin::IsCollateralAmount(nValue) && !CCoinJoin::IsDenominatedAmount(nValue);
+                break;
+            case CoinType::ONLY_MASTERNODE_COLLATERAL:
+                found = nValue == Params().GetConsensus().nMasternodeCollateral;
+                break;
+            case CoinType::ONLY_COINJOIN_COLLATERAL:
+                found = CCoinJoin::IsCollateralAmount(nValue);
+                break;
+            default:
+                found = true;
+            }
+            if (!found) continue;
+            if (wallet.IsLockedCoin(entry.first, i) && nCoinType != CoinType::ONLY_MASTERNODE_COLLATERAL) continue;
+            if (wallet.IsSpent(entry.first, i) || wallet.IsMine(wtx.tx->vout[i]) == ISMINE_NO) continue;
+            setCoins.insert(outpoint);
+        }
+    }
+    return setCoins;
+}
+
+// AvailableCoins() only visits the buckets an amount can match, it has to find
+// the same outputs as a full scan for every coin type
+BOOST_FIXTURE_TEST_CASE(available_coins_buckets, ListCoinsTestingSetup)
+{
+    CScript scriptPubKey = GetScriptForRawPubKey(coinbaseKey.GetPubKey());
+    CMutableTransaction tx;
+    tx.vin.emplace_back(InsecureRand256(), 0);
+    for (CAmount nValue : CCoinJoin::GetStandardDenominations()) {
+        tx.vout.emplace_back(nValue, scriptPubKey);
+        tx.vout.emplace_back(nValue + 1, scriptPubKey);
+    }
+    tx.vout.emplace_back(CCoinJoin::GetCollateralAmount(), scriptPubKey);
+    tx.vout.emplace_back(CCoinJoin::GetMaxCollateralAmount(), scriptPubKey);
+    tx.vout.emplace_back(CCoinJoin::GetMaxCollateralAmount() + 1, scriptPubKey);
+    tx.vout.emplace_back(Params().GetConsensus().nMasternodeCollateral, scriptPubKey);
+    tx.vout.emplace_back(Params().GetConsensus().nMasternodeCollateral, scriptPubKey);
+    tx.vout.emplace_back(3 * COIN, scriptPubKey);
+    tx.vout.emplace_back(3 * COIN, GetScriptForRawPubKey({}));
+
+    LOCK2(cs_main, wallet->cs_wallet);
+    CWalletTx wtx(wallet.get(), MakeTransactionRef(tx));
+    wtx.hashBlock = chainActive.Tip()->GetBlockHash();
+    wtx.nIndex = 0;
+    BOOST_CHECK(wallet->AddToWallet(wtx));
+
+    // Locked coins are only returned as masternode collaterals
+    const size_t nOutputs = tx.vout.size();
+    wallet->LockCoin(COutPoint(tx.GetHash(), nOutputs - 3));
+    wallet->LockCoin(COutPoint(tx.GetHash(), nOutputs - 2));
+
+    for (int i = (int)CoinType::MIN_COIN_TYPE; i <= (int)CoinType::MAX_COIN_TYPE; i++) {
+        CCoinControl coinControl;
+        coinControl.nCoinType = (CoinType)i;
+        std::vector<COutput> vCoins;
+        wallet->AvailableCoins(vCoins, true, &coinControl);
+
+        std::set<COutPoint> setCoins;
+        for (const COutput& out : vCoins) {
+            BOOST_CHECK(setCoins.emplace(out.tx->GetHash(), out.i).second);
+        }
+        BOOST_CHECK(setCoins == AvailableCoinsFullScan(*wallet, (CoinType)i));
+        if (coinControl.nCoinType != CoinType::ONLY_FULLY_MIXED) {
+            BOOST_CHECK(!setCoins.empty());
+        }
+    }
+}
+
 class CreateTransactionTestSetup : public TestChain100Setup
 {
 public:
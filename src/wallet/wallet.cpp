@@ -781,10 +781,85 @@ bool CWallet::IsSpent(const uint256& hash, unsigned int n) const
     return false;
 }
 
+CWallet::UTXOBucket CWallet::GetUTXOBucket(CAmount nValue)
+{
+    if (CCoinJoin::IsDenominatedAmount(nValue)) {
+        return UTXO_DENOMINATED;
+    }
+    if (CCoinJoin::IsCollateralAmount(nValue)) {
+        return UTXO_COINJOIN_COLLATERAL;
+    }
+    if (nValue == Params().GetConsensus().nMasternodeCollateral) {
+        return UTXO_MASTERNODE_COLLATERAL;
+    }
+    return UTXO_OTHER;
+}
+
+bool CWallet::AddWalletUTXO(const COutPoint& outpoint, const CTxOut& txout)
+{
+    AssertLockHeld(cs_wallet);
+    if (!setWalletUTXO.insert(outpoint).second) {
+        return false;
+    }
+    arrWalletUTXOByBucket[GetUTXOBucket(txout.nValue)].insert(outpoint);
+    CTxDestination txdest;
+    if (ExtractDestination(txout.scriptPubKey, txdest)) {
+        mapWalletUTXOByDest[txdest].insert(outpoint);
+    }
+    return true;
+}
+
+void CWallet::RemoveWalletUTXO(const COutPoint& outpoint)
+{
+    AssertLockHeld(cs_wallet);
+    if (setWalletUTXO.erase(outpoint) == 0) {
+        return;
+    }
+    auto it = mapWallet.find(outpoint.hash);
+    CTxDestination txdest;
+    if (it != mapWallet.end()) {
+        const CTxOut& txout = it->second.tx->vout[outpoint.n];
+        arrWalletUTXOByBucket[GetUTXOBucket(txout.nValue)].erase(outpoint);
+        if (!ExtractDestination(txout.scriptPubKey, txdest)) {
+            return;
+        }
+        auto itDest = mapWalletUTXOByDest.find(txdest);
+        if (itDest != mapWalletUTXOByDest.end() && itDest->second.erase(outpoint) && itDest->second.empty()) {
+            mapWalletUTXOByDest.erase(itDest);
+        }
+        return;
+    }
+    // the transaction is gone (zapped), look for the outpoint the slow way
+    for (auto& setBucket : arrWalletUTXOByBucket) {
+        setBucket.erase(outpoint);
+    }
+    for (auto itDest = mapWalletUTXOByDest.begin(); itDest != mapWalletUTXOByDest.end(); ++itDest) {
+        if (itDest->second.erase(outpoint)) {
+            if (itDest->second.empty()) {
+                mapWalletUTXOByDest.erase(itDest);
+            }
+            return;
+        }
+    }
+}
+
+void CWallet::RestoreWalletUTXO(const COutPoint& outpoint, const CWalletTx& wtxPrev)
+{
+    AssertLockHeld(cs_wallet);
+    if (outpoint.n >= wtxPrev.tx->vout.size()) {
+        return;
+    }
+    const CTxOut& txout = wtxPrev.tx->vout[outpoint.n];
+    if (IsMine(txout) && !IsSpent(outpoint.hash, outpoint.n)) {
+        AddWalletUTXO(outpoint, txout);
+    }
+}
+
 void CWallet::AddToSpends(const COutPoint& outpoint, const uint256& wtxid)
 {
     mapTxSpends.insert(std::make_pair(outpoint, wtxid));
-    setWalletUTXO.erase(outpoint);
+    RemoveWalletUTXO(outpoint);
+    MarkBalancesDirty();
 
     setLockedCoins.erase(outpoint);
 
@@ -1106,6 +1181,7 @@ void CWallet::MarkDirty()
 
     fAnonymizableTallyCached = false;
     fAnonymizableTallyCachedNonDenom = false;
+    MarkBalancesDirty();
 }
 
 bool CWallet::AddToWallet(const CWalletTx& wtxIn, bool fFlushOnClose)
@@ -1132,7 +1208,7 @@ bool CWallet::AddToWallet(const CWalletTx& wtxIn, bool fFlushOnClose)
         auto mnList = deterministicMNManager->GetListAtChainTip();
         for(unsigned int i = 0; i < wtx.tx->vout.size(); ++i) {
             if (IsMine(wtx.tx->vout[i]) && !IsSpent(hash, i)) {
-                setWalletUTXO.insert(COutPoint(hash, i));
+                AddWalletUTXO(COutPoint(hash, i), wtx.tx->vout[i]);
                 if (deterministicMNManager->IsProTxWithCollateral(wtx.tx, i) || mnList.HasMNByCollateral(COutPoint(hash, i))) {
                     LockCoin(COutPoint(hash, i));
                 }
@@ -1169,7 +1245,7 @@ bool CWallet::AddToWallet(const CWalletTx& wtxIn, bool fFlushOnClose)
         auto mnList = deterministicMNManager->GetListAtChainTip();
         for (unsigned int i = 0; i < wtx.tx->vout.size(); ++i) {
             if (IsMine(wtx.tx->vout[i]) && !IsSpent(hash, i)) {
-                bool new_utxo = setWalletUTXO.insert(COutPoint(hash, i)).second;
+                bool new_utxo = AddWalletUTXO(COutPoint(hash, i), wtx.tx->vout[i]);
                 if (new_utxo && (deterministicMNManager->IsProTxWithCollateral(wtx.tx, i) || mnList.HasMNByCollateral(COutPoint(hash, i)))) {
                     LockCoin(COutPoint(hash, i));
                 }
@@ -1204,6 +1280,7 @@ bool CWallet::AddToWallet(const CWalletTx& wtxIn, bool fFlushOnClose)
 
     fAnonymizableTallyCached = false;
     fAnonymizableTallyCachedNonDenom = false;
+    MarkBalancesDirty();
 
     return true;
 }
@@ -1218,6 +1295,7 @@ bool CWallet::LoadToWallet(const CWalletTx& wtxIn)
         wtx.m_it_wtxOrdered = wtxOrdered.insert(std::make_pair(wtx.nOrderPos, TxPair(&wtx, nullptr)));
     }
     AddToSpends(hash);
+    MarkBalancesDirty();
     for (const CTxIn& txin : wtx.tx->vin) {
         auto it = mapWallet.find(txin.prevout.hash);
         if (it != mapWallet.end()) {
@@ -1374,6 +1452,7 @@ bool CWallet::AbandonTransaction(const uint256& hashTx)
                 auto it = mapWallet.find(txin.prevout.hash);
                 if (it != mapWallet.end()) {
                     it->second.MarkDirty();
+                    RestoreWalletUTXO(txin.prevout, it->second);
                 }
             }
         }
@@ -1381,6 +1460,7 @@ bool CWallet::AbandonTransaction(const uint256& hashTx)
 
     fAnonymizableTallyCached = false;
     fAnonymizableTallyCachedNonDenom = false;
+    MarkBalancesDirty();
 
     return true;
 }
@@ -1438,6 +1518,7 @@ void CWallet::MarkConflicted(const uint256& hashBlock, const uint256& hashTx)
                 auto it = mapWallet.find(txin.prevout.hash);
                 if (it != mapWallet.end()) {
                     it->second.MarkDirty();
+                    RestoreWalletUTXO(txin.prevout, it->second);
                 }
             }
         }
@@ -1445,6 +1526,7 @@ void CWallet::MarkConflicted(const uint256& hashBlock, const uint256& hashTx)
 
     fAnonymizableTallyCached = false;
     fAnonymizableTallyCachedNonDenom = false;
+    MarkBalancesDirty();
 }
 
 void CWallet::SyncTransaction(const CTransactionRef& ptx, const CBlockIndex *pindex, int posInBlock) {
@@ -1465,6 +1547,7 @@ void CWallet::SyncTransaction(const CTransactionRef& ptx, const CBlockIndex *pin
 
     fAnonymizableTallyCached = false;
     fAnonymizableTallyCachedNonDenom = false;
+    MarkBalancesDirty();
 }
 
 void CWallet::TransactionAddedToMempool(const CTransactionRef& ptx, int64_t nAcceptTime) {
@@ -1474,6 +1557,7 @@ void CWallet::TransactionAddedToMempool(const CTransactionRef& ptx, int64_t nAcc
     auto it = mapWallet.find(ptx->GetHash());
     if (it != mapWallet.end()) {
         it->second.fInMempool = true;
+        MarkBalancesDirty();
     }
 }
 
@@ -1483,6 +1567,7 @@ void CWallet::TransactionRemovedFromMempool(const CTransactionRef &ptx, MemPoolR
         auto it = mapWallet.find(ptx->GetHash());
         if (it != mapWallet.end()) {
             it->second.fInMempool = false;
+            MarkBalancesDirty();
         }
     }
 }
@@ -1540,6 +1625,7 @@ void CWallet::BlockConnected(const std::shared_ptr<const CBlock>& pblock, const
     // reset cache to make sure no longer immature coins are included
     fAnonymizableTallyCached = false;
     fAnonymizableTallyCachedNonDenom = false;
+    MarkBalancesDirty();
 }
 
 void CWallet::BlockDisconnected(const std::shared_ptr<const CBlock>& pblock, const CBlockIndex* pindexDisconnected) {
@@ -1553,6 +1639,7 @@ void CWallet::BlockDisconnected(const std::shared_ptr<const CBlock>& pblock, con
     // reset cache to make sure no longer mature coins are excluded
     fAnonymizableTallyCached = false;
     fAnonymizableTallyCachedNonDenom = false;
+    MarkBalancesDirty();
 }
 
 
@@ -2694,21 +2781,51 @@ std::unordered_set<const CWalletTx*, WalletTxHasher> CWallet::GetSpendableTXs()
     return ret;
 }
 
-CAmount CWallet::GetBalance(const isminefilter& filter, const int min_depth, const bool fAddLocked) const
+CAmount CWallet::GetCachedBalance(BalanceType type, const isminefilter& filter, int min_depth, bool fAddLocked) const
 {
+    const auto key = std::make_tuple(type, filter, min_depth, fAddLocked);
+    {
+        LOCK(cs_balances);
+        auto it = mapCachedBalances.find(key);
+        if (it != mapCachedBalances.end() && it->second.first == nBalancesGeneration) {
+            return it->second.second;
+        }
+    }
+
+    // Read before computing, a change while we compute leaves the result stale and it's computed again next time
+    uint64_t nGeneration = nBalancesGeneration;
     CAmount nTotal = 0;
     {
         LOCK2(cs_main, cs_wallet);
         for (auto pcoin : GetSpendableTXs()) {
-            if (pcoin->IsTrusted() && ((pcoin->GetDepthInMainChain() >= min_depth) || (fAddLocked && pcoin->IsLockedByInstantSend()))) {
-                nTotal += pcoin->GetAvailableCredit(true, filter);
+            switch (type) {
+            case BalanceType::TRUSTED:
+                if (pcoin->IsTrusted() && ((pcoin->GetDepthInMainChain() >= min_depth) || (fAddLocked && pcoin->IsLockedByInstantSend()))) {
+                    nTotal += pcoin->GetAvailableCredit(true, filter);
+                }
+                break;
+            case BalanceType::UNCONFIRMED:
+                if (!pcoin->IsTrusted() && pcoin->GetDepthInMainChain() == 0 && !pcoin->IsLockedByInstantSend() && pcoin->InMempool()) {
+                    nTotal += pcoin->GetAvailableCredit(true, filter);
+                }
+                break;
+            case BalanceType::IMMATURE:
+                nTotal += (filter & ISMINE_WATCH_ONLY) ? pcoin->GetImmatureWatchOnlyCredit() : pcoin->GetImmatureCredit();
+                break;
             }
         }
     }
 
+    LOCK(cs_balances);
+    mapCachedBalances[key] = std::make_pair(nGeneration, nTotal);
     return nTotal;
 }
 
+CAmount CWallet::GetBalance(const isminefilter& filter, const int min_depth, const bool fAddLocked) const
+{
+    return GetCachedBalance(BalanceType::TRUSTED, filter, min_depth, fAddLocked);
+}
+
 CAmount CWallet::GetAnonymizableBalance(bool fSkipDenominated, bool fSkipUnconfirmed) const
 {
     if (!CCoinJoinClientOptions::IsEnabled()) return 0;
@@ -2809,52 +2926,22 @@ CAmount CWallet::GetDenominatedBalance(bool unconfirmed) const
 
 CAmount CWallet::GetUnconfirmedBalance() const
 {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (auto pcoin : GetSpendableTXs()) {
-            if (!pcoin->IsTrusted() && pcoin->GetDepthInMainChain() == 0 && !pcoin->IsLockedByInstantSend() && pcoin->InMempool())
-                nTotal += pcoin->GetAvailableCredit();
-        }
-    }
-    return nTotal;
+    return GetCachedBalance(BalanceType::UNCONFIRMED, ISMINE_SPENDABLE, 0, false);
 }
 
 CAmount CWallet::GetImmatureBalance() const
 {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (auto pcoin : GetSpendableTXs()) {
-            nTotal += pcoin->GetImmatureCredit();
-        }
-    }
-    return nTotal;
+    return GetCachedBalance(BalanceType::IMMATURE, ISMINE_SPENDABLE, 0, false);
 }
 
 CAmount CWallet::GetUnconfirmedWatchOnlyBalance() const
 {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (auto pcoin : GetSpendableTXs()) {
-            if (!pcoin->IsTrusted() && pcoin->GetDepthInMainChain() == 0 && !pcoin->IsLockedByInstantSend() && pcoin->InMempool())
-                nTotal += pcoin->GetAvailableCredit(true, ISMINE_WATCH_ONLY);
-        }
-    }
-    return nTotal;
+    return GetCachedBalance(BalanceType::UNCONFIRMED, ISMINE_WATCH_ONLY, 0, false);
 }
 
 CAmount CWallet::GetImmatureWatchOnlyBalance() const
 {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (auto pcoin : GetSpendableTXs()) {
-            nTotal += pcoin->GetImmatureWatchOnlyCredit();
-        }
-    }
-    return nTotal;
+    return GetCachedBalance(BalanceType::IMMATURE, ISMINE_WATCH_ONLY, 0, false);
 }
 
 // Calculate total balance in a different way from GetBalance. The biggest
@@ -2923,34 +3010,75 @@ void CWallet::AvailableCoins(std::vector<COutput> &vCoins, bool fOnlySafe, const
     vCoins.clear();
     CoinType nCoinType = coinControl ? coinControl->nCoinType : CoinType::ALL_COINS;
 
+    // Only visit the unspent outputs whose amount can match the coin type
+    std::vector<UTXOBucket> vecBuckets;
+    switch (nCoinType) {
+    case CoinType::ONLY_FULLY_MIXED:
+    case CoinType::ONLY_READY_TO_MIX:
+        vecBuckets = {UTXO_DENOMINATED};
+        break;
+    case CoinType::ONLY_NONDENOMINATED:
+        vecBuckets = {UTXO_MASTERNODE_COLLATERAL, UTXO_OTHER};
+        break;
+    case CoinType::ONLY_MASTERNODE_COLLATERAL:
+        vecBuckets = {UTXO_MASTERNODE_COLLATERAL};
+        break;
+    case CoinType::ONLY_COINJOIN_COLLATERAL:
+        vecBuckets = {UTXO_COINJOIN_COLLATERAL};
+        break;
+    default:
+        vecBuckets = {UTXO_DENOMINATED, UTXO_COINJOIN_COLLATERAL, UTXO_MASTERNODE_COLLATERAL, UTXO_OTHER};
+        break;
+    }
+
     CAmount nTotal = 0;
 
-    for (auto pcoin : GetSpendableTXs()) {
-        const uint256& wtxid = pcoin->GetHash();
+    for (const auto bucket : vecBuckets) {
+        // outpoints are sorted by hash, the checks of a transaction are done once for all of its outputs
+        uint256 hashLastTx;
+        const CWalletTx* pcoin = nullptr;
+        int nDepth = 0;
+        bool safeTx = false;
 
-        if (!CheckFinalTx(*pcoin->tx))
-            continue;
+        for (const auto& outpoint : arrWalletUTXOByBucket[bucket]) {
+            const uint256& wtxid = outpoint.hash;
+            const unsigned int i = outpoint.n;
 
-        if (pcoin->IsCoinBase() && pcoin->GetBlocksToMaturity() > 0)
-            continue;
+            if (hashLastTx.IsNull() || wtxid != hashLastTx) {
+                hashLastTx = wtxid;
+                pcoin = nullptr;
 
-        int nDepth = pcoin->GetDepthInMainChain();
+                const auto it = mapWallet.find(wtxid);
+                if (it == mapWallet.end())
+                    continue;
+                const CWalletTx* pcoinTmp = &it->second;
 
-        // We should not consider coins which aren't at least in our mempool
-        // It's possible for these to be conflicted via ancestors which we may never be able to detect
-        if (nDepth == 0 && !pcoin->InMempool())
-            continue;
+                if (!CheckFinalTx(*pcoinTmp->tx))
+                    continue;
 
-        bool safeTx = pcoin->IsTrusted();
+                if (pcoinTmp->IsCoinBase() && pcoinTmp->GetBlocksToMaturity() > 0)
+                    continue;
 
-        if (fOnlySafe && !safeTx) {
-            continue;
-        }
+                nDepth = pcoinTmp->GetDepthInMainChain();
 
-        if (nDepth < nMinDepth || nDepth > nMaxDepth)
-            continue;
+                // We should not consider coins which aren't at least in our mempool
+                // It's possible for these to be conflicted via ancestors which we may never be able to detect
+                if (nDepth == 0 && !pcoinTmp->InMempool())
+                    continue;
+
+                safeTx = pcoinTmp->IsTrusted();
+
+                if (fOnlySafe && !safeTx) {
+                    continue;
+                }
+
+                if (nDepth < nMinDepth || nDepth > nMaxDepth)
+                    continue;
+
+                pcoin = pcoinTmp;
+            }
+            if (pcoin == nullptr) continue;
 
-        for (unsigned int i = 0; i < pcoin->tx->vout.size(); i++) {
             bool found = false;
             if (nCoinType == CoinType::ONLY_FULLY_MIXED) {
                 if (!CCoinJoin::IsDenominatedAmount(pcoin->tx->vout[i].nValue)) continue;
@@ -3389,62 +3517,52 @@ bool CWallet::SelectCoinsGroupedByAddresses(std::vector<CompactTallyItem>& vecTa
 
     CAmount nSmallestDenom = CCoinJoin::GetSmallestDenomination();
 
-    // Tally
-    std::map<CTxDestination, CompactTallyItem> mapTally;
-    std::set<uint256> setWalletTxesCounted;
-    for (const auto& outpoint : setWalletUTXO) {
-
-        if (!setWalletTxesCounted.emplace(outpoint.hash).second) continue;
-
-        std::map<uint256, CWalletTx>::const_iterator it = mapWallet.find(outpoint.hash);
-        if (it == mapWallet.end()) continue;
+    // Tally, per destination so ownership is checked once per address and spent outputs aren't visited
+    // NOTE: vecTallyRet is "sorted" by txdest (i.e. address), just like mapWalletUTXOByDest
+    vecTallyRet.clear();
+    for (const auto& destPair : mapWalletUTXOByDest) {
+        const CTxDestination& txdest = destPair.first;
 
-        const CWalletTx& wtx = (*it).second;
+        isminefilter mine = ::IsMine(*this, txdest);
+        if(!(mine & filter)) continue;
 
-        if(wtx.IsCoinBase() && wtx.GetBlocksToMaturity() > 0) continue;
-        if(fSkipUnconfirmed && !wtx.IsTrusted()) continue;
-        if (wtx.GetDepthInMainChain() < 0) continue;
+        CompactTallyItem item;
+        item.txdest = txdest;
+        for (const auto& outpoint : destPair.second) {
+            if (nMaxOupointsPerAddress != -1 && item.vecInputCoins.size() >= (size_t)nMaxOupointsPerAddress) break;
 
-        for (unsigned int i = 0; i < wtx.tx->vout.size(); i++) {
-            CTxDestination txdest;
-            if (!ExtractDestination(wtx.tx->vout[i].scriptPubKey, txdest)) continue;
+            std::map<uint256, CWalletTx>::const_iterator it = mapWallet.find(outpoint.hash);
+            if (it == mapWallet.end()) continue;
 
-            isminefilter mine = ::IsMine(*this, txdest);
-            if(!(mine & filter)) continue;
+            const CWalletTx& wtx = (*it).second;
+            const CTxOut& txout = wtx.tx->vout[outpoint.n];
 
-            auto itTallyItem = mapTally.find(txdest);
-            if (nMaxOupointsPerAddress != -1 && itTallyItem != mapTally.end() && itTallyItem->second.vecInputCoins.size() >= nMaxOupointsPerAddress) continue;
+            if(wtx.IsCoinBase() && wtx.GetBlocksToMaturity() > 0) continue;
+            if(fSkipUnconfirmed && !wtx.IsTrusted()) continue;
+            if (wtx.GetDepthInMainChain() < 0) continue;
 
-            if(IsSpent(outpoint.hash, i) || IsLockedCoin(outpoint.hash, i)) continue;
+            if(IsSpent(outpoint.hash, outpoint.n) || IsLockedCoin(outpoint.hash, outpoint.n)) continue;
 
-            if(fSkipDenominated && CCoinJoin::IsDenominatedAmount(wtx.tx->vout[i].nValue)) continue;
+            if(fSkipDenominated && CCoinJoin::IsDenominatedAmount(txout.nValue)) continue;
 
             if(fAnonymizable) {
                 // ignore collaterals
-                if(CCoinJoin::IsCollateralAmount(wtx.tx->vout[i].nValue)) continue;
-                if(fMasternodeMode && wtx.tx->vout[i].nValue == Params().GetConsensus().nMasternodeCollateral) continue;
+                if(CCoinJoin::IsCollateralAmount(txout.nValue)) continue;
+                if(fMasternodeMode && txout.nValue == Params().GetConsensus().nMasternodeCollateral) continue;
                 // ignore outputs that are 10 times smaller then the smallest denomination
                 // otherwise they will just lead to higher fee / lower priority
-                if(wtx.tx->vout[i].nValue <= nSmallestDenom/10) continue;
+                if(txout.nValue <= nSmallestDenom/10) continue;
                 // ignore mixed
-                if (IsFullyMixed(COutPoint(outpoint.hash, i))) continue;
+                if (IsFullyMixed(outpoint)) continue;
             }
 
-            if (itTallyItem == mapTally.end()) {
-                itTallyItem = mapTally.emplace(txdest, CompactTallyItem()).first;
-                itTallyItem->second.txdest = txdest;
-            }
-            itTallyItem->second.nAmount += wtx.tx->vout[i].nValue;
-            itTallyItem->second.vecInputCoins.emplace_back(wtx.tx, i);
+            item.nAmount += txout.nValue;
+            item.vecInputCoins.emplace_back(wtx.tx, outpoint.n);
         }
-    }
 
-    // construct resulting vector
-    // NOTE: vecTallyRet is "sorted" by txdest (i.e. address), just like mapTally
-    vecTallyRet.clear();
-    for (const auto& item : mapTally) {
-        if(fAnonymizable && item.second.nAmount < nSmallestDenom) continue;
-        vecTallyRet.push_back(item.second);
+        if (item.vecInputCoins.empty()) continue;
+        if(fAnonymizable && item.nAmount < nSmallestDenom) continue;
+        vecTallyRet.push_back(std::move(item));
     }
 
     // Cache already confirmed mixable entries for later use.
@@ -4090,7 +4208,7 @@ DBErrors CWallet::LoadWallet(bool& fFirstRunRet)
         for (auto& pair : mapWallet) {
             for(unsigned int i = 0; i < pair.second.tx->vout.size(); ++i) {
                 if (IsMine(pair.second.tx->vout[i]) && !IsSpent(pair.first, i)) {
-                    setWalletUTXO.insert(COutPoint(pair.first, i));
+                    AddWalletUTXO(COutPoint(pair.first, i), pair.second.tx->vout[i]);
                 }
             }
         }
@@ -4131,6 +4249,7 @@ DBErrors CWallet::ZapSelectTx(std::vector<uint256>& vHashIn, std::vector<uint256
         wtxOrdered.erase(it->second.m_it_wtxOrdered);
         mapWallet.erase(it);
     }
+    MarkBalancesDirty();
 
     if (nZapSelectTxRet == DBErrors::NEED_REWRITE)
     {
@@ -4709,6 +4828,7 @@ void CWallet::LockCoin(const COutPoint& output)
 
     fAnonymizableTallyCached = false;
     fAnonymizableTallyCachedNonDenom = false;
+    MarkBalancesDirty();
 }
 
 void CWallet::UnlockCoin(const COutPoint& output)
@@ -4720,6 +4840,7 @@ void CWallet::UnlockCoin(const COutPoint& output)
 
     fAnonymizableTallyCached = false;
     fAnonymizableTallyCachedNonDenom = false;
+    MarkBalancesDirty();
 }
 
 void CWallet::UnlockAllCoins()
@@ -5398,6 +5519,7 @@ void CWallet::NotifyTransactionLock(const CTransactionRef &tx, const std::shared
     uint256 txHash = tx->GetHash();
     std::map<uint256, CWalletTx>::const_iterator mi = mapWallet.find(txHash);
     if (mi != mapWallet.end()){
+        MarkBalancesDirty();
         NotifyTransactionChanged(this, txHash, CT_UPDATED);
         NotifyISLockReceived();
         // notify an external script
@@ -5412,6 +5534,7 @@ void CWallet::NotifyTransactionLock(const CTransactionRef &tx, const std::shared
 
 void CWallet::NotifyChainLock(const CBlockIndex* pindexChainLock, const std::shared_ptr<const llmq::CChainLockSig>& clsig)
 {
+    MarkBalancesDirty();
     NotifyChainLockReceived(pindexChainLock->nHeight);
 }
 
@@ -27,6 +27,7 @@
 #include <governance/governance-object.h>
 
 #include <algorithm>
+#include <array>
 #include <atomic>
 #include <deque>
 #include <map>
@@ -720,6 +721,7 @@ private:
     std::atomic<double> m_scanning_progress{0};
     std::mutex mutexScanning;
     friend class WalletRescanReserver;
+    friend struct CWalletUTXOTest;
 
 
     /**
@@ -747,6 +749,24 @@ private:
     mutable bool fAnonymizableTallyCachedNonDenom = false;
     mutable std::vector<CompactTallyItem> vecAnonymizableTallyCachedNonDenom;
 
+    enum class BalanceType {
+        TRUSTED,
+        UNCONFIRMED,
+        IMMATURE,
+    };
+
+    //! Bumped by MarkBalancesDirty() whenever something happens that can change a balance
+    std::atomic<uint64_t> nBalancesGeneration{0};
+    mutable CCriticalSection cs_balances;
+    //! Balances by query (type, filter, min depth, add locked), with the generation they were computed at
+    mutable std::map<std::tuple<BalanceType, isminefilter, int, bool>, std::pair<uint64_t, CAmount>> mapCachedBalances GUARDED_BY(cs_balances);
+
+    /**
+     * Return the cached balance for the query or compute it, under cs_main and
+     * cs_wallet, if the wallet changed since. Hits don't take cs_main.
+     */
+    CAmount GetCachedBalance(BalanceType type, const isminefilter& filter, int min_depth, bool fAddLocked) const;
+
     /**
      * Staking parameters for wallet
      */
@@ -766,8 +786,27 @@ private:
     void AddToSpends(const uint256& wtxid);
 
     std::set<COutPoint> setWalletUTXO;
+    //! setWalletUTXO grouped by destination, kept in sync by AddWalletUTXO()/RemoveWalletUTXO()
+    std::map<CTxDestination, std::set<COutPoint>> mapWalletUTXOByDest;
+
+    //! What the amount of an output makes it usable for, the coin types of AvailableCoins() map to these
+    enum UTXOBucket {
+        UTXO_DENOMINATED,
+        UTXO_COINJOIN_COLLATERAL,
+        UTXO_MASTERNODE_COLLATERAL,
+        UTXO_OTHER,
+        UTXO_BUCKET_COUNT,
+    };
+    static UTXOBucket GetUTXOBucket(CAmount nValue);
+    //! setWalletUTXO split by bucket, kept in sync by AddWalletUTXO()/RemoveWalletUTXO()
+    std::array<std::set<COutPoint>, UTXO_BUCKET_COUNT> arrWalletUTXOByBucket;
     mutable std::map<COutPoint, int> mapOutpointRoundsCache;
 
+    bool AddWalletUTXO(const COutPoint& outpoint, const CTxOut& txout) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+    void RemoveWalletUTXO(const COutPoint& outpoint) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+    //! Put an output back into setWalletUTXO once the transaction spending it was abandoned or conflicted
+    void RestoreWalletUTXO(const COutPoint& outpoint, const CWalletTx& wtxPrev) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+
     /* Mark a transaction (and its in-wallet descendants) as conflicting with a particular block. */
     void MarkConflicted(const uint256& hashBlock, const uint256& hashTx);
 
@@ -1061,6 +1100,9 @@ public:
     CAmount GetImmatureBalance() const;
     CAmount GetUnconfirmedWatchOnlyBalance() const;
     CAmount GetImmatureWatchOnlyBalance() const;
+    //! Invalidate the cached balances, called on wallet transaction, block, mempool and lock events
+    void MarkBalancesDirty() { ++nBalancesGeneration; }
+    uint64_t GetBalancesGeneration() const { return nBalancesGeneration; }
     CAmount GetLegacyBalance(const isminefilter& filter, int minDepth, const std::string* account, const bool fAddLocked) const;
 
     CAmount GetAnonymizableBalance(bool fSkipDenominated = false, bool fSkipUnconfirmed = true) const;
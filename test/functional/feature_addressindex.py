@@ -12,6 +12,9 @@ from test_framework.util import *
 from test_framework.script import *
 from test_framework.mininode import *
 import binascii
+import http.client
+import json
+import urllib.parse
 
 class AddressIndexTest(BitcoinTestFramework):
 
@@ -204,6 +207,47 @@ class AddressIndexTest(BitcoinTestFramework):
         deltas = self.nodes[1].getaddressdeltas({"addresses": [address2], "start": 113, "end": 113})
         assert_equal(len(deltas), 1)
 
+        # Check that deltas can be paged through with a cursor
+        self.log.info("Testing pagination...")
+        page = self.nodes[1].getaddressdeltas({"addresses": [address2], "limit": 1})
+        assert_equal(len(page["deltas"]), 1)
+        assert_equal(page["deltas"][0], deltasAll[0])
+        paged = page["deltas"]
+        while page["cursor"] is not None:
+            page = self.nodes[1].getaddressdeltas({"addresses": [address2], "limit": 1, "cursor": page["cursor"]})
+            paged += page["deltas"]
+        assert_equal(paged, deltasAll)
+        txids_page = self.nodes[1].getaddresstxids({"addresses": [address2], "limit": len(deltasAll)})
+        assert_equal(txids_page["txids"], self.nodes[1].getaddresstxids(address2))
+        assert_raises_rpc_error(-8, "Invalid cursor", self.nodes[1].getaddressutxos, {"addresses": [address2], "cursor": "00"})
+
+        # Without pagination, the deltas are streamed as a chunked reply
+        self.log.info("Testing streamed replies...")
+        url = urllib.parse.urlparse(self.nodes[1].url)
+        authpair = url.username + ':' + url.password
+        headers = {"Authorization": "Basic " + str_to_b64str(authpair)}
+        conn = http.client.HTTPConnection(url.hostname, url.port)
+        conn.connect()
+        conn.request('POST', '/', json.dumps({"method": "getaddressdeltas", "params": [{"addresses": [address2]}], "id": 1}), headers)
+        response = conn.getresponse()
+        assert_equal(response.status, 200)
+        assert_equal(response.getheader('Transfer-Encoding'), 'chunked')
+        reply = json.loads(response.read().decode('utf-8'))
+        assert_equal(reply["error"], None)
+        assert_equal(reply["id"], 1)
+        assert_equal(reply["result"], deltasAll)
+        # The connection stays usable after a streamed reply
+        conn.request('POST', '/', json.dumps({"method": "getaddresstxids", "params": [address2], "id": 2}), headers)
+        response = conn.getresponse()
+        assert_equal(response.getheader('Transfer-Encoding'), 'chunked')
+        assert_equal(json.loads(response.read().decode('utf-8'))["result"], self.nodes[1].getaddresstxids(address2))
+        # Batches are not streamed
+        conn.request('POST', '/', json.dumps([{"method": "getaddressdeltas", "params": [{"addresses": [address2]}], "id": 3}]), headers)
+        response = conn.getresponse()
+        assert_equal(response.getheader('Transfer-Encoding'), None)
+        assert_equal(json.loads(response.read().decode('utf-8'))[0]["result"], deltasAll)
+        conn.close()
+
         # Check that unspent outputs can be queried
         self.log.info("Testing utxos...")
         utxos = self.nodes[1].getaddressutxos({"addresses": [address2]})